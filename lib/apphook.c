@@ -29,6 +29,7 @@
 #include "alarms.h"
 #include "stats/stats-registry.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 #include "logsource.h"
 #include "logwriter.h"
 #include "afinter.h"
@@ -44,6 +45,7 @@
 #include "secret-storage/secret-storage.h"
 #include "transport/transport-factory-id.h"
 #include "msg-stats.h"
+#include "pcre-exec.h"
 
 #include <iv.h>
 #include <iv_work.h>
@@ -157,7 +159,6 @@ app_startup(void)
   crypto_init();
   hostname_global_init();
   dns_caching_global_init();
-  dns_caching_thread_init();
   afinter_global_init();
   child_manager_init();
   alarm_init();
@@ -206,6 +207,7 @@ app_shutdown(void)
   main_loop_thread_resource_deinit();
   secret_storage_deinit();
   scratch_buffers_allocator_deinit();
+  log_pcre_thread_deinit();
   scratch_buffers_global_deinit();
   value_pairs_global_deinit();
   log_template_global_deinit();
@@ -217,7 +219,6 @@ app_shutdown(void)
   child_manager_deinit();
   g_list_foreach(application_hooks, (GFunc) g_free, NULL);
   g_list_free(application_hooks);
-  dns_caching_thread_deinit();
   dns_caching_global_deinit();
   hostname_global_deinit();
   crypto_deinit();
@@ -255,7 +256,6 @@ void
 app_thread_start(void)
 {
   scratch_buffers_allocator_init();
-  dns_caching_thread_init();
   main_loop_call_thread_init();
 }
 
@@ -263,6 +263,7 @@ void
 app_thread_stop(void)
 {
   main_loop_call_thread_deinit();
-  dns_caching_thread_deinit();
   scratch_buffers_allocator_deinit();
+  log_msg_slab_thread_deinit();
+  log_pcre_thread_deinit();
 }
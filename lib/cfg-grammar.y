@@ -205,6 +205,7 @@ extern struct _LogRewrite *last_rewrite;
 %token KW_TYPE                        10083
 %token KW_STATS_MAX_DYNAMIC           10084
 %token KW_MIN_IW_SIZE_PER_READER      10085
+%token KW_REORDER_FILTERS             10086
 %token KW_BATCH_LINES                 10087
 %token KW_BATCH_TIMEOUT               10088
 %token KW_TRIM_LARGE_MESSAGES         10089
@@ -227,6 +228,7 @@ extern struct _LogRewrite *last_rewrite;
 %token KW_DNS_CACHE_EXPIRE            10130
 %token KW_DNS_CACHE_EXPIRE_FAILED     10131
 %token KW_DNS_CACHE_HOSTS             10132
+%token KW_DNS_RESOLVER_THREADS        10133
 
 %token KW_PERSIST_ONLY                10140
 %token KW_USE_RCPTID                  10141
@@ -237,6 +239,7 @@ extern struct _LogRewrite *last_rewrite;
 %token KW_FRAC_DIGITS                 10152
 
 %token KW_LOG_FIFO_SIZE               10160
+%token KW_LOG_FIFO_IMPL               10161
 %token KW_LOG_FETCH_LIMIT             10162
 %token KW_LOG_IW_SIZE                 10163
 %token KW_LOG_PREFIX                  10164
@@ -354,6 +357,10 @@ extern struct _LogRewrite *last_rewrite;
 %token KW_RETRIES                     10512
 
 %token KW_FETCH_NO_DATA_DELAY         10513
+
+%token KW_WORKER_PARTITION_KEY        10514
+
+%token KW_WRITE_BATCH_LINES           10515
 /* END_DECLS */
 
 %code {
@@ -375,6 +382,7 @@ extern struct _LogRewrite *last_rewrite;
 #include "block-ref-parser.h"
 #include "plugin.h"
 #include "logwriter.h"
+#include "logqueue-fifo.h"
 #include "messages.h"
 
 #include "syslog-names.h"
@@ -996,6 +1004,7 @@ options_item
 	| KW_PASS_UNIX_CREDENTIALS '(' yesno ')' { configuration->pass_unix_credentials = $3; }
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
+	| KW_REORDER_FILTERS '(' yesno ')'	{ configuration->reorder_filters = $3; }
 	| KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ configuration->log_fifo_size = $3; }
 	| KW_LOG_IW_SIZE '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-iw-size() option was removed, please use a per-source log-iw-size()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_FETCH_LIMIT '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()", cfg_lexer_format_location_tag(lexer, &@1)); }
@@ -1008,6 +1017,7 @@ options_item
 	| KW_PROTO_TEMPLATE '(' string ')'	{ configuration->proto_template_name = g_strdup($3); free($3); }
 	| KW_RECV_TIME_ZONE '(' string ')'	{ configuration->recv_time_zone = g_strdup($3); free($3); }
 	| KW_MIN_IW_SIZE_PER_READER '(' positive_integer ')' { configuration->min_iw_size_per_reader = $3; }
+	| KW_DNS_RESOLVER_THREADS '(' nonnegative_integer ')' { configuration->dns_resolver_threads = $3; }
 	| { last_template_options = &configuration->template_options; } template_option
 	| { last_host_resolve_options = &configuration->host_resolve_options; } host_resolve_option
 	| { last_stats_options = &configuration->stats_options; } stat_option
@@ -1235,6 +1245,14 @@ dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
 
 	: KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
+	| KW_LOG_FIFO_IMPL '(' string ')'
+          {
+            gint impl = log_queue_fifo_lookup_impl($3);
+
+            CHECK_ERROR(impl != -1, @3, "unknown log-fifo-impl() argument %s", $3);
+            ((LogDestDriver *) last_driver)->log_fifo_impl = impl;
+            free($3);
+          }
 	| KW_THROTTLE '(' nonnegative_integer ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
         | inner_dest
         | driver_option
@@ -1248,6 +1266,10 @@ threaded_dest_driver_option
         }
         | KW_BATCH_LINES '(' nonnegative_integer ')' { log_threaded_dest_driver_set_batch_lines(last_driver, $3); }
         | KW_BATCH_TIMEOUT '(' positive_integer ')' { log_threaded_dest_driver_set_batch_timeout(last_driver, $3); }
+        | KW_WORKER_PARTITION_KEY '(' template_content ')'
+          {
+            log_threaded_dest_driver_set_worker_partition_key_ref(last_driver, $3);
+          }
         | dest_driver_option
         ;
 
@@ -1353,6 +1375,7 @@ dest_writer_option
 
 	: KW_FLAGS '(' dest_writer_options_flags ')' { last_writer_options->options = $3; }
 	| KW_FLUSH_LINES '(' nonnegative_integer ')'		{ last_writer_options->flush_lines = $3; }
+	| KW_WRITE_BATCH_LINES '(' nonnegative_integer ')'	{ last_writer_options->write_batch_lines = $3; }
 	| KW_FLUSH_TIMEOUT '(' positive_integer ')'	{ }
         | KW_SUPPRESS '(' nonnegative_integer ')'            { last_writer_options->suppress = $3; }
 	| KW_TEMPLATE '(' string ')'       	{
@@ -162,6 +162,8 @@ typedef struct _CfgTree
   GlobalConfig *cfg;
   GPtrArray *initialized_pipes;
   gint anon_counters[ENC_MAX];
+  /* numbers the AND/OR filter nodes with reorder-filters(yes), see filter-op.c */
+  gint reordered_filter_ops;
   /* hash of predefined source/filter/rewrite/parser/destination objects */
   GHashTable *objects;
   /* list of top-level rules */
@@ -32,6 +32,7 @@
 #include "userdb.h"
 #include "logmsg/logmsg.h"
 #include "dnscache.h"
+#include "dns-resolver.h"
 #include "serialize.h"
 #include "plugin.h"
 #include "cfg-parser.h"
@@ -360,6 +361,7 @@ cfg_init(GlobalConfig *cfg)
   stats_reinit(&cfg->stats_options);
 
   dns_caching_update_options(&cfg->dns_cache_options);
+  dns_resolver_set_threads(cfg->dns_resolver_threads);
   hostname_reinit(cfg->custom_domain);
   host_resolve_options_init_globals(&cfg->host_resolve_options);
   log_template_options_init(&cfg->template_options, cfg);
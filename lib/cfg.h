@@ -83,6 +83,7 @@ struct _GlobalConfig
   gchar *bad_hostname_re;
   gchar *custom_domain;
   DNSCacheOptions dns_cache_options;
+  gint dns_resolver_threads;
   gint time_reopen;
   gint time_reap;
   gint suppress;
@@ -96,6 +97,7 @@ struct _GlobalConfig
   FilePermOptions file_perm_options;
   GList *source_mangle_callback_list;
   gboolean use_uniqid;
+  gboolean reorder_filters;
 
   gboolean keep_timestamp;
 
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "dns-resolver.h"
+#include "host-resolve.h"
+#include "messages.h"
+
+typedef struct _DNSResolverCallbackEntry
+{
+  DNSResolverCallback func;
+  gpointer user_data;
+} DNSResolverCallbackEntry;
+
+typedef struct _DNSResolverRequest
+{
+  gchar *address;
+  GSockAddr *saddr;
+  GArray *callbacks;
+} DNSResolverRequest;
+
+static struct
+{
+  GMutex *lock;
+  GCond *wakeup_cond;
+  GCond *stopped_cond;
+  GQueue *requests;
+  /* pending requests indexed by the formatted address */
+  GHashTable *requests_by_address;
+  gint num_threads;
+  gint running_threads;
+  gboolean quit;
+} dns_resolver;
+
+static DNSResolverRequest *
+dns_resolver_request_new(GSockAddr *saddr, const gchar *address)
+{
+  DNSResolverRequest *self = g_new0(DNSResolverRequest, 1);
+
+  self->address = g_strdup(address);
+  self->saddr = g_sockaddr_ref(saddr);
+  self->callbacks = g_array_new(FALSE, FALSE, sizeof(DNSResolverCallbackEntry));
+  return self;
+}
+
+static void
+dns_resolver_request_free(DNSResolverRequest *self)
+{
+  g_free(self->address);
+  g_sockaddr_unref(self->saddr);
+  g_array_free(self->callbacks, TRUE);
+  g_free(self);
+}
+
+static void
+dns_resolver_request_complete(DNSResolverRequest *self)
+{
+  for (gint i = 0; i < self->callbacks->len; i++)
+    {
+      DNSResolverCallbackEntry *callback = &g_array_index(self->callbacks, DNSResolverCallbackEntry, i);
+
+      callback->func(callback->user_data);
+    }
+}
+
+static gpointer
+_resolver_thread_func(gpointer user_data)
+{
+  DNSResolverRequest *request;
+
+  g_mutex_lock(dns_resolver.lock);
+  while (!dns_resolver.quit)
+    {
+      request = g_queue_pop_head(dns_resolver.requests);
+      if (!request)
+        {
+          g_cond_wait(dns_resolver.wakeup_cond, dns_resolver.lock);
+          continue;
+        }
+      g_mutex_unlock(dns_resolver.lock);
+
+      resolve_sockaddr_into_dns_cache(request->saddr);
+
+      /* no more callbacks can be added once the request is removed */
+      g_mutex_lock(dns_resolver.lock);
+      g_hash_table_remove(dns_resolver.requests_by_address, request->address);
+      g_mutex_unlock(dns_resolver.lock);
+
+      dns_resolver_request_complete(request);
+      dns_resolver_request_free(request);
+
+      g_mutex_lock(dns_resolver.lock);
+    }
+  dns_resolver.running_threads--;
+  g_cond_signal(dns_resolver.stopped_cond);
+  g_mutex_unlock(dns_resolver.lock);
+  return NULL;
+}
+
+gboolean
+dns_resolver_is_running(void)
+{
+  return dns_resolver.num_threads > 0;
+}
+
+void
+dns_resolver_resolve_async(GSockAddr *saddr, DNSResolverCallback callback, gpointer user_data)
+{
+  DNSResolverCallbackEntry entry = { .func = callback, .user_data = user_data };
+  DNSResolverRequest *request;
+  gchar address[64];
+
+  g_assert(dns_resolver_is_running());
+
+  g_sockaddr_format(saddr, address, sizeof(address), GSA_ADDRESS_ONLY);
+
+  g_mutex_lock(dns_resolver.lock);
+  request = g_hash_table_lookup(dns_resolver.requests_by_address, address);
+  if (!request)
+    {
+      request = dns_resolver_request_new(saddr, address);
+      g_hash_table_insert(dns_resolver.requests_by_address, request->address, request);
+      g_queue_push_tail(dns_resolver.requests, request);
+      g_cond_signal(dns_resolver.wakeup_cond);
+    }
+  g_array_append_val(request->callbacks, entry);
+  g_mutex_unlock(dns_resolver.lock);
+}
+
+/* NOTE: runs in the main thread, the number of threads is never decreased */
+void
+dns_resolver_set_threads(gint num_threads)
+{
+  if (num_threads <= dns_resolver.num_threads)
+    return;
+
+  if (!dns_resolver.lock)
+    {
+      dns_resolver.lock = g_mutex_new();
+      dns_resolver.wakeup_cond = g_cond_new();
+      dns_resolver.stopped_cond = g_cond_new();
+      dns_resolver.requests = g_queue_new();
+      dns_resolver.requests_by_address = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+
+  msg_debug("Starting DNS resolver threads",
+            evt_tag_int("threads", num_threads));
+
+  g_mutex_lock(dns_resolver.lock);
+  dns_resolver.quit = FALSE;
+  for (; dns_resolver.num_threads < num_threads; dns_resolver.num_threads++)
+    {
+      GThread *thread = g_thread_create(_resolver_thread_func, NULL, FALSE, NULL);
+
+      g_assert(thread != NULL);
+      dns_resolver.running_threads++;
+    }
+  g_mutex_unlock(dns_resolver.lock);
+}
+
+/*
+ * NOTE: runs in the main thread, once all sources are stopped, so that no
+ * new requests are submitted.  Requests still in the queue are completed
+ * before the threads exit.
+ */
+void
+dns_resolver_stop(void)
+{
+  if (!dns_resolver.lock)
+    return;
+
+  g_mutex_lock(dns_resolver.lock);
+  while (dns_resolver.requests->length > 0)
+    {
+      DNSResolverRequest *request = g_queue_pop_head(dns_resolver.requests);
+
+      g_hash_table_remove(dns_resolver.requests_by_address, request->address);
+      g_mutex_unlock(dns_resolver.lock);
+      dns_resolver_request_complete(request);
+      dns_resolver_request_free(request);
+      g_mutex_lock(dns_resolver.lock);
+    }
+
+  dns_resolver.quit = TRUE;
+  g_cond_broadcast(dns_resolver.wakeup_cond);
+  while (dns_resolver.running_threads > 0)
+    g_cond_wait(dns_resolver.stopped_cond, dns_resolver.lock);
+  dns_resolver.num_threads = 0;
+  g_mutex_unlock(dns_resolver.lock);
+
+  g_hash_table_destroy(dns_resolver.requests_by_address);
+  g_queue_free(dns_resolver.requests);
+  g_cond_free(dns_resolver.stopped_cond);
+  g_cond_free(dns_resolver.wakeup_cond);
+  g_mutex_free(dns_resolver.lock);
+  dns_resolver.lock = NULL;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef DNS_RESOLVER_H_INCLUDED
+#define DNS_RESOLVER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "gsockaddr.h"
+
+/*
+ * A pool of threads resolving addresses into the shared DNS cache, so that
+ * a slow DNS server does not block the thread that needed the name.
+ *
+ * The callback is invoked from one of the resolver threads once the result
+ * is available in the DNS cache.  Resolver threads are not worker threads,
+ * so the callback must not process messages, only hand them back to the
+ * thread that owns them.  Requests for an address that is already being
+ * resolved are merged into the pending one.
+ */
+typedef void (*DNSResolverCallback)(gpointer user_data);
+
+gboolean dns_resolver_is_running(void);
+void dns_resolver_resolve_async(GSockAddr *saddr, DNSResolverCallback callback, gpointer user_data);
+
+void dns_resolver_set_threads(gint num_threads);
+void dns_resolver_stop(void);
+
+#endif
@@ -25,7 +25,6 @@
 #include "dnscache.h"
 #include "messages.h"
 #include "timeutils/cache.h"
-#include "tls-support.h"
 
 #include <sys/types.h>
 #include <netinet/in.h>
@@ -286,6 +285,27 @@ dns_cache_check_hosts(DNSCache *self, glong t)
     }
 }
 
+static DNSCacheEntry *
+dns_cache_lookup_entry(DNSCache *self, gint family, void *addr, time_t now)
+{
+  DNSCacheKey key;
+  DNSCacheEntry *entry;
+
+  dns_cache_fill_key(&key, family, addr);
+  entry = g_hash_table_lookup(self->cache, &key);
+  if (!entry)
+    return NULL;
+
+  if (entry->resolved &&
+      ((entry->positive && entry->resolved < now - self->options->expire) ||
+       (!entry->positive && entry->resolved < now - self->options->expire_failed)))
+    {
+      /* the entry is not persistent and is too old */
+      return NULL;
+    }
+  return entry;
+}
+
 /*
  * @hostname        is set to the stored hostname,
  * @positive        is set whether the match was a DNS match or failure
@@ -297,30 +317,19 @@ gboolean
 dns_cache_lookup(DNSCache *self, gint family, void *addr, const gchar **hostname, gsize *hostname_len,
                  gboolean *positive)
 {
-  DNSCacheKey key;
   DNSCacheEntry *entry;
   time_t now;
 
   now = cached_g_current_time_sec();
   dns_cache_check_hosts(self, now);
 
-  dns_cache_fill_key(&key, family, addr);
-  entry = g_hash_table_lookup(self->cache, &key);
+  entry = dns_cache_lookup_entry(self, family, addr, now);
   if (entry)
     {
-      if (entry->resolved &&
-          ((entry->positive && entry->resolved < now - self->options->expire) ||
-           (!entry->positive && entry->resolved < now - self->options->expire_failed)))
-        {
-          /* the entry is not persistent and is too old */
-        }
-      else
-        {
-          *hostname = entry->hostname;
-          *hostname_len = entry->hostname_len;
-          *positive = entry->positive;
-          return TRUE;
-        }
+      *hostname = entry->hostname;
+      *hostname_len = entry->hostname_len;
+      *positive = entry->positive;
+      return TRUE;
     }
   *hostname = NULL;
   *positive = FALSE;
@@ -367,69 +376,95 @@ dns_cache_options_destroy(DNSCacheOptions *options)
 }
 
 /**************************************************************************
- * The global API that manages DNSCache instances on its own. Callers need
- * not be aware of underlying data structures and locking, they can simply
- * call these functions to lookup/query the DNS cache.
+ * The global API that manages the DNSCache instance on its own. Callers
+ * need not be aware of underlying data structures and locking, they can
+ * simply call these functions to lookup/query the DNS cache.
  *
- * I would prefer these to be moved into a higher level implementation
- * detail.
+ * A single cache instance is shared by all threads, so that a name
+ * resolved by one of the worker threads is not resolved again by the
+ * others.  Lookups are much more frequent than stores, so the cache is
+ * protected by a reader-writer lock: lookups only take the reader side,
+ * which allows them to run in parallel.  Entries may be removed as soon
+ * as the lock is released, so the hostname is copied out of the cache
+ * while the lock is held.
  **************************************************************************/
 
-TLS_BLOCK_START
-{
-  DNSCache *dns_cache;
-}
-TLS_BLOCK_END;
-
-#define dns_cache __tls_deref(dns_cache)
-
 /* DNS cache related options are global, independent of the configuration
  * (e.g.  GlobalConfig instance), and they are stored in the
  * "effective_dns_cache_options" variable below.
  *
- * The reasons for using the global variable are as explained below.
- *
- * Some notes:
- *   1) DNS cache contents are better retained between configuration reloads
- *   2) There are multiple DNSCache instances as they are per-thread data structs.
- *
- * The usual pattern would be:
- *    DNSCache->options -> DNSCacheOptions
- *
- * And options would be a reference and would point inside a DNSCacheOptions
- * instance contained within the GlobalConfig.
- *
- * The problem with this approach is that we don't want to recreate DNSCache
- * instances when reloading the configuration (as we want to keep their
- * config), and this would mean that we'd have to update the "options"
- * pointers in each of the existing instances.  And those instances are
- * per-thread variables, making it a bit more difficult to track them.
- *
- * For this reason, it was a lot simpler to use a global variable to hold
- * configuration options, one that can be updated as the configuration is
- * reloaded.  Then DNSCache instances transparently take the options changes
- * into account as they continue to resolve names.
- *
- * I could come up with even better solutions to this problem (like using a
- * layer above GlobalConfig, a state that encapsulates per-execution state
- * of syslog-ng), however, right now that would be an overkill and I want to
- * get the DNSCache refactors into the master tree.
+ * DNS cache contents are better retained between configuration reloads,
+ * so the cache is not recreated when the configuration changes, it
+ * transparently takes the options changes into account as it continues to
+ * resolve names.
  */
 
 static DNSCacheOptions effective_dns_cache_options;
-G_LOCK_DEFINE_STATIC(unused_dns_caches);
-static GList *unused_dns_caches;
+static GStaticRWLock dns_cache_lock = G_STATIC_RW_LOCK_INIT;
+static DNSCache *dns_cache;
+
+/* must be called with the reader lock held, returns with the reader lock held */
+static void
+_check_hosts_file(time_t now)
+{
+  if (G_LIKELY(dns_cache->hosts_checktime == now))
+    return;
+
+  g_static_rw_lock_reader_unlock(&dns_cache_lock);
+  g_static_rw_lock_writer_lock(&dns_cache_lock);
+  dns_cache_check_hosts(dns_cache, now);
+  g_static_rw_lock_writer_unlock(&dns_cache_lock);
+  g_static_rw_lock_reader_lock(&dns_cache_lock);
+}
+
+/*
+ * The hostname is copied into @hostname, truncated to @hostname_size
+ * bytes, including the terminating NUL character.
+ */
+gboolean
+dns_caching_lookup(gint family, void *addr, gchar *hostname, gsize hostname_size, gsize *hostname_len,
+                   gboolean *positive)
+{
+  time_t now = cached_g_current_time_sec();
+  DNSCacheEntry *entry;
+
+  g_static_rw_lock_reader_lock(&dns_cache_lock);
+  _check_hosts_file(now);
+  entry = dns_cache_lookup_entry(dns_cache, family, addr, now);
+  if (entry)
+    {
+      *hostname_len = MIN(entry->hostname_len, hostname_size - 1);
+      memcpy(hostname, entry->hostname, *hostname_len);
+      hostname[*hostname_len] = 0;
+      *positive = entry->positive;
+    }
+  else
+    {
+      *positive = FALSE;
+    }
+  g_static_rw_lock_reader_unlock(&dns_cache_lock);
+  return entry != NULL;
+}
 
 gboolean
-dns_caching_lookup(gint family, void *addr, const gchar **hostname, gsize *hostname_len, gboolean *positive)
+dns_caching_is_cached(gint family, void *addr)
 {
-  return dns_cache_lookup(dns_cache, family, addr, hostname, hostname_len, positive);
+  time_t now = cached_g_current_time_sec();
+  gboolean result;
+
+  g_static_rw_lock_reader_lock(&dns_cache_lock);
+  _check_hosts_file(now);
+  result = dns_cache_lookup_entry(dns_cache, family, addr, now) != NULL;
+  g_static_rw_lock_reader_unlock(&dns_cache_lock);
+  return result;
 }
 
 void
 dns_caching_store(gint family, void *addr, const gchar *hostname, gboolean positive)
 {
+  g_static_rw_lock_writer_lock(&dns_cache_lock);
   dns_cache_store_dynamic(dns_cache, family, addr, hostname, positive);
+  g_static_rw_lock_writer_unlock(&dns_cache_lock);
 }
 
 void
@@ -437,6 +472,7 @@ dns_caching_update_options(const DNSCacheOptions *new_options)
 {
   DNSCacheOptions *options = &effective_dns_cache_options;
 
+  g_static_rw_lock_writer_lock(&dns_cache_lock);
   if (options->hosts)
     g_free(options->hosts);
 
@@ -444,49 +480,20 @@ dns_caching_update_options(const DNSCacheOptions *new_options)
   options->expire = new_options->expire;
   options->expire_failed = new_options->expire_failed;
   options->hosts = g_strdup(new_options->hosts);
-}
-
-void
-dns_caching_thread_init(void)
-{
-  g_assert(dns_cache == NULL);
-
-  G_LOCK(unused_dns_caches);
-  if (unused_dns_caches)
-    {
-      dns_cache = unused_dns_caches->data;
-      unused_dns_caches = g_list_delete_link(unused_dns_caches, unused_dns_caches);
-    }
-  G_UNLOCK(unused_dns_caches);
-
-  if (!dns_cache)
-    dns_cache = dns_cache_new(&effective_dns_cache_options);
-}
-
-void
-dns_caching_thread_deinit(void)
-{
-  g_assert(dns_cache != NULL);
-
-  G_LOCK(unused_dns_caches);
-  unused_dns_caches = g_list_prepend(unused_dns_caches, dns_cache);
-  G_UNLOCK(unused_dns_caches);
-  dns_cache = NULL;
+  g_static_rw_lock_writer_unlock(&dns_cache_lock);
 }
 
 void
 dns_caching_global_init(void)
 {
   dns_cache_options_defaults(&effective_dns_cache_options);
+  dns_cache = dns_cache_new(&effective_dns_cache_options);
 }
 
 void
 dns_caching_global_deinit(void)
 {
-  G_LOCK(unused_dns_caches);
-  g_list_foreach(unused_dns_caches, (GFunc) dns_cache_free, NULL);
-  g_list_free(unused_dns_caches);
-  unused_dns_caches = NULL;
-  G_UNLOCK(unused_dns_caches);
+  dns_cache_free(dns_cache);
+  dns_cache = NULL;
   dns_cache_options_destroy(&effective_dns_cache_options);
 }
@@ -259,6 +259,9 @@ _create_log_queue(LogDestDriver *self, const gchar *persist_name)
       return log_queue_fifo_legacy_new(log_fifo_size, persist_name);
     }
 
+  if (self->log_fifo_impl == LQF_IMPL_LOCKFREE)
+    return log_queue_fifo_lockfree_new(log_fifo_size, persist_name);
+
   return log_queue_fifo_new(log_fifo_size, persist_name);
 }
 
@@ -385,6 +388,7 @@ log_dest_driver_init_instance(LogDestDriver *self, GlobalConfig *cfg)
   self->acquire_queue = log_dest_driver_acquire_queue_method;
   self->release_queue = log_dest_driver_release_queue_method;
   self->log_fifo_size = -1;
+  self->log_fifo_impl = LQF_IMPL_LOCKED;
   self->throttle = 0;
 }
 
@@ -166,6 +166,7 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  gint log_fifo_impl;
   gint throttle;
   StatsCounterItem *queued_global_messages;
 };
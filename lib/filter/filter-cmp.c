@@ -24,6 +24,7 @@
 
 #include "filter/filter-cmp.h"
 #include "filter/filter-expr-grammar.h"
+#include "filter/filter-program.h"
 #include "scratch-buffers.h"
 
 #include <stdlib.h>
@@ -60,21 +61,14 @@ fop_compare(FilterCmp *self, const gchar *left, const gchar *right)
   return strcmp(left, right);
 }
 
+/* returns the result of the comparison without applying negation */
 static gboolean
-fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+fop_cmp_compare_values(FilterExprNode *s, LogMessage *msg, const gchar *left, const gchar *right)
 {
   FilterCmp *self = (FilterCmp *) s;
-
-  ScratchBuffersMarker marker;
-  GString *left_buf = scratch_buffers_alloc_and_mark(&marker);
-  GString *right_buf = scratch_buffers_alloc();
-
-  log_template_format_with_context(self->left, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, left_buf);
-  log_template_format_with_context(self->right, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, right_buf);
-
   gboolean result = FALSE;
 
-  gint cmp = fop_compare(self, left_buf->str, right_buf->str);
+  gint cmp = fop_compare(self, left, right);
 
   if (cmp == 0)
     {
@@ -90,15 +84,40 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
     }
 
   msg_trace("cmp() evaluation started",
-            evt_tag_str("left", left_buf->str),
+            evt_tag_str("left", left),
             evt_tag_str("operator", self->super.type),
-            evt_tag_str("right", right_buf->str),
-            evt_tag_printf("msg", "%p", msgs[num_msg - 1]));
+            evt_tag_str("right", right),
+            evt_tag_printf("msg", "%p", msg));
+
+  return result;
+}
+
+static gboolean
+fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterCmp *self = (FilterCmp *) s;
+
+  ScratchBuffersMarker marker;
+  GString *left_buf = scratch_buffers_alloc_and_mark(&marker);
+  GString *right_buf = scratch_buffers_alloc();
+
+  log_template_format_with_context(self->left, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, left_buf);
+  log_template_format_with_context(self->right, msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL, right_buf);
+
+  gboolean result = fop_cmp_compare_values(s, msgs[num_msg - 1], left_buf->str, right_buf->str);
 
   scratch_buffers_reclaim_marked(marker);
   return result ^ s->comp;
 }
 
+static void
+fop_cmp_compile(FilterExprNode *s, FilterCompiler *compiler)
+{
+  FilterCmp *self = (FilterCmp *) s;
+
+  filter_compiler_emit_cmp(compiler, s, self->left, self->right, fop_cmp_compare_values);
+}
+
 static void
 fop_cmp_free(FilterExprNode *s)
 {
@@ -181,6 +200,7 @@ fop_cmp_new(LogTemplate *left, LogTemplate *right, gint token)
   fop_map_grammar_token_to_cmp_op(self, left->cfg, token);
 
   self->super.eval = fop_cmp_eval;
+  self->super.compile = fop_cmp_compile;
   self->super.free_fn = fop_cmp_free;
   self->left = left;
   self->right = right;
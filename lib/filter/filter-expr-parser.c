@@ -58,6 +58,8 @@ static CfgLexerKeyword filter_expr_keywords[] =
   { "netmask",            KW_NETMASK },
   { "tags",               KW_TAGS },
   { "in_list",            KW_IN_LIST },
+  { "ignore_case",        KW_IGNORE_CASE },
+  { "compiled_file",      KW_COMPILED_FILE },
 #if SYSLOG_NG_ENABLE_IPV6
   { "netmask6",           KW_NETMASK6 },
 #endif
@@ -32,6 +32,7 @@
 
 struct _GlobalConfig;
 typedef struct _FilterExprNode FilterExprNode;
+typedef struct _FilterCompiler FilterCompiler;
 
 struct _FilterExprNode
 {
@@ -41,6 +42,8 @@ struct _FilterExprNode
   const gchar *type;
   gboolean (*init)(FilterExprNode *self, GlobalConfig *cfg);
   gboolean (*eval)(FilterExprNode *self, LogMessage **msg, gint num_msg);
+  /* optional, lowers the node into a FilterProgram, see filter-program.h */
+  void (*compile)(FilterExprNode *self, FilterCompiler *compiler);
   void (*free_fn)(FilterExprNode *self);
   StatsCounterItem *matched;
   StatsCounterItem *not_matched;
@@ -23,19 +23,16 @@
  */
 
 #include "filter-in-list.h"
+#include "filter/in-list-set.h"
 #include "logmsg/logmsg.h"
-#include "str-utils.h"
-
-#include <errno.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
 
 typedef struct _FilterInList
 {
   FilterExprNode super;
   NVHandle value_handle;
-  GTree *tree;
+  gboolean ignore_case;
+  gchar *compiled_file;
+  InListSet *set;
 } FilterInList;
 
 static gboolean
@@ -47,11 +44,10 @@ filter_in_list_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   gssize len = 0;
 
   value = log_msg_get_value(msg, self->value_handle, &len);
-  APPEND_ZERO(value, value, len);
 
-  gboolean result = (g_tree_lookup(self->tree, value) != NULL);
+  gboolean result = in_list_set_contains(self->set, value, len);
   msg_trace("in-list() evaluation started",
-            evt_tag_str("value", value),
+            evt_tag_printf("value", "%.*s", (gint) len, value),
             evt_tag_printf("msg", "%p", msg));
 
   return result ^ s->comp;
@@ -62,39 +58,63 @@ filter_in_list_free(FilterExprNode *s)
 {
   FilterInList *self = (FilterInList *)s;
 
-  g_tree_destroy(self->tree);
+  if (self->set)
+    in_list_set_unref(self->set);
+  g_free(self->compiled_file);
+}
+
+void
+filter_in_list_set_ignore_case(FilterExprNode *s, gboolean ignore_case)
+{
+  FilterInList *self = (FilterInList *)s;
+
+  self->ignore_case = ignore_case;
+}
+
+void
+filter_in_list_set_compiled_file(FilterExprNode *s, const gchar *compiled_file)
+{
+  FilterInList *self = (FilterInList *)s;
+
+  g_free(self->compiled_file);
+  self->compiled_file = g_strdup(compiled_file);
+}
+
+gboolean
+filter_in_list_load(FilterExprNode *s, const gchar *list_file)
+{
+  FilterInList *self = (FilterInList *)s;
+
+  if (self->set)
+    in_list_set_unref(self->set);
+
+  self->set = in_list_set_load(list_file, self->ignore_case, self->compiled_file);
+  return self->set != NULL;
 }
 
 FilterExprNode *
-filter_in_list_new(const gchar *list_file, const gchar *property)
+filter_in_list_construct(const gchar *property)
 {
   FilterInList *self;
-  FILE *stream;
-  gchar line[16384];
-
-  stream = fopen(list_file, "r");
-  if (!stream)
-    {
-      msg_error("Error opening in-list filter list file",
-                evt_tag_str("file", list_file),
-                evt_tag_error("errno"));
-      return NULL;
-    }
 
   self = g_new0(FilterInList, 1);
   filter_expr_node_init_instance(&self->super);
   self->value_handle = log_msg_get_value_handle(property);
-  self->tree = g_tree_new_full((GCompareDataFunc)strcmp, NULL, g_free, NULL);
-
-  while (fgets(line, sizeof(line), stream) != NULL)
-    {
-      line[strlen(line) - 1] = '\0';
-      if (line[0])
-        g_tree_insert(self->tree, g_strdup(line), GINT_TO_POINTER(1));
-    }
-  fclose(stream);
 
   self->super.eval = filter_in_list_eval;
   self->super.free_fn = filter_in_list_free;
   return &self->super;
 }
+
+FilterExprNode *
+filter_in_list_new(const gchar *list_file, const gchar *property)
+{
+  FilterExprNode *self = filter_in_list_construct(property);
+
+  if (!filter_in_list_load(self, list_file))
+    {
+      filter_expr_unref(self);
+      return NULL;
+    }
+  return self;
+}
@@ -29,5 +29,9 @@
 
 FilterExprNode *filter_in_list_new(const gchar *list_file,
                                    const gchar *property);
+FilterExprNode *filter_in_list_construct(const gchar *property);
+void filter_in_list_set_ignore_case(FilterExprNode *s, gboolean ignore_case);
+void filter_in_list_set_compiled_file(FilterExprNode *s, const gchar *compiled_file);
+gboolean filter_in_list_load(FilterExprNode *s, const gchar *list_file);
 
 #endif
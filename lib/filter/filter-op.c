@@ -22,13 +22,293 @@
  *
  */
 #include "filter-op.h"
+#include "filter-program.h"
+#include "cfg.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "timeutils/misc.h"
+#include "tls-support.h"
+
+#include <time.h>
+
+/*
+ * Adaptive operand ordering
+ *
+ * AND and OR are commutative as long as none of the operands change the
+ * message, so with reorder-filters(yes) the operand that is expected to
+ * decide the result at the lower cost is evaluated first.  For that, a
+ * small random sample of the evaluations evaluate both operands, measuring
+ * their cost and match rate.  Once enough samples were collected, the
+ * expected cost of both orders is compared:
+ *
+ *   AND: cost(first) + match_rate(first) * cost(second)
+ *   OR:  cost(first) + (1 - match_rate(first)) * cost(second)
+ *
+ * The order is only changed if the other one is significantly cheaper.
+ * The statistics are halved after each decision, so that the order follows
+ * changes in the traffic.
+ */
+
+/* every FOP_SAMPLE_INTERVAL .. 2 * FOP_SAMPLE_INTERVAL - 1th evaluation is sampled */
+#define FOP_SAMPLE_INTERVAL 32
+#define FOP_SAMPLES_PER_DECISION 128
+/* in percents of the expected cost of the current order */
+#define FOP_REORDER_THRESHOLD 90
+#define FOP_MAX_SAMPLE_COST_NSEC 1000000
+
+enum
+{
+  FOP_LEFT,
+  FOP_RIGHT,
+  FOP_OPERANDS
+};
+
+typedef struct _FilterOpOperandStats
+{
+  gint64 cost;
+  gint matched;
+
+  StatsCounterItem *evaluated_counter;
+  StatsCounterItem *matched_counter;
+  StatsCounterItem *cost_counter;
+} FilterOpOperandStats;
 
 typedef struct _FilterOp
 {
   FilterExprNode super;
   FilterExprNode *left, *right;
+  gboolean is_and;
+
+  /* adaptive ordering */
+  gint swapped;
+  GMutex *stats_lock;
+  gint samples;
+  FilterOpOperandStats operand_stats[FOP_OPERANDS];
+  gchar *stats_instance;
+  StatsCounterItem *swapped_counter;
 } FilterOp;
 
+static const gchar *operand_counter_names[FOP_OPERANDS][3] =
+{
+  { "left_evaluated", "left_matched", "left_cost_nsec" },
+  { "right_evaluated", "right_matched", "right_cost_nsec" },
+};
+
+TLS_BLOCK_START
+{
+  gint fop_sample_countdown;
+  guint32 fop_sample_seed;
+}
+TLS_BLOCK_END;
+
+#define fop_sample_countdown __tls_deref(fop_sample_countdown)
+#define fop_sample_seed __tls_deref(fop_sample_seed)
+
+static gboolean
+_should_sample(void)
+{
+  if (G_LIKELY(--fop_sample_countdown > 0))
+    return FALSE;
+
+  /* xorshift, so that nodes evaluated in a fixed pattern are sampled evenly */
+  if (!fop_sample_seed)
+    fop_sample_seed = g_random_int() | 1;
+  fop_sample_seed ^= fop_sample_seed << 13;
+  fop_sample_seed ^= fop_sample_seed >> 17;
+  fop_sample_seed ^= fop_sample_seed << 5;
+  fop_sample_countdown = FOP_SAMPLE_INTERVAL + fop_sample_seed % FOP_SAMPLE_INTERVAL;
+  return TRUE;
+}
+
+/* the expected cost of @samples evaluations when starting with @first */
+static gint64
+_expected_cost(FilterOp *self, gint first)
+{
+  FilterOpOperandStats *first_stats = &self->operand_stats[first];
+  FilterOpOperandStats *second_stats = &self->operand_stats[!first];
+  gint second_evaluated;
+
+  /* the second operand is only evaluated if the first did not decide the result */
+  if (self->is_and)
+    second_evaluated = first_stats->matched;
+  else
+    second_evaluated = self->samples - first_stats->matched;
+
+  return first_stats->cost * self->samples + second_stats->cost * second_evaluated;
+}
+
+static void
+_choose_order(FilterOp *self)
+{
+  gint current_first = g_atomic_int_get(&self->swapped) ? FOP_RIGHT : FOP_LEFT;
+  gint64 current_cost = _expected_cost(self, current_first);
+  gint64 other_cost = _expected_cost(self, !current_first);
+
+  if (other_cost * 100 < current_cost * FOP_REORDER_THRESHOLD)
+    {
+      g_atomic_int_set(&self->swapped, current_first == FOP_LEFT);
+      stats_counter_set(self->swapped_counter, current_first == FOP_LEFT);
+    }
+
+  self->samples /= 2;
+  for (gint i = 0; i < FOP_OPERANDS; i++)
+    {
+      self->operand_stats[i].cost /= 2;
+      self->operand_stats[i].matched /= 2;
+    }
+}
+
+static gboolean
+_eval_operand_sampled(FilterExprNode *operand, LogMessage **msgs, gint num_msg, glong *cost)
+{
+  struct timespec start, stop;
+  gboolean result;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  result = filter_expr_eval_with_context(operand, msgs, num_msg);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  *cost = CLAMP(timespec_diff_nsec(&stop, &start), 1, FOP_MAX_SAMPLE_COST_NSEC);
+  return result;
+}
+
+static void
+_record_sample(FilterOp *self, gint operand, gboolean result, glong cost)
+{
+  FilterOpOperandStats *stats = &self->operand_stats[operand];
+
+  stats->cost += cost;
+  stats->matched += !!result;
+
+  stats_counter_inc(stats->evaluated_counter);
+  stats_counter_add(stats->cost_counter, cost);
+  if (result)
+    stats_counter_inc(stats->matched_counter);
+}
+
+/* evaluates both operands, regardless of the result of the first one */
+static gboolean
+fop_eval_sampled(FilterOp *self, LogMessage **msgs, gint num_msg)
+{
+  glong left_cost, right_cost;
+  gboolean left_result = _eval_operand_sampled(self->left, msgs, num_msg, &left_cost);
+  gboolean right_result = _eval_operand_sampled(self->right, msgs, num_msg, &right_cost);
+
+  g_mutex_lock(self->stats_lock);
+  _record_sample(self, FOP_LEFT, left_result, left_cost);
+  _record_sample(self, FOP_RIGHT, right_result, right_cost);
+  if (++self->samples >= FOP_SAMPLES_PER_DECISION)
+    _choose_order(self);
+  g_mutex_unlock(self->stats_lock);
+
+  if (self->is_and)
+    return left_result && right_result;
+  return left_result || right_result;
+}
+
+static gboolean
+fop_eval_adaptive(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterOp *self = (FilterOp *) s;
+  FilterExprNode *first = self->left;
+  FilterExprNode *second = self->right;
+  gboolean result;
+
+  if (G_UNLIKELY(_should_sample()))
+    return fop_eval_sampled(self, msgs, num_msg) ^ s->comp;
+
+  if (g_atomic_int_get(&self->swapped))
+    {
+      first = self->right;
+      second = self->left;
+    }
+
+  result = filter_expr_eval_with_context(first, msgs, num_msg);
+  if (result == self->is_and)
+    result = filter_expr_eval_with_context(second, msgs, num_msg);
+  return result ^ s->comp;
+}
+
+static const gchar *
+_get_operand_type(FilterExprNode *operand)
+{
+  return operand->type ? operand->type : "filter";
+}
+
+static void
+_register_reorder_counter(FilterOp *self, const gchar *name, StatsCounterItem **counter)
+{
+  StatsClusterKey sc_key;
+
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_FILTER, "reorder", self->stats_instance, name);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+static void
+_unregister_reorder_counter(FilterOp *self, const gchar *name, StatsCounterItem **counter)
+{
+  StatsClusterKey sc_key;
+
+  stats_cluster_single_key_set_with_name(&sc_key, SCS_FILTER, "reorder", self->stats_instance, name);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+static void
+fop_register_reorder_counters(FilterOp *self)
+{
+  stats_lock();
+  _register_reorder_counter(self, "swapped", &self->swapped_counter);
+  for (gint i = 0; i < FOP_OPERANDS; i++)
+    {
+      FilterOpOperandStats *stats = &self->operand_stats[i];
+
+      _register_reorder_counter(self, operand_counter_names[i][0], &stats->evaluated_counter);
+      _register_reorder_counter(self, operand_counter_names[i][1], &stats->matched_counter);
+      _register_reorder_counter(self, operand_counter_names[i][2], &stats->cost_counter);
+    }
+  stats_unlock();
+}
+
+static void
+fop_unregister_reorder_counters(FilterOp *self)
+{
+  stats_lock();
+  _unregister_reorder_counter(self, "swapped", &self->swapped_counter);
+  for (gint i = 0; i < FOP_OPERANDS; i++)
+    {
+      FilterOpOperandStats *stats = &self->operand_stats[i];
+
+      _unregister_reorder_counter(self, operand_counter_names[i][0], &stats->evaluated_counter);
+      _unregister_reorder_counter(self, operand_counter_names[i][1], &stats->matched_counter);
+      _unregister_reorder_counter(self, operand_counter_names[i][2], &stats->cost_counter);
+    }
+  stats_unlock();
+}
+
+/* counters are identified by the position of the node within the
+ * configuration and the operands as written, so a reload of the same
+ * configuration gets the same names */
+static void
+fop_enable_reordering(FilterOp *self, GlobalConfig *cfg)
+{
+  if (self->stats_instance)
+    return;
+
+  self->stats_instance = g_strdup_printf("#%d %s %s %s", cfg->tree.reordered_filter_ops++,
+                                         _get_operand_type(self->left), self->super.type,
+                                         _get_operand_type(self->right));
+  fop_register_reorder_counters(self);
+  self->super.eval = fop_eval_adaptive;
+}
+
+gboolean
+fop_is_reordered(FilterExprNode *s)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  return g_atomic_int_get(&self->swapped);
+}
+
 static gboolean
 fop_init(FilterExprNode *s, GlobalConfig *cfg)
 {
@@ -45,6 +325,9 @@ fop_init(FilterExprNode *s, GlobalConfig *cfg)
 
   self->super.modify = self->left->modify || self->right->modify;
 
+  if (cfg && cfg->reorder_filters && !self->super.modify)
+    fop_enable_reordering(self, cfg);
+
   return TRUE;
 }
 
@@ -53,16 +336,37 @@ fop_free(FilterExprNode *s)
 {
   FilterOp *self = (FilterOp *) s;
 
+  if (self->stats_instance)
+    fop_unregister_reorder_counters(self);
+  g_free(self->stats_instance);
+  g_mutex_free(self->stats_lock);
+
   filter_expr_unref(self->left);
   filter_expr_unref(self->right);
 }
 
+static void
+fop_compile(FilterExprNode *s, FilterCompiler *compiler)
+{
+  FilterOp *self = (FilterOp *) s;
+
+  /* the evaluation order of adaptive nodes changes at runtime */
+  if (s->eval == fop_eval_adaptive)
+    filter_compiler_emit_eval(compiler, s);
+  else if (self->is_and)
+    filter_compiler_emit_and(compiler, self->left, self->right, s->comp);
+  else
+    filter_compiler_emit_or(compiler, self->left, self->right, s->comp);
+}
+
 static void
 fop_init_instance(FilterOp *self)
 {
   filter_expr_node_init_instance(&self->super);
   self->super.init = fop_init;
+  self->super.compile = fop_compile;
   self->super.free_fn = fop_free;
+  self->stats_lock = g_mutex_new();
 }
 
 static gboolean
@@ -103,6 +407,7 @@ fop_and_new(FilterExprNode *e1, FilterExprNode *e2)
 
   fop_init_instance(self);
   self->super.eval = fop_and_eval;
+  self->is_and = TRUE;
   self->left = e1;
   self->right = e2;
   self->super.type = "AND";
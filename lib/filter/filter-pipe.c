@@ -24,6 +24,7 @@
 
 #include "filter/filter-pipe.h"
 #include "stats/stats-registry.h"
+#include "messages.h"
 
 /*******************************************************************
  * LogFilterPipe
@@ -38,6 +39,10 @@ log_filter_pipe_init(LogPipe *s)
   if (!filter_expr_init(self->expr, cfg))
     return FALSE;
 
+  if (self->program)
+    filter_program_free(self->program);
+  self->program = filter_program_compile(self->expr);
+
   if (!self->name)
     self->name = cfg_tree_get_rule_name(&cfg->tree, ENC_FILTER, s->expr_node);
 
@@ -63,7 +68,11 @@ log_filter_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
             log_pipe_location_tag(s),
             evt_tag_printf("msg", "%p", msg));
 
-  res = filter_expr_eval_root(self->expr, &msg, path_options);
+  /* the program skips the per-node trace messages, so it is not used while tracing */
+  if (self->program && !trace_flag)
+    res = filter_program_eval_root(self->program, &msg, path_options);
+  else
+    res = filter_expr_eval_root(self->expr, &msg, path_options);
 
   if (res)
     {
@@ -108,6 +117,8 @@ log_filter_pipe_free(LogPipe *s)
   stats_unlock();
 
   g_free(self->name);
+  if (self->program)
+    filter_program_free(self->program);
   filter_expr_unref(self->expr);
   log_pipe_free_method(s);
 }
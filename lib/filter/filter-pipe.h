@@ -26,6 +26,7 @@
 #define FILTER_PIPE_H_INCLUDED
 
 #include "filter/filter-expr.h"
+#include "filter/filter-program.h"
 #include "logpipe.h"
 
 /* convert a filter expression into a drop/accept LogPipe */
@@ -38,6 +39,7 @@ typedef struct _LogFilterPipe
 {
   LogPipe super;
   FilterExprNode *expr;
+  FilterProgram *program;
   gchar *name;
   StatsCounterItem *matched;
   StatsCounterItem *not_matched;
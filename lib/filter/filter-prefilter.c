@@ -0,0 +1,370 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter/filter-prefilter.h"
+#include "module-config.h"
+#include "cfg.h"
+
+#include <string.h>
+
+#define MODULE_CONFIG_KEY "filter-prefilter"
+
+/* shorter literals are too common to filter out a significant number of values */
+#define FILTER_PREFILTER_MIN_LITERAL_LEN 3
+#define FILTER_PREFILTER_MAX_LITERALS 4096
+
+/*
+ * The automaton is a DFA: the goto and failure functions of the
+ * Aho-Corasick trie are merged into a single transition table.  To keep
+ * the table small, bytes are mapped to classes first, all bytes that do
+ * not occur in any of the literals share class 0.  ASCII letters are
+ * folded, so the automaton always matches caselessly, which only makes
+ * the prefilter less selective for case sensitive matchers.
+ *
+ * The literals found in each state (including the ones found through
+ * failure links) are listed in outputs[outputs_start[state]] ..
+ * outputs[outputs_start[state + 1] - 1].
+ */
+struct _FilterPrefilter
+{
+  GMutex *lock;
+  GHashTable *literal_ids;
+  GPtrArray *literals;
+  gint compiled;
+
+  guint8 byte_classes[256];
+  gint num_classes;
+  gint num_states;
+  guint32 *transitions;
+  guint32 *outputs_start;
+  guint32 *outputs;
+};
+
+typedef struct _FilterPrefilterConfig
+{
+  ModuleConfig super;
+  GHashTable *prefilters;
+} FilterPrefilterConfig;
+
+static void
+_assign_byte_classes(FilterPrefilter *self)
+{
+  memset(self->byte_classes, 0, sizeof(self->byte_classes));
+  self->num_classes = 1;
+
+  for (gint i = 0; i < self->literals->len; i++)
+    {
+      const guchar *literal = g_ptr_array_index(self->literals, i);
+
+      for (const guchar *p = literal; *p; p++)
+        {
+          if (self->byte_classes[*p])
+            continue;
+
+          self->byte_classes[*p] = self->num_classes;
+          self->byte_classes[g_ascii_toupper(*p)] = self->num_classes;
+          self->num_classes++;
+        }
+    }
+}
+
+static guint32 *
+_transition(FilterPrefilter *self, guint32 state, guchar c)
+{
+  return &self->transitions[state * self->num_classes + self->byte_classes[c]];
+}
+
+/* builds the trie, 0 means a missing edge, as no edge points to the root */
+static GPtrArray *
+_build_trie(FilterPrefilter *self)
+{
+  gsize max_states = 1;
+  GPtrArray *state_outputs = g_ptr_array_new_with_free_func((GDestroyNotify) g_array_unref);
+
+  for (gint i = 0; i < self->literals->len; i++)
+    max_states += strlen(g_ptr_array_index(self->literals, i));
+
+  self->transitions = g_new0(guint32, max_states * self->num_classes);
+  self->num_states = 1;
+  g_ptr_array_add(state_outputs, g_array_new(FALSE, FALSE, sizeof(guint32)));
+
+  for (guint32 id = 0; id < self->literals->len; id++)
+    {
+      const guchar *literal = g_ptr_array_index(self->literals, id);
+      guint32 state = 0;
+
+      for (const guchar *p = literal; *p; p++)
+        {
+          guint32 *next = _transition(self, state, *p);
+
+          if (!*next)
+            {
+              *next = self->num_states++;
+              g_ptr_array_add(state_outputs, g_array_new(FALSE, FALSE, sizeof(guint32)));
+            }
+          state = *next;
+        }
+      g_array_append_val(g_ptr_array_index(state_outputs, state), id);
+    }
+  return state_outputs;
+}
+
+/* turns the trie into a DFA by resolving failure links in BFS order */
+static void
+_resolve_failure_links(FilterPrefilter *self, GPtrArray *state_outputs)
+{
+  guint32 *failure = g_new0(guint32, self->num_states);
+  guint32 *queue = g_new(guint32, self->num_states);
+  gint head = 0, tail = 0;
+
+  for (gint c = 0; c < self->num_classes; c++)
+    {
+      guint32 next = self->transitions[c];
+
+      if (next)
+        queue[tail++] = next;
+    }
+
+  while (head < tail)
+    {
+      guint32 state = queue[head++];
+      GArray *outputs = g_ptr_array_index(state_outputs, state);
+      GArray *failure_outputs = g_ptr_array_index(state_outputs, failure[state]);
+
+      g_array_append_vals(outputs, failure_outputs->data, failure_outputs->len);
+      for (gint c = 0; c < self->num_classes; c++)
+        {
+          guint32 *next = &self->transitions[state * self->num_classes + c];
+          guint32 failure_next = self->transitions[failure[state] * self->num_classes + c];
+
+          if (*next)
+            {
+              failure[*next] = failure_next;
+              queue[tail++] = *next;
+            }
+          else
+            {
+              *next = failure_next;
+            }
+        }
+    }
+  g_free(queue);
+  g_free(failure);
+}
+
+static void
+_flatten_outputs(FilterPrefilter *self, GPtrArray *state_outputs)
+{
+  guint32 num_outputs = 0;
+
+  self->outputs_start = g_new(guint32, self->num_states + 1);
+  for (gint state = 0; state < self->num_states; state++)
+    {
+      self->outputs_start[state] = num_outputs;
+      num_outputs += ((GArray *) g_ptr_array_index(state_outputs, state))->len;
+    }
+  self->outputs_start[self->num_states] = num_outputs;
+
+  self->outputs = g_new(guint32, MAX(num_outputs, 1));
+  for (gint state = 0; state < self->num_states; state++)
+    {
+      GArray *outputs = g_ptr_array_index(state_outputs, state);
+
+      memcpy(&self->outputs[self->outputs_start[state]], outputs->data, outputs->len * sizeof(guint32));
+    }
+}
+
+static void
+_compile(FilterPrefilter *self)
+{
+  GPtrArray *state_outputs;
+
+  _assign_byte_classes(self);
+  state_outputs = _build_trie(self);
+  _resolve_failure_links(self, state_outputs);
+  _flatten_outputs(self, state_outputs);
+  g_ptr_array_free(state_outputs, TRUE);
+}
+
+static void
+_ensure_compiled(FilterPrefilter *self)
+{
+  if (G_LIKELY(g_atomic_int_get(&self->compiled)))
+    return;
+
+  g_mutex_lock(self->lock);
+  if (!self->compiled)
+    {
+      _compile(self);
+      g_atomic_int_set(&self->compiled, TRUE);
+    }
+  g_mutex_unlock(self->lock);
+}
+
+static void
+_scan(FilterPrefilter *self, const guchar *value, gsize value_len, guint8 *hits)
+{
+  guint32 state = 0;
+
+  for (gsize i = 0; i < value_len; i++)
+    {
+      state = self->transitions[state * self->num_classes + self->byte_classes[value[i]]];
+      for (guint32 o = self->outputs_start[state]; o < self->outputs_start[state + 1]; o++)
+        hits[self->outputs[o] / 8] |= 1 << (self->outputs[o] % 8);
+    }
+}
+
+/*
+ * Returns FALSE if the literal registered as @literal_id is not present
+ * in @value, which means that the filter cannot match.
+ */
+gboolean
+filter_prefilter_may_match(FilterPrefilter *self, gint literal_id, LogMessage *msg,
+                           const gchar *value, gssize value_len)
+{
+  const guint8 *hits;
+  gsize hits_len;
+
+  /* scanning the value only pays off if the result is shared between filters */
+  if (!log_msg_is_result_cache_enabled(msg))
+    return TRUE;
+
+  hits = (const guint8 *) log_msg_lookup_cached_result(msg, &self, sizeof(self), &hits_len);
+  if (!hits)
+    {
+      guint8 *new_hits;
+
+      _ensure_compiled(self);
+      hits_len = (self->literals->len + 7) / 8;
+      new_hits = g_alloca(hits_len);
+      memset(new_hits, 0, hits_len);
+
+      if (value_len < 0)
+        value_len = strlen(value);
+      _scan(self, (const guchar *) value, value_len, new_hits);
+      log_msg_store_cached_result(msg, &self, sizeof(self), (const gchar *) new_hits, hits_len);
+      hits = new_hits;
+    }
+
+  if ((gsize) literal_id / 8 >= hits_len)
+    return TRUE;
+  return (hits[literal_id / 8] >> (literal_id % 8)) & 1;
+}
+
+/*
+ * Registers a literal and returns its identifier to be passed to
+ * filter_prefilter_may_match(), or -1 if the literal cannot be used.
+ */
+gint
+filter_prefilter_add_literal(FilterPrefilter *self, const gchar *literal)
+{
+  gchar *folded;
+  gpointer id;
+  gint result = -1;
+
+  if (strlen(literal) < FILTER_PREFILTER_MIN_LITERAL_LEN)
+    return -1;
+
+  folded = g_ascii_strdown(literal, -1);
+
+  g_mutex_lock(self->lock);
+  if (g_hash_table_lookup_extended(self->literal_ids, folded, NULL, &id))
+    {
+      result = GPOINTER_TO_INT(id);
+    }
+  else if (!self->compiled && self->literals->len < FILTER_PREFILTER_MAX_LITERALS)
+    {
+      result = self->literals->len;
+      g_ptr_array_add(self->literals, folded);
+      g_hash_table_insert(self->literal_ids, folded, GINT_TO_POINTER(result));
+      folded = NULL;
+    }
+  g_mutex_unlock(self->lock);
+
+  g_free(folded);
+  return result;
+}
+
+static FilterPrefilter *
+filter_prefilter_new(void)
+{
+  FilterPrefilter *self = g_new0(FilterPrefilter, 1);
+
+  self->lock = g_mutex_new();
+  self->literals = g_ptr_array_new_with_free_func(g_free);
+  self->literal_ids = g_hash_table_new(g_str_hash, g_str_equal);
+  return self;
+}
+
+static void
+filter_prefilter_free(FilterPrefilter *self)
+{
+  g_hash_table_destroy(self->literal_ids);
+  g_ptr_array_free(self->literals, TRUE);
+  g_free(self->transitions);
+  g_free(self->outputs_start);
+  g_free(self->outputs);
+  g_mutex_free(self->lock);
+  g_free(self);
+}
+
+static void
+filter_prefilter_config_free(ModuleConfig *s)
+{
+  FilterPrefilterConfig *self = (FilterPrefilterConfig *) s;
+
+  g_hash_table_destroy(self->prefilters);
+  module_config_free_method(s);
+}
+
+static FilterPrefilterConfig *
+filter_prefilter_config_new(void)
+{
+  FilterPrefilterConfig *self = g_new0(FilterPrefilterConfig, 1);
+
+  self->super.free_fn = filter_prefilter_config_free;
+  self->prefilters = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                           NULL, (GDestroyNotify) filter_prefilter_free);
+  return self;
+}
+
+FilterPrefilter *
+filter_prefilter_get(GlobalConfig *cfg, NVHandle value_handle)
+{
+  FilterPrefilterConfig *pc = g_hash_table_lookup(cfg->module_config, MODULE_CONFIG_KEY);
+  FilterPrefilter *prefilter;
+
+  if (!pc)
+    {
+      pc = filter_prefilter_config_new();
+      g_hash_table_insert(cfg->module_config, g_strdup(MODULE_CONFIG_KEY), pc);
+    }
+
+  prefilter = g_hash_table_lookup(pc->prefilters, GUINT_TO_POINTER(value_handle));
+  if (!prefilter)
+    {
+      prefilter = filter_prefilter_new();
+      g_hash_table_insert(pc->prefilters, GUINT_TO_POINTER(value_handle), prefilter);
+    }
+  return prefilter;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILTER_PREFILTER_H_INCLUDED
+#define FILTER_PREFILTER_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logmsg/logmsg.h"
+
+/*
+ * Literal prefilter shared by the regexp based filters of a configuration.
+ *
+ * Filters register a literal that must be present in the value they
+ * match against (see log_matcher_get_required_literal()).  All literals
+ * registered for the same value are compiled into a single Aho-Corasick
+ * automaton, which finds all of them in a single pass over the value.  The
+ * set of literals found is cached in the message, so when a message is
+ * delivered to a lot of log paths, each filtering on the same value, the
+ * value is scanned only once and the matcher is only run by filters whose
+ * literal was found.
+ *
+ * The automaton is compiled when the first message is scanned, literals
+ * registered after that point are rejected.
+ */
+typedef struct _FilterPrefilter FilterPrefilter;
+
+FilterPrefilter *filter_prefilter_get(GlobalConfig *cfg, NVHandle value_handle);
+gint filter_prefilter_add_literal(FilterPrefilter *self, const gchar *literal);
+gboolean filter_prefilter_may_match(FilterPrefilter *self, gint literal_id, LogMessage *msg,
+                                    const gchar *value, gssize value_len);
+
+#endif
@@ -25,6 +25,7 @@
 #include "filter/filter-pri.h"
 #include "syslog-names.h"
 #include "logmsg/logmsg.h"
+#include "filter/filter-program.h"
 
 typedef struct _FilterPri
 {
@@ -32,23 +33,43 @@ typedef struct _FilterPri
   guint32 valid;
 } FilterPri;
 
+typedef gboolean (*FilterPriMatchFunc)(FilterPri *self, guint32 pri);
+
+static void
+filter_pri_compile(FilterPri *self, FilterCompiler *compiler, FilterPriMatchFunc matches)
+{
+  guint32 table[FILTER_PRI_TABLE_WORDS] = { 0 };
+
+  for (guint32 pri = 0; pri < FILTER_PRI_TABLE_SIZE; pri++)
+    {
+      if (matches(self, pri))
+        table[pri / 32] |= 1U << (pri % 32);
+    }
+  filter_compiler_emit_pri_check(compiler, table, self->super.comp);
+}
+
 static gboolean
-filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+filter_facility_matches(FilterPri *self, guint32 pri)
 {
-  FilterPri *self = (FilterPri *) s;
-  LogMessage *msg = msgs[num_msg - 1];
-  guint32 fac_num = (msg->pri & LOG_FACMASK) >> 3;
-  gboolean res;
+  guint32 fac_num = (pri & LOG_FACMASK) >> 3;
 
   if (G_UNLIKELY(self->valid & 0x80000000))
     {
       /* exact number specified */
-      res = ((self->valid & ~0x80000000) == fac_num);
-    }
-  else
-    {
-      res = !!(self->valid & (1 << fac_num));
+      return ((self->valid & ~0x80000000) == fac_num);
     }
+
+  return fac_num < 32 && !!(self->valid & (1 << fac_num));
+}
+
+static gboolean
+filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
+{
+  FilterPri *self = (FilterPri *) s;
+  LogMessage *msg = msgs[num_msg - 1];
+  guint32 fac_num = (msg->pri & LOG_FACMASK) >> 3;
+  gboolean res = filter_facility_matches(self, msg->pri);
+
   msg_trace("facility() evaluation started",
             evt_tag_int("fac", fac_num),
             evt_tag_printf("valid_fac", "%08x", self->valid),
@@ -57,6 +78,12 @@ filter_facility_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   return res ^ s->comp;
 }
 
+static void
+filter_facility_compile(FilterExprNode *s, FilterCompiler *compiler)
+{
+  filter_pri_compile((FilterPri *) s, compiler, filter_facility_matches);
+}
+
 FilterExprNode *
 filter_facility_new(guint32 facilities)
 {
@@ -64,20 +91,25 @@ filter_facility_new(guint32 facilities)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_facility_eval;
+  self->super.compile = filter_facility_compile;
   self->valid = facilities;
   self->super.type = "facility";
   return &self->super;
 }
 
+static gboolean
+filter_severity_matches(FilterPri *self, guint32 pri)
+{
+  return !!((1 << (pri & LOG_PRIMASK)) & self->valid);
+}
+
 static gboolean
 filter_severity_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
 {
   FilterPri *self = (FilterPri *) s;
   LogMessage *msg = msgs[num_msg - 1];
   guint32 pri = msg->pri & LOG_PRIMASK;
-  gboolean res;
-
-  res = !!((1 << pri) & self->valid);
+  gboolean res = filter_severity_matches(self, pri);
 
   msg_trace("severity() evaluation started",
             evt_tag_int("pri", pri),
@@ -87,6 +119,12 @@ filter_severity_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   return res ^ s->comp;
 }
 
+static void
+filter_severity_compile(FilterExprNode *s, FilterCompiler *compiler)
+{
+  filter_pri_compile((FilterPri *) s, compiler, filter_severity_matches);
+}
+
 FilterExprNode *
 filter_severity_new(guint32 levels)
 {
@@ -94,6 +132,7 @@ filter_severity_new(guint32 levels)
 
   filter_expr_node_init_instance(&self->super);
   self->super.eval = filter_severity_eval;
+  self->super.compile = filter_severity_compile;
   self->valid = levels;
   self->super.type = "severity";
   return &self->super;
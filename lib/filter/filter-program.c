@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter/filter-program.h"
+#include "scratch-buffers.h"
+#include "syslog-names.h"
+
+#include <string.h>
+
+typedef enum
+{
+  /* result = node->eval() */
+  FPI_EVAL,
+  /* result = pri_table[msg->pri] */
+  FPI_PRI_CHECK,
+  /* result = compare(template[left], template[right]) ^ negate */
+  FPI_CMP,
+  FPI_NOT,
+  FPI_JUMP_IF_FALSE,
+  FPI_JUMP_IF_TRUE,
+} FilterProgramOpcode;
+
+typedef struct _FilterInstruction
+{
+  FilterProgramOpcode opcode;
+  gboolean negate;
+  FilterExprNode *node;
+  union
+  {
+    gint target;
+    guint32 *pri_table;
+    struct
+    {
+      gint left, right;
+      FilterCompareFunc compare;
+    } cmp;
+  };
+} FilterInstruction;
+
+struct _FilterProgram
+{
+  FilterExprNode *expr;
+  FilterInstruction *code;
+  gint length;
+  /* templates used by comparisons, deduplicated */
+  LogTemplate **templates;
+  gint num_templates;
+};
+
+struct _FilterCompiler
+{
+  GArray *code;
+  GPtrArray *templates;
+};
+
+static FilterInstruction *
+_emit(FilterCompiler *self, FilterProgramOpcode opcode, FilterExprNode *node)
+{
+  FilterInstruction insn = { .opcode = opcode, .node = node };
+
+  g_array_append_val(self->code, insn);
+  return &g_array_index(self->code, FilterInstruction, self->code->len - 1);
+}
+
+static FilterInstruction *
+_instruction(FilterCompiler *self, gint pc)
+{
+  return &g_array_index(self->code, FilterInstruction, pc);
+}
+
+static void
+_truncate(FilterCompiler *self, gint length)
+{
+  for (gint pc = length; pc < self->code->len; pc++)
+    {
+      FilterInstruction *insn = _instruction(self, pc);
+
+      if (insn->opcode == FPI_PRI_CHECK)
+        g_free(insn->pri_table);
+    }
+  g_array_set_size(self->code, length);
+}
+
+void
+filter_compiler_emit_eval(FilterCompiler *self, FilterExprNode *node)
+{
+  _emit(self, FPI_EVAL, node);
+}
+
+void
+filter_compiler_emit_node(FilterCompiler *self, FilterExprNode *node)
+{
+  if (node->compile)
+    node->compile(node, self);
+  else
+    filter_compiler_emit_eval(self, node);
+}
+
+void
+filter_compiler_emit_pri_check(FilterCompiler *self, const guint32 *pri_table, gboolean negate)
+{
+  FilterInstruction *insn = _emit(self, FPI_PRI_CHECK, NULL);
+
+  insn->pri_table = g_new(guint32, FILTER_PRI_TABLE_WORDS);
+  for (gint i = 0; i < FILTER_PRI_TABLE_WORDS; i++)
+    insn->pri_table[i] = negate ? ~pri_table[i] : pri_table[i];
+}
+
+/* returns the pri table if the code between @start and @end is a single priority check */
+static guint32 *
+_get_single_pri_check(FilterCompiler *self, gint start, gint end)
+{
+  FilterInstruction *insn = _instruction(self, start);
+
+  if (end - start != 1 || insn->opcode != FPI_PRI_CHECK)
+    return NULL;
+  return insn->pri_table;
+}
+
+/*
+ * Both operands are emitted, separated by a conditional jump that skips
+ * the second one if the first already decided the result.  If both
+ * operands turn out to be priority checks, they are folded into one.
+ */
+static void
+_emit_junction(FilterCompiler *self, FilterExprNode *left, FilterExprNode *right, gboolean is_and,
+               gboolean negate)
+{
+  gint left_start = self->code->len;
+  gint jump, right_start;
+  guint32 *left_table, *right_table;
+
+  filter_compiler_emit_node(self, left);
+  jump = self->code->len;
+  _emit(self, is_and ? FPI_JUMP_IF_FALSE : FPI_JUMP_IF_TRUE, NULL);
+  right_start = self->code->len;
+  filter_compiler_emit_node(self, right);
+
+  left_table = _get_single_pri_check(self, left_start, jump);
+  right_table = _get_single_pri_check(self, right_start, self->code->len);
+  if (left_table && right_table)
+    {
+      guint32 table[FILTER_PRI_TABLE_WORDS];
+
+      for (gint i = 0; i < FILTER_PRI_TABLE_WORDS; i++)
+        table[i] = is_and ? left_table[i] & right_table[i] : left_table[i] | right_table[i];
+
+      _truncate(self, left_start);
+      filter_compiler_emit_pri_check(self, table, negate);
+      return;
+    }
+
+  _instruction(self, jump)->target = self->code->len;
+  if (negate)
+    _emit(self, FPI_NOT, NULL);
+}
+
+void
+filter_compiler_emit_and(FilterCompiler *self, FilterExprNode *left, FilterExprNode *right, gboolean negate)
+{
+  _emit_junction(self, left, right, TRUE, negate);
+}
+
+void
+filter_compiler_emit_or(FilterCompiler *self, FilterExprNode *left, FilterExprNode *right, gboolean negate)
+{
+  _emit_junction(self, left, right, FALSE, negate);
+}
+
+static gboolean
+_is_same_template(LogTemplate *a, LogTemplate *b)
+{
+  if (a == b)
+    return TRUE;
+
+  return a->template && b->template &&
+         a->escape == b->escape &&
+         a->type_hint == b->type_hint &&
+         strcmp(a->template, b->template) == 0;
+}
+
+static gint
+_lookup_template(FilterCompiler *self, LogTemplate *template)
+{
+  for (gint i = 0; i < self->templates->len; i++)
+    {
+      if (_is_same_template(g_ptr_array_index(self->templates, i), template))
+        return i;
+    }
+  g_ptr_array_add(self->templates, log_template_ref(template));
+  return self->templates->len - 1;
+}
+
+void
+filter_compiler_emit_cmp(FilterCompiler *self, FilterExprNode *node, LogTemplate *left, LogTemplate *right,
+                         FilterCompareFunc compare)
+{
+  gint left_index = _lookup_template(self, left);
+  gint right_index = _lookup_template(self, right);
+  FilterInstruction *insn = _emit(self, FPI_CMP, node);
+
+  insn->negate = node->comp;
+  insn->cmp.left = left_index;
+  insn->cmp.right = right_index;
+  insn->cmp.compare = compare;
+}
+
+/* jumps landing on a jump of the same kind can skip over it, as the result is not changed in between */
+static void
+_thread_jumps(FilterProgram *self)
+{
+  for (gint pc = 0; pc < self->length; pc++)
+    {
+      FilterInstruction *insn = &self->code[pc];
+
+      if (insn->opcode != FPI_JUMP_IF_FALSE && insn->opcode != FPI_JUMP_IF_TRUE)
+        continue;
+
+      while (insn->target < self->length && self->code[insn->target].opcode == insn->opcode)
+        insn->target = self->code[insn->target].target;
+    }
+}
+
+/*
+ * Returns NULL if compiling @expr would not be faster than evaluating it
+ * directly, e.g. because it consists of a single node.
+ */
+FilterProgram *
+filter_program_compile(FilterExprNode *expr)
+{
+  FilterCompiler compiler;
+  FilterProgram *self;
+
+  compiler.code = g_array_new(FALSE, TRUE, sizeof(FilterInstruction));
+  compiler.templates = g_ptr_array_new();
+  filter_compiler_emit_node(&compiler, expr);
+
+  if (compiler.code->len == 1 && _instruction(&compiler, 0)->opcode == FPI_EVAL)
+    {
+      g_array_free(compiler.code, TRUE);
+      g_ptr_array_free(compiler.templates, TRUE);
+      return NULL;
+    }
+
+  self = g_new0(FilterProgram, 1);
+  self->expr = filter_expr_ref(expr);
+  self->length = compiler.code->len;
+  self->code = (FilterInstruction *) g_array_free(compiler.code, FALSE);
+  self->num_templates = compiler.templates->len;
+  self->templates = (LogTemplate **) g_ptr_array_free(compiler.templates, FALSE);
+  _thread_jumps(self);
+  return self;
+}
+
+static const gchar *
+_format_template(FilterProgram *self, gint index, GString **values, LogMessage **msgs, gint num_msg)
+{
+  if (!values[index])
+    {
+      values[index] = scratch_buffers_alloc();
+      log_template_format_with_context(self->templates[index], msgs, num_msg, NULL, LTZ_LOCAL, 0, NULL,
+                                       values[index]);
+    }
+  return values[index]->str;
+}
+
+gboolean
+filter_program_eval(FilterProgram *self, LogMessage **msgs, gint num_msg)
+{
+  LogMessage *msg = msgs[num_msg - 1];
+  GString **values = g_alloca(sizeof(GString *) * MAX(self->num_templates, 1));
+  ScratchBuffersMarker marker;
+  gboolean result = FALSE;
+  guint32 pri;
+
+  g_assert(num_msg > 0);
+
+  memset(values, 0, sizeof(GString *) * self->num_templates);
+  scratch_buffers_mark(&marker);
+
+  for (gint pc = 0; pc < self->length; pc++)
+    {
+      FilterInstruction *insn = &self->code[pc];
+
+      switch (insn->opcode)
+        {
+        case FPI_EVAL:
+          result = filter_expr_eval_with_context(insn->node, msgs, num_msg);
+          /* e.g. store-matches may have changed what the templates expand to */
+          if (insn->node->modify)
+            memset(values, 0, sizeof(GString *) * self->num_templates);
+          break;
+        case FPI_PRI_CHECK:
+          pri = msg->pri & (LOG_FACMASK | LOG_PRIMASK);
+          result = (insn->pri_table[pri / 32] >> (pri % 32)) & 1;
+          break;
+        case FPI_CMP:
+          result = insn->cmp.compare(insn->node, msg,
+                                     _format_template(self, insn->cmp.left, values, msgs, num_msg),
+                                     _format_template(self, insn->cmp.right, values, msgs, num_msg)) ^ insn->negate;
+          break;
+        case FPI_NOT:
+          result = !result;
+          break;
+        case FPI_JUMP_IF_FALSE:
+          if (!result)
+            pc = insn->target - 1;
+          break;
+        case FPI_JUMP_IF_TRUE:
+          if (result)
+            pc = insn->target - 1;
+          break;
+        default:
+          g_assert_not_reached();
+        }
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+  return result;
+}
+
+gboolean
+filter_program_eval_root(FilterProgram *self, LogMessage **msg, const LogPathOptions *path_options)
+{
+  if (self->expr->modify)
+    log_msg_make_writable(msg, path_options);
+
+  return filter_program_eval(self, msg, 1);
+}
+
+gint
+filter_program_get_length(FilterProgram *self)
+{
+  return self->length;
+}
+
+void
+filter_program_free(FilterProgram *self)
+{
+  for (gint pc = 0; pc < self->length; pc++)
+    {
+      if (self->code[pc].opcode == FPI_PRI_CHECK)
+        g_free(self->code[pc].pri_table);
+    }
+  for (gint i = 0; i < self->num_templates; i++)
+    log_template_unref(self->templates[i]);
+  g_free(self->templates);
+  g_free(self->code);
+  filter_expr_unref(self->expr);
+  g_free(self);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef FILTER_PROGRAM_H_INCLUDED
+#define FILTER_PROGRAM_H_INCLUDED
+
+#include "filter/filter-expr.h"
+#include "template/templates.h"
+
+/*
+ * Filter expressions compiled into a linear program.
+ *
+ * Instead of walking the FilterExprNode tree through virtual eval() calls,
+ * AND/OR nodes are lowered into short-circuit jumps, facility() and
+ * severity() checks (and any AND/OR/NOT combination of them) are folded
+ * into a single lookup in a table indexed by the priority of the message
+ * and the templates of comparisons are formatted at most once per
+ * evaluation, even if multiple comparisons use them (unless a node that
+ * modifies the message is evaluated in between).
+ *
+ * Nodes implement the compile() method of FilterExprNode to emit their
+ * instructions, nodes without one are evaluated through their eval()
+ * method.
+ */
+
+/* one bit for each possible value of (pri & (LOG_FACMASK | LOG_PRIMASK)) */
+#define FILTER_PRI_TABLE_SIZE 1024
+#define FILTER_PRI_TABLE_WORDS (FILTER_PRI_TABLE_SIZE / 32)
+
+typedef struct _FilterProgram FilterProgram;
+
+typedef gboolean (*FilterCompareFunc)(FilterExprNode *node, LogMessage *msg, const gchar *left, const gchar *right);
+
+void filter_compiler_emit_node(FilterCompiler *self, FilterExprNode *node);
+void filter_compiler_emit_eval(FilterCompiler *self, FilterExprNode *node);
+void filter_compiler_emit_and(FilterCompiler *self, FilterExprNode *left, FilterExprNode *right, gboolean negate);
+void filter_compiler_emit_or(FilterCompiler *self, FilterExprNode *left, FilterExprNode *right, gboolean negate);
+void filter_compiler_emit_pri_check(FilterCompiler *self, const guint32 *pri_table, gboolean negate);
+void filter_compiler_emit_cmp(FilterCompiler *self, FilterExprNode *node, LogTemplate *left, LogTemplate *right,
+                              FilterCompareFunc compare);
+
+FilterProgram *filter_program_compile(FilterExprNode *expr);
+gboolean filter_program_eval(FilterProgram *self, LogMessage **msgs, gint num_msg);
+gboolean filter_program_eval_root(FilterProgram *self, LogMessage **msg, const LogPathOptions *path_options);
+gint filter_program_get_length(FilterProgram *self);
+void filter_program_free(FilterProgram *self);
+
+#endif
@@ -23,6 +23,7 @@
  */
 
 #include "filter-re.h"
+#include "filter-prefilter.h"
 #include "str-utils.h"
 #include "messages.h"
 #include "scratch-buffers.h"
@@ -34,6 +35,8 @@ typedef struct _FilterRE
   NVHandle value_handle;
   LogMatcherOptions matcher_options;
   LogMatcher *matcher;
+  FilterPrefilter *prefilter;
+  gint prefilter_literal_id;
 } FilterRE;
 
 
@@ -68,7 +71,12 @@ filter_re_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg)
   value = log_msg_get_value(msg, self->value_handle, &len);
   APPEND_ZERO(value, value, len);
 
-  rc = filter_re_eval_string(s, msg, self->value_handle, value, len);
+  /* a value without the required literal would fail the match anyway */
+  if (self->prefilter &&
+      !filter_prefilter_may_match(self->prefilter, self->prefilter_literal_id, msg, value, len))
+    rc = s->comp;
+  else
+    rc = filter_re_eval_string(s, msg, self->value_handle, value, len);
 
   nv_table_unref(payload);
   return rc;
@@ -83,6 +91,28 @@ filter_re_free(FilterExprNode *s)
   log_matcher_options_destroy(&self->matcher_options);
 }
 
+static void
+filter_re_register_prefilter_literal(FilterRE *self, GlobalConfig *cfg)
+{
+  FilterPrefilter *prefilter;
+  gchar *literal;
+  gint literal_id;
+
+  literal = log_matcher_get_required_literal(self->matcher);
+  if (!literal)
+    return;
+
+  prefilter = filter_prefilter_get(cfg, self->value_handle);
+  literal_id = filter_prefilter_add_literal(prefilter, literal);
+  g_free(literal);
+
+  if (literal_id < 0)
+    return;
+
+  self->prefilter = prefilter;
+  self->prefilter_literal_id = literal_id;
+}
+
 static gboolean
 filter_re_init(FilterExprNode *s, GlobalConfig *cfg)
 {
@@ -91,6 +121,9 @@ filter_re_init(FilterExprNode *s, GlobalConfig *cfg)
   if (self->matcher_options.flags & LMF_STORE_MATCHES)
     self->super.modify = TRUE;
 
+  if (cfg && self->matcher && self->value_handle != LM_V_NONE && !self->prefilter)
+    filter_re_register_prefilter_literal(self, cfg);
+
   return TRUE;
 }
 
@@ -0,0 +1,546 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "in-list-set.h"
+#include "messages.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define IN_LIST_SET_MAGIC "SNGINLST"
+#define IN_LIST_SET_VERSION 1
+#define IN_LIST_SET_BYTE_ORDER_MARK 0x01020304
+#define IN_LIST_SET_FLAG_IGNORE_CASE 0x0001
+#define IN_LIST_SET_MIN_SLOTS 8
+
+/*
+ * Layout of the set (both in memory and in compiled files):
+ *
+ *   header | slots[num_slots] | strings[strings_size]
+ *
+ * Each slot holds the hash of an entry and its offset (+1) within the
+ * strings area, 0 meaning an empty slot.  Entries in the strings area are
+ * a 32 bit length followed by the bytes of the entry, padded to 4 bytes.
+ * There are always at least twice as many slots as entries, so linear
+ * probing always finds an empty slot.
+ */
+typedef struct _InListSetHeader
+{
+  gchar magic[8];
+  guint32 version;
+  guint32 byte_order;
+  guint32 flags;
+  guint32 num_entries;
+  guint32 num_slots;
+  guint32 strings_size;
+  /* size and mtime of the text file the set was compiled from */
+  guint64 source_size;
+  gint64 source_mtime;
+} InListSetHeader;
+
+typedef struct _InListSetSlot
+{
+  guint32 hash;
+  guint32 offset;
+} InListSetSlot;
+
+struct _InListSet
+{
+  gint ref_cnt;
+  gchar *registry_key;
+  dev_t source_dev;
+  ino_t source_ino;
+  guint64 source_size;
+  gint64 source_mtime;
+
+  gboolean ignore_case;
+  guint32 mask;
+  const InListSetHeader *header;
+  const InListSetSlot *slots;
+  const guchar *strings;
+
+  gpointer data;
+  gsize data_len;
+  gboolean mmapped;
+};
+
+/* sets are shared between filter instances as long as their source did not change */
+G_LOCK_DEFINE_STATIC(registry_lock);
+static GHashTable *registry;
+
+static inline guint32
+_hash(const gchar *value, gsize len, gboolean ignore_case)
+{
+  guint32 hash = 2166136261U;
+
+  /* FNV-1a */
+  if (ignore_case)
+    {
+      for (gsize i = 0; i < len; i++)
+        hash = (hash ^ (guchar) g_ascii_tolower(value[i])) * 16777619U;
+    }
+  else
+    {
+      for (gsize i = 0; i < len; i++)
+        hash = (hash ^ (guchar) value[i]) * 16777619U;
+    }
+  return hash;
+}
+
+static inline gboolean
+_equal(const guchar *entry, const gchar *value, gsize len, gboolean ignore_case)
+{
+  if (!ignore_case)
+    return memcmp(entry, value, len) == 0;
+
+  for (gsize i = 0; i < len; i++)
+    {
+      if (g_ascii_tolower(entry[i]) != g_ascii_tolower(value[i]))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static inline guint32
+_entry_length(const guchar *entry)
+{
+  guint32 len;
+
+  memcpy(&len, entry, sizeof(len));
+  return len;
+}
+
+gboolean
+in_list_set_contains(InListSet *self, const gchar *value, gssize value_len)
+{
+  if (value_len < 0)
+    value_len = strlen(value);
+
+  if (self->header->num_entries == 0)
+    return FALSE;
+
+  guint32 hash = _hash(value, value_len, self->ignore_case);
+  for (guint32 i = hash & self->mask; ; i = (i + 1) & self->mask)
+    {
+      const InListSetSlot *slot = &self->slots[i];
+
+      if (slot->offset == 0)
+        return FALSE;
+      if (slot->hash != hash)
+        continue;
+
+      const guchar *entry = self->strings + slot->offset - 1;
+      if (_entry_length(entry) == value_len &&
+          _equal(entry + sizeof(guint32), value, value_len, self->ignore_case))
+        return TRUE;
+    }
+}
+
+guint32
+in_list_set_get_size(InListSet *self)
+{
+  return self->header->num_entries;
+}
+
+gboolean
+in_list_set_is_mmapped(InListSet *self)
+{
+  return self->mmapped;
+}
+
+static void
+_setup_pointers(InListSet *self)
+{
+  self->header = (const InListSetHeader *) self->data;
+  self->slots = (const InListSetSlot *) (self->header + 1);
+  self->strings = (const guchar *) (self->slots + self->header->num_slots);
+  self->mask = self->header->num_slots - 1;
+  self->ignore_case = !!(self->header->flags & IN_LIST_SET_FLAG_IGNORE_CASE);
+}
+
+static guint32
+_calculate_num_slots(guint32 num_entries)
+{
+  guint32 num_slots = IN_LIST_SET_MIN_SLOTS;
+
+  while (num_slots < (guint64) num_entries * 2)
+    num_slots <<= 1;
+  return num_slots;
+}
+
+static gboolean
+_read_entries(FILE *stream, GString *strings, GArray *offsets)
+{
+  gchar line[16384];
+
+  while (fgets(line, sizeof(line), stream) != NULL)
+    {
+      guint32 len = strlen(line);
+
+      while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        len--;
+      if (len == 0)
+        continue;
+
+      while (strings->len % sizeof(guint32))
+        g_string_append_c(strings, 0);
+
+      guint32 offset = strings->len;
+      g_array_append_val(offsets, offset);
+      g_string_append_len(strings, (const gchar *) &len, sizeof(len));
+      g_string_append_len(strings, line, len);
+
+      if (strings->len > G_MAXUINT32 / 2)
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static InListSet *
+_build_from_text(const gchar *list_file, gboolean ignore_case)
+{
+  FILE *stream = fopen(list_file, "r");
+  if (!stream)
+    {
+      msg_error("Error opening in-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_error("errno"));
+      return NULL;
+    }
+
+  GString *strings = g_string_sized_new(4096);
+  GArray *offsets = g_array_new(FALSE, FALSE, sizeof(guint32));
+  gboolean success = _read_entries(stream, strings, offsets);
+  fclose(stream);
+
+  if (!success)
+    {
+      msg_error("in-list filter list file is too large",
+                evt_tag_str("file", list_file));
+      g_string_free(strings, TRUE);
+      g_array_free(offsets, TRUE);
+      return NULL;
+    }
+
+  InListSet *self = g_new0(InListSet, 1);
+  guint32 num_slots = _calculate_num_slots(offsets->len);
+
+  self->data_len = sizeof(InListSetHeader) + num_slots * sizeof(InListSetSlot) + strings->len;
+  self->data = g_malloc0(self->data_len);
+
+  InListSetHeader *header = (InListSetHeader *) self->data;
+  InListSetSlot *slots = (InListSetSlot *) (header + 1);
+  guchar *entries = (guchar *) (slots + num_slots);
+
+  memcpy(header->magic, IN_LIST_SET_MAGIC, sizeof(header->magic));
+  header->version = IN_LIST_SET_VERSION;
+  header->byte_order = IN_LIST_SET_BYTE_ORDER_MARK;
+  header->flags = ignore_case ? IN_LIST_SET_FLAG_IGNORE_CASE : 0;
+  header->num_slots = num_slots;
+  header->strings_size = strings->len;
+  memcpy(entries, strings->str, strings->len);
+  _setup_pointers(self);
+
+  for (guint i = 0; i < offsets->len; i++)
+    {
+      guint32 offset = g_array_index(offsets, guint32, i);
+      const guchar *entry = entries + offset;
+      const gchar *value = (const gchar *) entry + sizeof(guint32);
+      guint32 len = _entry_length(entry);
+
+      if (in_list_set_contains(self, value, len))
+        continue;
+
+      guint32 hash = _hash(value, len, ignore_case);
+      guint32 slot = hash & self->mask;
+      while (slots[slot].offset)
+        slot = (slot + 1) & self->mask;
+
+      slots[slot].hash = hash;
+      slots[slot].offset = offset + 1;
+      header->num_entries++;
+    }
+
+  g_string_free(strings, TRUE);
+  g_array_free(offsets, TRUE);
+  return self;
+}
+
+static gboolean
+_is_compiled_file(const gchar *filename)
+{
+  gchar magic[sizeof(((InListSetHeader *) NULL)->magic)];
+  gboolean result = FALSE;
+
+  FILE *stream = fopen(filename, "r");
+  if (!stream)
+    return FALSE;
+
+  if (fread(magic, sizeof(magic), 1, stream) == 1)
+    result = memcmp(magic, IN_LIST_SET_MAGIC, sizeof(magic)) == 0;
+  fclose(stream);
+  return result;
+}
+
+static gboolean
+_validate_compiled(const guchar *data, gsize data_len)
+{
+  const InListSetHeader *header = (const InListSetHeader *) data;
+
+  if (data_len < sizeof(InListSetHeader) ||
+      memcmp(header->magic, IN_LIST_SET_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != IN_LIST_SET_VERSION ||
+      header->byte_order != IN_LIST_SET_BYTE_ORDER_MARK)
+    return FALSE;
+
+  if (header->num_slots < IN_LIST_SET_MIN_SLOTS ||
+      (header->num_slots & (header->num_slots - 1)) != 0 ||
+      header->num_entries >= header->num_slots)
+    return FALSE;
+
+  if (data_len != sizeof(InListSetHeader) + (gsize) header->num_slots * sizeof(InListSetSlot) + header->strings_size)
+    return FALSE;
+
+  const InListSetSlot *slots = (const InListSetSlot *) (header + 1);
+  const guchar *strings = (const guchar *) (slots + header->num_slots);
+  guint32 used_slots = 0;
+
+  for (guint32 i = 0; i < header->num_slots; i++)
+    {
+      if (slots[i].offset == 0)
+        continue;
+
+      guint32 offset = slots[i].offset - 1;
+      if (offset % sizeof(guint32) != 0 ||
+          (guint64) offset + sizeof(guint32) > header->strings_size ||
+          (guint64) offset + sizeof(guint32) + _entry_length(strings + offset) > header->strings_size)
+        return FALSE;
+      used_slots++;
+    }
+  return used_slots == header->num_entries;
+}
+
+static InListSet *
+_load_compiled(const gchar *filename)
+{
+  struct stat st;
+  gint fd = open(filename, O_RDONLY);
+
+  if (fd < 0)
+    return NULL;
+
+  if (fstat(fd, &st) < 0 || (gsize) st.st_size < sizeof(InListSetHeader))
+    {
+      close(fd);
+      return NULL;
+    }
+
+  gpointer data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return NULL;
+
+  if (!_validate_compiled(data, st.st_size))
+    {
+      msg_error("Invalid compiled in-list filter list file",
+                evt_tag_str("file", filename));
+      munmap(data, st.st_size);
+      return NULL;
+    }
+
+  InListSet *self = g_new0(InListSet, 1);
+  self->data = data;
+  self->data_len = st.st_size;
+  self->mmapped = TRUE;
+  _setup_pointers(self);
+  return self;
+}
+
+static void
+_free(InListSet *self)
+{
+  if (self->mmapped)
+    munmap(self->data, self->data_len);
+  else
+    g_free(self->data);
+  g_free(self->registry_key);
+  g_free(self);
+}
+
+gboolean
+in_list_set_save(InListSet *self, const gchar *filename)
+{
+  gchar *temp_filename = g_strdup_printf("%s.tmp", filename);
+  InListSetHeader header = *self->header;
+  gboolean success = FALSE;
+
+  header.source_size = self->source_size;
+  header.source_mtime = self->source_mtime;
+
+  FILE *stream = fopen(temp_filename, "w");
+  if (stream)
+    {
+      success = fwrite(&header, sizeof(header), 1, stream) == 1 &&
+                fwrite((const guchar *) self->data + sizeof(header), self->data_len - sizeof(header), 1, stream) == 1;
+      success = (fclose(stream) == 0) && success;
+      success = success && rename(temp_filename, filename) == 0;
+    }
+
+  if (!success)
+    {
+      msg_error("Error writing compiled in-list filter list file",
+                evt_tag_str("file", filename),
+                evt_tag_error("errno"));
+      unlink(temp_filename);
+    }
+  g_free(temp_filename);
+  return success;
+}
+
+static gboolean
+_is_compiled_file_fresh(InListSet *compiled, const struct stat *source, gboolean ignore_case)
+{
+  return compiled->ignore_case == ignore_case &&
+         compiled->header->source_size == source->st_size &&
+         compiled->header->source_mtime == source->st_mtime;
+}
+
+static InListSet *
+_load(const gchar *list_file, const struct stat *st, gboolean ignore_case, const gchar *compiled_file)
+{
+  InListSet *self;
+
+  if (_is_compiled_file(list_file))
+    {
+      self = _load_compiled(list_file);
+      if (self && self->ignore_case != ignore_case)
+        {
+          msg_error("Compiled in-list filter list file was created with a different ignore-case() setting",
+                    evt_tag_str("file", list_file));
+          _free(self);
+          return NULL;
+        }
+      return self;
+    }
+
+  if (compiled_file)
+    {
+      self = _load_compiled(compiled_file);
+      if (self && _is_compiled_file_fresh(self, st, ignore_case))
+        return self;
+      if (self)
+        _free(self);
+    }
+
+  self = _build_from_text(list_file, ignore_case);
+  if (self && compiled_file)
+    {
+      self->source_size = st->st_size;
+      self->source_mtime = st->st_mtime;
+      in_list_set_save(self, compiled_file);
+    }
+  return self;
+}
+
+InListSet *
+in_list_set_load(const gchar *list_file, gboolean ignore_case, const gchar *compiled_file)
+{
+  struct stat st;
+
+  if (stat(list_file, &st) < 0)
+    {
+      msg_error("Error opening in-list filter list file",
+                evt_tag_str("file", list_file),
+                evt_tag_error("errno"));
+      return NULL;
+    }
+
+  gchar *key = g_strdup_printf("%s\n%d\n%s", list_file, ignore_case, compiled_file ? compiled_file : "");
+  InListSet *self;
+
+  G_LOCK(registry_lock);
+  if (!registry)
+    registry = g_hash_table_new(g_str_hash, g_str_equal);
+
+  self = g_hash_table_lookup(registry, key);
+  if (self &&
+      self->source_dev == st.st_dev && self->source_ino == st.st_ino &&
+      self->source_size == st.st_size && self->source_mtime == st.st_mtime)
+    {
+      self->ref_cnt++;
+      G_UNLOCK(registry_lock);
+      g_free(key);
+      return self;
+    }
+
+  self = _load(list_file, &st, ignore_case, compiled_file);
+  if (self)
+    {
+      self->ref_cnt = 1;
+      self->registry_key = key;
+      self->source_dev = st.st_dev;
+      self->source_ino = st.st_ino;
+      self->source_size = st.st_size;
+      self->source_mtime = st.st_mtime;
+      g_hash_table_replace(registry, self->registry_key, self);
+    }
+  else
+    {
+      g_free(key);
+    }
+  G_UNLOCK(registry_lock);
+
+  return self;
+}
+
+InListSet *
+in_list_set_ref(InListSet *self)
+{
+  G_LOCK(registry_lock);
+  self->ref_cnt++;
+  G_UNLOCK(registry_lock);
+  return self;
+}
+
+void
+in_list_set_unref(InListSet *self)
+{
+  G_LOCK(registry_lock);
+  if (--self->ref_cnt == 0)
+    {
+      if (g_hash_table_lookup(registry, self->registry_key) == self)
+        g_hash_table_remove(registry, self->registry_key);
+      if (g_hash_table_size(registry) == 0)
+        {
+          g_hash_table_destroy(registry);
+          registry = NULL;
+        }
+      _free(self);
+    }
+  G_UNLOCK(registry_lock);
+}
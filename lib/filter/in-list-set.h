@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef IN_LIST_SET_H_INCLUDED
+#define IN_LIST_SET_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/*
+ * Read-only set of strings used by the in-list() filter.
+ *
+ * The set is an open-addressing hash table stored in a single contiguous
+ * buffer, which is also its on-disk "compiled" format: a compiled list
+ * file is simply mmap()-ed, without parsing or rehashing.  Sets are shared
+ * between filter instances (and across reloads) as long as the underlying
+ * file does not change.
+ */
+typedef struct _InListSet InListSet;
+
+InListSet *in_list_set_load(const gchar *list_file, gboolean ignore_case, const gchar *compiled_file);
+gboolean in_list_set_save(InListSet *self, const gchar *filename);
+
+gboolean in_list_set_contains(InListSet *self, const gchar *value, gssize value_len);
+guint32 in_list_set_get_size(InListSet *self);
+gboolean in_list_set_is_mmapped(InListSet *self);
+
+InListSet *in_list_set_ref(InListSet *self);
+void in_list_set_unref(InListSet *self);
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "filter/filter-program.h"
+#include "filter/filter-expr-parser.h"
+#include "test_filters_common.h"
+#include "cfg-lexer.h"
+#include "apphook.h"
+
+#include <criterion/criterion.h>
+#include <criterion/parameterized.h>
+
+static FilterExprNode *
+_compile_filter(const gchar *config_snippet)
+{
+  FilterExprNode *filter;
+
+  CfgLexer *lexer = cfg_lexer_new_buffer(configuration, config_snippet, strlen(config_snippet));
+  cr_assert(lexer, "Couldn't initialize a buffer for CfgLexer");
+
+  cr_assert(cfg_run_parser(configuration, lexer, &filter_expr_parser, (gpointer *) &filter, NULL));
+  cr_assert(filter_expr_init(filter, configuration));
+  return filter;
+}
+
+typedef struct _FilterProgramParams
+{
+  gchar *config_snippet;
+  gint expected_length;
+} FilterProgramParams;
+
+ParameterizedTestParameters(filter_program, test_program_evaluates_the_same_as_the_tree)
+{
+  static FilterProgramParams test_data_list[] =
+  {
+    /* priority checks are folded into a single lookup */
+    {.config_snippet = "facility(kern) and level(err..emerg)", .expected_length = 1 },
+    {.config_snippet = "facility(user, daemon) or not level(debug)", .expected_length = 1 },
+    {.config_snippet = "not (facility(2) and level(3))", .expected_length = 1 },
+    {.config_snippet = "(not facility(2)) or (not level(3) and facility(3))", .expected_length = 1 },
+
+    {.config_snippet = "facility(user) and (program(\"openvpn\") or level(info))", .expected_length = 5 },
+    {.config_snippet = "not (program(\"openvpn\") or level(info))", .expected_length = 4 },
+    {.config_snippet = "\"${PROGRAM}\" eq \"openvpn\" and not \"${PID}\" == \"2499\"", .expected_length = 3 },
+    {.config_snippet = "\"${PROGRAM}\" ne \"foo\" or facility(mail)", .expected_length = 3 },
+    {.config_snippet = "level(err) or \"${PROGRAM}\" eq \"openvpn\" and facility(cron)", .expected_length = 5 },
+    {.config_snippet = "\"${PROGRAM}\" eq \"foo\" or \"${PROGRAM}\" eq \"openvpn\" or message(\"PTHREAD\")", .expected_length = 5 },
+  };
+
+  return cr_make_param_array(FilterProgramParams, test_data_list, G_N_ELEMENTS(test_data_list));
+}
+
+ParameterizedTest(FilterProgramParams *params, filter_program, test_program_evaluates_the_same_as_the_tree)
+{
+  FilterExprNode *filter = _compile_filter(params->config_snippet);
+  FilterProgram *program = filter_program_compile(filter);
+
+  cr_assert(program);
+  cr_assert_eq(filter_program_get_length(program), params->expected_length,
+               "unexpected program length for %s: %d", params->config_snippet,
+               filter_program_get_length(program));
+
+  for (gint pri = 0; pri < 24 * 8; pri++)
+    {
+      gchar *msg = g_strdup_printf("<%d> openvpn[2499]: PTHREAD support initialized", pri);
+      LogMessage *logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+
+      cr_assert_eq(filter_program_eval(program, &logmsg, 1), filter_expr_eval(filter, logmsg),
+                   "program and tree evaluation differ for %s, pri=%d", params->config_snippet, pri);
+
+      log_msg_unref(logmsg);
+      g_free(msg);
+    }
+
+  filter_program_free(program);
+  filter_expr_unref(filter);
+}
+
+Test(filter_program, test_templates_are_formatted_again_after_a_modifying_node)
+{
+  const gchar *config_snippet = "\"$1\" ne \"\" or (message(\"(f)oo\" flags(store-matches)) and \"$1\" eq \"f\")";
+  FilterExprNode *filter = _compile_filter(config_snippet);
+  FilterProgram *program = filter_program_compile(filter);
+  const gchar *msg = "<15> openvpn[2499]: foo";
+  LogMessage *program_msg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+  LogMessage *tree_msg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+
+  cr_assert(program);
+  cr_assert(filter_expr_eval(filter, tree_msg));
+  cr_assert(filter_program_eval(program, &program_msg, 1));
+
+  log_msg_unref(program_msg);
+  log_msg_unref(tree_msg);
+  filter_program_free(program);
+  filter_expr_unref(filter);
+}
+
+Test(filter_program, test_single_nodes_are_not_compiled)
+{
+  FilterExprNode *filter = _compile_filter("message(\"PTHREAD\")");
+
+  cr_assert_null(filter_program_compile(filter));
+  filter_expr_unref(filter);
+}
+
+TestSuite(filter_program, .init = setup, .fini = teardown);
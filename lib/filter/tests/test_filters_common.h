@@ -23,6 +23,13 @@
 
 #ifndef __TEST_FILTER_COMMON_H__
 #define __TEST_FILTER_COMMON_H__
+
+#include "filter/filter-expr.h"
+#include "template/templates.h"
+#include "msg-format.h"
+
+extern MsgFormatOptions parse_options;
+
 void
 testcase_with_socket(const gchar *msg, const gchar *sockaddr,
                      FilterExprNode *f,
@@ -24,6 +24,7 @@
 #include "filter/filter-op.h"
 #include "filter/filter-expr.h"
 #include "filter/filter-pri.h"
+#include "filter/filter-re.h"
 #include "filter/filter-expr-parser.h"
 #include "test_filters_common.h"
 #include "cfg-lexer.h"
@@ -94,4 +95,26 @@ ParameterizedTest(FilterParams *params, filter_op, test_or_evaluation)
   testcase(msg, filter, params->expected_result);
 }
 
+Test(filter_op, test_reorder_filters_moves_the_cheaper_and_more_selective_operand_first)
+{
+  const gchar *msg = "<16> openvpn[2499]: PTHREAD support initialized";
+  LogMessage *logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+  FilterExprNode *filter = fop_and_new(create_pcre_regexp_filter(LM_V_MESSAGE, "(P|T)+HREAD.*support", 0),
+                                       filter_facility_new(facility_bits("kern")));
+
+  configuration->reorder_filters = TRUE;
+  cr_assert(filter_expr_init(filter, configuration));
+  cr_assert_not(fop_is_reordered(filter));
+
+  for (gint i = 0; i < 100000; i++)
+    cr_assert_not(filter_expr_eval(filter, logmsg));
+  cr_assert(fop_is_reordered(filter), "the facility() check should be evaluated first");
+
+  filter->comp = 1;
+  cr_assert(filter_expr_eval(filter, logmsg));
+
+  filter_expr_unref(filter);
+  log_msg_unref(logmsg);
+}
+
 TestSuite(filter_op, .init = setup, .fini = teardown);
@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include "cfg.h"
 #include "messages.h"
@@ -32,11 +33,13 @@
 #include "apphook.h"
 #include "plugin.h"
 #include "filter/filter-in-list.h"
+#include "filter/in-list-set.h"
 
 #include <criterion/criterion.h>
 
 #define MSG_1 "<15>Sep  4 15:03:55 localhost test-program[3086]: some random message"
 #define MSG_2 "<15>Sep  4 15:03:55 localhost foo[3086]: some random message"
+#define MSG_UPPERCASE "<15>Sep  4 15:03:55 localhost TEST-Program[3086]: some random message"
 #define MSG_3 "<15>Sep  4 15:03:55 192.168.1.1 foo[3086]: some random message"
 #define MSG_LONG "<15>Sep  4 15:03:55 test-hostAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA foo[3086]: some random message"
 
@@ -127,6 +130,87 @@ Test(template_filters, test_filter_with_long_line)
   g_free(list_file_with_long_line);
 }
 
+Test(template_filters, test_filter_with_ignore_case)
+{
+  gchar *list_file_with_one_line = g_strdup_printf(LIST_FILE_DIR "test.list", top_srcdir);
+  FilterExprNode *filter = filter_in_list_construct("PROGRAM");
+
+  filter_in_list_set_ignore_case(filter, TRUE);
+  cr_assert(filter_in_list_load(filter, list_file_with_one_line));
+  cr_assert(evaluate_testcase(MSG_UPPERCASE, filter), "in-list filter should match case-insensitively");
+
+  cr_assert_not(evaluate_testcase(MSG_UPPERCASE, filter_in_list_new(list_file_with_one_line, "PROGRAM")),
+                "in-list filter should be case sensitive by default");
+  g_free(list_file_with_one_line);
+}
+
+Test(template_filters, test_set_lookup_is_length_aware)
+{
+  gchar *list_file_with_one_line = g_strdup_printf(LIST_FILE_DIR "test.list", top_srcdir);
+  InListSet *set = in_list_set_load(list_file_with_one_line, FALSE, NULL);
+
+  cr_assert_eq(in_list_set_get_size(set), 1);
+  cr_assert(in_list_set_contains(set, "test-program-and-trailing-junk", strlen("test-program")));
+  cr_assert(in_list_set_contains(set, "test-program", -1));
+  cr_assert_not(in_list_set_contains(set, "test-progra", -1));
+  cr_assert_not(in_list_set_contains(set, "test-program-and-trailing-junk", -1));
+
+  in_list_set_unref(set);
+  g_free(list_file_with_one_line);
+}
+
+Test(template_filters, test_sets_are_shared_between_instances)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "lot_of_lines.list", top_srcdir);
+  InListSet *set = in_list_set_load(list_file, FALSE, NULL);
+  InListSet *shared = in_list_set_load(list_file, FALSE, NULL);
+  InListSet *case_insensitive = in_list_set_load(list_file, TRUE, NULL);
+
+  cr_assert_eq(set, shared);
+  cr_assert_neq(set, case_insensitive);
+
+  in_list_set_unref(case_insensitive);
+  in_list_set_unref(shared);
+  in_list_set_unref(set);
+  g_free(list_file);
+}
+
+Test(template_filters, test_compiled_list_file_is_mmapped)
+{
+  gchar *list_file = g_strdup_printf(LIST_FILE_DIR "lot_of_lines.list", top_srcdir);
+  /* written to the build directory the test is run from */
+  const gchar *compiled_file = "test_filters_in_list_lot_of_lines.compiled";
+
+  g_unlink(compiled_file);
+
+  InListSet *set = in_list_set_load(list_file, FALSE, compiled_file);
+  cr_assert_not(in_list_set_is_mmapped(set));
+  cr_assert(g_file_test(compiled_file, G_FILE_TEST_EXISTS), "compiled list file should have been written");
+
+  InListSet *compiled = in_list_set_load(compiled_file, FALSE, NULL);
+  cr_assert_not_null(compiled);
+  cr_assert(in_list_set_is_mmapped(compiled));
+  cr_assert_eq(in_list_set_get_size(compiled), in_list_set_get_size(set));
+  cr_assert(in_list_set_contains(compiled, "test-program", -1));
+  cr_assert(in_list_set_contains(compiled, "foo-bar1", -1));
+  cr_assert_not(in_list_set_contains(compiled, "foo-bar", -1));
+
+  cr_assert_null(in_list_set_load(compiled_file, TRUE, NULL),
+                 "loading a compiled list with a different ignore-case() setting should fail");
+
+  in_list_set_unref(compiled);
+  in_list_set_unref(set);
+
+  /* the up-to-date compiled file is used instead of parsing the list again */
+  FilterExprNode *filter = filter_in_list_construct("PROGRAM");
+  filter_in_list_set_compiled_file(filter, compiled_file);
+  cr_assert(filter_in_list_load(filter, list_file));
+  cr_assert(evaluate_testcase(MSG_1, filter), "in-list filter matches");
+
+  g_unlink(compiled_file);
+  g_free(list_file);
+}
+
 static void
 setup(void)
 {
@@ -72,6 +72,7 @@ ParameterizedTestParameters(filter, test_filter_regexp_backref_chk)
     {.msg = "<15>Oct 15 16:17:01 host openvpn[2499]: alma fa", .field = LM_V_MESSAGE, .regexp = "(?P<a>a)(?P<l>l)(?P<MM>m)(?P<aa>a) (?P<fa>fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "MM", .value = "m"},
     {.msg = "<15>Oct 15 16:17:02 host openvpn[2499]: alma fa", .field = LM_V_MESSAGE, .regexp = "(?P<a>a)(?P<l>l)(?P<MM>m)(?P<aa>a) (?P<fa>fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "aaaa", .value = NULL},
     {.msg = "<15>Oct 15 16:17:03 host openvpn[2499]: alma fa", .field = LM_V_MESSAGE, .regexp = "(?P<a>a)(?P<l>l)(?P<MM>m)(?P<aa>a) (?P<fa_name>fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "fa_name", .value = "fa"},
+    {.msg = "<15>Oct 15 16:17:03 host openvpn[2499]: al fa", .field = LM_V_MESSAGE, .regexp = "(?P<aopt>x)?(?P<l>al) (?P<fa>fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "fa", .value = "fa"},
     {.msg = "<15>Oct 15 16:17:04 host openvpn[2499]: al fa", .field = LM_V_MESSAGE, .regexp = "(a)(l) (fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "2", .value = "l"},
     {.msg = "<15>Oct 15 16:17:05 host openvpn[2499]: al fa", .field = LM_V_MESSAGE, .regexp = "(a)(l) (fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "0", .value = "al fa"},
     {.msg = "<15>Oct 15 16:17:06 host openvpn[2499]: al fa", .field = LM_V_MESSAGE, .regexp = "(a)(l) (fa)", .flags = LMF_STORE_MATCHES, .expected_result = TRUE, .name = "233", .value = NULL}
@@ -206,3 +207,43 @@ Test(filter, test_match_with_template)
   filter_match_set_template_ref(filter, compile_template("$PID $PROGRAM", FALSE));
   testcase("<15>Oct 15 16:17:01 host openvpn[2499]: PTHREAD support initialized", filter, TRUE);
 }
+
+Test(filter, test_filters_on_the_same_value_share_a_literal_prefilter)
+{
+  const gchar *msg = "<15>Oct 15 16:17:01 host sshd[2499]: Accepted publickey for root";
+  FilterExprNode *filters[] =
+  {
+    create_pcre_regexp_filter(LM_V_MESSAGE, "^Accepted (password|publickey) for", 0),
+    create_pcre_regexp_filter(LM_V_MESSAGE, "Failed password", 0),
+    create_pcre_regexp_filter(LM_V_MESSAGE, "publickey for admin", 0),
+    create_pcre_regexp_filter(LM_V_MESSAGE, "PUBLICKEY", 0),
+    create_pcre_regexp_filter(LM_V_MESSAGE, "PUBLICKEY", LMF_ICASE),
+  };
+  gboolean expected_results[] = { TRUE, FALSE, FALSE, FALSE, TRUE };
+  LogMessage *logmsg = log_msg_new(msg, strlen(msg), NULL, &parse_options);
+
+  /* the prefilter is only used for messages delivered to multiple log paths */
+  log_msg_enable_result_cache(logmsg);
+
+  for (gint i = 0; i < G_N_ELEMENTS(filters); i++)
+    cr_assert(filter_expr_init(filters[i], configuration));
+
+  for (gint i = 0; i < G_N_ELEMENTS(filters); i++)
+    {
+      cr_assert_eq(filter_expr_eval(filters[i], logmsg), expected_results[i], "Filter test failed; filter=%d", i);
+
+      filters[i]->comp = 1;
+      cr_assert_eq(filter_expr_eval(filters[i], logmsg), !expected_results[i], "Filter test failed (negated); filter=%d",
+                   i);
+      filters[i]->comp = 0;
+    }
+
+  /* changing the value invalidates the literals found earlier */
+  log_msg_set_value(logmsg, LM_V_MESSAGE, "Failed password for root", -1);
+  cr_assert_not(filter_expr_eval(filters[0], logmsg));
+  cr_assert(filter_expr_eval(filters[1], logmsg));
+
+  for (gint i = 0; i < G_N_ELEMENTS(filters); i++)
+    filter_expr_unref(filters[i]);
+  log_msg_unref(logmsg);
+}
@@ -24,18 +24,31 @@
 #include "find-crlf.h"
 
 #include <string.h>
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define FIND_CRLF_HAVE_SSE2 1
+#include <emmintrin.h>
+#if (defined(__clang__) || __GNUC__ >= 5)
+#define FIND_CRLF_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
+
+typedef const guchar *(*FindTerminatorFunc)(const guchar *s, gsize n);
+
 /**
  * This is an optimized version of finding either a CR or LF or NUL
  * character in a buffer.  It is used to find these line terminators in
  * syslog traffic.
  *
  * It uses an algorithm very similar to what there's in libc memchr/strchr.
+ * This is the portable fallback of the SIMD variants below.
  **/
-gchar *
-find_cr_or_lf(gchar *s, gsize n)
+static const guchar *
+_find_cr_or_lf_or_nul_generic(const guchar *s, gsize n)
 {
-  gchar *char_ptr;
-  gulong *longword_ptr;
+  const guchar *char_ptr;
+  const gulong *longword_ptr;
   gulong longword, magic_bits, cr_charmask, lf_charmask;
   const char CR = '\r';
   const char LF = '\n';
@@ -43,13 +56,11 @@ find_cr_or_lf(gchar *s, gsize n)
   /* align input to long boundary */
   for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
     {
-      if (*char_ptr == CR || *char_ptr == LF)
+      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
         return char_ptr;
-      else if (*char_ptr == 0)
-        return NULL;
     }
 
-  longword_ptr = (gulong *) char_ptr;
+  longword_ptr = (const gulong *) char_ptr;
 
 #if GLIB_SIZEOF_LONG == 8
   magic_bits = 0x7efefefefefefeffL;
@@ -70,30 +81,304 @@ find_cr_or_lf(gchar *s, gsize n)
         {
           gint i;
 
-          char_ptr = (gchar *) (longword_ptr - 1);
+          char_ptr = (const guchar *) (longword_ptr - 1);
+
+          for (i = 0; i < sizeof(longword); i++)
+            {
+              if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
+                return char_ptr;
+              char_ptr++;
+            }
+        }
+      n -= sizeof(longword);
+    }
+
+  char_ptr = (const guchar *) longword_ptr;
+
+  while (n-- > 0)
+    {
+      if (*char_ptr == CR || *char_ptr == LF || *char_ptr == 0)
+        return char_ptr;
+      ++char_ptr;
+    }
+
+  return NULL;
+}
+
+/**
+ * Find the first LF or NUL character in the buffer, the portable fallback
+ * of find_lf_or_nul().
+ **/
+static const guchar *
+_find_lf_or_nul_generic(const guchar *s, gsize n)
+{
+  const guchar *char_ptr;
+  const gulong *longword_ptr;
+  gulong longword, magic_bits, charmask;
+  gchar c;
+
+  c = '\n';
+
+  /* align input to long boundary */
+  for (char_ptr = s; n > 0 && ((gulong) char_ptr & (sizeof(longword) - 1)) != 0; ++char_ptr, n--)
+    {
+      if (*char_ptr == c || *char_ptr == '\0')
+        return char_ptr;
+    }
+
+  longword_ptr = (const gulong *) char_ptr;
+
+#if GLIB_SIZEOF_LONG == 8
+  magic_bits = 0x7efefefefefefeffL;
+#elif GLIB_SIZEOF_LONG == 4
+  magic_bits = 0x7efefeffL;
+#else
+#error "unknown architecture"
+#endif
+  memset(&charmask, c, sizeof(charmask));
+
+  while (n > sizeof(longword))
+    {
+      longword = *longword_ptr++;
+      if ((((longword + magic_bits) ^ ~longword) & ~magic_bits) != 0 ||
+          ((((longword ^ charmask) + magic_bits) ^ ~(longword ^ charmask)) & ~magic_bits) != 0)
+        {
+          gint i;
+
+          char_ptr = (const guchar *) (longword_ptr - 1);
 
           for (i = 0; i < sizeof(longword); i++)
             {
-              if (*char_ptr == CR || *char_ptr == LF)
+              if (*char_ptr == c || *char_ptr == '\0')
                 return char_ptr;
-              else if (*char_ptr == 0)
-                return NULL;
               char_ptr++;
             }
         }
       n -= sizeof(longword);
     }
 
-  char_ptr = (gchar *) longword_ptr;
+  char_ptr = (const guchar *) longword_ptr;
 
   while (n-- > 0)
     {
-      if (*char_ptr == CR || *char_ptr == LF)
+      if (*char_ptr == c || *char_ptr == '\0')
         return char_ptr;
-      else if (*char_ptr == 0)
-        return NULL;
       ++char_ptr;
     }
 
   return NULL;
 }
+
+#if FIND_CRLF_HAVE_SSE2
+
+/*
+ * The SIMD variants compare 16 (SSE2) or 32 (AVX2) bytes at a time against
+ * all the terminator characters, and use the resulting bitmask to locate
+ * the first match directly, without going back to a byte-by-byte loop.
+ * Loads are unaligned and never cross the end of the buffer, the last
+ * partial block is handled by the generic implementation.
+ */
+
+static const guchar *
+_find_cr_or_lf_or_nul_sse2(const guchar *s, gsize n)
+{
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+
+  while (n >= 16)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) s);
+      __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, cr),
+                                                _mm_cmpeq_epi8(block, lf)),
+                                   _mm_cmpeq_epi8(block, nul));
+      guint32 mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += 16;
+      n -= 16;
+    }
+  return _find_cr_or_lf_or_nul_generic(s, n);
+}
+
+static const guchar *
+_find_lf_or_nul_sse2(const guchar *s, gsize n)
+{
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i nul = _mm_setzero_si128();
+
+  while (n >= 16)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) s);
+      __m128i match = _mm_or_si128(_mm_cmpeq_epi8(block, lf),
+                                   _mm_cmpeq_epi8(block, nul));
+      guint32 mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += 16;
+      n -= 16;
+    }
+  return _find_lf_or_nul_generic(s, n);
+}
+
+#endif
+
+#if FIND_CRLF_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static const guchar *
+_find_cr_or_lf_or_nul_avx2(const guchar *s, gsize n)
+{
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i nul = _mm256_setzero_si256();
+
+  while (n >= 32)
+    {
+      __m256i block = _mm256_loadu_si256((const __m256i *) s);
+      __m256i match = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, cr),
+                                                      _mm256_cmpeq_epi8(block, lf)),
+                                      _mm256_cmpeq_epi8(block, nul));
+      guint32 mask = (guint32) _mm256_movemask_epi8(match);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += 32;
+      n -= 32;
+    }
+  return _find_cr_or_lf_or_nul_sse2(s, n);
+}
+
+__attribute__((target("avx2")))
+static const guchar *
+_find_lf_or_nul_avx2(const guchar *s, gsize n)
+{
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i nul = _mm256_setzero_si256();
+
+  while (n >= 32)
+    {
+      __m256i block = _mm256_loadu_si256((const __m256i *) s);
+      __m256i match = _mm256_or_si256(_mm256_cmpeq_epi8(block, lf),
+                                      _mm256_cmpeq_epi8(block, nul));
+      guint32 mask = (guint32) _mm256_movemask_epi8(match);
+
+      if (mask)
+        return s + __builtin_ctz(mask);
+      s += 32;
+      n -= 32;
+    }
+  return _find_lf_or_nul_sse2(s, n);
+}
+
+#endif
+
+static gboolean
+_is_impl_supported(FindCrlfImpl impl)
+{
+  switch (impl)
+    {
+    case FIND_CRLF_IMPL_GENERIC:
+      return TRUE;
+#if FIND_CRLF_HAVE_SSE2
+    case FIND_CRLF_IMPL_SSE2:
+      return TRUE;
+#endif
+#if FIND_CRLF_HAVE_AVX2
+    case FIND_CRLF_IMPL_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return FALSE;
+    }
+}
+
+static FindCrlfImpl
+_detect_best_impl(void)
+{
+  if (_is_impl_supported(FIND_CRLF_IMPL_AVX2))
+    return FIND_CRLF_IMPL_AVX2;
+  if (_is_impl_supported(FIND_CRLF_IMPL_SSE2))
+    return FIND_CRLF_IMPL_SSE2;
+  return FIND_CRLF_IMPL_GENERIC;
+}
+
+static const guchar *_find_cr_or_lf_or_nul_resolve(const guchar *s, gsize n);
+static const guchar *_find_lf_or_nul_resolve(const guchar *s, gsize n);
+
+static FindTerminatorFunc find_cr_or_lf_or_nul_impl = _find_cr_or_lf_or_nul_resolve;
+static FindTerminatorFunc find_lf_or_nul_impl = _find_lf_or_nul_resolve;
+
+gboolean
+find_crlf_set_impl(FindCrlfImpl impl)
+{
+  if (impl == FIND_CRLF_IMPL_AUTO)
+    impl = _detect_best_impl();
+
+  if (!_is_impl_supported(impl))
+    return FALSE;
+
+  switch (impl)
+    {
+#if FIND_CRLF_HAVE_AVX2
+    case FIND_CRLF_IMPL_AVX2:
+      find_cr_or_lf_or_nul_impl = _find_cr_or_lf_or_nul_avx2;
+      find_lf_or_nul_impl = _find_lf_or_nul_avx2;
+      break;
+#endif
+#if FIND_CRLF_HAVE_SSE2
+    case FIND_CRLF_IMPL_SSE2:
+      find_cr_or_lf_or_nul_impl = _find_cr_or_lf_or_nul_sse2;
+      find_lf_or_nul_impl = _find_lf_or_nul_sse2;
+      break;
+#endif
+    default:
+      find_cr_or_lf_or_nul_impl = _find_cr_or_lf_or_nul_generic;
+      find_lf_or_nul_impl = _find_lf_or_nul_generic;
+      break;
+    }
+  return TRUE;
+}
+
+/* the first call selects the best implementation for the running CPU,
+ * racing callers would store the same function pointers anyway */
+static const guchar *
+_find_cr_or_lf_or_nul_resolve(const guchar *s, gsize n)
+{
+  find_crlf_set_impl(FIND_CRLF_IMPL_AUTO);
+  return find_cr_or_lf_or_nul_impl(s, n);
+}
+
+static const guchar *
+_find_lf_or_nul_resolve(const guchar *s, gsize n)
+{
+  find_crlf_set_impl(FIND_CRLF_IMPL_AUTO);
+  return find_lf_or_nul_impl(s, n);
+}
+
+/*
+ * Find the first CR or LF character in the buffer, returns NULL if there's
+ * none, or if a NUL character precedes them.
+ */
+gchar *
+find_cr_or_lf(gchar *s, gsize n)
+{
+  gchar *eol = (gchar *) find_cr_or_lf_or_nul_impl((const guchar *) s, n);
+
+  if (eol && *eol == 0)
+    return NULL;
+  return eol;
+}
+
+/*
+ * Find the first LF or NUL character in the buffer, returns NULL if there's
+ * none.
+ */
+const guchar *
+find_lf_or_nul(const guchar *s, gsize n)
+{
+  return find_lf_or_nul_impl(s, n);
+}
@@ -26,6 +26,19 @@
 
 #include "syslog-ng.h"
 
+typedef enum
+{
+  FIND_CRLF_IMPL_AUTO,
+  FIND_CRLF_IMPL_GENERIC,
+  FIND_CRLF_IMPL_SSE2,
+  FIND_CRLF_IMPL_AVX2,
+} FindCrlfImpl;
+
 gchar *find_cr_or_lf(gchar *s, gsize n);
+const guchar *find_lf_or_nul(const guchar *s, gsize n);
+
+/* select the implementation explicitly (mostly for testing & benchmarking),
+ * returns FALSE if the running CPU does not support it */
+gboolean find_crlf_set_impl(FindCrlfImpl impl);
 
 #endif
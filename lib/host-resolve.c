@@ -322,6 +322,23 @@ sockaddr_to_dnscache_key(GSockAddr *saddr)
     }
 }
 
+static const gchar *
+resolve_address_using_dns(GSockAddr *saddr, gchar *buf, gsize buf_len)
+{
+#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
+  return resolve_address_using_getnameinfo(saddr, buf, buf_len);
+#else
+  return resolve_address_using_gethostbyaddr(saddr, buf, buf_len);
+#endif
+}
+
+static gboolean
+should_use_dns(const HostResolveOptions *host_resolve_options)
+{
+  /* use_dns(persist_only) is represented as 2 */
+  return host_resolve_options->use_dns && host_resolve_options->use_dns != 2;
+}
+
 static const gchar *
 resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
                                            const HostResolveOptions *host_resolve_options)
@@ -338,17 +355,14 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
 
   if (host_resolve_options->use_dns_cache)
     {
-      if (dns_caching_lookup(saddr->sa.sa_family, dnscache_key, (const gchar **) &hname, &hname_len, &positive))
-        return hostname_apply_options_fqdn(hname_len, result_len, hname, positive, host_resolve_options);
+      if (dns_caching_lookup(saddr->sa.sa_family, dnscache_key, hostname_buffer, sizeof(hostname_buffer), &hname_len,
+                             &positive))
+        return hostname_apply_options_fqdn(hname_len, result_len, hostname_buffer, positive, host_resolve_options);
     }
 
-  if (!hname && host_resolve_options->use_dns && host_resolve_options->use_dns != 2)
+  if (should_use_dns(host_resolve_options))
     {
-#ifdef SYSLOG_NG_HAVE_GETNAMEINFO
-      hname = resolve_address_using_getnameinfo(saddr, hostname_buffer, sizeof(hostname_buffer));
-#else
-      hname = resolve_address_using_gethostbyaddr(saddr, hostname_buffer, sizeof(hostname_buffer));
-#endif
+      hname = resolve_address_using_dns(saddr, hostname_buffer, sizeof(hostname_buffer));
       positive = (hname != NULL);
     }
 
@@ -363,6 +377,43 @@ resolve_sockaddr_to_inet_or_inet6_hostname(gsize *result_len, GSockAddr *saddr,
   return hostname_apply_options_fqdn(-1, result_len, hname, positive, host_resolve_options);
 }
 
+/*
+ * Returns TRUE if resolve_sockaddr_to_hostname() would have to query DNS
+ * for @saddr, e.g.  the result is not available in the DNS cache.  Only
+ * lookups that store their result in the cache are considered, as those
+ * can be performed asynchronously by resolve_sockaddr_into_dns_cache().
+ */
+gboolean
+resolve_sockaddr_needs_dns_query(GSockAddr *saddr, const HostResolveOptions *host_resolve_options)
+{
+  void *dnscache_key;
+
+  if (is_sockaddr_local(saddr) || !host_resolve_options->use_dns_cache || !should_use_dns(host_resolve_options))
+    return FALSE;
+
+  dnscache_key = sockaddr_to_dnscache_key(saddr);
+  return dnscache_key && !dns_caching_is_cached(saddr->sa.sa_family, dnscache_key);
+}
+
+/* resolves @saddr using DNS and stores the result in the DNS cache */
+void
+resolve_sockaddr_into_dns_cache(GSockAddr *saddr)
+{
+  void *dnscache_key = sockaddr_to_dnscache_key(saddr);
+  const gchar *hname;
+  gboolean positive;
+
+  if (!dnscache_key || dns_caching_is_cached(saddr->sa.sa_family, dnscache_key))
+    return;
+
+  hname = resolve_address_using_dns(saddr, hostname_buffer, sizeof(hostname_buffer));
+  positive = (hname != NULL);
+  if (!hname)
+    hname = g_sockaddr_format(saddr, hostname_buffer, sizeof(hostname_buffer), GSA_ADDRESS_ONLY);
+
+  dns_caching_store(saddr->sa.sa_family, dnscache_key, hname, positive);
+}
+
 const gchar *
 resolve_sockaddr_to_hostname(gsize *result_len, GSockAddr *saddr, const HostResolveOptions *host_resolve_options)
 {
@@ -38,6 +38,8 @@ typedef struct _HostResolveOptions
 const gchar *resolve_sockaddr_to_hostname(gsize *result_len, GSockAddr *saddr,
                                           const HostResolveOptions *host_resolve_options);
 gboolean resolve_hostname_to_sockaddr(GSockAddr **addr, gint family, const gchar *name);
+gboolean resolve_sockaddr_needs_dns_query(GSockAddr *saddr, const HostResolveOptions *host_resolve_options);
+void resolve_sockaddr_into_dns_cache(GSockAddr *saddr);
 const gchar *resolve_hostname_to_hostname(gsize *result_len, const gchar *hostname, HostResolveOptions *options);
 
 void host_resolve_options_defaults(HostResolveOptions *options);
@@ -27,7 +27,7 @@
 #include "cfg.h"
 #include "str-utils.h"
 #include "compat/string.h"
-#include "compat/pcre.h"
+#include "pcre-exec.h"
 
 static gboolean
 _shall_set_values_indirectly(NVHandle value_handle)
@@ -58,6 +58,80 @@ log_matcher_init(LogMatcher *self, const LogMatcherOptions *options)
   self->free_fn = log_matcher_free_method;
 }
 
+/* Literal extraction: collects the longest run of characters that has to be
+ * present in every value the matcher accepts.  It is used to prefilter
+ * values before running the matcher itself, so it has to be conservative:
+ * whenever unsure, the current run is terminated.  */
+
+typedef struct _LogMatcherLiteralExtractor
+{
+  GString *run;
+  GString *longest;
+  gboolean icase;
+} LogMatcherLiteralExtractor;
+
+static void
+_literal_extractor_init(LogMatcherLiteralExtractor *self, gboolean icase)
+{
+  self->run = g_string_sized_new(32);
+  self->longest = g_string_sized_new(32);
+  self->icase = icase;
+}
+
+static void
+_literal_extractor_end_run(LogMatcherLiteralExtractor *self)
+{
+  if (self->run->len > self->longest->len)
+    g_string_assign(self->longest, self->run->str);
+  g_string_truncate(self->run, 0);
+}
+
+static void
+_literal_extractor_add_char(LogMatcherLiteralExtractor *self, guchar c)
+{
+  /* caseless comparison of non-ASCII characters cannot be done bytewise */
+  if (self->icase && c >= 0x80)
+    {
+      _literal_extractor_end_run(self);
+      return;
+    }
+  g_string_append_c(self->run, c);
+}
+
+/* the last character of the run was made optional by a quantifier, drop
+ * it along with its UTF-8 continuation bytes */
+static void
+_literal_extractor_drop_last_char(LogMatcherLiteralExtractor *self)
+{
+  gsize len = self->run->len;
+
+  while (len > 0 && (self->run->str[len - 1] & 0xC0) == 0x80)
+    len--;
+  if (len > 0)
+    len--;
+  g_string_truncate(self->run, len);
+  _literal_extractor_end_run(self);
+}
+
+static gchar *
+_literal_extractor_abort(LogMatcherLiteralExtractor *self)
+{
+  g_string_free(self->run, TRUE);
+  g_string_free(self->longest, TRUE);
+  return NULL;
+}
+
+static gchar *
+_literal_extractor_finish(LogMatcherLiteralExtractor *self)
+{
+  _literal_extractor_end_run(self);
+  if (self->longest->len == 0)
+    return _literal_extractor_abort(self);
+
+  g_string_free(self->run, TRUE);
+  return g_string_free(self->longest, FALSE);
+}
+
 typedef struct _LogMatcherString
 {
   LogMatcher super;
@@ -200,6 +274,18 @@ log_matcher_string_replace(LogMatcher *s, LogMessage *msg, gint value_handle, co
   return NULL;
 }
 
+/* exact, prefix and substring matches all require the complete pattern */
+static gchar *
+log_matcher_string_get_required_literal(LogMatcher *s)
+{
+  LogMatcherLiteralExtractor extractor;
+
+  _literal_extractor_init(&extractor, s->flags & LMF_ICASE);
+  for (const gchar *p = s->pattern; *p; p++)
+    _literal_extractor_add_char(&extractor, *p);
+  return _literal_extractor_finish(&extractor);
+}
+
 LogMatcher *
 log_matcher_string_new(const LogMatcherOptions *options)
 {
@@ -209,6 +295,7 @@ log_matcher_string_new(const LogMatcherOptions *options)
   self->super.compile = log_matcher_string_compile;
   self->super.match = log_matcher_string_match;
   self->super.replace = log_matcher_string_replace;
+  self->super.get_required_literal = log_matcher_string_get_required_literal;
 
   return &self->super;
 }
@@ -269,6 +356,22 @@ log_matcher_glob_free(LogMatcher *s)
   log_matcher_free_method(s);
 }
 
+static gchar *
+log_matcher_glob_get_required_literal(LogMatcher *s)
+{
+  LogMatcherLiteralExtractor extractor;
+
+  _literal_extractor_init(&extractor, FALSE);
+  for (const gchar *p = s->pattern; *p; p++)
+    {
+      if (*p == '*' || *p == '?')
+        _literal_extractor_end_run(&extractor);
+      else
+        _literal_extractor_add_char(&extractor, *p);
+    }
+  return _literal_extractor_finish(&extractor);
+}
+
 LogMatcher *
 log_matcher_glob_new(const LogMatcherOptions *options)
 {
@@ -278,6 +381,7 @@ log_matcher_glob_new(const LogMatcherOptions *options)
   self->super.compile = log_matcher_glob_compile;
   self->super.match = log_matcher_glob_match;
   self->super.replace = NULL;
+  self->super.get_required_literal = log_matcher_glob_get_required_literal;
   self->super.free_fn = log_matcher_glob_free;
 
   return &self->super;
@@ -291,6 +395,12 @@ typedef struct _LogMatcherPcreRe
   pcre *pattern;
   pcre_extra *extra;
   gint match_options;
+
+  /* looked up at compile time, instead of calling pcre_fullinfo() for every match */
+  gint num_matches;
+  gint name_count;
+  gint name_entry_size;
+  const gchar *name_table;
 } LogMatcherPcreRe;
 
 static gboolean
@@ -365,6 +475,22 @@ _study_pcre_regexp(LogMatcherPcreRe *self, const gchar *re, GError **error)
   return TRUE;
 }
 
+static void
+_lookup_pcre_info(LogMatcherPcreRe *self)
+{
+  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &self->num_matches) < 0)
+    g_assert_not_reached();
+  if (self->num_matches > RE_MAX_MATCHES)
+    self->num_matches = RE_MAX_MATCHES;
+
+  pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMECOUNT, &self->name_count);
+  if (self->name_count > 0)
+    {
+      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMETABLE, &self->name_table);
+      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMEENTRYSIZE, &self->name_entry_size);
+    }
+}
+
 static gboolean
 log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
 {
@@ -379,6 +505,7 @@ log_matcher_pcre_re_compile(LogMatcher *s, const gchar *re, GError **error)
   if (!_study_pcre_regexp(self, re, error))
     return FALSE;
 
+  _lookup_pcre_info(self);
   return TRUE;
 }
 
@@ -411,37 +538,22 @@ log_matcher_pcre_re_feed_backrefs(LogMatcher *s, LogMessage *msg, gint value_han
 static void
 log_matcher_pcre_re_feed_named_substrings(LogMatcher *s, LogMessage *msg, int *matches, const gchar *value)
 {
-  gchar *name_table = NULL;
-  gint i = 0;
-  gint namecount = 0;
-  gint name_entry_size = 0;
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
+  const gchar *tabptr = self->name_table;
+  gint i;
 
-  pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMECOUNT, &namecount);
-  if (namecount > 0)
+  /* each entry of the name table is the number of the group in two bytes,
+   * followed by its NUL terminated name */
+  for (i = 0; i < self->name_count; i++, tabptr += self->name_entry_size)
     {
-      gchar *tabptr;
-      /* Before we can access the substrings, we must extract the table for
-         translating names to numbers, and the size of each entry in the table.
-       */
-      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMETABLE, &name_table);
-      pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_NAMEENTRYSIZE, &name_entry_size);
-      /* Now we can scan the table and, for each entry, print the number, the name,
-         and the substring itself.
-       */
-      tabptr = name_table;
-      for (i = 0; i < namecount; i++)
-        {
-          int n = (tabptr[0] << 8) | tabptr[1];
-          gint begin_index = matches[2 * n];
-          gint end_index = matches[2 * n + 1];
+      int n = (tabptr[0] << 8) | tabptr[1];
+      gint begin_index = matches[2 * n];
+      gint end_index = matches[2 * n + 1];
 
-          if (begin_index < 0 || end_index < 0)
-            continue;
+      if (begin_index < 0 || end_index < 0)
+        continue;
 
-          log_msg_set_value_by_name(msg, tabptr + 2, value + begin_index, end_index - begin_index);
-          tabptr += name_entry_size;
-        }
+      log_msg_set_value_by_name(msg, tabptr + 2, value + begin_index, end_index - begin_index);
     }
 }
 
@@ -451,22 +563,16 @@ log_matcher_pcre_re_match(LogMatcher *s, LogMessage *msg, gint value_handle, con
   LogMatcherPcreRe *self = (LogMatcherPcreRe *) s;
   gint *matches;
   gsize matches_size;
-  gint num_matches;
   gint rc;
 
   if (value_len == -1)
     value_len = strlen(value);
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
-  matches_size = 3 * (num_matches + 1);
+  matches_size = 3 * (self->num_matches + 1);
   matches = g_alloca(matches_size * sizeof(gint));
 
-  rc = pcre_exec(self->pattern, self->extra,
-                 value, value_len, 0, self->match_options, matches, matches_size);
+  rc = log_pcre_exec(self->pattern, self->extra,
+                     value, value_len, 0, self->match_options, matches, matches_size);
   if (rc < 0)
     {
       switch (rc)
@@ -505,18 +611,12 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
   GString *new_value = NULL;
   gint *matches;
   gsize matches_size;
-  gint num_matches;
   gint rc;
   gint start_offset, last_offset;
   gint options;
   gboolean last_match_was_empty;
 
-  if (pcre_fullinfo(self->pattern, self->extra, PCRE_INFO_CAPTURECOUNT, &num_matches) < 0)
-    g_assert_not_reached();
-  if (num_matches > RE_MAX_MATCHES)
-    num_matches = RE_MAX_MATCHES;
-
-  matches_size = 3 * (num_matches + 1);
+  matches_size = 3 * (self->num_matches + 1);
   matches = g_alloca(matches_size * sizeof(gint));
 
   /* we need zero initialized offsets for the last match as the
@@ -566,9 +666,9 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
           options = 0;
         }
 
-      rc = pcre_exec(self->pattern, self->extra,
-                     value, value_len,
-                     start_offset, (self->match_options | options), matches, matches_size);
+      rc = log_pcre_exec(self->pattern, self->extra,
+                         value, value_len,
+                         start_offset, (self->match_options | options), matches, matches_size);
       if (rc < 0 && rc != PCRE_ERROR_NOMATCH)
         {
           msg_error("Error while matching regexp",
@@ -628,6 +728,214 @@ log_matcher_pcre_re_replace(LogMatcher *s, LogMessage *msg, gint value_handle, c
   return NULL;
 }
 
+/* skips the argument of an escape sequence like \x41, \x{263a}, \p{L} or \g-1 */
+static const gchar *
+_skip_pcre_escape_argument(gchar escape, const gchar *p)
+{
+  const gchar *closing_chars = "}>'";
+  const gchar *opening_chars = "{<'";
+  const gchar *bracket;
+
+  if (escape == 'c')
+    return *p ? p + 1 : p;
+
+  if (*p && (bracket = strchr(opening_chars, *p)) && strchr("xopPNgk", escape))
+    {
+      const gchar *end = strchr(p + 1, closing_chars[bracket - opening_chars]);
+
+      return end ? end + 1 : NULL;
+    }
+
+  switch (escape)
+    {
+    case 'x':
+      for (gint i = 0; i < 2 && g_ascii_isxdigit(*p); i++)
+        p++;
+      break;
+    case 'p':
+    case 'P':
+      if (*p)
+        p++;
+      break;
+    case 'g':
+      if (*p == '-' || *p == '+')
+        p++;
+      while (g_ascii_isdigit(*p))
+        p++;
+      break;
+    default:
+      if (g_ascii_isdigit(escape))
+        {
+          while (g_ascii_isdigit(*p))
+            p++;
+        }
+      break;
+    }
+  return p;
+}
+
+/* returns the position right after the character class starting at @p */
+static const gchar *
+_skip_pcre_char_class(const gchar *p)
+{
+  p++;
+  if (*p == '^')
+    p++;
+  if (*p == ']')
+    p++;
+
+  while (*p)
+    {
+      if (*p == '\\')
+        {
+          if (!p[1])
+            return NULL;
+          p += 2;
+        }
+      else if (p[0] == '[' && p[1] == ':')
+        {
+          const gchar *end = strstr(p + 2, ":]");
+
+          if (!end)
+            return NULL;
+          p = end + 2;
+        }
+      else if (*p == ']')
+        {
+          return p + 1;
+        }
+      else
+        {
+          p++;
+        }
+    }
+  return NULL;
+}
+
+/* returns TRUE if the group at @p is an option setting like (?i) or
+ * (?i:...), ignores groups that change the interpretation of the rest of
+ * the pattern by setting @supported to FALSE */
+static gboolean
+_process_pcre_option_group(const gchar *p, LogMatcherLiteralExtractor *extractor, gboolean *supported,
+                           gboolean *opens_group)
+{
+  const gchar *options = p + 2;
+  gsize options_len = strspn(options, "imnsxJUX-");
+
+  if (options[options_len] != ')' && options[options_len] != ':')
+    return FALSE;
+
+  if (memchr(options, 'x', options_len))
+    *supported = FALSE;
+  if (memchr(options, 'i', options_len))
+    extractor->icase = TRUE;
+  *opens_group = options[options_len] == ':';
+  return TRUE;
+}
+
+static gboolean
+_is_pcre_counted_quantifier(const gchar *p)
+{
+  p++;
+  if (!g_ascii_isdigit(*p))
+    return FALSE;
+  while (g_ascii_isdigit(*p) || *p == ',')
+    p++;
+  return *p == '}';
+}
+
+/* Only literals outside of groups are considered, a top-level alternation
+ * means there is no required literal at all. */
+static gchar *
+log_matcher_pcre_re_get_required_literal(LogMatcher *s)
+{
+  LogMatcherLiteralExtractor extractor;
+  const gchar *p = s->pattern;
+  gint depth = 0;
+
+  _literal_extractor_init(&extractor, s->flags & LMF_ICASE);
+  while (*p)
+    {
+      gboolean supported = TRUE;
+      gboolean opens_group = TRUE;
+
+      switch (*p)
+        {
+        case '\\':
+          if (p[1] == 0 || p[1] == 'Q')
+            return _literal_extractor_abort(&extractor);
+
+          if (!g_ascii_isalnum(p[1]))
+            {
+              if (depth == 0)
+                _literal_extractor_add_char(&extractor, p[1]);
+              p += 2;
+              continue;
+            }
+
+          _literal_extractor_end_run(&extractor);
+          p = _skip_pcre_escape_argument(p[1], p + 2);
+          if (!p)
+            return _literal_extractor_abort(&extractor);
+          continue;
+        case '[':
+          _literal_extractor_end_run(&extractor);
+          p = _skip_pcre_char_class(p);
+          if (!p)
+            return _literal_extractor_abort(&extractor);
+          continue;
+        case '(':
+          _literal_extractor_end_run(&extractor);
+          if (p[1] == '?' && _process_pcre_option_group(p, &extractor, &supported, &opens_group))
+            {
+              if (!supported)
+                return _literal_extractor_abort(&extractor);
+              if (!opens_group)
+                {
+                  p = strchr(p, ')') + 1;
+                  continue;
+                }
+            }
+          depth++;
+          break;
+        case ')':
+          _literal_extractor_end_run(&extractor);
+          depth--;
+          break;
+        case '|':
+          if (depth == 0)
+            return _literal_extractor_abort(&extractor);
+          break;
+        case '?':
+        case '*':
+          _literal_extractor_drop_last_char(&extractor);
+          break;
+        case '{':
+          if (_is_pcre_counted_quantifier(p))
+            {
+              _literal_extractor_drop_last_char(&extractor);
+              p = strchr(p, '}') + 1;
+              continue;
+            }
+          if (depth == 0)
+            _literal_extractor_add_char(&extractor, *p);
+          break;
+        case '+':
+        case '.':
+        case '^':
+        case '$':
+          _literal_extractor_end_run(&extractor);
+          break;
+        default:
+          if (depth == 0)
+            _literal_extractor_add_char(&extractor, *p);
+          break;
+        }
+      p++;
+    }
+  return _literal_extractor_finish(&extractor);
+}
+
 static void
 log_matcher_pcre_re_free(LogMatcher *s)
 {
@@ -646,6 +954,7 @@ log_matcher_pcre_re_new(const LogMatcherOptions *options)
   self->super.compile = log_matcher_pcre_re_compile;
   self->super.match = log_matcher_pcre_re_match;
   self->super.replace = log_matcher_pcre_re_replace;
+  self->super.get_required_literal = log_matcher_pcre_re_get_required_literal;
   self->super.free_fn = log_matcher_pcre_re_free;
 
   return &self->super;
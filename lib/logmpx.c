@@ -76,6 +76,7 @@ log_multiplexer_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_op
   if (self->next_hops->len > 1)
     {
       log_msg_write_protect(msg);
+      log_msg_enable_result_cache(msg);
     }
   for (fallback = 0; (fallback == 0) || (fallback == 1 && self->fallback_exists && !delivered); fallback++)
     {
@@ -0,0 +1,367 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg-slab.h"
+#include "tls-support.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+#include "apphook.h"
+
+#include <sys/mman.h>
+
+/*
+ * Slab allocator for LogMessage instances
+ *
+ * A LogMessage is allocated in one block along with its queue nodes and
+ * its initial NVTable, the size of which depends on the length of the
+ * incoming message.  These sizes are rounded up to a small number of size
+ * classes and freed blocks are kept for reuse instead of being returned to
+ * the general purpose allocator.
+ *
+ *   - each thread keeps a cache of free blocks for every size class, which
+ *     serves allocations and frees without any locking
+ *
+ *   - messages are usually allocated by the source and freed by the
+ *     destination thread, so free blocks pile up in consumer threads. These
+ *     are moved to a global depot in batches, where producer threads
+ *     pick them up when their own cache runs empty.  This is the only
+ *     point where threads synchronize.
+ *
+ *   - new blocks are carved out from large arenas mapped directly from the
+ *     kernel, these can be backed by huge pages (--msg-huge-pages) to
+ *     reduce TLB pressure.
+ *
+ * Memory that was once used by messages is kept for later messages and
+ * is not returned to the system, its amount is published as the
+ * msg_slab_reserved_bytes counter.
+ */
+
+#define LOG_MSG_SLAB_ARENA_SIZE (2 * 1024 * 1024)
+/* number of blocks moved between a thread cache and the depot at once */
+#define LOG_MSG_SLAB_BATCH_SIZE 32
+#define LOG_MSG_SLAB_THREAD_CACHE_MAX (2 * LOG_MSG_SLAB_BATCH_SIZE)
+
+static const gsize slab_class_sizes[] =
+{
+  [LOG_MSG_SLAB_NONE] = 0,
+  512, 768, 1024, 1280, 1536, 2048, 2560, 3072, 4096, 5120, 6144, 8192, 10240, 12288, 16384
+};
+
+#define LOG_MSG_SLAB_CLASSES G_N_ELEMENTS(slab_class_sizes)
+
+/* the header of a free block */
+typedef struct _SlabBlock SlabBlock;
+struct _SlabBlock
+{
+  SlabBlock *next;
+
+  /* only used in the first block of a batch stored in the depot */
+  SlabBlock *next_batch;
+  gint batch_len;
+};
+
+typedef struct _SlabThreadCache
+{
+  SlabBlock *blocks;
+  gint len;
+} SlabThreadCache;
+
+TLS_BLOCK_START
+{
+  SlabThreadCache slab_thread_caches[LOG_MSG_SLAB_CLASSES];
+}
+TLS_BLOCK_END;
+
+#define slab_thread_caches __tls_deref(slab_thread_caches)
+
+static struct
+{
+  GStaticMutex lock;
+  SlabBlock *batches[LOG_MSG_SLAB_CLASSES];
+  gchar *arena_pos;
+  gchar *arena_end;
+  gsize reserved_bytes;
+  gsize depot_bytes;
+} slab_depot = { .lock = G_STATIC_MUTEX_INIT };
+
+static gboolean slab_huge_pages;
+static StatsCounterItem *count_slab_reserved_bytes;
+static StatsCounterItem *count_slab_depot_bytes;
+
+static inline guint8
+_find_class(gsize size)
+{
+  for (guint8 slab_class = LOG_MSG_SLAB_NONE + 1; slab_class < LOG_MSG_SLAB_CLASSES; slab_class++)
+    {
+      if (size <= slab_class_sizes[slab_class])
+        return slab_class;
+    }
+  return LOG_MSG_SLAB_NONE;
+}
+
+/* must be called with slab_depot.lock held */
+static void
+_update_stats(void)
+{
+  stats_counter_set(count_slab_reserved_bytes, slab_depot.reserved_bytes);
+  stats_counter_set(count_slab_depot_bytes, slab_depot.depot_bytes);
+}
+
+static gchar *
+_map_arena(void)
+{
+  gsize len = LOG_MSG_SLAB_ARENA_SIZE;
+
+  /* map twice the size, so that the arena can be aligned to the huge page size */
+  if (slab_huge_pages)
+    len *= 2;
+
+  gchar *area = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (area == MAP_FAILED)
+    return NULL;
+
+  if (slab_huge_pages)
+    {
+      guintptr mask = LOG_MSG_SLAB_ARENA_SIZE - 1;
+      gchar *aligned = (gchar *) (((guintptr) area + mask) & ~mask);
+      gsize head = aligned - area;
+
+      if (head > 0)
+        munmap(area, head);
+      munmap(aligned + LOG_MSG_SLAB_ARENA_SIZE, len - head - LOG_MSG_SLAB_ARENA_SIZE);
+      area = aligned;
+#ifdef MADV_HUGEPAGE
+      madvise(area, LOG_MSG_SLAB_ARENA_SIZE, MADV_HUGEPAGE);
+#endif
+    }
+  return area;
+}
+
+/* must be called with slab_depot.lock held */
+static SlabBlock *
+_carve_batch(guint8 slab_class, gint *batch_len)
+{
+  gsize size = slab_class_sizes[slab_class];
+  SlabBlock *blocks = NULL;
+  gint len;
+
+  for (len = 0; len < LOG_MSG_SLAB_BATCH_SIZE; len++)
+    {
+      if ((gsize) (slab_depot.arena_end - slab_depot.arena_pos) < size)
+        {
+          /* the rest of the current arena is wasted, at most the size of the largest class */
+          gchar *arena = _map_arena();
+
+          if (!arena)
+            break;
+          slab_depot.arena_pos = arena;
+          slab_depot.arena_end = arena + LOG_MSG_SLAB_ARENA_SIZE;
+          slab_depot.reserved_bytes += LOG_MSG_SLAB_ARENA_SIZE;
+        }
+
+      SlabBlock *block = (SlabBlock *) slab_depot.arena_pos;
+      slab_depot.arena_pos += size;
+      block->next = blocks;
+      blocks = block;
+    }
+  *batch_len = len;
+  return blocks;
+}
+
+static void
+_refill_thread_cache(SlabThreadCache *cache, guint8 slab_class)
+{
+  SlabBlock *batch;
+  gint batch_len;
+
+  g_static_mutex_lock(&slab_depot.lock);
+  batch = slab_depot.batches[slab_class];
+  if (batch)
+    {
+      slab_depot.batches[slab_class] = batch->next_batch;
+      batch_len = batch->batch_len;
+      slab_depot.depot_bytes -= batch_len * slab_class_sizes[slab_class];
+    }
+  else
+    {
+      batch = _carve_batch(slab_class, &batch_len);
+    }
+  _update_stats();
+  g_static_mutex_unlock(&slab_depot.lock);
+
+  cache->blocks = batch;
+  cache->len = batch_len;
+}
+
+static void
+_push_batch_to_depot(SlabBlock *batch, gint batch_len, guint8 slab_class)
+{
+  batch->batch_len = batch_len;
+
+  g_static_mutex_lock(&slab_depot.lock);
+  batch->next_batch = slab_depot.batches[slab_class];
+  slab_depot.batches[slab_class] = batch;
+  slab_depot.depot_bytes += batch_len * slab_class_sizes[slab_class];
+  _update_stats();
+  g_static_mutex_unlock(&slab_depot.lock);
+}
+
+static void
+_flush_thread_cache_batch(SlabThreadCache *cache, guint8 slab_class)
+{
+  SlabBlock *batch = cache->blocks;
+  SlabBlock *last = batch;
+
+  for (gint i = 1; i < LOG_MSG_SLAB_BATCH_SIZE; i++)
+    last = last->next;
+
+  cache->blocks = last->next;
+  cache->len -= LOG_MSG_SLAB_BATCH_SIZE;
+  last->next = NULL;
+  _push_batch_to_depot(batch, LOG_MSG_SLAB_BATCH_SIZE, slab_class);
+}
+
+static inline SlabBlock *
+_alloc_block(guint8 slab_class)
+{
+  SlabThreadCache *cache = &slab_thread_caches[slab_class];
+
+  if (G_UNLIKELY(!cache->blocks))
+    {
+      _refill_thread_cache(cache, slab_class);
+      if (!cache->blocks)
+        return NULL;
+    }
+
+  SlabBlock *block = cache->blocks;
+  cache->blocks = block->next;
+  cache->len--;
+  return block;
+}
+
+gpointer
+log_msg_slab_alloc(gsize size, guint8 *slab_class)
+{
+  guint8 c = _find_class(size);
+  SlabBlock *block;
+
+  if (c != LOG_MSG_SLAB_NONE && (block = _alloc_block(c)))
+    {
+      *slab_class = c;
+      return block;
+    }
+
+  *slab_class = LOG_MSG_SLAB_NONE;
+  return g_malloc(size);
+}
+
+void
+log_msg_slab_free(gpointer block, guint8 slab_class)
+{
+  if (slab_class == LOG_MSG_SLAB_NONE)
+    {
+      g_free(block);
+      return;
+    }
+
+  SlabThreadCache *cache = &slab_thread_caches[slab_class];
+  SlabBlock *b = (SlabBlock *) block;
+
+  b->next = cache->blocks;
+  cache->blocks = b;
+  cache->len++;
+  if (G_UNLIKELY(cache->len > LOG_MSG_SLAB_THREAD_CACHE_MAX))
+    _flush_thread_cache_batch(cache, slab_class);
+}
+
+gsize
+log_msg_slab_get_reserved_bytes(void)
+{
+  gsize reserved_bytes;
+
+  g_static_mutex_lock(&slab_depot.lock);
+  reserved_bytes = slab_depot.reserved_bytes;
+  g_static_mutex_unlock(&slab_depot.lock);
+  return reserved_bytes;
+}
+
+static GOptionEntry log_msg_slab_options[] =
+{
+  { "msg-huge-pages",      0,         0, G_OPTION_ARG_NONE, &slab_huge_pages, "Back the memory of messages with huge pages", NULL },
+  { NULL },
+};
+
+void
+log_msg_slab_add_options(GOptionContext *ctx)
+{
+  g_option_context_add_main_entries(ctx, log_msg_slab_options, NULL);
+}
+
+/* hands over the free blocks of the current thread, called when the thread exits */
+void
+log_msg_slab_thread_deinit(void)
+{
+  for (guint8 slab_class = LOG_MSG_SLAB_NONE + 1; slab_class < LOG_MSG_SLAB_CLASSES; slab_class++)
+    {
+      SlabThreadCache *cache = &slab_thread_caches[slab_class];
+
+      if (cache->blocks)
+        _push_batch_to_depot(cache->blocks, cache->len, slab_class);
+      cache->blocks = NULL;
+      cache->len = 0;
+    }
+}
+
+static void
+log_msg_slab_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "msg_slab_reserved_bytes", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_reserved_bytes);
+
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "msg_slab_depot_bytes", NULL);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_depot_bytes);
+  stats_unlock();
+
+  g_static_mutex_lock(&slab_depot.lock);
+  _update_stats();
+  g_static_mutex_unlock(&slab_depot.lock);
+}
+
+void
+log_msg_slab_global_init(void)
+{
+  register_application_hook(AH_RUNNING, (ApplicationHookFunc) log_msg_slab_register_stats, NULL);
+}
+
+/* NOTE: the arenas are not unmapped, as messages may outlive the
+ * application (e.g. in unit tests) */
+void
+log_msg_slab_global_deinit(void)
+{
+  log_msg_slab_thread_deinit();
+  count_slab_reserved_bytes = NULL;
+  count_slab_depot_bytes = NULL;
+}
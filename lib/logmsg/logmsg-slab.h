@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_SLAB_H_INCLUDED
+#define LOGMSG_SLAB_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* size class of allocations that are served by g_malloc() */
+#define LOG_MSG_SLAB_NONE 0
+
+gpointer log_msg_slab_alloc(gsize size, guint8 *slab_class);
+void log_msg_slab_free(gpointer block, guint8 slab_class);
+
+gsize log_msg_slab_get_reserved_bytes(void);
+void log_msg_slab_add_options(GOptionContext *ctx);
+
+void log_msg_slab_thread_deinit(void);
+void log_msg_slab_global_init(void);
+void log_msg_slab_global_deinit(void);
+
+#endif
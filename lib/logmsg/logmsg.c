@@ -23,6 +23,7 @@
  */
 
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
 #include "str-utils.h"
 #include "str-repr/encode.h"
 #include "messages.h"
@@ -238,9 +239,103 @@ log_msg_make_writable(LogMessage **pself, const LogPathOptions *path_options)
       log_msg_unref(*pself);
       *pself = new;
     }
+  else
+    {
+      /* the message is about to be changed in place */
+      log_msg_clear_cached_results(*pself);
+    }
   return *pself;
 }
 
+/*
+ * Cache of formatted results (e.g.  expanded templates).  When a message
+ * is delivered to multiple destinations, they often format it the same
+ * way, the cache makes it possible to do that only once.
+ *
+ * Destinations may run in different threads, so entries are immutable
+ * once added and they are pushed to the list atomically.  The list is
+ * dropped as soon as the message is changed, which happens in a single
+ * thread, as modification requires the message to be writable.
+ */
+#define LOGMSG_MAX_CACHED_RESULTS 8
+
+struct _LogMessageCachedResult
+{
+  LogMessageCachedResult *next;
+  gsize key_len;
+  gsize result_len;
+  /* key followed by the result */
+  gchar data[];
+};
+
+/* called when a message is about to be delivered to multiple destinations */
+void
+log_msg_enable_result_cache(LogMessage *self)
+{
+  self->cache_results = TRUE;
+}
+
+const gchar *
+log_msg_lookup_cached_result(LogMessage *self, gconstpointer key, gsize key_len, gsize *result_len)
+{
+  LogMessageCachedResult *entry;
+
+  for (entry = g_atomic_pointer_get(&self->cached_results); entry; entry = entry->next)
+    {
+      if (entry->key_len == key_len && memcmp(entry->data, key, key_len) == 0)
+        {
+          *result_len = entry->result_len;
+          return entry->data + key_len;
+        }
+    }
+  return NULL;
+}
+
+void
+log_msg_store_cached_result(LogMessage *self, gconstpointer key, gsize key_len, const gchar *result, gsize result_len)
+{
+  LogMessageCachedResult *entry, *head;
+  gint count = 0;
+
+  for (entry = g_atomic_pointer_get(&self->cached_results); entry; entry = entry->next)
+    {
+      if (++count >= LOGMSG_MAX_CACHED_RESULTS)
+        return;
+    }
+
+  entry = g_malloc(sizeof(LogMessageCachedResult) + key_len + result_len);
+  entry->key_len = key_len;
+  entry->result_len = result_len;
+  memcpy(entry->data, key, key_len);
+  memcpy(entry->data + key_len, result, result_len);
+
+  /* two threads may add the same key at the same time, which is harmless */
+  do
+    {
+      head = g_atomic_pointer_get(&self->cached_results);
+      entry->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->cached_results, head, entry));
+}
+
+void
+log_msg_clear_cached_results(LogMessage *self)
+{
+  LogMessageCachedResult *entry = self->cached_results;
+
+  if (G_LIKELY(!entry))
+    return;
+
+  self->cached_results = NULL;
+  while (entry)
+    {
+      LogMessageCachedResult *next = entry->next;
+
+      g_free(entry);
+      entry = next;
+    }
+}
+
 
 static void
 log_msg_update_sdata_slow(LogMessage *self, NVHandle handle, const gchar *name, gssize name_len)
@@ -528,6 +623,7 @@ log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize
   if (handle == LM_V_NONE)
     return;
 
+  log_msg_clear_cached_results(self);
   name_len = 0;
   name = log_msg_get_value_name(handle, &name_len);
 
@@ -582,6 +678,7 @@ log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize
 void
 log_msg_unset_value(LogMessage *self, NVHandle handle)
 {
+  log_msg_clear_cached_results(self);
   while (!nv_table_unset_value(self->payload, handle))
     {
       /* error allocating string in payload, reallocate */
@@ -626,6 +723,7 @@ log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handl
 
   g_assert(handle >= LM_V_MAX);
 
+  log_msg_clear_cached_results(self);
   name_len = 0;
   name = log_msg_get_value_name(handle, &name_len);
 
@@ -786,6 +884,7 @@ log_msg_set_tag_by_id_onoff(LogMessage *self, LogTagId id, gboolean on)
   gboolean inline_tags;
 
   g_assert(!log_msg_is_write_protected(self));
+  log_msg_clear_cached_results(self);
   if (!log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->num_tags)
     {
       self->tags = g_memdup(self->tags, sizeof(self->tags[0]) * self->num_tags);
@@ -1131,6 +1230,7 @@ log_msg_init(LogMessage *self, GSockAddr *saddr)
 void
 log_msg_clear(LogMessage *self)
 {
+  log_msg_clear_cached_results(self);
   if(log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     nv_table_unref(self->payload);
   self->payload = nv_table_new(LM_V_MAX, 16, 256);
@@ -1182,9 +1282,11 @@ log_msg_alloc(gsize payload_size)
       payload_ofs = alloc_size;
       alloc_size += payload_space;
     }
-  msg = g_malloc(alloc_size);
+  guint8 slab_class;
+  msg = log_msg_slab_alloc(alloc_size, &slab_class);
 
   memset(msg, 0, sizeof(LogMessage));
+  msg->slab_class = slab_class;
 
   if (payload_size)
     msg->payload = nv_table_init_borrowed(((gchar *) msg) + payload_ofs, payload_space, LM_V_MAX);
@@ -1238,12 +1340,14 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
 {
   LogMessage *self = log_msg_alloc(0);
   gsize allocated_bytes = self->allocated_bytes;
+  guint8 slab_class = self->slab_class;
 
   stats_counter_inc(count_msg_clones);
   log_msg_write_protect(msg);
 
   memcpy(self, msg, sizeof(*msg));
   msg->allocated_bytes = allocated_bytes;
+  self->slab_class = slab_class;
 
   msg_trace("Message was cloned",
             evt_tag_printf("original_msg", "%p", msg),
@@ -1258,6 +1362,8 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
                                                 0) + LOGMSG_REFCACHE_ABORT_TO_VALUE(0);
   self->cur_node = 0;
   self->protect_cnt = 0;
+  self->cache_results = FALSE;
+  self->cached_results = NULL;
 
   log_msg_add_ack(self, path_options);
   if (!path_options->ack_needed)
@@ -1397,9 +1503,10 @@ log_msg_free(LogMessage *self)
   if (self->original)
     log_msg_unref(self->original);
 
+  log_msg_clear_cached_results(self);
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
-  g_free(self);
+  log_msg_slab_free(self, self->slab_class);
 }
 
 /**
@@ -1849,6 +1956,7 @@ void
 log_msg_global_init(void)
 {
   log_msg_registry_init();
+  log_msg_slab_global_init();
 
   /* NOTE: we always initialize counters as they are on stats-level(0),
    * however we need to defer that as the stats subsystem may not be
@@ -1866,6 +1974,7 @@ log_msg_get_handle_name(NVHandle handle, gssize *length)
 void
 log_msg_global_deinit(void)
 {
+  log_msg_slab_global_deinit();
   log_msg_registry_deinit();
 }
 
@@ -149,6 +149,8 @@ typedef struct _LogMessageQueueNode
 } LogMessageQueueNode;
 
 
+typedef struct _LogMessageCachedResult LogMessageCachedResult;
+
 /* NOTE: the members are ordered according to the presumed use frequency.
  * The structure itself is 2 cachelines, the border is right after the "msg"
  * member */
@@ -204,6 +206,13 @@ struct _LogMessage
   guint8 num_nodes;
   guint8 cur_node;
   guint8 protect_cnt;
+  guint8 cache_results:1;
+  /* size class of the allocation, see logmsg-slab.h */
+  guint8 slab_class;
+
+  /* formatted results shared between the destinations of the message, see
+   * log_msg_lookup_cached_result() */
+  LogMessageCachedResult *cached_results;
 
   guint64 rcptid;
 
@@ -229,6 +238,18 @@ log_msg_is_write_protected(const LogMessage *self)
   return self->protect_cnt > 0;
 }
 
+void log_msg_enable_result_cache(LogMessage *self);
+const gchar *log_msg_lookup_cached_result(LogMessage *self, gconstpointer key, gsize key_len, gsize *result_len);
+void log_msg_store_cached_result(LogMessage *self, gconstpointer key, gsize key_len,
+                                 const gchar *result, gsize result_len);
+void log_msg_clear_cached_results(LogMessage *self);
+
+static inline gboolean
+log_msg_is_result_cache_enabled(const LogMessage *self)
+{
+  return self->cache_results;
+}
+
 LogMessage *log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options);
 LogMessage *log_msg_make_writable(LogMessage **pmsg, const LogPathOptions *path_options);
 
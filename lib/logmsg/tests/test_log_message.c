@@ -538,3 +538,45 @@ Test(log_message, when_get_indirect_value_with_null_value_len_abort_instead_of_s
 
   log_message_test_params_free(params);
 }
+
+Test(log_message, test_cached_results_are_dropped_when_the_message_changes)
+{
+  LogMessage *msg = _construct_log_message();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gsize result_len;
+
+  log_msg_enable_result_cache(msg);
+  cr_assert_null(log_msg_lookup_cached_result(msg, "key", 3, &result_len));
+
+  log_msg_store_cached_result(msg, "key", 3, "result", 6);
+  log_msg_store_cached_result(msg, "other-key", 9, "other", 5);
+
+  const gchar *result = log_msg_lookup_cached_result(msg, "key", 3, &result_len);
+  cr_assert_eq(result_len, 6);
+  cr_assert_arr_eq(result, "result", 6);
+  cr_assert_null(log_msg_lookup_cached_result(msg, "ke", 2, &result_len));
+
+  log_msg_set_value_by_name(msg, "foo", "bar", -1);
+  cr_assert_null(log_msg_lookup_cached_result(msg, "key", 3, &result_len));
+
+  log_msg_store_cached_result(msg, "key", 3, "result", 6);
+  log_msg_set_tag_by_name(msg, "cached");
+  cr_assert_null(log_msg_lookup_cached_result(msg, "key", 3, &result_len));
+
+  /* the clone starts without cached results, the original keeps them */
+  log_msg_store_cached_result(msg, "key", 3, "result", 6);
+  log_msg_write_protect(msg);
+  LogMessage *clone = log_msg_ref(msg);
+  log_msg_make_writable(&clone, &path_options);
+  cr_assert_neq(clone, msg);
+  cr_assert_not(log_msg_is_result_cache_enabled(clone));
+  cr_assert_null(log_msg_lookup_cached_result(clone, "key", 3, &result_len));
+  cr_assert_not_null(log_msg_lookup_cached_result(msg, "key", 3, &result_len));
+  log_msg_write_unprotect(msg);
+
+  log_msg_make_writable(&msg, &path_options);
+  cr_assert_null(log_msg_lookup_cached_result(msg, "key", 3, &result_len));
+
+  log_msg_unref(clone);
+  log_msg_unref(msg);
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
+#include "apphook.h"
+
+#include <criterion/criterion.h>
+#include <string.h>
+
+#define BLOCKS 1000
+
+static gpointer blocks[BLOCKS];
+
+static void
+_alloc_blocks(gsize size)
+{
+  for (gint i = 0; i < BLOCKS; i++)
+    {
+      guint8 slab_class;
+
+      blocks[i] = log_msg_slab_alloc(size, &slab_class);
+      cr_assert_neq(slab_class, LOG_MSG_SLAB_NONE);
+      memset(blocks[i], 'x', size);
+    }
+}
+
+static gpointer
+_free_blocks_in_thread(gpointer user_data)
+{
+  guint8 slab_class = GPOINTER_TO_UINT(user_data);
+
+  for (gint i = 0; i < BLOCKS; i++)
+    log_msg_slab_free(blocks[i], slab_class);
+  log_msg_slab_thread_deinit();
+  return NULL;
+}
+
+Test(logmsg_slab, freed_blocks_are_reused)
+{
+  guint8 slab_class, other_class;
+  gpointer block = log_msg_slab_alloc(600, &slab_class);
+
+  cr_assert_neq(slab_class, LOG_MSG_SLAB_NONE);
+  log_msg_slab_free(block, slab_class);
+
+  cr_assert_eq(log_msg_slab_alloc(700, &other_class), block);
+  cr_assert_eq(other_class, slab_class);
+  log_msg_slab_free(block, slab_class);
+}
+
+Test(logmsg_slab, large_allocations_use_the_heap)
+{
+  guint8 slab_class;
+  gpointer block = log_msg_slab_alloc(1024 * 1024, &slab_class);
+
+  cr_assert_eq(slab_class, LOG_MSG_SLAB_NONE);
+  log_msg_slab_free(block, slab_class);
+}
+
+Test(logmsg_slab, blocks_freed_by_another_thread_are_reused)
+{
+  guint8 slab_class;
+  gpointer block = log_msg_slab_alloc(3000, &slab_class);
+  log_msg_slab_free(block, slab_class);
+
+  _alloc_blocks(3000);
+  gsize reserved_bytes = log_msg_slab_get_reserved_bytes();
+
+  GThread *thread = g_thread_create(_free_blocks_in_thread, GUINT_TO_POINTER(slab_class), TRUE, NULL);
+  g_thread_join(thread);
+
+  _alloc_blocks(3000);
+  cr_assert_eq(log_msg_slab_get_reserved_bytes(), reserved_bytes, "blocks freed by the other thread were not reused");
+
+  for (gint i = 0; i < BLOCKS; i++)
+    log_msg_slab_free(blocks[i], slab_class);
+}
+
+Test(logmsg_slab, messages_are_allocated_from_the_slab)
+{
+  LogMessage *msg = log_msg_new_empty();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  cr_assert_neq(msg->slab_class, LOG_MSG_SLAB_NONE);
+  log_msg_set_value_by_name(msg, "foo", "bar", -1);
+
+  LogMessage *clone = log_msg_clone_cow(msg, &path_options);
+  cr_assert_neq(clone->slab_class, LOG_MSG_SLAB_NONE);
+
+  log_msg_unref(clone);
+  log_msg_unref(msg);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(logmsg_slab, .init = setup, .fini = teardown);
@@ -583,6 +583,10 @@ log_proto_buffered_server_prepare(LogProtoServer *s, GIOCondition *cond, gint *t
   if (*cond == 0)
     *cond = G_IO_IN;
 
+  /* data already received by the transport would not trigger the poll */
+  if (log_transport_has_buffered_input(self->super.transport))
+    return LPPA_FORCE_SCHEDULE_FETCH;
+
   return LPPA_POLL_IO;
 }
 
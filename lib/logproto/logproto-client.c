@@ -76,10 +76,17 @@ log_proto_client_options_get_timeout(LogProtoClientOptions *options)
   return options->timeout;
 }
 
+void
+log_proto_client_options_set_batch_size(LogProtoClientOptions *options, gint batch_size)
+{
+  options->batch_size = batch_size;
+}
+
 void
 log_proto_client_options_defaults(LogProtoClientOptions *options)
 {
   options->drop_input = FALSE;
+  options->batch_size = 0;
 }
 
 void
@@ -36,6 +36,8 @@ typedef struct _LogProtoClientOptions
 {
   gboolean drop_input;
   gint timeout;
+  /* maximum number of messages to be written by a single writev() call, 0 or 1 disables batching */
+  gint batch_size;
 } LogProtoClientOptions;
 
 typedef union _LogProtoClientOptionsStorage
@@ -57,6 +59,7 @@ typedef struct
 void log_proto_client_options_set_drop_input(LogProtoClientOptions *options, gboolean drop_input);
 void log_proto_client_options_set_timeout(LogProtoClientOptions *options, gint timeout);
 gint log_proto_client_options_get_timeout(LogProtoClientOptions *options);
+void log_proto_client_options_set_batch_size(LogProtoClientOptions *options, gint batch_size);
 
 void log_proto_client_options_defaults(LogProtoClientOptions *options);
 void log_proto_client_options_init(LogProtoClientOptions *options, GlobalConfig *cfg);
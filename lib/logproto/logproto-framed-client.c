@@ -28,12 +28,46 @@
 #define LPFCS_FRAME_SEND    0
 #define LPFCS_MESSAGE_SEND  1
 
+#define LPFC_FRAME_HDR_SIZE 9
+
 typedef struct _LogProtoFramedClient
 {
   LogProtoTextClient super;
-  guchar frame_hdr_buf[9];
+  guchar frame_hdr_buf[LPFC_FRAME_HDR_SIZE];
+  /* frame headers of the messages in the current batch, in batched mode */
+  guchar (*batch_frame_hdr_bufs)[LPFC_FRAME_HDR_SIZE];
 } LogProtoFramedClient;
 
+/* in batched mode, each message occupies two iovec entries: the frame header and the payload */
+static LogProtoStatus
+log_proto_framed_client_post_batched(LogProtoFramedClient *self, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoClient *s = &self->super.super;
+  gint frame_hdr_len;
+
+  *consumed = FALSE;
+  if (!log_proto_text_client_batch_has_room(&self->super, 2))
+    {
+      const LogProtoStatus status = log_proto_client_flush(s);
+      if (status != LPS_SUCCESS)
+        return status;
+
+      if (!log_proto_text_client_batch_has_room(&self->super, 2))
+        return LPS_PARTIAL;
+    }
+
+  guchar *frame_hdr_buf = self->batch_frame_hdr_bufs[self->super.batch.num_messages];
+  frame_hdr_len = g_snprintf((gchar *) frame_hdr_buf, LPFC_FRAME_HDR_SIZE, "%" G_GSIZE_FORMAT" ", msg_len);
+
+  *consumed = TRUE;
+  log_proto_text_client_batch_append(&self->super, frame_hdr_buf, frame_hdr_len, NULL, FALSE);
+  log_proto_text_client_batch_append(&self->super, msg, msg_len, (GDestroyNotify) g_free, TRUE);
+
+  if (!log_proto_text_client_batch_has_room(&self->super, 2))
+    return log_proto_client_flush(s);
+  return LPS_SUCCESS;
+}
+
 static LogProtoStatus
 log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, gsize msg_len, gboolean *consumed)
 {
@@ -54,6 +88,9 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
       msg_len = 9999999;
     }
 
+  if (log_proto_text_client_is_batched(&self->super))
+    return log_proto_framed_client_post_batched(self, msg, msg_len, consumed);
+
   status = LPS_SUCCESS;
   while (status == LPS_SUCCESS && !(*consumed) && self->super.partial == NULL)
     {
@@ -75,12 +112,25 @@ log_proto_framed_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg,
   return status;
 }
 
+static void
+log_proto_framed_client_free(LogProtoClient *s)
+{
+  LogProtoFramedClient *self = (LogProtoFramedClient *) s;
+
+  g_free(self->batch_frame_hdr_bufs);
+  log_proto_text_client_free_method(s);
+}
+
 LogProtoClient *
 log_proto_framed_client_new(LogTransport *transport, const LogProtoClientOptions *options)
 {
   LogProtoFramedClient *self = g_new0(LogProtoFramedClient, 1);
 
   log_proto_text_client_init(&self->super, transport, options);
+  log_proto_text_client_init_batch(&self->super, 2);
+  if (log_proto_text_client_is_batched(&self->super))
+    self->batch_frame_hdr_bufs = g_malloc0(self->super.batch.max_messages * LPFC_FRAME_HDR_SIZE);
+  self->super.super.free_fn = log_proto_framed_client_free;
   self->super.super.post = log_proto_framed_client_post;
   self->super.state = LPFCS_FRAME_SEND;
   return &self->super.super;
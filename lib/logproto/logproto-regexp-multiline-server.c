@@ -23,7 +23,7 @@
 
 #include "logproto-regexp-multiline-server.h"
 #include "messages.h"
-#include "compat/pcre.h"
+#include "pcre-exec.h"
 
 #include <string.h>
 
@@ -103,7 +103,7 @@ _find_regexp(MultiLineRegexp *re, const guchar *str, gsize len, gint *matches, g
   if (!re)
     return -1;
 
-  rc = pcre_exec(re->pattern, re->extra, (const gchar *) str, len, 0, 0, matches, matches_num * 3);
+  rc = log_pcre_exec(re->pattern, re->extra, (const gchar *) str, len, 0, 0, matches, matches_num * 3);
   return rc;
 }
 
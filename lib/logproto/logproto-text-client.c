@@ -25,6 +25,7 @@
 #include "messages.h"
 
 #include <errno.h>
+#include <limits.h>
 
 static gboolean
 log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, gint *timeout)
@@ -38,7 +39,7 @@ log_proto_text_client_prepare(LogProtoClient *s, gint *fd, GIOCondition *cond, g
   if (*cond == 0)
     *cond = G_IO_OUT;
 
-  const gboolean pending_write = self->partial != NULL;
+  const gboolean pending_write = self->partial != NULL || self->batch.iov_count > 0;
 
   if (!pending_write && s->options->timeout > 0)
     *timeout = s->options->timeout;
@@ -73,12 +74,103 @@ log_proto_text_client_drop_input(LogProtoClient *s)
   return LPS_SUCCESS;
 }
 
+static void
+_batch_release_chunk(LogProtoTextClientBatch *batch, gint index)
+{
+  LogProtoTextClientChunk *chunk = &batch->chunks[index];
+
+  if (chunk->data_free)
+    chunk->data_free(chunk->data);
+  chunk->data = NULL;
+  chunk->data_free = NULL;
+}
+
+static void
+_batch_release(LogProtoTextClientBatch *batch)
+{
+  for (gint i = batch->iov_pos; i < batch->iov_count; i++)
+    _batch_release_chunk(batch, i);
+  batch->iov_pos = batch->iov_count = batch->num_messages = 0;
+}
+
+void
+log_proto_text_client_batch_append(LogProtoTextClient *self, guchar *chunk, gsize chunk_len,
+                                   GDestroyNotify chunk_free, gboolean end_of_message)
+{
+  LogProtoTextClientBatch *batch = &self->batch;
+
+  g_assert(batch->iov_count < batch->max_iov);
+
+  batch->iov[batch->iov_count].iov_base = chunk;
+  batch->iov[batch->iov_count].iov_len = chunk_len;
+  batch->chunks[batch->iov_count].data = chunk;
+  batch->chunks[batch->iov_count].data_free = chunk_free;
+  batch->chunks[batch->iov_count].end_of_message = end_of_message;
+  batch->iov_count++;
+  if (end_of_message)
+    batch->num_messages++;
+}
+
+/*
+ * Writes the collected batch with a single writev() call. Messages are
+ * acked one by one as their last chunk gets written, the rest of a partially
+ * written batch is retried on the next flush.
+ */
+static LogProtoStatus
+log_proto_text_client_flush_batch(LogProtoTextClient *self)
+{
+  LogProtoTextClientBatch *batch = &self->batch;
+  gint acked = 0;
+  gssize rc;
+
+  if (batch->iov_pos == batch->iov_count)
+    return LPS_SUCCESS;
+
+  rc = log_transport_writev(self->super.transport, &batch->iov[batch->iov_pos], batch->iov_count - batch->iov_pos);
+  if (rc < 0)
+    {
+      if (errno != EAGAIN && errno != EINTR)
+        {
+          msg_error("I/O error occurred while writing",
+                    evt_tag_int("fd", self->super.transport->fd),
+                    evt_tag_error(EVT_TAG_OSERROR));
+          return LPS_ERROR;
+        }
+      return LPS_SUCCESS;
+    }
+
+  while (batch->iov_pos < batch->iov_count && (gsize) rc >= batch->iov[batch->iov_pos].iov_len)
+    {
+      rc -= batch->iov[batch->iov_pos].iov_len;
+      if (batch->chunks[batch->iov_pos].end_of_message)
+        acked++;
+      _batch_release_chunk(batch, batch->iov_pos);
+      batch->iov_pos++;
+    }
+
+  if (acked)
+    log_proto_client_msg_ack(&self->super, acked);
+
+  if (batch->iov_pos < batch->iov_count)
+    {
+      batch->iov[batch->iov_pos].iov_base = (guchar *) batch->iov[batch->iov_pos].iov_base + rc;
+      batch->iov[batch->iov_pos].iov_len -= rc;
+      return LPS_PARTIAL;
+    }
+
+  batch->iov_pos = batch->iov_count = batch->num_messages = 0;
+  return LPS_SUCCESS;
+}
+
 static LogProtoStatus
 log_proto_text_client_flush(LogProtoClient *s)
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
   gint rc;
 
+  if (log_proto_text_client_is_batched(self))
+    return log_proto_text_client_flush_batch(self);
+
   if (!self->partial)
     {
       return LPS_SUCCESS;
@@ -137,6 +229,32 @@ log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len
 }
 
 
+/* appends @msg to the write batch, flushing the batch when it is full */
+static LogProtoStatus
+log_proto_text_client_post_batched(LogProtoClient *s, guchar *msg, gsize msg_len, gboolean *consumed)
+{
+  LogProtoTextClient *self = (LogProtoTextClient *) s;
+
+  *consumed = FALSE;
+  if (!log_proto_text_client_batch_has_room(self, 1))
+    {
+      const LogProtoStatus status = log_proto_text_client_flush(s);
+      if (status != LPS_SUCCESS)
+        return status;
+
+      /* the batch could not be written out yet */
+      if (!log_proto_text_client_batch_has_room(self, 1))
+        return LPS_PARTIAL;
+    }
+
+  *consumed = TRUE;
+  log_proto_text_client_batch_append(self, msg, msg_len, (GDestroyNotify) g_free, TRUE);
+
+  if (!log_proto_text_client_batch_has_room(self, 1))
+    return log_proto_text_client_flush(s);
+  return LPS_SUCCESS;
+}
+
 /*
  * log_proto_text_client_post:
  * @msg: formatted log message to send (this might be consumed by this function)
@@ -153,6 +271,9 @@ log_proto_text_client_post(LogProtoClient *s, LogMessage *logmsg, guchar *msg, g
 {
   LogProtoTextClient *self = (LogProtoTextClient *) s;
 
+  if (log_proto_text_client_is_batched(self))
+    return log_proto_text_client_post_batched(s, msg, msg_len, consumed);
+
   /* try to flush already buffered data */
   *consumed = FALSE;
   const LogProtoStatus status = log_proto_text_client_flush(s);
@@ -189,9 +310,35 @@ log_proto_text_client_free(LogProtoClient *s)
   if (self->partial_free)
     self->partial_free(self->partial);
   self->partial = NULL;
+  _batch_release(&self->batch);
+  g_free(self->batch.iov);
+  g_free(self->batch.chunks);
   log_proto_client_free_method(s);
 };
 
+/*
+ * Enables batched mode if the user asked for it and the transport is able
+ * to write multiple buffers at once. @chunks_per_message is the number of
+ * iovec entries a single message occupies.
+ */
+void
+log_proto_text_client_init_batch(LogProtoTextClient *self, gint chunks_per_message)
+{
+  gint max_messages = self->super.options->batch_size;
+
+  if (max_messages <= 1 || !self->super.transport->writev)
+    return;
+
+#ifdef IOV_MAX
+  max_messages = MIN(max_messages, IOV_MAX / chunks_per_message);
+#endif
+
+  self->batch.max_messages = max_messages;
+  self->batch.max_iov = max_messages * chunks_per_message;
+  self->batch.iov = g_new0(struct iovec, self->batch.max_iov);
+  self->batch.chunks = g_new0(LogProtoTextClientChunk, self->batch.max_iov);
+}
+
 void
 log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport, const LogProtoClientOptions *options)
 {
@@ -212,5 +359,6 @@ log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *
   LogProtoTextClient *self = g_new0(LogProtoTextClient, 1);
 
   log_proto_text_client_init(self, transport, options);
+  log_proto_text_client_init_batch(self, 1);
   return &self->super;
 }
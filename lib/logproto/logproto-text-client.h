@@ -26,6 +26,30 @@
 
 #include "logproto-client.h"
 
+#include <sys/uio.h>
+
+typedef struct _LogProtoTextClientChunk
+{
+  gpointer data;
+  GDestroyNotify data_free;
+  /* this is the last chunk of a message, it is acked once written */
+  gboolean end_of_message;
+} LogProtoTextClientChunk;
+
+typedef struct _LogProtoTextClientBatch
+{
+  /* maximum number of messages and iovec entries in the batch */
+  gint max_messages;
+  gint max_iov;
+
+  gint num_messages;
+  gint iov_count;
+  /* index of the first iovec entry not yet written */
+  gint iov_pos;
+  struct iovec *iov;
+  LogProtoTextClientChunk *chunks;
+} LogProtoTextClientBatch;
+
 typedef struct _LogProtoTextClient
 {
   LogProtoClient super;
@@ -33,14 +57,35 @@ typedef struct _LogProtoTextClient
   guchar *partial;
   GDestroyNotify partial_free;
   gsize partial_len, partial_pos;
+  /* only used in batched mode, see log_proto_text_client_is_batched() */
+  LogProtoTextClientBatch batch;
 } LogProtoTextClient;
 
+static inline gboolean
+log_proto_text_client_is_batched(LogProtoTextClient *self)
+{
+  return self->batch.max_messages > 1;
+}
+
+static inline gboolean
+log_proto_text_client_batch_has_room(LogProtoTextClient *self, gint chunks)
+{
+  return self->batch.iov_pos == 0 &&
+         self->batch.num_messages < self->batch.max_messages &&
+         self->batch.iov_count + chunks <= self->batch.max_iov;
+}
+
+void log_proto_text_client_batch_append(LogProtoTextClient *self, guchar *chunk, gsize chunk_len,
+                                        GDestroyNotify chunk_free, gboolean end_of_message);
 LogProtoStatus log_proto_text_client_submit_write(LogProtoClient *s, guchar *msg, gsize msg_len,
                                                   GDestroyNotify msg_free, gint next_state);
 void log_proto_text_client_init(LogProtoTextClient *self, LogTransport *transport,
                                 const LogProtoClientOptions *options);
+void log_proto_text_client_init_batch(LogProtoTextClient *self, gint chunks_per_message);
 LogProtoClient *log_proto_text_client_new(LogTransport *transport, const LogProtoClientOptions *options);
 
-#define log_proto_text_client_free_method log_proto_client_free_method
+void log_proto_text_client_free(LogProtoClient *s);
+
+#define log_proto_text_client_free_method log_proto_text_client_free
 
 #endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "mock-transport.h"
+#include "proto_lib.h"
+#include "logproto/logproto-text-client.h"
+#include "logproto/logproto-framed-client.h"
+
+#include <criterion/criterion.h>
+
+static gint acked_messages;
+
+static void
+_count_acks(gint num_msg_acked, gpointer user_data)
+{
+  acked_messages += num_msg_acked;
+}
+
+static LogProtoClient *
+_construct_batched_client(LogProtoClient *(*construct)(LogTransport *, const LogProtoClientOptions *),
+                          LogTransport *transport, LogProtoClientOptions *options, gint batch_size)
+{
+  LogProtoClientFlowControlFuncs flow_control_funcs = { .ack_callback = _count_acks };
+
+  memset(options, 0, sizeof(*options));
+  log_proto_client_options_set_batch_size(options, batch_size);
+
+  LogProtoClient *proto = construct(transport, options);
+  log_proto_client_set_client_flow_control(proto, &flow_control_funcs);
+  acked_messages = 0;
+  return proto;
+}
+
+static void
+_post(LogProtoClient *proto, const gchar *msg, LogProtoStatus expected_status)
+{
+  gboolean consumed = FALSE;
+
+  cr_assert_eq(log_proto_client_post(proto, NULL, (guchar *) g_strdup(msg), strlen(msg), &consumed), expected_status);
+  cr_assert(consumed);
+}
+
+static void
+_assert_written(LogTransport *transport, const gchar *expected)
+{
+  gchar buf[1024];
+  gssize len = log_transport_mock_read_from_write_buffer((LogTransportMock *) transport, buf, sizeof(buf));
+
+  cr_assert_eq(len, strlen(expected), "written=%.*s, expected=%s", (gint) len, buf, expected);
+  cr_assert(memcmp(buf, expected, len) == 0, "written=%.*s, expected=%s", (gint) len, buf, expected);
+}
+
+Test(log_proto, test_text_client_batches_messages_until_flush)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(LTM_EOF);
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, transport, &options, 4);
+
+  _post(proto, "first\n", LPS_SUCCESS);
+  _post(proto, "second\n", LPS_SUCCESS);
+  _post(proto, "third\n", LPS_SUCCESS);
+  _assert_written(transport, "");
+  cr_assert_eq(acked_messages, 0);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "first\nsecond\nthird\n");
+  cr_assert_eq(acked_messages, 3);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_text_client_writes_full_batch_immediately)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(LTM_EOF);
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, transport, &options, 2);
+
+  _post(proto, "first\n", LPS_SUCCESS);
+  _post(proto, "second\n", LPS_SUCCESS);
+  _assert_written(transport, "first\nsecond\n");
+  cr_assert_eq(acked_messages, 2);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_text_client_acks_messages_one_by_one_on_partial_batch_write)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(LTM_EOF);
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, transport, &options, 4);
+
+  log_transport_mock_set_write_chunk_limit((LogTransportMock *) transport, 8);
+  _post(proto, "first\n", LPS_SUCCESS);
+  _post(proto, "second\n", LPS_SUCCESS);
+  _post(proto, "third\n", LPS_SUCCESS);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_PARTIAL);
+  _assert_written(transport, "first\nse");
+  cr_assert_eq(acked_messages, 1);
+
+  /* no new messages are accepted until the pending batch is written */
+  gboolean consumed = FALSE;
+  gchar *msg = g_strdup("fourth\n");
+  cr_assert_eq(log_proto_client_post(proto, NULL, (guchar *) msg, strlen(msg), &consumed), LPS_PARTIAL);
+  cr_assert_not(consumed);
+  g_free(msg);
+  _assert_written(transport, "cond\nthi");
+  cr_assert_eq(acked_messages, 2);
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "rd\n");
+  cr_assert_eq(acked_messages, 3);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_framed_client_batches_frame_headers_and_payloads)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(LTM_EOF);
+  LogProtoClient *proto = _construct_batched_client(log_proto_framed_client_new, transport, &options, 4);
+
+  _post(proto, "first", LPS_SUCCESS);
+  _post(proto, "second", LPS_SUCCESS);
+  _assert_written(transport, "");
+
+  cr_assert_eq(log_proto_client_flush(proto), LPS_SUCCESS);
+  _assert_written(transport, "5 first6 second");
+  cr_assert_eq(acked_messages, 2);
+
+  log_proto_client_free(proto);
+}
+
+Test(log_proto, test_text_client_without_batch_size_writes_messages_one_by_one)
+{
+  LogProtoClientOptions options;
+  LogTransport *transport = log_transport_mock_stream_new(LTM_EOF);
+  LogProtoClient *proto = _construct_batched_client(log_proto_text_client_new, transport, &options, 0);
+
+  _post(proto, "first\n", LPS_SUCCESS);
+  _assert_written(transport, "first\n");
+  cr_assert_eq(acked_messages, 1);
+
+  log_proto_client_free(proto);
+}
@@ -22,7 +22,7 @@
  *
  */
 
-#include "logqueue.h"
+#include "logqueue-fifo.h"
 #include "logpipe.h"
 #include "messages.h"
 #include "serialize.h"
@@ -69,6 +69,20 @@ QueueType log_queue_fifo_type = "FIFO";
  *   - the head of the queue is only manipulated from the output thread
  *   - the tail of the queue is only manipulated from the input threads
  *
+ * Lock-free variant (log-fifo-impl(lockfree)):
+ *   - the wait queue is replaced by an intrusive, singly linked LIFO,
+ *     chained through the list.next pointer of the queue nodes (newest
+ *     first).  Input threads put a whole input queue there with a single
+ *     compare-and-swap, without grabbing the lock.
+ *
+ *   - the output thread takes the complete LIFO with an atomic exchange
+ *     and reverses it to the end of the output queue, which restores the
+ *     original ordering.  As nodes are never removed one-by-one, the ABA
+ *     problem of classic lock-free stacks does not apply here.
+ *
+ *   - the lock is only taken by the input threads if the output thread is
+ *     waiting for new items (e.g. parallel_push_notify is registered).
+ *
  */
 
 typedef struct _InputQueue
@@ -101,6 +115,11 @@ typedef struct _LogQueueFifo
   /* legacy: flow-controlled messages are included in the log_fifo_size limit */
   gboolean use_legacy_fifo_size;
 
+  /* lock-free wait queue: wait_queue.items is unused, its lengths are
+   * updated atomically, the items are on lockfree_wait_stack */
+  gboolean use_lockfree_wait_queue;
+  struct iv_list_head *lockfree_wait_stack;
+
   InputQueue input_queues[0];
 } LogQueueFifo;
 
@@ -130,13 +149,106 @@ log_queue_fifo_get_length(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
 
-  return self->wait_queue.len + self->output_queue.len;
+  return g_atomic_int_get(&self->wait_queue.len) + self->output_queue.len;
 }
 
 static gint64
 log_queue_fifo_get_non_flow_controlled_length(LogQueueFifo *self)
 {
-  return self->wait_queue.non_flow_controlled_len + self->output_queue.non_flow_controlled_len;
+  return g_atomic_int_get(&self->wait_queue.non_flow_controlled_len) + self->output_queue.non_flow_controlled_len;
+}
+
+/* push a complete list of nodes to the lock-free wait queue, can be called
+ * from any thread without holding any locks */
+static void
+log_queue_fifo_lockfree_push_list(LogQueueFifo *self, struct iv_list_head *items)
+{
+  struct iv_list_head *oldest, *newest, *ilh, *next, *old_top;
+
+  if (iv_list_empty(items))
+    return;
+
+  /* relink the nodes newest first, the oldest item points to the old top */
+  oldest = items->next;
+  newest = NULL;
+  for (ilh = items->next; ilh != items; ilh = next)
+    {
+      next = ilh->next;
+      ilh->next = newest;
+      newest = ilh;
+    }
+  INIT_IV_LIST_HEAD(items);
+
+  do
+    {
+      old_top = g_atomic_pointer_get(&self->lockfree_wait_stack);
+      oldest->next = old_top;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->lockfree_wait_stack, old_top, newest));
+}
+
+/* take all items from the lock-free wait queue and append them to @target
+ * in their original order, returns the number of items moved. Can only be
+ * called from the output thread. */
+static gint
+log_queue_fifo_lockfree_take_all(LogQueueFifo *self, struct iv_list_head *target, gint *non_flow_controlled_len)
+{
+  struct iv_list_head *top, *next;
+  struct iv_list_head items;
+  gint len = 0;
+
+  *non_flow_controlled_len = 0;
+  do
+    {
+      top = g_atomic_pointer_get(&self->lockfree_wait_stack);
+      if (!top)
+        return 0;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->lockfree_wait_stack, top, NULL));
+
+  INIT_IV_LIST_HEAD(&items);
+  for (; top; top = next)
+    {
+      LogMessageQueueNode *node = iv_list_entry(top, LogMessageQueueNode, list);
+
+      next = top->next;
+      iv_list_add(top, &items);
+      len++;
+      if (!node->flow_control_requested)
+        (*non_flow_controlled_len)++;
+    }
+  iv_list_splice_tail(&items, target);
+  return len;
+}
+
+static void
+log_queue_fifo_lockfree_move_wait_to_output(LogQueueFifo *self)
+{
+  gint non_flow_controlled_len;
+  gint len = log_queue_fifo_lockfree_take_all(self, &self->output_queue.items, &non_flow_controlled_len);
+
+  if (len == 0)
+    return;
+
+  self->output_queue.len += len;
+  self->output_queue.non_flow_controlled_len += non_flow_controlled_len;
+  g_atomic_int_add(&self->wait_queue.len, -len);
+  g_atomic_int_add(&self->wait_queue.non_flow_controlled_len, -non_flow_controlled_len);
+}
+
+/* The output thread registers parallel_push_notify under the lock and
+ * checks the queue length once more afterwards (see
+ * log_queue_check_items()), so input threads only need the lock if a
+ * callback is registered after they published their items. */
+static void
+log_queue_fifo_lockfree_push_notify(LogQueueFifo *self)
+{
+  if (!g_atomic_pointer_get(&self->super.parallel_push_notify))
+    return;
+
+  g_static_mutex_lock(&self->super.lock);
+  log_queue_push_notify(&self->super);
+  g_static_mutex_unlock(&self->super.lock);
 }
 
 gboolean
@@ -252,7 +364,8 @@ log_queue_fifo_calculate_num_of_messages_to_drop(LogQueueFifo *self, InputQueue
   return TRUE;
 }
 
-/* move items from the per-thread input queue to the lock-protected "wait" queue */
+/* move items from the per-thread input queue to the lock-protected "wait"
+ * queue. The lock is not needed if the lock-free wait queue is used. */
 static void
 log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
 {
@@ -269,9 +382,20 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_id)
   log_queue_queued_messages_add(&self->super, self->input_queues[thread_id].len);
   iv_list_update_msg_size(self, &self->input_queues[thread_id].items);
 
-  iv_list_splice_tail_init(&self->input_queues[thread_id].items, &self->wait_queue.items);
-  self->wait_queue.len += self->input_queues[thread_id].len;
-  self->wait_queue.non_flow_controlled_len += self->input_queues[thread_id].non_flow_controlled_len;
+  if (self->use_lockfree_wait_queue)
+    {
+      /* counted before publishing, so that the output thread never
+       * subtracts items that are not yet accounted for */
+      g_atomic_int_add(&self->wait_queue.len, self->input_queues[thread_id].len);
+      g_atomic_int_add(&self->wait_queue.non_flow_controlled_len, self->input_queues[thread_id].non_flow_controlled_len);
+      log_queue_fifo_lockfree_push_list(self, &self->input_queues[thread_id].items);
+    }
+  else
+    {
+      iv_list_splice_tail_init(&self->input_queues[thread_id].items, &self->wait_queue.items);
+      self->wait_queue.len += self->input_queues[thread_id].len;
+      self->wait_queue.non_flow_controlled_len += self->input_queues[thread_id].non_flow_controlled_len;
+    }
   self->input_queues[thread_id].len = 0;
   self->input_queues[thread_id].non_flow_controlled_len = 0;
 }
@@ -291,16 +415,24 @@ log_queue_fifo_move_input(gpointer user_data)
 
   g_assert(thread_id >= 0);
 
-  g_static_mutex_lock(&self->super.lock);
-  log_queue_fifo_move_input_unlocked(self, thread_id);
-  log_queue_push_notify(&self->super);
-  g_static_mutex_unlock(&self->super.lock);
+  if (self->use_lockfree_wait_queue)
+    {
+      log_queue_fifo_move_input_unlocked(self, thread_id);
+      log_queue_fifo_lockfree_push_notify(self);
+    }
+  else
+    {
+      g_static_mutex_lock(&self->super.lock);
+      log_queue_fifo_move_input_unlocked(self, thread_id);
+      log_queue_push_notify(&self->super);
+      g_static_mutex_unlock(&self->super.lock);
+    }
   self->input_queues[thread_id].finish_cb_registered = FALSE;
   log_queue_unref(&self->super);
   return NULL;
 }
 
-/* lock must be held */
+/* lock must be held, unless the lock-free wait queue is used */
 static inline gboolean
 _message_has_to_be_dropped(LogQueueFifo *self, const LogPathOptions *path_options)
 {
@@ -323,6 +455,41 @@ _drop_message(LogMessage *msg, const LogPathOptions *path_options)
   log_msg_drop(msg, path_options, AT_PROCESSED);
 }
 
+static void
+log_queue_fifo_push_tail_lockfree(LogQueueFifo *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogMessageQueueNode *node;
+  struct iv_list_head items;
+
+  if (_message_has_to_be_dropped(self, path_options))
+    {
+      stats_counter_inc(self->super.dropped_messages);
+      _drop_message(msg, path_options);
+
+      msg_debug("Destination queue full, dropping message",
+                evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
+                evt_tag_int("log_fifo_size", self->log_fifo_size),
+                evt_tag_str("persist_name", self->super.persist_name));
+      return;
+    }
+
+  log_queue_queued_messages_inc(&self->super);
+  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+
+  /* counted before publishing, see log_queue_fifo_move_input_unlocked() */
+  g_atomic_int_inc(&self->wait_queue.len);
+  if (!path_options->flow_control_requested)
+    g_atomic_int_inc(&self->wait_queue.non_flow_controlled_len);
+
+  node = log_msg_alloc_queue_node(msg, path_options);
+  INIT_IV_LIST_HEAD(&items);
+  iv_list_add_tail(&node->list, &items);
+  log_queue_fifo_lockfree_push_list(self, &items);
+
+  log_msg_unref(msg);
+  log_queue_fifo_lockfree_push_notify(self);
+}
+
 /**
  * Assumed to be called from one of the input threads. If the thread_id
  * cannot be determined, the item is put directly in the wait queue.
@@ -386,6 +553,12 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
 
   /* slow path, put the pending item and the whole input queue to the wait_queue */
 
+  if (self->use_lockfree_wait_queue)
+    {
+      log_queue_fifo_push_tail_lockfree(self, msg, path_options);
+      return;
+    }
+
   g_static_mutex_lock(&self->super.lock);
 
   if (_message_has_to_be_dropped(self, path_options))
@@ -461,7 +634,11 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
   LogMessageQueueNode *node;
   LogMessage *msg = NULL;
 
-  if (self->output_queue.len == 0)
+  if (self->output_queue.len == 0 && self->use_lockfree_wait_queue)
+    {
+      log_queue_fifo_lockfree_move_wait_to_output(self);
+    }
+  else if (self->output_queue.len == 0)
     {
       /* slow path, output queue is empty, get some elements from the wait queue */
       g_static_mutex_lock(&self->super.lock);
@@ -644,6 +821,11 @@ log_queue_fifo_free(LogQueue *s)
       log_queue_fifo_free_queue(&self->input_queues[i].items);
     }
 
+  if (self->use_lockfree_wait_queue)
+    {
+      gint non_flow_controlled_len;
+      log_queue_fifo_lockfree_take_all(self, &self->wait_queue.items, &non_flow_controlled_len);
+    }
   log_queue_fifo_free_queue(&self->wait_queue.items);
   log_queue_fifo_free_queue(&self->output_queue.items);
   log_queue_fifo_free_queue(&self->backlog_queue.items);
@@ -695,3 +877,21 @@ log_queue_fifo_legacy_new(gint log_fifo_size, const gchar *persist_name)
   self->use_legacy_fifo_size = TRUE;
   return &self->super;
 }
+
+LogQueue *
+log_queue_fifo_lockfree_new(gint log_fifo_size, const gchar *persist_name)
+{
+  LogQueueFifo *self = (LogQueueFifo *) log_queue_fifo_new(log_fifo_size, persist_name);
+  self->use_lockfree_wait_queue = TRUE;
+  return &self->super;
+}
+
+gint
+log_queue_fifo_lookup_impl(const gchar *impl)
+{
+  if (strcmp(impl, "locked") == 0)
+    return LQF_IMPL_LOCKED;
+  else if (strcmp(impl, "lockfree") == 0 || strcmp(impl, "lock-free") == 0)
+    return LQF_IMPL_LOCKFREE;
+  return -1;
+}
@@ -27,7 +27,16 @@
 
 #include "logqueue.h"
 
+typedef enum
+{
+  LQF_IMPL_LOCKED,
+  LQF_IMPL_LOCKFREE,
+} LogQueueFifoImpl;
+
 LogQueue *log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name);
 LogQueue *log_queue_fifo_legacy_new(gint log_fifo_size, const gchar *persist_name);
+LogQueue *log_queue_fifo_lockfree_new(gint log_fifo_size, const gchar *persist_name);
+
+gint log_queue_fifo_lookup_impl(const gchar *impl);
 
 #endif
@@ -25,6 +25,8 @@
 #include "logsource.h"
 #include "messages.h"
 #include "host-resolve.h"
+#include "dns-resolver.h"
+#include "atomic.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "msg-stats.h"
@@ -32,7 +34,9 @@
 #include "ack-tracker/ack_tracker.h"
 #include "timeutils/misc.h"
 #include "scratch-buffers.h"
+#include "mainloop-io-worker.h"
 
+#include <iv_event.h>
 #include <string.h>
 
 gboolean accurate_nanosleep = FALSE;
@@ -446,6 +450,281 @@ _unregister_window_stats(LogSource *self)
   stats_unregister_dynamic_counter(self->stat_full_window_cluster, SC_TYPE_SINGLE_VALUE, &self->stat_full_window);
 }
 
+/*
+ * Asynchronous hostname resolution
+ *
+ * When the DNS resolver threads are running (dns-resolver-threads()), a
+ * message whose source address is not found in the DNS cache is not
+ * processed right away, as resolving the address would block the current
+ * thread.  Instead, the message is parked in the resolve queue of the
+ * source, and a resolver thread stores the answer in the DNS cache.
+ * Messages posted while the queue is not empty, or while parked messages
+ * are being processed, are parked too, so the order of the messages of the
+ * source is retained.
+ *
+ * Resolver threads never process messages themselves: once the message at
+ * the head of the queue is resolved, they signal the main thread, which
+ * submits an I/O worker job to process the resolved messages.  This way
+ * parked messages are only processed by worker jobs, which are stopped by
+ * main_loop_worker_sync_call() before a reload or shutdown.  Messages
+ * still parked when the source is deinitialized are dropped.
+ *
+ * Parked messages still hold their flow-control window, so the window of
+ * the source also limits the length of the queue.
+ */
+
+struct _LogSourceResolveQueue
+{
+  GAtomicCounter ref_cnt;
+  GMutex *lock;
+  GCond *drained_cond;
+  /* NULL once the source is deinitialized */
+  LogSource *source;
+  GQueue *msgs;
+  guint64 last_msg_id;
+  gboolean draining;
+  struct iv_event head_resolved;
+  MainLoopIOWorkerJob drain_job;
+};
+
+typedef struct _LogSourceParkedMsg
+{
+  guint64 id;
+  LogMessage *msg;
+  LogPathOptions path_options;
+  gboolean resolved;
+} LogSourceParkedMsg;
+
+typedef struct _LogSourceResolveRequest
+{
+  LogSourceResolveQueue *queue;
+  guint64 msg_id;
+} LogSourceResolveRequest;
+
+static void log_source_process_msg(LogSource *self, LogMessage *msg, const LogPathOptions *path_options);
+
+static LogSourceResolveQueue *
+log_source_resolve_queue_ref(LogSourceResolveQueue *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+static void
+log_source_resolve_queue_unref(LogSourceResolveQueue *self)
+{
+  if (!g_atomic_counter_dec_and_test(&self->ref_cnt))
+    return;
+
+  g_assert(g_queue_is_empty(self->msgs));
+  g_queue_free(self->msgs);
+  g_cond_free(self->drained_cond);
+  g_mutex_free(self->lock);
+  g_free(self);
+}
+
+/* must be called with the lock held */
+static gboolean
+_is_head_resolved(LogSourceResolveQueue *self)
+{
+  LogSourceParkedMsg *parked = g_queue_peek_head(self->msgs);
+
+  return self->source && parked && parked->resolved;
+}
+
+static void
+_process_parked_msg(LogSource *source, LogSourceParkedMsg *parked)
+{
+  ScratchBuffersMarker mark;
+
+  scratch_buffers_mark(&mark);
+  log_source_process_msg(source, parked->msg, &parked->path_options);
+  scratch_buffers_reclaim_marked(mark);
+  g_free(parked);
+}
+
+/* NOTE: runs in an I/O worker thread, processes the resolved messages from
+ * the head of the queue */
+static void
+_drain_resolved_msgs(gpointer s, GIOCondition cond)
+{
+  LogSourceResolveQueue *self = (LogSourceResolveQueue *) s;
+  LogSourceParkedMsg *parked;
+
+  g_mutex_lock(self->lock);
+  self->draining = TRUE;
+  while (_is_head_resolved(self))
+    {
+      parked = g_queue_pop_head(self->msgs);
+      g_mutex_unlock(self->lock);
+
+      _process_parked_msg(self->source, parked);
+
+      g_mutex_lock(self->lock);
+    }
+  self->draining = FALSE;
+  g_cond_broadcast(self->drained_cond);
+  g_mutex_unlock(self->lock);
+}
+
+/* NOTE: runs in the main thread */
+static void
+_schedule_drain(LogSourceResolveQueue *self)
+{
+  gboolean head_resolved;
+
+  if (self->drain_job.working)
+    return;
+
+  g_mutex_lock(self->lock);
+  head_resolved = _is_head_resolved(self);
+  g_mutex_unlock(self->lock);
+
+  if (head_resolved)
+    main_loop_io_worker_job_submit(&self->drain_job, G_IO_IN);
+}
+
+static void
+_head_resolved(gpointer s)
+{
+  _schedule_drain((LogSourceResolveQueue *) s);
+}
+
+/* the head may have been resolved while the job was running */
+static void
+_drain_finished(gpointer s)
+{
+  _schedule_drain((LogSourceResolveQueue *) s);
+}
+
+/* NOTE: runs in the main thread, from log_source_init() */
+static LogSourceResolveQueue *
+log_source_resolve_queue_new(LogSource *source)
+{
+  LogSourceResolveQueue *self = g_new0(LogSourceResolveQueue, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  self->lock = g_mutex_new();
+  self->drained_cond = g_cond_new();
+  self->source = source;
+  self->msgs = g_queue_new();
+
+  IV_EVENT_INIT(&self->head_resolved);
+  self->head_resolved.cookie = self;
+  self->head_resolved.handler = _head_resolved;
+  iv_event_register(&self->head_resolved);
+
+  main_loop_io_worker_job_init(&self->drain_job);
+  self->drain_job.user_data = self;
+  self->drain_job.work = _drain_resolved_msgs;
+  self->drain_job.completion = _drain_finished;
+  self->drain_job.engage = (void (*)(gpointer)) log_source_resolve_queue_ref;
+  self->drain_job.release = (void (*)(gpointer)) log_source_resolve_queue_unref;
+  return self;
+}
+
+/*
+ * NOTE: runs in the main thread, from log_source_deinit().  The queue is
+ * detached from its source, and the messages still parked are dropped
+ * instead of being sent to a pipeline that is being torn down.
+ */
+static void
+log_source_resolve_queue_detach(LogSourceResolveQueue *self)
+{
+  LogSourceParkedMsg *parked;
+  GQueue *parked_msgs;
+
+  g_mutex_lock(self->lock);
+  while (self->draining)
+    g_cond_wait(self->drained_cond, self->lock);
+
+  self->source = NULL;
+  iv_event_unregister(&self->head_resolved);
+  parked_msgs = self->msgs;
+  self->msgs = g_queue_new();
+  g_mutex_unlock(self->lock);
+
+  if (!g_queue_is_empty(parked_msgs))
+    msg_notice("Dropping messages waiting for hostname resolution as the source is being stopped",
+               evt_tag_int("count", g_queue_get_length(parked_msgs)));
+
+  while ((parked = g_queue_pop_head(parked_msgs)))
+    {
+      log_msg_drop(parked->msg, &parked->path_options, AT_ABORTED);
+      g_free(parked);
+    }
+  g_queue_free(parked_msgs);
+}
+
+/* NOTE: runs in a resolver thread, the answer is already in the DNS cache */
+static void
+_parked_msg_resolved(gpointer user_data)
+{
+  LogSourceResolveRequest *request = (LogSourceResolveRequest *) user_data;
+  LogSourceResolveQueue *self = request->queue;
+
+  g_mutex_lock(self->lock);
+  for (GList *l = self->msgs->head; l; l = l->next)
+    {
+      LogSourceParkedMsg *parked = (LogSourceParkedMsg *) l->data;
+
+      if (parked->id == request->msg_id)
+        {
+          parked->resolved = TRUE;
+          break;
+        }
+    }
+
+  /* the event is unregistered once the source is detached, under the lock */
+  if (_is_head_resolved(self))
+    iv_event_post(&self->head_resolved);
+  g_mutex_unlock(self->lock);
+
+  log_source_resolve_queue_unref(self);
+  g_free(request);
+}
+
+static gboolean
+log_source_park_until_resolved(LogSource *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogSourceResolveQueue *queue = self->resolve_queue;
+  LogSourceParkedMsg *parked;
+  gboolean needs_query;
+
+  if (!queue)
+    return FALSE;
+
+  needs_query = resolve_sockaddr_needs_dns_query(msg->saddr, &self->options->host_resolve_options);
+
+  g_mutex_lock(queue->lock);
+  /* a drain job may still be processing the last parked message */
+  if (g_queue_is_empty(queue->msgs) && !queue->draining && !needs_query)
+    {
+      g_mutex_unlock(queue->lock);
+      return FALSE;
+    }
+
+  parked = g_new0(LogSourceParkedMsg, 1);
+  parked->id = ++queue->last_msg_id;
+  parked->msg = msg;
+  parked->path_options = *path_options;
+  /* the caller's stack frame is gone by the time the message is processed */
+  parked->path_options.matched = NULL;
+  parked->resolved = !needs_query;
+  g_queue_push_tail(queue->msgs, parked);
+  g_mutex_unlock(queue->lock);
+
+  if (needs_query)
+    {
+      LogSourceResolveRequest *request = g_new0(LogSourceResolveRequest, 1);
+
+      request->queue = log_source_resolve_queue_ref(queue);
+      request->msg_id = parked->id;
+      dns_resolver_resolve_async(msg->saddr, _parked_msg_resolved, request);
+    }
+  return TRUE;
+}
+
 static inline void
 _create_ack_tracker_if_not_exists(LogSource *self)
 {
@@ -476,6 +755,9 @@ log_source_init(LogPipe *s)
 
   stats_unlock();
 
+  if (dns_resolver_is_running() && !self->resolve_queue)
+    self->resolve_queue = log_source_resolve_queue_new(self);
+
   return TRUE;
 }
 
@@ -484,6 +766,13 @@ log_source_deinit(LogPipe *s)
 {
   LogSource *self = (LogSource *) s;
 
+  if (self->resolve_queue)
+    {
+      log_source_resolve_queue_detach(self->resolve_queue);
+      log_source_resolve_queue_unref(self->resolve_queue);
+      self->resolve_queue = NULL;
+    }
+
   stats_lock();
   StatsClusterKey sc_key;
   stats_cluster_logpipe_key_set(&sc_key, self->options->stats_source | SCS_SOURCE, self->stats_id, self->stats_instance);
@@ -575,9 +864,9 @@ log_source_override_program(LogSource *self, LogMessage *msg)
 }
 
 static void
-log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+log_source_process_msg(LogSource *self, LogMessage *msg, const LogPathOptions *path_options)
 {
-  LogSource *self = (LogSource *) s;
+  LogPipe *s = &self->super;
   gint i;
 
   msg_set_context(msg);
@@ -636,6 +925,17 @@ log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options
   msg_set_context(NULL);
 }
 
+static void
+log_source_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogSource *self = (LogSource *) s;
+
+  if (log_source_park_until_resolved(self, msg, path_options))
+    return;
+
+  log_source_process_msg(self, msg, path_options);
+}
+
 static void
 _initialize_window(LogSource *self, gint init_window_size)
 {
@@ -51,6 +51,7 @@ typedef struct _LogSourceOptions
 } LogSourceOptions;
 
 typedef struct _LogSource LogSource;
+typedef struct _LogSourceResolveQueue LogSourceResolveQueue;
 
 /**
  * LogSource:
@@ -88,6 +89,8 @@ struct _LogSource
   glong window_full_sleep_nsec;
   struct timespec last_ack_rate_time;
   AckTracker *ack_tracker;
+  /* messages waiting for the asynchronous resolution of their address */
+  LogSourceResolveQueue *resolve_queue;
 
   void (*wakeup)(LogSource *s);
   void (*schedule_dynamic_window_realloc)(LogSource *s);
@@ -947,13 +947,38 @@ log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_retries
   self->retries_on_error_max = max_retries;
 }
 
+void
+log_threaded_dest_driver_set_worker_partition_key_ref(LogDriver *s, LogTemplate *key)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *)s;
+
+  log_template_unref(self->worker_partition_key);
+  self->worker_partition_key = key;
+}
+
+static gint
+_lookup_partitioned_worker_index(LogThreadedDestDriver *self, LogMessage *msg)
+{
+  ScratchBuffersMarker marker;
+  GString *key = scratch_buffers_alloc_and_mark(&marker);
+
+  log_template_format(self->worker_partition_key, msg, NULL, LTZ_SEND, 0, NULL, key);
+  gint worker_index = g_str_hash(key->str) % self->num_workers;
+
+  scratch_buffers_reclaim_marked(marker);
+  return worker_index;
+}
+
 LogThreadedDestWorker *
 _lookup_worker(LogThreadedDestDriver *self, LogMessage *msg)
 {
-  gint worker_index = self->last_worker % self->num_workers;
-  self->last_worker++;
+  gint worker_index;
+
+  if (self->num_workers > 1 && self->worker_partition_key)
+    return self->workers[_lookup_partitioned_worker_index(self, msg)];
 
-  /* here would come the lookup mechanism that maps msg -> worker that doesn't exist yet. */
+  worker_index = self->last_worker % self->num_workers;
+  self->last_worker++;
   return self->workers[worker_index];
 }
 
@@ -1111,6 +1136,7 @@ log_threaded_dest_driver_free(LogPipe *s)
   LogThreadedDestDriver *self = (LogThreadedDestDriver *)s;
 
   log_threaded_dest_worker_free_method(&self->worker.instance);
+  log_template_unref(self->worker_partition_key);
   g_mutex_free(self->lock);
   g_free(self->workers);
   log_dest_driver_free((LogPipe *)self);
@@ -31,6 +31,7 @@
 #include "logqueue.h"
 #include "mainloop-worker.h"
 #include "seqnum.h"
+#include "template/templates.h"
 
 #include <iv.h>
 #include <iv_event.h>
@@ -137,6 +138,10 @@ struct _LogThreadedDestDriver
   gint workers_started;
   guint last_worker;
 
+  /* if set, messages with the same key are always delivered by the same
+   * worker, otherwise workers are selected in a round-robin fashion */
+  LogTemplate *worker_partition_key;
+
   gint stats_source;
 
   /* this counter is not thread safe if there are multiple worker threads,
@@ -235,5 +240,6 @@ void log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_re
 void log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers);
 void log_threaded_dest_driver_set_batch_lines(LogDriver *s, gint batch_lines);
 void log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout);
+void log_threaded_dest_driver_set_worker_partition_key_ref(LogDriver *s, LogTemplate *key);
 
 #endif
@@ -769,6 +769,82 @@ Test(logthrdestdrv, test_explicit_ack_accept)
   cr_assert(dd->super.shared_seq_num == 11, "%d", dd->super.shared_seq_num);
 }
 
+#define PARTITIONED_WORKERS 4
+#define PARTITION_KEYS 10
+
+static GMutex *partitioned_lock;
+static GHashTable *worker_index_by_host;
+static gint partition_violations;
+
+static LogThreadedResult
+_insert_and_record_worker_of_host(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  const gchar *host = log_msg_get_value(msg, LM_V_HOST, NULL);
+  gpointer worker_index;
+
+  g_mutex_lock(partitioned_lock);
+  if (g_hash_table_lookup_extended(worker_index_by_host, host, NULL, &worker_index))
+    {
+      if (GPOINTER_TO_INT(worker_index) != s->worker_index)
+        partition_violations++;
+    }
+  else
+    {
+      g_hash_table_insert(worker_index_by_host, g_strdup(host), GINT_TO_POINTER(s->worker_index));
+    }
+  g_mutex_unlock(partitioned_lock);
+  return LTR_SUCCESS;
+}
+
+static LogThreadedDestWorker *
+_construct_partitioned_worker(LogThreadedDestDriver *o, gint worker_index)
+{
+  LogThreadedDestWorker *self = g_new0(LogThreadedDestWorker, 1);
+
+  log_threaded_dest_worker_init_instance(self, o, worker_index);
+  self->insert = _insert_and_record_worker_of_host;
+  return self;
+}
+
+Test(logthrdestdrv, messages_with_the_same_partition_key_are_delivered_by_the_same_worker)
+{
+  GlobalConfig *cfg = main_loop_get_current_config(main_loop);
+  TestThreadedDestDriver *pdd = test_threaded_dd_new(cfg);
+  LogTemplate *key = log_template_new(cfg, NULL);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+  gchar host[32];
+
+  partitioned_lock = g_mutex_new();
+  worker_index_by_host = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  partition_violations = 0;
+
+  cr_assert(log_template_compile(key, "${HOST}", NULL));
+  log_threaded_dest_driver_set_worker_partition_key_ref(&pdd->super.super.super, key);
+  log_threaded_dest_driver_set_num_workers(&pdd->super.super.super, PARTITIONED_WORKERS);
+  pdd->super.worker.construct = _construct_partitioned_worker;
+  cr_assert(log_pipe_init(&pdd->super.super.super.super));
+
+  for (gint i = 0; i < 100; i++)
+    {
+      LogMessage *msg = create_sample_message();
+
+      g_snprintf(host, sizeof(host), "host%d", i % PARTITION_KEYS);
+      log_msg_set_value(msg, LM_V_HOST, host, -1);
+      log_pipe_queue(&pdd->super.super.super.super, msg, &path_options);
+    }
+  _spin_for_counter_value(pdd->super.written_messages, 100);
+
+  cr_assert_eq(partition_violations, 0, "messages with the same key were delivered by different workers");
+  cr_assert_eq(g_hash_table_size(worker_index_by_host), PARTITION_KEYS);
+
+  main_loop_sync_worker_startup_and_teardown();
+  log_pipe_deinit(&pdd->super.super.super.super);
+  log_pipe_unref(&pdd->super.super.super.super);
+
+  g_hash_table_unref(worker_index_by_host);
+  g_mutex_free(partitioned_lock);
+}
+
 MainLoopOptions main_loop_options = {0};
 
 static void
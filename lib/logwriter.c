@@ -1676,6 +1676,7 @@ log_writer_options_defaults(LogWriterOptions *options)
 {
   options->template = NULL;
   options->flush_lines = -1;
+  options->write_batch_lines = 0;
   log_template_options_defaults(&options->template_options);
   options->time_reopen = -1;
   options->suppress = -1;
@@ -1741,6 +1742,8 @@ log_writer_options_init(LogWriterOptions *options, GlobalConfig *cfg, guint32 op
 
   if (options->flush_lines == -1)
     options->flush_lines = cfg->flush_lines;
+  /* protocols supporting it write write_batch_lines messages with a single writev() */
+  log_proto_client_options_set_batch_size(&options->proto_options.super, options->write_batch_lines);
   if (options->suppress == -1)
     options->suppress = cfg->suppress;
   if (options->time_reopen == -1)
@@ -55,6 +55,8 @@ typedef struct _LogWriterOptions
 
   /* minimum number of entries to trigger a flush */
   gint flush_lines;
+  /* maximum number of messages written by a single writev(), 0 disables batching */
+  gint write_batch_lines;
 
   LogTemplate *template;
   LogTemplate *file_template;
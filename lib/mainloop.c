@@ -37,10 +37,12 @@
 #include "persist-state.h"
 #include "run-id.h"
 #include "host-id.h"
+#include "dns-resolver.h"
 #include "debugger/debugger-main.h"
 #include "plugin.h"
 #include "resolved-configurable-paths.h"
 #include "scratch-buffers.h"
+#include "logmsg/logmsg-slab.h"
 #include "timeutils/misc.h"
 #include "stats/stats-control.h"
 
@@ -636,6 +638,7 @@ main_loop_deinit(MainLoop *self)
   main_loop_call_deinit();
   main_loop_io_worker_deinit();
   main_loop_worker_deinit();
+  dns_resolver_stop();
   block_till_workers_exit();
   scratch_buffers_automatic_gc_deinit();
   g_static_mutex_free(&workers_running_lock);
@@ -664,6 +667,7 @@ void
 main_loop_add_options(GOptionContext *ctx)
 {
   main_loop_io_worker_add_options(ctx);
+  log_msg_slab_add_options(ctx);
 }
 
 void
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "pcre-exec.h"
+#include "tls-support.h"
+
+/*
+ * Executing JIT compiled regular expressions
+ *
+ * pcre_exec() checks its arguments and looks up the JIT code at every
+ * invocation and the JIT code runs on a small stack (32k) allocated on
+ * the machine stack, on which complex patterns fail to match.
+ *
+ * Instead, when the pattern was JIT compiled successfully, we call the
+ * JIT code directly with pcre_jit_exec() (PCRE 8.32+) and let it run on a
+ * larger stack allocated once for each thread.
+ *
+ * This stays on the PCRE1 API, which every regexp user in the tree and
+ * the build (libpcre >= 6.1) depends on.  The ovector, the counterpart of
+ * PCRE2 match data, is allocated on the machine stack by the callers,
+ * which is already free of per-match heap allocations.
+ */
+
+#if defined(PCRE_CONFIG_JIT) && defined(PCRE_EXTRA_EXECUTABLE_JIT) && \
+  (PCRE_MAJOR > 8 || (PCRE_MAJOR == 8 && PCRE_MINOR >= 32))
+#define LOG_PCRE_JIT_EXEC 1
+#else
+#define LOG_PCRE_JIT_EXEC 0
+#endif
+
+#define LOG_PCRE_JIT_STACK_MIN (32 * 1024)
+#define LOG_PCRE_JIT_STACK_MAX (512 * 1024)
+
+/* options that the JIT code supports at match time, others need pcre_exec() */
+#define LOG_PCRE_JIT_OPTIONS (PCRE_NO_UTF8_CHECK | PCRE_NOTBOL | PCRE_NOTEOL | PCRE_NOTEMPTY | PCRE_NOTEMPTY_ATSTART)
+
+#if LOG_PCRE_JIT_EXEC
+
+TLS_BLOCK_START
+{
+  pcre_jit_stack *pcre_thread_jit_stack;
+}
+TLS_BLOCK_END;
+
+#define pcre_thread_jit_stack __tls_deref(pcre_thread_jit_stack)
+
+static inline pcre_jit_stack *
+_get_thread_jit_stack(void)
+{
+  if (G_UNLIKELY(!pcre_thread_jit_stack))
+    pcre_thread_jit_stack = pcre_jit_stack_alloc(LOG_PCRE_JIT_STACK_MIN, LOG_PCRE_JIT_STACK_MAX);
+  return pcre_thread_jit_stack;
+}
+
+gint
+log_pcre_exec(const pcre *pattern, const pcre_extra *extra, const gchar *subject, gint length,
+              gint start_offset, gint options, gint *ovector, gint ovecsize)
+{
+  if (extra && (extra->flags & PCRE_EXTRA_EXECUTABLE_JIT) && (options & ~LOG_PCRE_JIT_OPTIONS) == 0)
+    {
+      pcre_jit_stack *jit_stack = _get_thread_jit_stack();
+
+      if (jit_stack)
+        return pcre_jit_exec(pattern, extra, subject, length, start_offset, options, ovector, ovecsize, jit_stack);
+    }
+  return pcre_exec(pattern, extra, subject, length, start_offset, options, ovector, ovecsize);
+}
+
+void
+log_pcre_thread_deinit(void)
+{
+  if (pcre_thread_jit_stack)
+    {
+      pcre_jit_stack_free(pcre_thread_jit_stack);
+      pcre_thread_jit_stack = NULL;
+    }
+}
+
+#else
+
+gint
+log_pcre_exec(const pcre *pattern, const pcre_extra *extra, const gchar *subject, gint length,
+              gint start_offset, gint options, gint *ovector, gint ovecsize)
+{
+  return pcre_exec(pattern, extra, subject, length, start_offset, options, ovector, ovecsize);
+}
+
+void
+log_pcre_thread_deinit(void)
+{
+}
+
+#endif
@@ -51,11 +51,42 @@ csv_scanner_options_set_columns(CSVScannerOptions *options, GList *columns)
   options->columns = columns;
 }
 
+/*
+ * Collects every character that can start a delimiter, so that unquoted
+ * values can be skipped with a single strcspn() call.  An empty string
+ * delimiter matches anywhere, in which case we leave this unset and fall
+ * back to matching the delimiters character-by-character.
+ */
+static void
+_update_value_terminators(CSVScannerOptions *options)
+{
+  GString *terminators;
+  GList *l;
+
+  g_free(options->value_terminators);
+  options->value_terminators = NULL;
+
+  terminators = g_string_new(options->delimiters);
+  for (l = options->string_delimiters; l; l = l->next)
+    {
+      const gchar *string_delimiter = (const gchar *) l->data;
+
+      if (string_delimiter[0] == 0)
+        {
+          g_string_free(terminators, TRUE);
+          return;
+        }
+      g_string_append_c(terminators, string_delimiter[0]);
+    }
+  options->value_terminators = g_string_free(terminators, FALSE);
+}
+
 void
 csv_scanner_options_set_delimiters(CSVScannerOptions *options, const gchar *delimiters)
 {
   g_free(options->delimiters);
   options->delimiters = g_strdup(delimiters);
+  _update_value_terminators(options);
 }
 
 void
@@ -63,6 +94,7 @@ csv_scanner_options_set_string_delimiters(CSVScannerOptions *options, GList *str
 {
   string_list_free(options->string_delimiters);
   options->string_delimiters = string_delimiters;
+  _update_value_terminators(options);
 }
 
 void
@@ -128,6 +160,7 @@ csv_scanner_options_clean(CSVScannerOptions *options)
   g_free(options->quotes_end);
   g_free(options->null_value);
   g_free(options->delimiters);
+  g_free(options->value_terminators);
   string_list_free(options->string_delimiters);
   string_list_free(options->columns);
 }
@@ -269,9 +302,42 @@ _parse_unquoted_literal_character(CSVScanner *self)
   self->src++;
 }
 
+/*
+ * Unquoted values are not copied: we only look for the characters that
+ * may start a delimiter and record where the value is in the input.
+ */
+static gboolean
+_parse_unquoted_value_in_input(CSVScanner *self)
+{
+  const gchar *terminators = self->options->value_terminators;
+  const gchar *value_start = self->src;
+  const gchar *value_end = self->src;
+
+  if (self->current_quote || !terminators)
+    return FALSE;
+
+  while (TRUE)
+    {
+      value_end += strcspn(value_end, terminators);
+      self->src = value_end;
+      if (*value_end == 0 || _parse_delimiter(self))
+        break;
+
+      /* first character of a string delimiter without the rest */
+      value_end++;
+    }
+
+  self->current_value_start = value_start;
+  self->current_value_len = value_end - value_start;
+  return TRUE;
+}
+
 static void
 _parse_value_with_whitespace_and_delimiter(CSVScanner *self)
 {
+  if (_parse_unquoted_value_in_input(self))
+    return;
+
   while (*self->src)
     {
       if (self->current_quote)
@@ -303,16 +369,39 @@ _get_value_length_without_right_whitespace(CSVScanner *self)
 static void
 _translate_rstrip_whitespace(CSVScanner *self)
 {
-  if (self->options->flags & CSV_SCANNER_STRIP_WHITESPACE)
-    g_string_truncate(self->current_value, _get_value_length_without_right_whitespace(self));
+  if ((self->options->flags & CSV_SCANNER_STRIP_WHITESPACE) == 0)
+    return;
+
+  if (self->current_value_start)
+    {
+      while (self->current_value_len > 0 &&
+             _is_whitespace_char(self->current_value_start + self->current_value_len - 1))
+        self->current_value_len--;
+    }
+  else
+    {
+      g_string_truncate(self->current_value, _get_value_length_without_right_whitespace(self));
+    }
 }
 
 static void
 _translate_null_value(CSVScanner *self)
 {
-  if (self->options->null_value &&
-      strcmp(self->current_value->str, self->options->null_value) == 0)
-    g_string_truncate(self->current_value, 0);
+  const gchar *null_value = self->options->null_value;
+
+  if (!null_value)
+    return;
+
+  if (self->current_value_start)
+    {
+      if (strncmp(self->current_value_start, null_value, self->current_value_len) == 0 &&
+          null_value[self->current_value_len] == 0)
+        self->current_value_len = 0;
+    }
+  else if (strcmp(self->current_value->str, null_value) == 0)
+    {
+      g_string_truncate(self->current_value, 0);
+    }
 }
 
 static void
@@ -332,6 +421,8 @@ static gboolean
 _switch_to_next_column(CSVScanner *self)
 {
   g_string_truncate(self->current_value, 0);
+  self->current_value_start = NULL;
+  self->current_value_len = 0;
 
   switch (self->state)
     {
@@ -366,8 +457,9 @@ csv_scanner_scan_next(CSVScanner *self)
 
   if (_is_last_column(self) && (self->options->flags & CSV_SCANNER_GREEDY))
     {
-      g_string_assign(self->current_value, self->src);
-      self->src += self->current_value->len;
+      self->current_value_start = self->src;
+      self->current_value_len = strlen(self->src);
+      self->src += self->current_value_len;
       self->state = CSV_STATE_GREEDY_COLUMN;
       return TRUE;
     }
@@ -413,6 +505,7 @@ csv_scanner_init(CSVScanner *scanner, CSVScannerOptions *options, const gchar *i
 {
   memset(scanner, 0, sizeof(*scanner));
   scanner->state = CSV_STATE_INITIAL;
+  scanner->input = input;
   scanner->src = input;
   scanner->current_value = scratch_buffers_alloc();
   scanner->current_column = NULL;
@@ -424,18 +517,43 @@ csv_scanner_deinit(CSVScanner *self)
 {
 }
 
+/* NOTE: this copies values that are still in the input to current_value */
 const gchar *
 csv_scanner_get_current_value(CSVScanner *self)
 {
+  if (self->current_value_start)
+    {
+      g_string_truncate(self->current_value, 0);
+      g_string_append_len(self->current_value, self->current_value_start, self->current_value_len);
+      self->current_value_start = NULL;
+    }
   return self->current_value->str;
 }
 
 gint
 csv_scanner_get_current_value_len(CSVScanner *self)
 {
+  if (self->current_value_start)
+    return self->current_value_len;
   return self->current_value->len;
 }
 
+/*
+ * Returns TRUE if the current value is an unmodified part of the input,
+ * @ofs is set to its offset from the start of the input.  Call it before
+ * csv_scanner_get_current_value(), which copies the value out of the
+ * input.
+ */
+gboolean
+csv_scanner_is_current_value_in_input(CSVScanner *self, gsize *ofs)
+{
+  if (!self->current_value_start)
+    return FALSE;
+
+  *ofs = self->current_value_start - self->input;
+  return TRUE;
+}
+
 gchar *
 csv_scanner_dup_current_value(CSVScanner *self)
 {
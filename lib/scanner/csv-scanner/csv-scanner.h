@@ -46,6 +46,8 @@ typedef struct _CSVScannerOptions
   gchar *quotes_end;
   gchar *null_value;
   GList *string_delimiters;
+  /* characters that may terminate an unquoted value, NULL if unknown */
+  gchar *value_terminators;
   CSVScannerDialect dialect;
   guint32 flags;
 } CSVScannerOptions;
@@ -76,14 +78,19 @@ typedef struct
     CSV_STATE_FINISH,
   } state;
   GList *current_column;
+  const gchar *input;
   const gchar *src;
   GString *current_value;
+  /* unquoted values are not copied, they point into the input */
+  const gchar *current_value_start;
+  gint current_value_len;
   gchar current_quote;
 } CSVScanner;
 
 const gchar *csv_scanner_get_current_name(CSVScanner *pstate);
 const gchar *csv_scanner_get_current_value(CSVScanner *pstate);
 gint csv_scanner_get_current_value_len(CSVScanner *self);
+gboolean csv_scanner_is_current_value_in_input(CSVScanner *self, gsize *ofs);
 gboolean csv_scanner_scan_next(CSVScanner *pstate);
 gboolean csv_scanner_is_scan_complete(CSVScanner *pstate);
 gchar *csv_scanner_dup_current_value(CSVScanner *self);
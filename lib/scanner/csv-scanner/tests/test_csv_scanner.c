@@ -190,6 +190,43 @@ Test(csv_scanner, greedy_column)
   csv_scanner_deinit(&scanner);
 }
 
+static gboolean
+_column_value_is_in_input_at(gsize expected_ofs, gint expected_len)
+{
+  gsize ofs;
+
+  return csv_scanner_is_current_value_in_input(&scanner, &ofs) &&
+         ofs == expected_ofs &&
+         csv_scanner_get_current_value_len(&scanner) == expected_len;
+}
+
+Test(csv_scanner, unquoted_values_are_not_copied_from_the_input)
+{
+  const gchar *columns[] = { "foo", "bar", "baz", NULL };
+  gsize ofs;
+
+  csv_scanner_init(&scanner, _default_options(columns), "val1 ,'val2',val3");
+
+  cr_expect(_scan_next());
+  cr_expect(_column_value_is_in_input_at(0, 4));
+  cr_expect(_column_nv_equals("foo", "val1"));
+
+  cr_expect(_scan_next());
+  cr_expect(!csv_scanner_is_current_value_in_input(&scanner, &ofs));
+  cr_expect(_column_nv_equals("bar", "val2"));
+
+  cr_expect(_scan_next());
+  cr_expect(_column_value_is_in_input_at(13, 4));
+  cr_expect(_column_nv_equals("baz", "val3"));
+
+  /* the value is copied once it is fetched */
+  cr_expect(!_column_value_is_in_input_at(13, 4));
+
+  cr_expect(!_scan_next());
+  cr_expect(_scan_complete());
+  csv_scanner_deinit(&scanner);
+}
+
 static void
 setup(void)
 {
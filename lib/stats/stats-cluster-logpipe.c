@@ -50,6 +50,8 @@ _counter_group_logpipe_init(StatsCounterGroupInit *self, StatsCounterGroup *coun
 {
   counter_group->counters = g_new0(StatsCounterItem, SC_TYPE_MAX);
   counter_group->capacity = SC_TYPE_MAX;
+  counter_group->sharded_mask = (1 << SC_TYPE_PROCESSED) | (1 << SC_TYPE_WRITTEN) |
+                                (1 << SC_TYPE_MATCHED) | (1 << SC_TYPE_NOT_MATCHED);
   counter_group->counter_names = self->counter_names;
   counter_group->free_fn = _counter_group_logpipe_free;
 }
@@ -210,6 +210,11 @@ stats_cluster_track_counter(StatsCluster *self, gint type)
 
   g_assert(type < self->counter_group.capacity);
 
+  /* dynamic clusters are numerous and are rarely hot, so they are not
+   * worth the memory of the shards */
+  if (!(self->live_mask & type_mask) && (self->counter_group.sharded_mask & type_mask) && !self->dynamic)
+    stats_counter_enable_sharding(&self->counter_group.counters[type]);
+
   self->live_mask |= type_mask;
   self->use_count++;
   return &self->counter_group.counters[type];
@@ -54,6 +54,8 @@ struct _StatsCounterGroup
   StatsCounterItem *counters;
   const gchar **counter_names;
   guint16 capacity;
+  /* counters updated on hot paths, these are sharded per-thread */
+  guint16 sharded_mask;
   void (*free_fn)(StatsCounterGroup *self);
 };
 
@@ -24,6 +24,21 @@
 #include "stats/stats-counter.h"
 #include "stats/stats-cluster.h"
 #include "stats/stats-registry.h"
+#include "tls-support.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+TLS_BLOCK_START
+{
+  /* shifted by one, 0 means that the thread has not been assigned a shard yet */
+  gint stats_counter_shard_index;
+}
+TLS_BLOCK_END;
+
+#define stats_counter_shard_index __tls_deref(stats_counter_shard_index)
+
+static gint stats_counter_next_shard_index;
 
 static void
 _reset_counter(StatsCluster *sc, gint type, StatsCounterItem *counter, gpointer user_data)
@@ -52,8 +67,35 @@ stats_reset_counters(void)
   stats_unlock();
 }
 
+/* threads are assigned to shards in a round-robin fashion on their first
+ * counter update */
+gint
+stats_counter_get_shard_index(void)
+{
+  if (G_UNLIKELY(!stats_counter_shard_index))
+    stats_counter_shard_index = (g_atomic_int_add(&stats_counter_next_shard_index, 1) % STATS_COUNTER_SHARDS) + 1;
+  return stats_counter_shard_index - 1;
+}
+
+/* NOTE: must be called before the counter is published to other threads */
+void
+stats_counter_enable_sharding(StatsCounterItem *counter)
+{
+  gpointer shards;
+
+  if (counter->shards)
+    return;
+
+  if (posix_memalign(&shards, STATS_COUNTER_CACHE_LINE_SIZE, STATS_COUNTER_SHARDS * sizeof(StatsCounterShard)) != 0)
+    g_assert_not_reached();
+  memset(shards, 0, STATS_COUNTER_SHARDS * sizeof(StatsCounterShard));
+  counter->shards = shards;
+}
+
 void
 stats_counter_free(StatsCounterItem *counter)
 {
+  free(counter->shards);
+  counter->shards = NULL;
   g_free(counter->name);
 }
@@ -27,48 +27,97 @@
 #include "syslog-ng.h"
 #include "atomic-gssize.h"
 
+#define STATS_COUNTER_SHARDS 16
+#define STATS_COUNTER_CACHE_LINE_SIZE 64
+
+/* a per-thread slot of a sharded counter, padded to a full cache line so
+ * that threads updating different shards do not share cache lines */
+typedef union _StatsCounterShard
+{
+  atomic_gssize value;
+  gchar __padding[STATS_COUNTER_CACHE_LINE_SIZE];
+} StatsCounterShard;
+
 typedef struct _StatsCounterItem
 {
   atomic_gssize value;
+  /* high-frequency counters are sharded: updates go to the shard of the
+   * current thread and stats_counter_get() sums them up */
+  StatsCounterShard *shards;
   gchar *name;
   gint type;
 } StatsCounterItem;
 
+gint stats_counter_get_shard_index(void);
+
+static inline atomic_gssize *
+_stats_counter_get_local_value(StatsCounterItem *counter)
+{
+  if (counter->shards)
+    return &counter->shards[stats_counter_get_shard_index()].value;
+  return &counter->value;
+}
 
 static inline void
 stats_counter_add(StatsCounterItem *counter, gssize add)
 {
   if (counter)
-    atomic_gssize_add(&counter->value, add);
+    atomic_gssize_add(_stats_counter_get_local_value(counter), add);
 }
 
 static inline void
 stats_counter_sub(StatsCounterItem *counter, gssize sub)
 {
   if (counter)
-    atomic_gssize_sub(&counter->value, sub);
+    atomic_gssize_sub(_stats_counter_get_local_value(counter), sub);
 }
 
 static inline void
 stats_counter_inc(StatsCounterItem *counter)
 {
   if (counter)
-    atomic_gssize_inc(&counter->value);
+    atomic_gssize_inc(_stats_counter_get_local_value(counter));
 }
 
 static inline void
 stats_counter_dec(StatsCounterItem *counter)
 {
   if (counter)
-    atomic_gssize_dec(&counter->value);
+    atomic_gssize_dec(_stats_counter_get_local_value(counter));
 }
 
 /* NOTE: this is _not_ atomic and doesn't have to be as sets would race anyway */
 static inline void
 stats_counter_set(StatsCounterItem *counter, gsize value)
 {
-  if (counter)
-    atomic_gssize_racy_set(&counter->value, value);
+  if (!counter)
+    return;
+
+  atomic_gssize_racy_set(&counter->value, value);
+  if (counter->shards)
+    {
+      for (gint i = 0; i < STATS_COUNTER_SHARDS; i++)
+        atomic_gssize_racy_set(&counter->shards[i].value, 0);
+    }
+}
+
+/* raises the counter to value if it is smaller, not for sharded counters */
+static inline void
+stats_counter_set_max(StatsCounterItem *counter, gsize value)
+{
+  gsize oldval;
+
+  if (!counter)
+    return;
+
+  g_assert(!counter->shards);
+  do
+    {
+      oldval = atomic_gssize_get_unsigned(&counter->value);
+      if (oldval >= value)
+        return;
+    }
+  while (!atomic_gssize_compare_and_exchange(&counter->value, oldval, value));
 }
 
 /* NOTE: this is _not_ atomic and doesn't have to be as sets would race anyway */
@@ -78,7 +127,14 @@ stats_counter_get(StatsCounterItem *counter)
   gsize result = 0;
 
   if (counter)
-    result = atomic_gssize_get_unsigned(&counter->value);
+    {
+      result = atomic_gssize_get_unsigned(&counter->value);
+      if (counter->shards)
+        {
+          for (gint i = 0; i < STATS_COUNTER_SHARDS; i++)
+            result += atomic_gssize_get_unsigned(&counter->shards[i].value);
+        }
+    }
   return result;
 }
 
@@ -91,6 +147,7 @@ stats_counter_get_name(StatsCounterItem *counter)
 }
 
 void stats_reset_counters(void);
+void stats_counter_enable_sharding(StatsCounterItem *counter);
 void stats_counter_free(StatsCounterItem *counter);
 
 #endif
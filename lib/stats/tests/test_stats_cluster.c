@@ -272,4 +272,65 @@ Test(stats_cluster, test_register_type)
   cr_assert_eq(first, same);
 }
 
+#define SHARDED_COUNTER_THREADS 8
+#define SHARDED_COUNTER_INCREMENTS 100000
+
+static gpointer
+_increment_counter(gpointer user_data)
+{
+  StatsCounterItem *counter = (StatsCounterItem *) user_data;
+
+  for (gint i = 0; i < SHARDED_COUNTER_INCREMENTS; i++)
+    stats_counter_inc(counter);
+  return NULL;
+}
+
+Test(stats_cluster, test_hot_logpipe_counters_are_sharded_and_summed_on_read)
+{
+  StatsCluster *sc;
+  StatsClusterKey sc_key;
+  GThread *threads[SHARDED_COUNTER_THREADS];
+
+  stats_cluster_logpipe_key_set(&sc_key, SCS_SOURCE | SCS_FILE, "id", "instance");
+  sc = stats_cluster_new(&sc_key);
+
+  StatsCounterItem *processed = stats_cluster_track_counter(sc, SC_TYPE_PROCESSED);
+  StatsCounterItem *dropped = stats_cluster_track_counter(sc, SC_TYPE_DROPPED);
+  cr_assert_not_null(processed->shards, "processed counters should be sharded");
+  cr_assert_null(dropped->shards, "dropped counters should not be sharded");
+
+  for (gint i = 0; i < SHARDED_COUNTER_THREADS; i++)
+    threads[i] = g_thread_create(_increment_counter, processed, TRUE, NULL);
+  for (gint i = 0; i < SHARDED_COUNTER_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  stats_counter_add(processed, 5);
+  stats_counter_dec(processed);
+  cr_assert_eq(stats_counter_get(processed), SHARDED_COUNTER_THREADS * SHARDED_COUNTER_INCREMENTS + 4);
+
+  stats_counter_set(processed, 42);
+  cr_assert_eq(stats_counter_get(processed), 42);
+
+  stats_cluster_untrack_counter(sc, SC_TYPE_PROCESSED, &processed);
+  stats_cluster_untrack_counter(sc, SC_TYPE_DROPPED, &dropped);
+  stats_cluster_free(sc);
+}
+
+Test(stats_cluster, test_dynamic_clusters_are_not_sharded)
+{
+  StatsCluster *sc;
+  StatsClusterKey sc_key;
+
+  stats_cluster_logpipe_key_set(&sc_key, SCS_HOST | SCS_SOURCE, NULL, "localhost");
+  sc = stats_cluster_dynamic_new(&sc_key);
+
+  StatsCounterItem *processed = stats_cluster_track_counter(sc, SC_TYPE_PROCESSED);
+  cr_assert_null(processed->shards);
+  stats_counter_inc(processed);
+  cr_assert_eq(stats_counter_get(processed), 1);
+
+  stats_cluster_untrack_counter(sc, SC_TYPE_PROCESSED, &processed);
+  stats_cluster_free(sc);
+}
+
 TestSuite(stats_cluster, .init=setup, .fini = app_shutdown);
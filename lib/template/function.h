@@ -77,6 +77,11 @@ struct _LogTemplateFunction
 
   /* generic argument that can be used to pass information from registration time */
   gpointer arg;
+
+  /* optional: return TRUE if the result only depends on the message and
+   * the template options, allowing it to be cached on the message.  NULL
+   * means not cacheable */
+  gboolean (*is_cacheable)(LogTemplateFunction *self, gpointer state);
 };
 
 #define TEMPLATE_FUNCTION_PROTOTYPE(prefix) \
@@ -102,6 +107,23 @@ struct _LogTemplateFunction
     return &func;                                                       \
   }
 
+/* same as TEMPLATE_FUNCTION(), for functions that can be cached */
+#define TEMPLATE_FUNCTION_CACHEABLE(state_struct, prefix, prepare, eval, call, free_state, arg, is_cacheable) \
+  TEMPLATE_FUNCTION_PROTOTYPE(prefix)           \
+  {                                                                     \
+    static LogTemplateFunction func = {                                 \
+      sizeof(state_struct),                                             \
+      prepare,                                                          \
+      eval,                                                             \
+      call,                                                             \
+      free_state,                                                       \
+      NULL,                                                             \
+      arg,                                                              \
+      is_cacheable                                                      \
+    };                                                                  \
+    return &func;                                                       \
+  }
+
 #define TEMPLATE_FUNCTION_PLUGIN(x, tf_name) \
   {                                     \
     .type = LL_CONTEXT_TEMPLATE_FUNC,   \
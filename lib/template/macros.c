@@ -303,10 +303,33 @@ log_macro_expand_date_time(GString *result, gint id, gboolean escape, const LogT
    *   message specific timezone, if one is specified
    *   local timezone
    */
+  glong zone_offset = time_zone_info_get_offset(opts->time_zone_info[tz], stamp->ut_sec);
+
+  /* complete timestamps go through the formatted timestamp cache */
+  switch (id)
+    {
+    case M_DATE:
+      append_format_unix_time(stamp, result, TS_FMT_BSD, zone_offset, opts->frac_digits);
+      return;
+    case M_STAMP:
+      append_format_unix_time(stamp, result, opts->ts_format, zone_offset, opts->frac_digits);
+      return;
+    case M_ISODATE:
+      append_format_unix_time(stamp, result, TS_FMT_ISO, zone_offset, opts->frac_digits);
+      return;
+    case M_FULLDATE:
+      append_format_unix_time(stamp, result, TS_FMT_FULL, zone_offset, opts->frac_digits);
+      return;
+    case M_UNIXTIME:
+      append_format_unix_time(stamp, result, TS_FMT_UNIX, zone_offset, opts->frac_digits);
+      return;
+    default:
+      break;
+    }
+
   WallClockTime wct;
 
-  convert_unix_time_to_wall_clock_time_with_tz_override(stamp, &wct,
-                                                        time_zone_info_get_offset(opts->time_zone_info[tz], stamp->ut_sec));
+  convert_unix_time_to_wall_clock_time_with_tz_override(stamp, &wct, zone_offset);
   switch (id)
     {
     case M_WEEK_DAY_ABBREV:
@@ -375,24 +398,6 @@ log_macro_expand_date_time(GString *result, gint id, gboolean escape, const LogT
     case M_AMPM:
       g_string_append(result, wct.wct_hour < 12 ? "AM" : "PM");
       break;
-    case M_DATE:
-      append_format_wall_clock_time(&wct, result, TS_FMT_BSD, opts->frac_digits);
-      break;
-    case M_STAMP:
-      if (opts->ts_format == TS_FMT_UNIX)
-        append_format_unix_time(stamp, result, TS_FMT_UNIX, wct.wct_gmtoff, opts->frac_digits);
-      else
-        append_format_wall_clock_time(&wct, result, opts->ts_format, opts->frac_digits);
-      break;
-    case M_ISODATE:
-      append_format_wall_clock_time(&wct, result, TS_FMT_ISO, opts->frac_digits);
-      break;
-    case M_FULLDATE:
-      append_format_wall_clock_time(&wct, result, TS_FMT_FULL, opts->frac_digits);
-      break;
-    case M_UNIXTIME:
-      append_format_unix_time(stamp, result, TS_FMT_UNIX, wct.wct_gmtoff, opts->frac_digits);
-      break;
     case M_TZ:
     case M_TZOFFSET:
       append_format_zone_info(result, wct.wct_gmtoff);
@@ -642,6 +647,35 @@ log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOpt
   return TRUE;
 }
 
+/* $ISODATE without the dispatching in log_macro_expand() */
+void
+log_macro_expand_isodate(GString *result, const UnixTime *stamp, const LogTemplateOptions *opts, gint tz)
+{
+  append_format_unix_time(stamp, result, TS_FMT_ISO,
+                          time_zone_info_get_offset(opts->time_zone_info[tz], stamp->ut_sec), opts->frac_digits);
+}
+
+/* whether the expansion only depends on the message and the template
+ * options, so it can be reused when the same message is formatted again */
+gboolean
+log_macro_is_cacheable(gint id)
+{
+  switch (id)
+    {
+    case M_SEQNUM:
+    case M_CONTEXT_ID:
+    case M_SYSUPTIME:
+      return FALSE;
+    default:
+      break;
+    }
+
+  /* C_ macros use the current time, P_ macros fall back to it */
+  if (id >= M_TIME_FIRST + M_CSTAMP_OFS && id <= M_TIME_LAST + M_PROCESSED_OFS)
+    return FALSE;
+  return TRUE;
+}
+
 gboolean
 log_macro_expand_simple(GString *result, gint id, const LogMessage *msg)
 {
@@ -27,6 +27,7 @@
 
 #include "syslog-ng.h"
 #include "common-template-typedefs.h"
+#include "timeutils/unixtime.h"
 
 /* macro IDs */
 enum
@@ -116,6 +117,8 @@ guint log_macro_lookup(const gchar *macro, gint len);
 gboolean log_macro_expand(GString *result, gint id, gboolean escape, const LogTemplateOptions *opts, gint tz,
                           gint32 seq_num, const gchar *context_id, const LogMessage *msg);
 gboolean log_macro_expand_simple(GString *result, gint id, const LogMessage *msg);
+gboolean log_macro_is_cacheable(gint id);
+void log_macro_expand_isodate(GString *result, const UnixTime *stamp, const LogTemplateOptions *opts, gint tz);
 
 void log_macros_global_init(void);
 void log_macros_global_deinit(void);
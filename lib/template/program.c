@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "template/program.h"
+#include "template/macros.h"
+
+#include <string.h>
+
+static gsize
+_calculate_literals_size(GList *compiled_template)
+{
+  gsize size = 0;
+
+  for (GList *l = compiled_template; l; l = l->next)
+    size += ((LogTemplateElem *) l->data)->text_len;
+  return size;
+}
+
+static LogTemplateInstr *
+_last_instr(GArray *instrs)
+{
+  if (instrs->len == 0)
+    return NULL;
+  return &g_array_index(instrs, LogTemplateInstr, instrs->len - 1);
+}
+
+/* literals are copied one after the other into a buffer that is
+ * allocated upfront, so adjacent ones can be merged by extending the
+ * length of the previous instruction */
+static void
+_emit_text(GArray *instrs, gchar **literal_end, const gchar *text, gsize text_len)
+{
+  LogTemplateInstr *last = _last_instr(instrs);
+
+  memcpy(*literal_end, text, text_len);
+  if (last && last->opcode == LTI_TEXT)
+    {
+      last->text.len += text_len;
+    }
+  else
+    {
+      LogTemplateInstr instr =
+      {
+        .opcode = LTI_TEXT,
+        .text = { .str = *literal_end, .len = text_len },
+      };
+
+      g_array_append_val(instrs, instr);
+    }
+  *literal_end += text_len;
+}
+
+static void
+_lower_macro(LogTemplateInstr *instr, guint macro)
+{
+  switch (macro)
+    {
+    case M_MESSAGE:
+      instr->opcode = LTI_MACRO_VALUE;
+      instr->value_handle = LM_V_MESSAGE;
+      break;
+    case M_HOST:
+      instr->opcode = LTI_HOST;
+      instr->macro = macro;
+      break;
+    case M_ISODATE:
+    case M_STAMP_OFS + M_ISODATE:
+      instr->opcode = LTI_ISODATE;
+      instr->timestamp = LM_TS_STAMP;
+      break;
+    case M_RECVD_OFS + M_ISODATE:
+      instr->opcode = LTI_ISODATE;
+      instr->timestamp = LM_TS_RECVD;
+      break;
+    default:
+      instr->opcode = LTI_MACRO;
+      instr->macro = macro;
+      break;
+    }
+}
+
+static void
+_emit_elem(GArray *instrs, LogTemplateElem *e)
+{
+  LogTemplateInstr instr =
+  {
+    .msg_ref = e->msg_ref,
+    .default_value = e->default_value,
+  };
+
+  switch (e->type)
+    {
+    case LTE_MACRO:
+      /* literal text only */
+      if (e->macro == M_NONE)
+        return;
+      _lower_macro(&instr, e->macro);
+      break;
+    case LTE_VALUE:
+      instr.opcode = LTI_VALUE;
+      instr.value_handle = e->value_handle;
+      break;
+    case LTE_FUNC:
+      instr.opcode = LTI_FUNC;
+      instr.func = e;
+      break;
+    default:
+      g_assert_not_reached();
+    }
+  g_array_append_val(instrs, instr);
+}
+
+/* the program refers to the elements of compiled_template, so it must not
+ * outlive them */
+LogTemplateProgram *
+log_template_program_new(GList *compiled_template)
+{
+  LogTemplateProgram *self = g_new0(LogTemplateProgram, 1);
+  GArray *instrs = g_array_new(FALSE, TRUE, sizeof(LogTemplateInstr));
+  gchar *literal_end;
+
+  self->literals = g_malloc(_calculate_literals_size(compiled_template) + 1);
+  literal_end = self->literals;
+
+  for (GList *l = compiled_template; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+
+      if (e->text_len > 0)
+        _emit_text(instrs, &literal_end, e->text, e->text_len);
+      _emit_elem(instrs, e);
+    }
+  *literal_end = 0;
+
+  self->len = instrs->len;
+  self->instrs = (LogTemplateInstr *) g_array_free(instrs, FALSE);
+  return self;
+}
+
+void
+log_template_program_free(LogTemplateProgram *self)
+{
+  if (!self)
+    return;
+
+  g_free(self->instrs);
+  g_free(self->literals);
+  g_free(self);
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef TEMPLATE_PROGRAM_H_INCLUDED
+#define TEMPLATE_PROGRAM_H_INCLUDED
+
+#include "template/repr.h"
+
+/*
+ * The flat representation of a compiled template, which is what
+ * log_template_append_format_with_context() executes.  Adjacent literals
+ * are merged into a single instruction and the most common macros are
+ * specialized so they don't have to go through log_macro_expand().
+ */
+enum
+{
+  LTI_TEXT,
+  LTI_VALUE,
+  /* a macro that is a plain name-value pair ($MSG) */
+  LTI_MACRO_VALUE,
+  LTI_HOST,
+  LTI_ISODATE,
+  LTI_MACRO,
+  LTI_FUNC
+};
+
+typedef struct _LogTemplateInstr
+{
+  guint8 opcode;
+  guint16 msg_ref;
+  const gchar *default_value;
+  union
+  {
+    struct
+    {
+      const gchar *str;
+      gsize len;
+    } text;
+    NVHandle value_handle;
+    guint macro;
+    /* LM_TS_* */
+    gint timestamp;
+    LogTemplateElem *func;
+  };
+} LogTemplateInstr;
+
+struct _LogTemplateProgram
+{
+  LogTemplateInstr *instrs;
+  gint len;
+  gchar *literals;
+};
+
+LogTemplateProgram *log_template_program_new(GList *compiled_template);
+void log_template_program_free(LogTemplateProgram *self);
+
+#endif
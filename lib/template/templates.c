@@ -23,12 +23,16 @@
  */
 #include "template/templates.h"
 #include "template/repr.h"
+#include "template/program.h"
 #include "template/compiler.h"
 #include "template/macros.h"
 #include "template/escaping.h"
+#include "timeutils/format.h"
 #include "template/repr.h"
 #include "cfg.h"
 
+#include <string.h>
+
 gboolean
 log_template_is_trivial(LogTemplate *self)
 {
@@ -111,12 +115,59 @@ _calculate_triviality(LogTemplate *self)
     }
 }
 
+/* the output only depends on the message and the formatting options */
+gboolean
+log_template_is_cacheable(LogTemplate *self)
+{
+  return self->cacheable && !self->uses_seq_num;
+}
+
+static void
+_calculate_cacheability(LogTemplate *self)
+{
+  gboolean has_function = FALSE;
+
+  self->cacheable = TRUE;
+  self->uses_seq_num = FALSE;
+  for (GList *l = self->compiled_template; l; l = l->next)
+    {
+      LogTemplateElem *e = (LogTemplateElem *) l->data;
+
+      switch (e->type)
+        {
+        case LTE_MACRO:
+          /* $SEQNUM is part of the cache key */
+          if (e->macro == M_SEQNUM)
+            self->uses_seq_num = TRUE;
+          else if (!log_macro_is_cacheable(e->macro))
+            self->cacheable = FALSE;
+          break;
+        case LTE_FUNC:
+          has_function = TRUE;
+          if (!e->func.ops->is_cacheable || !e->func.ops->is_cacheable(e->func.ops, e->func.state))
+            self->cacheable = FALSE;
+          break;
+        default:
+          break;
+        }
+    }
+
+  /* caching the result is only worth it if formatting is expensive */
+  if (self->cacheable && has_function)
+    self->signature = g_intern_string(self->template);
+}
+
 static void
 log_template_reset_compiled(LogTemplate *self)
 {
+  log_template_program_free(self->program);
+  self->program = NULL;
   log_template_elem_free_list(self->compiled_template);
   self->compiled_template = NULL;
   self->trivial = FALSE;
+  self->cacheable = FALSE;
+  self->uses_seq_num = FALSE;
+  self->signature = NULL;
 }
 
 gboolean
@@ -136,7 +187,9 @@ log_template_compile(LogTemplate *self, const gchar *template, GError **error)
   result = log_template_compiler_compile(&compiler, &self->compiled_template, error);
   log_template_compiler_clear(&compiler);
 
+  self->program = log_template_program_new(self->compiled_template);
   self->trivial = _calculate_triviality(self);
+  _calculate_cacheability(self);
   return result;
 }
 
@@ -148,6 +201,8 @@ log_template_compile_literal_string(LogTemplate *self, const gchar *literal)
   self->template = g_strdup(literal);
   self->compiled_template = g_list_append(self->compiled_template,
                                           log_template_elem_new_macro(literal, M_NONE, NULL, 0));
+  self->program = log_template_program_new(self->compiled_template);
+  self->cacheable = TRUE;
 }
 
 void
@@ -164,24 +219,68 @@ log_template_set_type_hint(LogTemplate *self, const gchar *type_hint, GError **e
   return type_hint_parse(type_hint, &self->type_hint, error);
 }
 
+static inline void
+_append_value(GString *result, LogMessage *msg, NVHandle handle, gboolean escape)
+{
+  gssize value_len;
+  const gchar *value = log_msg_get_value(msg, handle, &value_len);
+
+  result_append(result, value, value_len, escape);
+}
+
+static inline void
+_append_default_if_empty(GString *result, gsize len_before, const gchar *default_value)
+{
+  if (len_before == result->len && default_value)
+    g_string_append(result, default_value);
+}
+
+static void
+_call_function(const LogTemplateInstr *instr, LogMessage **messages, gint num_messages, gint msg_ndx,
+               const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
+{
+  LogTemplateElem *e = instr->func;
+  LogTemplateInvokeArgs args =
+  {
+    e->msg_ref ? &messages[msg_ndx] : messages,
+    e->msg_ref ? 1 : num_messages,
+    opts,
+    tz,
+    seq_num,
+    context_id
+  };
+
+  /* if a function call is called with an msg_ref, we only
+   * pass that given logmsg to argument resolution, otherwise
+   * we pass the whole set so the arguments can individually
+   * specify which message they want to resolve from
+   */
+  if (e->func.ops->eval)
+    e->func.ops->eval(e->func.ops, e->func.state, &args);
+  e->func.ops->call(e->func.ops, e->func.state, &args, result);
+}
+
 void
 log_template_append_format_with_context(LogTemplate *self, LogMessage **messages, gint num_messages,
                                         const LogTemplateOptions *opts, gint tz, gint32 seq_num, const gchar *context_id, GString *result)
 {
-  GList *p;
-  LogTemplateElem *e;
+  if (!self->program)
+    return;
 
   if (!opts)
     opts = &self->cfg->template_options;
 
-  for (p = self->compiled_template; p; p = g_list_next(p))
+  for (gint i = 0; i < self->program->len; i++)
     {
+      const LogTemplateInstr *instr = &self->program->instrs[i];
+      LogMessage *msg;
       gint msg_ndx;
+      gsize len;
 
-      e = (LogTemplateElem *) p->data;
-      if (e->text)
+      if (instr->opcode == LTI_TEXT)
         {
-          g_string_append_len(result, e->text, e->text_len);
+          g_string_append_len(result, instr->text.str, instr->text.len);
+          continue;
         }
 
       /* NOTE: msg_ref is 1 larger than the index specified by the user in
@@ -190,67 +289,55 @@ log_template_append_format_with_context(LogTemplate *self, LogMessage **messages
        *
        * msg_ref == 0 means that the user didn't specify msg_ref
        * msg_ref >= 1 means that the user supplied the given msg_ref, 1 is equal to @0 */
-      if (e->msg_ref > num_messages)
+      if (instr->msg_ref > num_messages)
         continue;
-      msg_ndx = num_messages - e->msg_ref;
+      msg_ndx = num_messages - instr->msg_ref;
 
       /* value and macro can't understand a context, assume that no msg_ref means @0 */
-      if (e->msg_ref == 0)
+      if (instr->msg_ref == 0)
         msg_ndx--;
 
-      switch (e->type)
+      if (instr->opcode == LTI_FUNC)
         {
-        case LTE_VALUE:
+          _call_function(instr, messages, num_messages, msg_ndx, opts, tz, seq_num, context_id, result);
+          continue;
+        }
+      msg = messages[msg_ndx];
+
+      switch (instr->opcode)
+        {
+        case LTI_VALUE:
         {
-          const gchar *value = NULL;
           gssize value_len = -1;
+          const gchar *value = log_msg_get_value(msg, instr->value_handle, &value_len);
 
-          value = log_msg_get_value(messages[msg_ndx], e->value_handle, &value_len);
           if (value && value[0])
             result_append(result, value, value_len, self->escape);
-          else if (e->default_value)
-            result_append(result, e->default_value, -1, self->escape);
+          else if (instr->default_value)
+            result_append(result, instr->default_value, -1, self->escape);
           break;
         }
-        case LTE_MACRO:
-        {
-          gint len = result->len;
-
-          if (e->macro)
-            {
-              log_macro_expand(result, e->macro, self->escape, opts ? opts : &self->cfg->template_options, tz, seq_num, context_id,
-                               messages[msg_ndx]);
-              if (len == result->len && e->default_value)
-                g_string_append(result, e->default_value);
-            }
+        case LTI_MACRO_VALUE:
+          len = result->len;
+          _append_value(result, msg, instr->value_handle, self->escape);
+          _append_default_if_empty(result, len, instr->default_value);
           break;
-        }
-        case LTE_FUNC:
-        {
-          if (1)
-            {
-              LogTemplateInvokeArgs args =
-              {
-                e->msg_ref ? &messages[msg_ndx] : messages,
-                e->msg_ref ? 1 : num_messages,
-                opts,
-                tz,
-                seq_num,
-                context_id
-              };
-
-
-              /* if a function call is called with an msg_ref, we only
-               * pass that given logmsg to argument resolution, otherwise
-               * we pass the whole set so the arguments can individually
-               * specify which message they want to resolve from
-               */
-              if (e->func.ops->eval)
-                e->func.ops->eval(e->func.ops, e->func.state, &args);
-              e->func.ops->call(e->func.ops, e->func.state, &args, result);
-            }
+        case LTI_HOST:
+          len = result->len;
+          if (msg->flags & LF_CHAINED_HOSTNAME)
+            log_macro_expand(result, instr->macro, self->escape, opts, tz, seq_num, context_id, msg);
+          else
+            _append_value(result, msg, LM_V_HOST, self->escape);
+          _append_default_if_empty(result, len, instr->default_value);
+          break;
+        case LTI_ISODATE:
+          log_macro_expand_isodate(result, &msg->timestamps[instr->timestamp], opts, tz);
+          break;
+        case LTI_MACRO:
+          len = result->len;
+          log_macro_expand(result, instr->macro, self->escape, opts, tz, seq_num, context_id, msg);
+          _append_default_if_empty(result, len, instr->default_value);
           break;
-        }
         default:
           g_assert_not_reached();
           break;
@@ -266,11 +353,84 @@ log_template_format_with_context(LogTemplate *self, LogMessage **messages, gint
   log_template_append_format_with_context(self, messages, num_messages, opts, tz, seq_num, context_id, result);
 }
 
+/*
+ * Everything that influences the output of a cacheable template, used as
+ * the key of the results cached on the message.  Templates with the same
+ * text share the signature, so identical templates of different
+ * destinations share the result too.
+ */
+typedef struct _LogTemplateCacheKey
+{
+  const gchar *signature;
+  gint32 seq_num;
+  gint tz;
+  gint ts_format;
+  gint frac_digits;
+  gint on_error;
+  gboolean use_fqdn;
+  gboolean escape;
+  /* variable length, only the used part is compared */
+  gchar time_zone[64];
+} LogTemplateCacheKey;
+
+static gboolean
+_fill_cache_key(LogTemplate *self, LogTemplateCacheKey *key, gsize *key_len, const LogTemplateOptions *opts,
+                gint tz, gint32 seq_num)
+{
+  const gchar *time_zone = opts->time_zone[tz] ? opts->time_zone[tz] : "";
+  gsize time_zone_len = strlen(time_zone);
+
+  if (time_zone_len >= sizeof(key->time_zone))
+    return FALSE;
+
+  /* clear the padding too, as keys are compared with memcmp() */
+  memset(key, 0, sizeof(*key));
+  key->signature = self->signature;
+  key->seq_num = self->uses_seq_num ? seq_num : 0;
+  key->tz = tz;
+  key->ts_format = opts->ts_format;
+  key->frac_digits = opts->frac_digits;
+  key->on_error = opts->on_error;
+  key->use_fqdn = opts->use_fqdn;
+  key->escape = self->escape;
+  memcpy(key->time_zone, time_zone, time_zone_len);
+  *key_len = G_STRUCT_OFFSET(LogTemplateCacheKey, time_zone) + time_zone_len;
+  return TRUE;
+}
+
 void
 log_template_append_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num,
                            const gchar *context_id, GString *result)
 {
+  LogTemplateCacheKey key;
+  gsize key_len;
+
+  if (!self->signature || !log_msg_is_result_cache_enabled(lm))
+    {
+      log_template_append_format_with_context(self, &lm, 1, opts, tz, seq_num, context_id, result);
+      return;
+    }
+
+  if (!opts)
+    opts = &self->cfg->template_options;
+
+  if (!_fill_cache_key(self, &key, &key_len, opts, tz, seq_num))
+    {
+      log_template_append_format_with_context(self, &lm, 1, opts, tz, seq_num, context_id, result);
+      return;
+    }
+
+  gsize cached_len;
+  const gchar *cached = log_msg_lookup_cached_result(lm, &key, key_len, &cached_len);
+  if (cached)
+    {
+      g_string_append_len(result, cached, cached_len);
+      return;
+    }
+
+  gsize start = result->len;
   log_template_append_format_with_context(self, &lm, 1, opts, tz, seq_num, context_id, result);
+  log_msg_store_cached_result(lm, &key, key_len, result->str + start, result->len - start);
 }
 
 void
@@ -409,11 +569,13 @@ void
 log_template_global_init(void)
 {
   log_macros_global_init();
+  format_unix_time_global_init();
 }
 
 void
 log_template_global_deinit(void)
 {
+  format_unix_time_global_deinit();
   log_macros_global_deinit();
 }
 
@@ -54,6 +54,8 @@ typedef enum
   ON_ERROR_SILENT              = 0x08
 } LogTemplateOnError;
 
+typedef struct _LogTemplateProgram LogTemplateProgram;
+
 /* structure that represents an expandable syslog-ng template */
 typedef struct _LogTemplate
 {
@@ -61,8 +63,11 @@ typedef struct _LogTemplate
   gchar *name;
   gchar *template;
   GList *compiled_template;
+  LogTemplateProgram *program;
   GlobalConfig *cfg;
-  guint escape:1, def_inline:1, trivial:1;
+  guint escape:1, def_inline:1, trivial:1, cacheable:1, uses_seq_num:1;
+  /* identifies the results cached on messages, NULL if they are not cached */
+  const gchar *signature;
   TypeHint type_hint;
 } LogTemplate;
 
@@ -94,6 +99,7 @@ gboolean log_template_set_type_hint(LogTemplate *self, const gchar *hint, GError
 gboolean log_template_compile(LogTemplate *self, const gchar *template, GError **error);
 void log_template_compile_literal_string(LogTemplate *self, const gchar *literal);
 gboolean log_template_is_trivial(LogTemplate *self);
+gboolean log_template_is_cacheable(LogTemplate *self);
 const gchar *log_template_get_trivial_value(LogTemplate *self, LogMessage *msg, gssize *value_len);
 void log_template_format(LogTemplate *self, LogMessage *lm, const LogTemplateOptions *opts, gint tz, gint32 seq_num,
                          const gchar *context_id, GString *result);
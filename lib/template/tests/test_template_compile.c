@@ -375,6 +375,54 @@ Test(template_compile, test_unknown_function)
                            type = LTE_MACRO, msg_ref = 0);
 }
 
+static const LogTemplateInstr *
+assert_program_instr(gint index_, guint8 opcode)
+{
+  cr_assert_lt(index_, template->program->len, "program is too short");
+
+  const LogTemplateInstr *instr = &template->program->instrs[index_];
+  cr_assert_eq(instr->opcode, opcode, "Bad opcode at %d, expected=%d, actual=%d", index_, opcode, instr->opcode);
+  return instr;
+}
+
+static void
+assert_program_text(gint index_, const gchar *expected_text)
+{
+  const LogTemplateInstr *instr = assert_program_instr(index_, LTI_TEXT);
+
+  cr_assert_eq(instr->text.len, strlen(expected_text));
+  cr_assert_arr_eq(instr->text.str, expected_text, instr->text.len, "Bad text at %d: %.*s", index_,
+                   (gint) instr->text.len, instr->text.str);
+}
+
+Test(template_compile, test_program_merges_literals_and_specializes_common_macros)
+{
+  assert_template_compile("<$PRI>$ISODATE $HOST $MSGHDR${MESSAGE} ${APP.VALUE:-default} $(hello) foo bar");
+
+  assert_program_text(0, "<");
+  assert_program_instr(1, LTI_MACRO);
+  assert_program_text(2, ">");
+  cr_assert_eq(assert_program_instr(3, LTI_ISODATE)->timestamp, LM_TS_STAMP);
+  assert_program_text(4, " ");
+  assert_program_instr(5, LTI_HOST);
+  assert_program_text(6, " ");
+  cr_assert_eq(assert_program_instr(7, LTI_MACRO)->macro, M_MSGHDR);
+  cr_assert_eq(assert_program_instr(8, LTI_MACRO_VALUE)->value_handle, LM_V_MESSAGE);
+  assert_program_text(9, " ");
+  cr_assert_str_eq(assert_program_instr(10, LTI_VALUE)->default_value, "default");
+  assert_program_text(11, " ");
+  assert_program_instr(12, LTI_FUNC);
+  assert_program_text(13, " foo bar");
+  cr_assert_eq(template->program->len, 14);
+
+  assert_template_compile("$R_ISODATE");
+  cr_assert_eq(assert_program_instr(0, LTI_ISODATE)->timestamp, LM_TS_RECVD);
+  cr_assert_eq(template->program->len, 1);
+
+  assert_template_compile("");
+  cr_assert_eq(template->program->len, 0);
+}
+
 static void
 setup(void)
 {
@@ -29,6 +29,7 @@
 #include "cfg.h"
 #include "libtest/cr_template.h"
 #include "libtest/stopwatch.h"
+#include "template/macros.h"
 
 Test(template_speed, test_template_speed)
 {
@@ -59,3 +60,28 @@ Test(template_speed, test_template_speed)
 
   app_shutdown();
 }
+
+Test(template_speed, test_builtin_macro_speed)
+{
+  app_startup();
+
+  init_template_tests();
+  setenv("TZ", "MET-1METDST", TRUE);
+  tzset();
+
+  cfg_load_module(configuration, "syslogformat");
+
+  /* the R_, S_, C_ and P_ variants of the date related macros are
+   * expanded the same way as the unprefixed ones */
+  for (gint i = 0; macros[i].name; i++)
+    {
+      if (macros[i].id > M_TIME_LAST)
+        continue;
+
+      gchar *template = g_strdup_printf("$%s", macros[i].name);
+      perftest_template(template);
+      g_free(template);
+    }
+
+  app_shutdown();
+}
@@ -424,3 +424,149 @@ Test(logqueue, log_queue_fifo_should_drop_only_non_flow_controlled_messages_thre
   _unregister_stats_counters(q);
   log_queue_unref(q);
 }
+
+Test(logqueue, lockfree_fifo_normal_acks_and_memory_usage)
+{
+  LogQueue *q = log_queue_fifo_lockfree_new(OVERFLOW_SIZE, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+  _register_stats_counters(q);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 1);
+  gint size_when_single_msg = stats_counter_get(q->memory_usage);
+
+  for (gint i = 0; i < 10; i++)
+    feed_some_messages(q, 10);
+
+  cr_assert_eq(log_queue_get_length(q), 101);
+  cr_assert_eq(stats_counter_get(q->queued_messages), 101);
+  cr_assert_eq(stats_counter_get(q->memory_usage), 101*size_when_single_msg);
+
+  send_some_messages(q, fed_messages);
+  cr_assert_eq(log_queue_get_length(q), 0);
+  cr_assert_eq(stats_counter_get(q->memory_usage), 0);
+
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(stats_counter_get(q->queued_messages), 101);
+
+  send_some_messages(q, fed_messages);
+  log_queue_ack_backlog(q, fed_messages);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  _unregister_stats_counters(q);
+  log_queue_unref(q);
+}
+
+Test(logqueue, lockfree_fifo_should_drop_only_non_flow_controlled_messages_threaded)
+{
+  gint fifo_size = 5;
+  log_queue_set_max_threads(1);
+  LogQueue *q = log_queue_fifo_lockfree_new(fifo_size, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+  _register_stats_counters(q);
+
+  GThread *thread = g_thread_create(_flow_control_feed_thread, q, TRUE, NULL);
+  g_thread_join(thread);
+
+  cr_assert_eq(stats_counter_get(q->dropped_messages), 3);
+
+  gint queued_messages = stats_counter_get(q->queued_messages);
+  send_some_messages(q, queued_messages);
+  log_queue_ack_backlog(q, queued_messages);
+
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  _unregister_stats_counters(q);
+  log_queue_unref(q);
+}
+
+#define BENCHMARK_MAX_FEEDERS 8
+#define BENCHMARK_MESSAGES_PER_FEEDER 100000
+
+static gpointer
+_benchmark_feed(gpointer args)
+{
+  LogQueue *q = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *tmpl = log_msg_new_empty();
+
+  iv_init();
+  main_loop_worker_thread_start(NULL);
+
+  for (gint i = 0; i < BENCHMARK_MESSAGES_PER_FEEDER; i++)
+    {
+      LogMessage *msg = log_msg_clone_cow(tmpl, &path_options);
+      log_msg_add_ack(msg, &path_options);
+      msg->ack_func = test_ack;
+
+      log_queue_push_tail(q, msg, &path_options);
+
+      if ((i & 0xFF) == 0)
+        main_loop_worker_invoke_batch_callbacks();
+    }
+  main_loop_worker_invoke_batch_callbacks();
+
+  log_msg_unref(tmpl);
+  main_loop_worker_thread_stop();
+  iv_deinit();
+  return NULL;
+}
+
+static gint64
+_benchmark_fifo(LogQueue *q, gint feeders)
+{
+  GThread *feed_threads[BENCHMARK_MAX_FEEDERS];
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gint total = feeders * BENCHMARK_MESSAGES_PER_FEEDER;
+  gint consumed = 0;
+
+  gint64 start = g_get_monotonic_time();
+  for (gint i = 0; i < feeders; i++)
+    feed_threads[i] = g_thread_create(_benchmark_feed, q, TRUE, NULL);
+
+  while (consumed < total)
+    {
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          g_thread_yield();
+          continue;
+        }
+
+      log_msg_ack(msg, &path_options, AT_PROCESSED);
+      log_msg_unref(msg);
+      consumed++;
+    }
+
+  for (gint i = 0; i < feeders; i++)
+    g_thread_join(feed_threads[i]);
+
+  return g_get_monotonic_time() - start;
+}
+
+Test(logqueue, benchmark_fifo_implementations_with_increasing_number_of_feeders)
+{
+  log_queue_set_max_threads(BENCHMARK_MAX_FEEDERS);
+
+  for (gint feeders = 1; feeders <= BENCHMARK_MAX_FEEDERS; feeders *= 2)
+    {
+      LogQueue *locked = log_queue_fifo_new(feeders * BENCHMARK_MESSAGES_PER_FEEDER, NULL);
+      gint64 locked_time = _benchmark_fifo(locked, feeders);
+      log_queue_unref(locked);
+
+      LogQueue *lockfree = log_queue_fifo_lockfree_new(feeders * BENCHMARK_MESSAGES_PER_FEEDER, NULL);
+      gint64 lockfree_time = _benchmark_fifo(lockfree, feeders);
+      log_queue_unref(lockfree);
+
+      fprintf(stderr, "FIFO throughput with %d feeder(s): locked=%.2lf msg/sec, lockfree=%.2lf msg/sec\n", feeders,
+              (double) feeders * BENCHMARK_MESSAGES_PER_FEEDER * G_USEC_PER_SEC / MAX(locked_time, 1),
+              (double) feeders * BENCHMARK_MESSAGES_PER_FEEDER * G_USEC_PER_SEC / MAX(lockfree_time, 1));
+    }
+}
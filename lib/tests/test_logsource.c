@@ -29,13 +29,20 @@
 #include "cfg.h"
 #include "apphook.h"
 #include "dynamic-window-pool.h"
+#include "dns-resolver.h"
+#include "host-resolve.h"
+#include "mainloop.h"
+#include "mainloop-worker.h"
+#include "timeutils/misc.h"
 
 #include <criterion/criterion.h>
 #include <criterion/parameterized.h>
+#include <iv.h>
 
 #include <syslog.h>
 
 #include <string.h>
+#include <stdlib.h>
 
 #define TEST_SOURCE_GROUP "test_source_group"
 #define TEST_STATS_ID "test_stats_id"
@@ -506,3 +513,208 @@ Test(log_source, test_dynamic_window_reclaim)
 }
 
 TestSuite(log_source, .init = setup, .fini = teardown);
+
+#define SLOW_DNS_PORT 1
+
+gboolean
+resolve_sockaddr_needs_dns_query(GSockAddr *saddr, const HostResolveOptions *host_resolve_options)
+{
+  return g_sockaddr_get_port(saddr) == SLOW_DNS_PORT;
+}
+
+void
+resolve_sockaddr_into_dns_cache(GSockAddr *saddr)
+{
+  g_usleep(1000);
+}
+
+typedef struct OrderedPipe
+{
+  LogPipe super;
+  GThread *producer_thread;
+  GMutex *lock;
+  gint last_seq;
+  gint received;
+  gint out_of_order;
+} OrderedPipe;
+
+static void
+ordered_pipe_queue(LogPipe *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  OrderedPipe *pipe = (OrderedPipe *) s;
+  gint seq = atoi(log_msg_get_value_by_name(msg, "SEQ", NULL));
+
+  /* make the I/O workers draining the parked messages slower than the producer */
+  if (g_thread_self() != pipe->producer_thread)
+    g_usleep(100);
+
+  g_mutex_lock(pipe->lock);
+  if (seq < pipe->last_seq)
+    pipe->out_of_order++;
+  pipe->last_seq = seq;
+  pipe->received++;
+  g_mutex_unlock(pipe->lock);
+
+  log_msg_drop(msg, path_options, AT_PROCESSED);
+}
+
+static OrderedPipe *
+ordered_pipe_new(void)
+{
+  OrderedPipe *pipe = g_new0(OrderedPipe, 1);
+
+  log_pipe_init_instance(&pipe->super, cfg);
+  pipe->super.queue = ordered_pipe_queue;
+  pipe->lock = g_mutex_new();
+  return pipe;
+}
+
+static void
+ordered_pipe_free(OrderedPipe *pipe)
+{
+  g_mutex_free(pipe->lock);
+  log_pipe_unref(&pipe->super);
+}
+
+static gint
+ordered_pipe_get_received(OrderedPipe *pipe)
+{
+  gint received;
+
+  g_mutex_lock(pipe->lock);
+  received = pipe->received;
+  g_mutex_unlock(pipe->lock);
+  return received;
+}
+
+static void
+_post_message_from_port(LogSource *source, gint seq, gint port)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar seq_str[16];
+
+  g_snprintf(seq_str, sizeof(seq_str), "%d", seq);
+  log_msg_set_value_by_name(msg, "SEQ", seq_str, -1);
+  msg->saddr = g_sockaddr_inet_new("10.0.0.1", port);
+  log_source_post(source, msg);
+}
+
+#define PRODUCER_ROUNDS 50
+#define PRODUCER_MSGS_PER_ROUND 41
+
+static gpointer
+_producer_thread(gpointer user_data)
+{
+  LogSource *source = (LogSource *) user_data;
+  OrderedPipe *pipe = (OrderedPipe *) source->super.pipe_next;
+  gint seq = 0;
+
+  main_loop_worker_thread_start(NULL);
+  pipe->producer_thread = g_thread_self();
+
+  for (gint round = 0; round < PRODUCER_ROUNDS; round++)
+    {
+      /* parks the messages of the source until it is resolved */
+      _post_message_from_port(source, seq++, SLOW_DNS_PORT);
+      for (gint i = 1; i < PRODUCER_MSGS_PER_ROUND; i++)
+        {
+          _post_message_from_port(source, seq++, 514);
+          g_usleep(200);
+        }
+    }
+
+  main_loop_worker_thread_stop();
+  return NULL;
+}
+
+typedef struct _ReceiveWaiter
+{
+  struct iv_timer timer;
+  OrderedPipe *pipe;
+  gint expected;
+  gint remaining_checks;
+} ReceiveWaiter;
+
+static void
+_check_received(gpointer s)
+{
+  ReceiveWaiter *waiter = (ReceiveWaiter *) s;
+
+  if (ordered_pipe_get_received(waiter->pipe) == waiter->expected || --waiter->remaining_checks == 0)
+    {
+      iv_quit();
+      return;
+    }
+
+  iv_validate_now();
+  waiter->timer.expires = iv_now;
+  timespec_add_msec(&waiter->timer.expires, 10);
+  iv_timer_register(&waiter->timer);
+}
+
+/* runs the main loop, so that the resolved messages are handed to I/O workers */
+static void
+_run_main_loop_until_received(OrderedPipe *pipe, gint expected)
+{
+  ReceiveWaiter waiter = { .pipe = pipe, .expected = expected, .remaining_checks = 500 };
+
+  IV_TIMER_INIT(&waiter.timer);
+  waiter.timer.cookie = &waiter;
+  waiter.timer.handler = _check_received;
+  iv_validate_now();
+  waiter.timer.expires = iv_now;
+  iv_timer_register(&waiter.timer);
+
+  iv_main();
+}
+
+Test(log_source, test_messages_parked_for_dns_resolution_keep_their_order)
+{
+  MainLoopOptions main_loop_options = {0};
+  MainLoop *main_loop = main_loop_get_instance();
+  OrderedPipe *pipe = ordered_pipe_new();
+  gint expected = PRODUCER_ROUNDS * PRODUCER_MSGS_PER_ROUND;
+
+  main_loop_init(main_loop, &main_loop_options);
+  dns_resolver_set_threads(2);
+
+  source_options.init_window_size = 10000;
+  LogSource *source = test_source_init(&source_options);
+  log_pipe_append(&source->super, &pipe->super);
+
+  GThread *producer = g_thread_create(_producer_thread, source, TRUE, NULL);
+  _run_main_loop_until_received(pipe, expected);
+  g_thread_join(producer);
+  main_loop_sync_worker_startup_and_teardown();
+
+  cr_assert_eq(ordered_pipe_get_received(pipe), expected);
+  cr_assert_eq(pipe->out_of_order, 0, "%d messages were reordered", pipe->out_of_order);
+
+  test_source_destroy(source);
+  main_loop_deinit(main_loop);
+  ordered_pipe_free(pipe);
+}
+
+Test(log_source, test_parked_messages_are_dropped_when_the_source_is_deinitialized)
+{
+  OrderedPipe *pipe = ordered_pipe_new();
+
+  dns_resolver_set_threads(1);
+
+  source_options.init_window_size = 2;
+  LogSource *source = test_source_init(&source_options);
+  log_pipe_append(&source->super, &pipe->super);
+
+  /* the main loop is not running, so the parked messages are never resumed */
+  _post_message_from_port(source, 0, SLOW_DNS_PORT);
+  _post_message_from_port(source, 1, 514);
+  cr_assert_not(log_source_free_to_send(source));
+
+  log_pipe_deinit(&source->super);
+  cr_assert_eq(ordered_pipe_get_received(pipe), 0);
+  cr_assert(log_source_free_to_send(source), "dropped messages should give back their window");
+
+  log_pipe_unref(&source->super);
+  dns_resolver_stop();
+  ordered_pipe_free(pipe);
+}
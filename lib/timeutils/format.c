@@ -25,7 +25,50 @@
 #include "timeutils/cache.h"
 #include "timeutils/names.h"
 #include "timeutils/conv.h"
+#include "timeutils/misc.h"
+#include "stats/stats-registry.h"
 #include "str-format.h"
+#include "apphook.h"
+#include "tls-support.h"
+
+#include <string.h>
+
+/*
+ * Most messages processed within a second share the part of their
+ * formatted timestamp that does not depend on the fraction of the second,
+ * so it is cached in a small per-thread table keyed by (second, zone
+ * offset, format).  The fractional digits are formatted for each call and
+ * are inserted between the cached prefix and the zone suffix, so the
+ * number of frac digits does not need to be part of the key.
+ */
+#define FORMAT_CACHE_SIZE 16
+#define FORMAT_CACHE_STATS_BATCH 1024
+
+typedef struct _FormatCacheEntry
+{
+  gint64 sec;
+  glong gmtoff;
+  gint ts_format;
+  guint8 prefix_len;
+  guint8 suffix_len;
+  gchar prefix[32];
+  gchar suffix[8];
+} FormatCacheEntry;
+
+TLS_BLOCK_START
+{
+  FormatCacheEntry format_cache[FORMAT_CACHE_SIZE];
+  gint format_cache_hits;
+  gint format_cache_misses;
+}
+TLS_BLOCK_END;
+
+#define format_cache __tls_deref(format_cache)
+#define format_cache_hits __tls_deref(format_cache_hits)
+#define format_cache_misses __tls_deref(format_cache_misses)
+
+static StatsCounterItem *count_format_cache_hits;
+static StatsCounterItem *count_format_cache_misses;
 
 static void
 _append_frac_digits(glong usecs, GString *target, gint frac_digits)
@@ -55,11 +98,155 @@ append_format_zone_info(GString *target, glong gmtoff)
   format_uint32_padded(target, 2, '0', 10, ((gmtoff < 0 ? -gmtoff : gmtoff) % 3600) / 60);
 }
 
-void
-append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+/* everything up to and including the seconds */
+static void
+_append_format_wall_clock_time_seconds(const WallClockTime *wct, GString *target, gint ts_format)
+{
+  switch (ts_format)
+    {
+    case TS_FMT_BSD:
+      g_string_append_len(target, month_names_abbrev[wct->wct_mon], MONTH_NAME_ABBREV_LEN);
+      g_string_append_c(target, ' ');
+      format_uint32_padded(target, 2, ' ', 10, wct->wct_mday);
+      g_string_append_c(target, ' ');
+      break;
+    case TS_FMT_ISO:
+      format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
+      g_string_append_c(target, '-');
+      format_uint32_padded(target, 2, '0', 10, wct->wct_mon + 1);
+      g_string_append_c(target, '-');
+      format_uint32_padded(target, 2, '0', 10, wct->wct_mday);
+      g_string_append_c(target, 'T');
+      break;
+    case TS_FMT_FULL:
+      format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
+      g_string_append_c(target, ' ');
+      g_string_append_len(target, month_names_abbrev[wct->wct_mon], MONTH_NAME_ABBREV_LEN);
+      g_string_append_c(target, ' ');
+      format_uint32_padded(target, 2, ' ', 10, wct->wct_mday);
+      g_string_append_c(target, ' ');
+      break;
+    default:
+      g_assert_not_reached();
+      break;
+    }
+  format_uint32_padded(target, 2, '0', 10, wct->wct_hour);
+  g_string_append_c(target, ':');
+  format_uint32_padded(target, 2, '0', 10, wct->wct_min);
+  g_string_append_c(target, ':');
+  format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
+}
+
+/* whatever follows the fraction of the second */
+static void
+_append_format_wall_clock_time_suffix(const WallClockTime *wct, GString *target, gint ts_format)
+{
+  if (ts_format == TS_FMT_ISO)
+    append_format_zone_info(target, wct->wct_gmtoff);
+}
+
+/* same order as convert_unix_time_to_wall_clock_time_with_tz_override() */
+static glong
+_resolve_gmtoff(const UnixTime *ut, glong zone_offset)
+{
+  if (zone_offset != -1)
+    return zone_offset;
+  if (ut->ut_gmtoff != -1)
+    return ut->ut_gmtoff;
+  return get_local_timezone_ofs(ut->ut_sec);
+}
+
+static void
+_format_cache_flush_stats(void)
+{
+  stats_counter_add(count_format_cache_hits, format_cache_hits);
+  stats_counter_add(count_format_cache_misses, format_cache_misses);
+  format_cache_hits = 0;
+  format_cache_misses = 0;
+}
+
+static void
+_format_cache_account(gboolean hit)
+{
+  if (hit)
+    format_cache_hits++;
+  else
+    format_cache_misses++;
+
+  if (format_cache_hits + format_cache_misses >= FORMAT_CACHE_STATS_BATCH)
+    _format_cache_flush_stats();
+}
+
+static FormatCacheEntry *
+_format_cache_lookup(gint64 sec, glong gmtoff, gint ts_format)
+{
+  guint index = ((guint) sec ^ ((guint) gmtoff / 900) ^ ((guint) ts_format << 2)) % FORMAT_CACHE_SIZE;
+
+  return &format_cache[index];
+}
+
+static gboolean
+_format_cache_entry_matches(const FormatCacheEntry *entry, gint64 sec, glong gmtoff, gint ts_format)
+{
+  return entry->prefix_len > 0 && entry->sec == sec && entry->gmtoff == gmtoff && entry->ts_format == ts_format;
+}
+
+static void
+_format_cache_entry_store(FormatCacheEntry *entry, const gchar *prefix, gsize prefix_len,
+                          const gchar *suffix, gsize suffix_len)
 {
+  /* oversized values (e.g. years beyond 9999) are not cached */
+  if (prefix_len >= sizeof(entry->prefix) || suffix_len >= sizeof(entry->suffix))
+    {
+      entry->prefix_len = 0;
+      return;
+    }
+  memcpy(entry->prefix, prefix, prefix_len);
+  entry->prefix_len = prefix_len;
+  memcpy(entry->suffix, suffix, suffix_len);
+  entry->suffix_len = suffix_len;
+}
+
+static void
+_append_format_unix_time_cached(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset,
+                                gint frac_digits)
+{
+  glong gmtoff = _resolve_gmtoff(ut, zone_offset);
+  FormatCacheEntry *entry = _format_cache_lookup(ut->ut_sec, gmtoff, ts_format);
+
+  if (_format_cache_entry_matches(entry, ut->ut_sec, gmtoff, ts_format))
+    {
+      _format_cache_account(TRUE);
+      g_string_append_len(target, entry->prefix, entry->prefix_len);
+      _append_frac_digits(ut->ut_usec, target, frac_digits);
+      g_string_append_len(target, entry->suffix, entry->suffix_len);
+      return;
+    }
+
+  _format_cache_account(FALSE);
+
   WallClockTime wct = WALL_CLOCK_TIME_INIT;
+  convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, gmtoff);
+
+  gsize prefix_start = target->len;
+  _append_format_wall_clock_time_seconds(&wct, target, ts_format);
+  gsize prefix_len = target->len - prefix_start;
+
+  _append_frac_digits(ut->ut_usec, target, frac_digits);
+
+  gsize suffix_start = target->len;
+  _append_format_wall_clock_time_suffix(&wct, target, ts_format);
+
+  entry->sec = ut->ut_sec;
+  entry->gmtoff = gmtoff;
+  entry->ts_format = ts_format;
+  _format_cache_entry_store(entry, target->str + prefix_start, prefix_len,
+                            target->str + suffix_start, target->len - suffix_start);
+}
 
+void
+append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
   if (ts_format == TS_FMT_UNIX)
     {
       format_uint32_padded(target, 0, 0, 10, (int) ut->ut_sec);
@@ -67,8 +254,7 @@ append_format_unix_time(const UnixTime *ut, GString *target, gint ts_format, glo
     }
   else
     {
-      convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, zone_offset);
-      append_format_wall_clock_time(&wct, target, ts_format, frac_digits);
+      _append_format_unix_time_cached(ut, target, ts_format, zone_offset, frac_digits);
     }
 }
 
@@ -94,57 +280,60 @@ append_format_wall_clock_time(const WallClockTime *wct, GString *target, gint ts
 {
   UnixTime ut = UNIX_TIME_INIT;
 
-  switch (ts_format)
+  if (ts_format == TS_FMT_UNIX)
     {
-    case TS_FMT_BSD:
-      g_string_append_len(target, month_names_abbrev[wct->wct_mon], MONTH_NAME_ABBREV_LEN);
-      g_string_append_c(target, ' ');
-      format_uint32_padded(target, 2, ' ', 10, wct->wct_mday);
-      g_string_append_c(target, ' ');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_hour);
-      g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_min);
-      g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
-      break;
-    case TS_FMT_ISO:
-      format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
-      g_string_append_c(target, '-');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_mon + 1);
-      g_string_append_c(target, '-');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_mday);
-      g_string_append_c(target, 'T');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_hour);
-      g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_min);
-      g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
-      append_format_zone_info(target, wct->wct_gmtoff);
-      break;
-    case TS_FMT_FULL:
-      format_uint32_padded(target, 0, 0, 10, wct->wct_year + 1900);
-      g_string_append_c(target, ' ');
-      g_string_append_len(target, month_names_abbrev[wct->wct_mon], MONTH_NAME_ABBREV_LEN);
-      g_string_append_c(target, ' ');
-      format_uint32_padded(target, 2, ' ', 10, wct->wct_mday);
-      g_string_append_c(target, ' ');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_hour);
-      g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_min);
-      g_string_append_c(target, ':');
-      format_uint32_padded(target, 2, '0', 10, wct->wct_sec);
-
-      _append_frac_digits(wct->wct_usec, target, frac_digits);
-      break;
-    case TS_FMT_UNIX:
       convert_wall_clock_time_to_unix_time(wct, &ut);
       append_format_unix_time(&ut, target, TS_FMT_UNIX, wct->wct_gmtoff, frac_digits);
-      break;
-    default:
-      g_assert_not_reached();
-      break;
+      return;
     }
+
+  _append_format_wall_clock_time_seconds(wct, target, ts_format);
+  _append_frac_digits(wct->wct_usec, target, frac_digits);
+  _append_format_wall_clock_time_suffix(wct, target, ts_format);
+}
+
+static void
+_reinit_cache_counter(const gchar *name, StatsCounterItem **counter)
+{
+  StatsClusterKey sc_key;
+
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, name, NULL);
+  if (!stats_check_level(1))
+    stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, counter);
+  else if (!*counter)
+    stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, counter);
+}
+
+/*
+ * NOTE: called whenever a configuration is initialized, so that the
+ * stats-level() of the new configuration applies.  Worker threads are
+ * stopped at that point, so they don't flush into a counter that is being
+ * unregistered.
+ */
+static void
+format_unix_time_reinit_stats(void)
+{
+  stats_lock();
+  _reinit_cache_counter("timestamp_format_cache_hits", &count_format_cache_hits);
+  _reinit_cache_counter("timestamp_format_cache_misses", &count_format_cache_misses);
+  stats_unlock();
+}
+
+void
+format_unix_time_global_init(void)
+{
+  register_application_hook(AH_CONFIG_CHANGED, (ApplicationHookFunc) format_unix_time_reinit_stats, NULL);
+}
+
+void
+format_unix_time_global_deinit(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "timestamp_format_cache_hits", NULL);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &count_format_cache_hits);
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "timestamp_format_cache_misses", NULL);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &count_format_cache_misses);
+  stats_unlock();
 }
@@ -43,4 +43,7 @@ void append_format_wall_clock_time(const WallClockTime *stamp, GString *target,
                                    gint ts_format, gint frac_digits);
 void append_format_zone_info(GString *target, glong gmtoff);
 
+void format_unix_time_global_init(void);
+void format_unix_time_global_deinit(void);
+
 #endif
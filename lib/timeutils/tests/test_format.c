@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "timeutils/format.h"
+#include "timeutils/conv.h"
+#include <criterion/criterion.h>
+#include <criterion/parameterized.h>
+
+static void
+_format_uncached(const UnixTime *ut, GString *target, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  WallClockTime wct = WALL_CLOCK_TIME_INIT;
+
+  g_string_truncate(target, 0);
+  convert_unix_time_to_wall_clock_time_with_tz_override(ut, &wct, zone_offset);
+  append_format_wall_clock_time(&wct, target, ts_format, frac_digits);
+}
+
+static void
+_assert_cached_format_matches(const UnixTime *ut, gint ts_format, glong zone_offset, gint frac_digits)
+{
+  GString *cached = g_string_new("");
+  GString *uncached = g_string_new("");
+
+  format_unix_time(ut, cached, ts_format, zone_offset, frac_digits);
+  _format_uncached(ut, uncached, ts_format, zone_offset, frac_digits);
+  cr_assert_str_eq(cached->str, uncached->str,
+                   "cached timestamp mismatch, ts_format=%d, zone_offset=%ld, frac_digits=%d",
+                   ts_format, zone_offset, frac_digits);
+
+  g_string_free(cached, TRUE);
+  g_string_free(uncached, TRUE);
+}
+
+ParameterizedTestParameters(format, cached_format_matches_uncached)
+{
+  static gint ts_formats[] = { TS_FMT_BSD, TS_FMT_ISO, TS_FMT_FULL, TS_FMT_UNIX };
+
+  return cr_make_param_array(gint, ts_formats, G_N_ELEMENTS(ts_formats));
+}
+
+ParameterizedTest(gint *ts_format, format, cached_format_matches_uncached)
+{
+  glong zone_offsets[] = { -1, 0, 3600, -5 * 3600 - 1800 };
+
+  /* repeated calls within the same second hit the cache with varying
+   * fractions, nearby seconds may land in the same slot */
+  for (gint sec = 0; sec < 40; sec++)
+    for (gint usec = 0; usec < 1000000; usec += 123456)
+      for (guint tz = 0; tz < G_N_ELEMENTS(zone_offsets); tz++)
+        for (gint frac_digits = 0; frac_digits <= 6; frac_digits++)
+          {
+            UnixTime ut = { .ut_sec = 1547920728 + sec, .ut_usec = usec, .ut_gmtoff = 7200 };
+
+            _assert_cached_format_matches(&ut, *ts_format, zone_offsets[tz], frac_digits);
+          }
+}
+
+Test(format, cached_iso_timestamp_carries_the_zone_after_the_fraction)
+{
+  UnixTime ut = { .ut_sec = 1547920728, .ut_usec = 123456, .ut_gmtoff = 3600 };
+  GString *result = g_string_new("");
+
+  format_unix_time(&ut, result, TS_FMT_ISO, -1, 3);
+  cr_assert_str_eq(result->str, "2019-01-19T18:58:48.123+01:00");
+
+  ut.ut_usec = 654321;
+  format_unix_time(&ut, result, TS_FMT_ISO, -1, 6);
+  cr_assert_str_eq(result->str, "2019-01-19T18:58:48.654321+01:00");
+
+  format_unix_time(&ut, result, TS_FMT_ISO, 0, 0);
+  cr_assert_str_eq(result->str, "2019-01-19T17:58:48+00:00");
+
+  format_unix_time(&ut, result, TS_FMT_BSD, -1, 1);
+  cr_assert_str_eq(result->str, "Jan 19 18:58:48.6");
+
+  g_string_free(result, TRUE);
+}
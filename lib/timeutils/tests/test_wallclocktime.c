@@ -164,6 +164,57 @@ Test(wallclocktime, guess_year_returns_next_year)
     cr_assert(_guessed_year_is_current_year(&wct, mon));
 }
 
+static void
+_assert_compiled_format_parses_like_strptime(const gchar *format, const gchar *input)
+{
+  WallClockTime expected = WALL_CLOCK_TIME_INIT;
+  WallClockTime wct = WALL_CLOCK_TIME_INIT;
+  WallClockTimeFormat *compiled = wall_clock_time_format_new(format);
+
+  cr_assert(compiled, "format is expected to compile: %s", format);
+
+  gchar *expected_end = wall_clock_time_strptime(&expected, format, input);
+  gchar *end = wall_clock_time_format_parse(compiled, &wct, input);
+  cr_assert(end == expected_end, "format: %s, input: %s", format, input);
+
+  if (expected_end)
+    {
+      cr_expect(wct.wct_year == expected.wct_year);
+      cr_expect(wct.wct_mon == expected.wct_mon);
+      cr_expect(wct.wct_mday == expected.wct_mday);
+      cr_expect(wct.wct_wday == expected.wct_wday);
+      cr_expect(wct.wct_yday == expected.wct_yday);
+      cr_expect(wct.wct_hour == expected.wct_hour);
+      cr_expect(wct.wct_min == expected.wct_min);
+      cr_expect(wct.wct_sec == expected.wct_sec);
+      cr_expect(wct.wct_usec == expected.wct_usec);
+      cr_expect(wct.wct_gmtoff == expected.wct_gmtoff);
+    }
+  wall_clock_time_format_free(compiled);
+}
+
+Test(wallclocktime, compiled_format_parses_like_strptime)
+{
+  _assert_compiled_format_parses_like_strptime("%FT%T%z", "2019-01-16T18:23:12+01:00");
+  _assert_compiled_format_parses_like_strptime("%FT%T.%f%z", "2019-01-16T18:23:12.012Z");
+  _assert_compiled_format_parses_like_strptime("%FT%T%z", "2019-01-16 18:23:12+01:00");
+  _assert_compiled_format_parses_like_strptime("%b %d %H:%M:%S", "Jan 16 18:23:12");
+  _assert_compiled_format_parses_like_strptime("%b %d %H:%M:%S", "JUNE  6 18:23:12");
+  _assert_compiled_format_parses_like_strptime("%b %d %H:%M:%S", "Jux 16 18:23:12");
+  _assert_compiled_format_parses_like_strptime("%a, %d %b %Y %T %z", "Wed, 16 Jan 2019 18:23:12 PST");
+  _assert_compiled_format_parses_like_strptime("%A %B %e %Y %r", "Wednesday January 16 2019 06:23:12 PM");
+  _assert_compiled_format_parses_like_strptime("%j %Y", "016 2019");
+  _assert_compiled_format_parses_like_strptime("%U %Y %w", "02 2019 3");
+  _assert_compiled_format_parses_like_strptime("%D %%", "01/16/19 %");
+}
+
+Test(wallclocktime, alternative_modifiers_are_not_compiled)
+{
+  cr_assert_null(wall_clock_time_format_new("%EY-%m-%d"));
+  cr_assert_null(wall_clock_time_format_new("%H:%OM"));
+  cr_assert_null(wall_clock_time_format_new("%H:%M%"));
+}
+
 static void
 setup(void)
 {
@@ -215,9 +215,27 @@ static const _TimeLocale _DefaultTimeLocale =
 #define _TIME_LOCALE(loc) \
   (&_DefaultTimeLocale)
 
+/* the lowercase abbreviated names packed into an integer, see find_name() */
+#define NAME_KEY(a, b, c) (((guint32) (a) << 16) | ((guint32) (b) << 8) | (guint32) (c))
+
+static const guint32 day_name_keys[7] =
+{
+  NAME_KEY('s', 'u', 'n'), NAME_KEY('m', 'o', 'n'), NAME_KEY('t', 'u', 'e'), NAME_KEY('w', 'e', 'd'),
+  NAME_KEY('t', 'h', 'u'), NAME_KEY('f', 'r', 'i'), NAME_KEY('s', 'a', 't'),
+};
+
+static const guint32 month_name_keys[12] =
+{
+  NAME_KEY('j', 'a', 'n'), NAME_KEY('f', 'e', 'b'), NAME_KEY('m', 'a', 'r'), NAME_KEY('a', 'p', 'r'),
+  NAME_KEY('m', 'a', 'y'), NAME_KEY('j', 'u', 'n'), NAME_KEY('j', 'u', 'l'), NAME_KEY('a', 'u', 'g'),
+  NAME_KEY('s', 'e', 'p'), NAME_KEY('o', 'c', 't'), NAME_KEY('n', 'o', 'v'), NAME_KEY('d', 'e', 'c'),
+};
+
 static const unsigned char *conv_num(const unsigned char *, int *, unsigned int, unsigned int);
 static const unsigned char *find_string(const unsigned char *, int *, const char *const *,
                                         const char *const *, int);
+static const unsigned char *find_name(const unsigned char *, int *, const char *const *,
+                                      const char *const *, const guint32 *, int);
 static int first_wday_of(int yr);
 
 
@@ -269,14 +287,510 @@ static const int start_of_month[2][13] =
   { 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335, 366 }
 };
 
+typedef struct
+{
+  int state;
+  int split_year;
+  int day_offset;
+  int week_offset;
+} StrptimeState;
+
+#define STRPTIME_STATE_INIT { .state = 0, .split_year = 0, .day_offset = -1, .week_offset = 0 }
+
+/*
+ * Parse a single "elementary" conversion (e.g. %Y or %z) at @bp.  This is
+ * shared by wall_clock_time_strptime() and the compiled
+ * WallClockTimeFormat programs, returns NULL if the input does not match.
+ */
+static const unsigned char *
+_parse_conversion(unsigned char c, const unsigned char *bp, WallClockTime *wct, StrptimeState *st)
+{
+  const unsigned char *ep;
+  int i = 0, neg = 0, offs;
+
+  switch (c)
+    {
+    case 'A': /* The day of week, using the locale's form. */
+    case 'a':
+      bp = find_name(bp, &wct->tm.tm_wday,
+                     _TIME_LOCALE(loc)->day, _TIME_LOCALE(loc)->abday, day_name_keys, 7);
+      st->state |= S_WDAY;
+      return bp;
+
+    case 'B': /* The month, using the locale's form. */
+    case 'b':
+    case 'h':
+      bp = find_name(bp, &wct->tm.tm_mon,
+                     _TIME_LOCALE(loc)->mon, _TIME_LOCALE(loc)->abmon, month_name_keys, 12);
+      st->state |= S_MON;
+      return bp;
+
+    case 'C': /* The century number. */
+      i = 20;
+      bp = conv_num(bp, &i, 0, 99);
+
+      i = i * 100 - TM_YEAR_BASE;
+      if (st->split_year)
+        i += wct->tm.tm_year % 100;
+      st->split_year = 1;
+      wct->tm.tm_year = i;
+      st->state |= S_YEAR;
+      return bp;
+
+    case 'd': /* The day of month. */
+    case 'e':
+      bp = conv_num(bp, &wct->tm.tm_mday, 1, 31);
+      st->state |= S_MDAY;
+      return bp;
+
+    case 'f':
+    {
+      const unsigned char *end = conv_num(bp, &wct->wct_usec, 0, 999999);
+      int digits;
+
+      if (!end)
+        return NULL;
+      digits = end - bp;
+
+      /*
+       * We have read up to 6 digits, but if the message has
+       * sub-microsecond precision, eat-up the digits we cannot handle.
+       */
+      while (isdigit(*end))
+        {
+          end++;
+        }
+
+      /*
+       * If we read less than 6 digits, we need to adjust the value:
+       * "012" was parsed as 12 but is 12000 us.
+       */
+      while (digits++ < 6)
+        {
+          wct->wct_usec *= 10;
+        }
+
+      st->state |= S_USEC;
+      return end;
+    }
+
+    case 'k': /* The hour (24-hour clock representation). */
+    case 'H':
+      bp = conv_num(bp, &wct->tm.tm_hour, 0, 23);
+      st->state |= S_HOUR;
+      return bp;
+
+    case 'l': /* The hour (12-hour clock representation). */
+    case 'I':
+      bp = conv_num(bp, &wct->tm.tm_hour, 1, 12);
+      if (wct->tm.tm_hour == 12)
+        wct->tm.tm_hour = 0;
+      st->state |= S_HOUR;
+      return bp;
+
+    case 'j': /* The day of year. */
+      i = 1;
+      bp = conv_num(bp, &i, 1, 366);
+      wct->tm.tm_yday = i - 1;
+      st->state |= S_YDAY;
+      return bp;
+
+    case 'M': /* The minute. */
+      return conv_num(bp, &wct->tm.tm_min, 0, 59);
+
+    case 'm': /* The month. */
+      i = 1;
+      bp = conv_num(bp, &i, 1, 12);
+      wct->tm.tm_mon = i - 1;
+      st->state |= S_MON;
+      return bp;
+
+    case 'p': /* The locale's equivalent of AM/PM. */
+      bp = find_string(bp, &i, _TIME_LOCALE(loc)->am_pm,
+                       NULL, 2);
+      if (HAVE_HOUR(st->state) && wct->tm.tm_hour > 11)
+        return NULL;
+      wct->tm.tm_hour += i * 12;
+      return bp;
+
+    case 'S': /* The seconds. */
+      return conv_num(bp, &wct->tm.tm_sec, 0, 61);
+
+#ifndef TIME_MAX
+#define TIME_MAX  INT64_MAX
+#endif
+    case 's': /* seconds since the epoch */
+    {
+      time_t sse = 0;
+      uint64_t rulim = TIME_MAX;
+
+      if (*bp < '0' || *bp > '9')
+        return NULL;
+
+      do
+        {
+          sse *= 10;
+          sse += *bp++ - '0';
+          rulim /= 10;
+        }
+      while ((sse * 10 <= TIME_MAX) &&
+             rulim && *bp >= '0' && *bp <= '9');
+
+      if (sse < 0 || (uint64_t)sse > TIME_MAX)
+        return NULL;
+
+      cached_localtime(&sse, &wct->tm);
+      st->state |= S_YDAY | S_WDAY |
+                   S_MON | S_MDAY | S_YEAR;
+      return bp;
+    }
+
+    case 'U': /* The week of year, beginning on sunday. */
+    case 'W': /* The week of year, beginning on monday. */
+      /*
+       * XXX This is bogus, as we can not assume any valid
+       * information present in the tm structure at this
+       * point to calculate a real value, so just check the
+       * range for now.
+       */
+      bp = conv_num(bp, &i, 0, 53);
+      if (c == 'U')
+        st->day_offset = TM_SUNDAY;
+      else
+        st->day_offset = TM_MONDAY;
+      st->week_offset = i;
+      return bp;
+
+    case 'w': /* The day of week, beginning on sunday. */
+      bp = conv_num(bp, &wct->tm.tm_wday, 0, 6);
+      st->state |= S_WDAY;
+      return bp;
+
+    case 'u': /* The day of week, monday = 1. */
+      bp = conv_num(bp, &i, 1, 7);
+      wct->tm.tm_wday = i % 7;
+      st->state |= S_WDAY;
+      return bp;
+
+    case 'g': /* The year corresponding to the ISO week
+     * number but without the century.
+     */
+      return conv_num(bp, &i, 0, 99);
+
+    case 'G': /* The year corresponding to the ISO week
+     * number with century.
+     */
+      do
+        bp++;
+      while (isdigit(*bp));
+      return bp;
+
+    case 'V': /* The ISO 8601:1988 week number as decimal */
+      return conv_num(bp, &i, 0, 53);
+
+    case 'Y': /* The year. */
+      i = TM_YEAR_BASE; /* just for data sanity... */
+      bp = conv_num(bp, &i, 0, 9999);
+      wct->tm.tm_year = i - TM_YEAR_BASE;
+      st->state |= S_YEAR;
+      return bp;
+
+    case 'y': /* The year within 100 years of the epoch. */
+      bp = conv_num(bp, &i, 0, 99);
+
+      if (st->split_year)
+        /* preserve century */
+        i += (wct->tm.tm_year / 100) * 100;
+      else
+        {
+          st->split_year = 1;
+          if (i <= 68)
+            i = i + 2000 - TM_YEAR_BASE;
+          else
+            i = i + 1900 - TM_YEAR_BASE;
+        }
+      wct->tm.tm_year = i;
+      st->state |= S_YEAR;
+      return bp;
+
+    case 'Z':
+      if (strncmp((const char *)bp, gmt, 3) == 0 ||
+          strncmp((const char *)bp, utc, 3) == 0)
+        {
+          wct->tm.tm_isdst = 0;
+          wct->wct_gmtoff = 0;
+          wct->wct_zone = gmt;
+          bp += 3;
+        }
+      else
+        {
+          ep = find_string(bp, &i, (const char *const *)tzname, NULL, 2);
+          if (ep != NULL)
+            {
+              wct->tm.tm_isdst = i;
+#ifdef SYSLOG_NG_HAVE_TIMEZONE
+              wct->wct_gmtoff = -(timezone);
+#endif
+              wct->wct_zone = tzname[i];
+            }
+          bp = ep;
+        }
+      return bp;
+
+    case 'z':
+      /*
+       * We recognize all ISO 8601 formats:
+       * Z  = Zulu time/UTC
+       * [+-]hhmm
+       * [+-]hh:mm
+       * [+-]hh
+       * We recognize all RFC-822/RFC-2822 formats:
+       * UT|GMT
+       *          North American : UTC offsets
+       * E[DS]T = Eastern : -4 | -5
+       * C[DS]T = Central : -5 | -6
+       * M[DS]T = Mountain: -6 | -7
+       * P[DS]T = Pacific : -7 | -8
+       *          Military
+       * [A-IL-M] = -1 ... -9 (J not used)
+       * [N-Y]  = +1 ... +12
+       */
+      while (isspace(*bp))
+        bp++;
+
+      switch (*bp++)
+        {
+        case 'G':
+          if (*bp++ != 'M')
+            return NULL;
+        /*FALLTHROUGH*/
+        case 'U':
+          if (*bp++ != 'T')
+            return NULL;
+        /*FALLTHROUGH*/
+        case 'Z':
+          wct->tm.tm_isdst = 0;
+          wct->wct_gmtoff = 0;
+          wct->wct_zone = utc;
+          return bp;
+        case '+':
+          neg = 0;
+          break;
+        case '-':
+          neg = 1;
+          break;
+        default:
+          --bp;
+          ep = find_string(bp, &i, nast, NULL, 4);
+          if (ep != NULL)
+            {
+              wct->wct_gmtoff = (-5 - i) * 3600;
+              wct->wct_zone = __UNCONST(nast[i]);
+              return ep;
+            }
+          ep = find_string(bp, &i, nadt, NULL, 4);
+          if (ep != NULL)
+            {
+              wct->tm.tm_isdst = 1;
+              wct->wct_gmtoff = (-4 - i) * 3600;
+              wct->wct_zone = __UNCONST(nadt[i]);
+              return ep;
+            }
+
+          if ((*bp >= 'A' && *bp <= 'I') ||
+              (*bp >= 'L' && *bp <= 'Y'))
+            {
+              /* Argh! No 'J'! */
+              if (*bp >= 'A' && *bp <= 'I')
+                wct->wct_gmtoff =
+                  (('A' - 1) - (int)*bp) * 3600;
+              else if (*bp >= 'L' && *bp <= 'M')
+                wct->wct_gmtoff = ('A' - (int)*bp) * 3600;
+              else if (*bp >= 'N' && *bp <= 'Y')
+                wct->wct_gmtoff = ((int)*bp - 'M') * 3600;
+              wct->wct_zone = utc; /* XXX */
+              bp++;
+              return bp;
+            }
+          return NULL;
+        }
+      offs = 0;
+      for (i = 0; i < 4; )
+        {
+          if (isdigit(*bp))
+            {
+              offs = offs * 10 + (*bp++ - '0');
+              i++;
+              continue;
+            }
+          if (i == 2 && *bp == ':')
+            {
+              bp++;
+              continue;
+            }
+          break;
+        }
+      switch (i)
+        {
+        case 2:
+          offs *= 100;
+          break;
+        case 4:
+          i = offs % 100;
+          if (i >= 60)
+            return NULL;
+          /* Convert minutes into decimal */
+          offs = (offs / 100) * 100 + (i * 50) / 30;
+          break;
+        default:
+          return NULL;
+        }
+      if (neg)
+        offs = -offs;
+      wct->tm.tm_isdst = 0; /* XXX */
+      wct->wct_gmtoff = (offs * 3600) / 100;
+      wct->wct_zone = utc; /* XXX */
+      return bp;
+
+    /*
+     * Miscellaneous conversions.
+     */
+    case 'n': /* Any kind of white-space. */
+    case 't':
+      while (isspace(*bp))
+        bp++;
+      return bp;
+
+    default:  /* Unknown/unsupported conversion. */
+      return NULL;
+    }
+}
+
+/* the "alternative" modifiers (%E?, %O?) accepted by the conversion */
+static int
+_get_legal_alt_format(unsigned char c)
+{
+  switch (c)
+    {
+    case 'C':
+    case 'Y':
+      return ALT_E;
+    case 'd':
+    case 'e':
+    case 'H':
+    case 'I':
+    case 'M':
+    case 'm':
+    case 'S':
+    case 'U':
+    case 'W':
+    case 'w':
+    case 'u':
+      return ALT_O;
+    case 's':
+    case 'g':
+    case 'G':
+    case 'V':
+    case 'y':
+    case 'Z':
+    case 'z':
+      return ALT_E | ALT_O;
+    default:
+      return 0;
+    }
+}
+
+/* fill in the fields that can be derived from the ones parsed */
+static void
+_complete_wall_clock_time(WallClockTime *wct, StrptimeState *st)
+{
+  int i;
+
+  if (!HAVE_YDAY(st->state) && HAVE_YEAR(st->state))
+    {
+      if (HAVE_MON(st->state) && HAVE_MDAY(st->state))
+        {
+          /* calculate day of year (ordinal date) */
+          wct->tm.tm_yday =  start_of_month[isleap_sum(wct->tm.tm_year,
+                                                       TM_YEAR_BASE)][wct->tm.tm_mon] + (wct->tm.tm_mday - 1);
+          st->state |= S_YDAY;
+        }
+      else if (st->day_offset != -1)
+        {
+          /*
+           * Set the date to the first Sunday (or Monday)
+           * of the specified week of the year.
+           */
+          if (!HAVE_WDAY(st->state))
+            {
+              wct->tm.tm_wday = st->day_offset;
+              st->state |= S_WDAY;
+            }
+          wct->tm.tm_yday = (7 -
+                             first_wday_of(wct->tm.tm_year + TM_YEAR_BASE) +
+                             st->day_offset) % 7 + (st->week_offset - 1) * 7 +
+                            wct->tm.tm_wday  - st->day_offset;
+          st->state |= S_YDAY;
+        }
+    }
+
+  if (HAVE_YDAY(st->state) && HAVE_YEAR(st->state))
+    {
+      int isleap;
+
+      if (!HAVE_MON(st->state))
+        {
+          /* calculate month of day of year */
+          i = 0;
+          isleap = isleap_sum(wct->tm.tm_year, TM_YEAR_BASE);
+          while (wct->tm.tm_yday >= start_of_month[isleap][i])
+            i++;
+          if (i > 12)
+            {
+              i = 1;
+              wct->tm.tm_yday -= start_of_month[isleap][12];
+              wct->tm.tm_year++;
+            }
+          wct->tm.tm_mon = i - 1;
+          st->state |= S_MON;
+        }
+
+      if (!HAVE_MDAY(st->state))
+        {
+          /* calculate day of month */
+          isleap = isleap_sum(wct->tm.tm_year, TM_YEAR_BASE);
+          wct->tm.tm_mday = wct->tm.tm_yday -
+                            start_of_month[isleap][wct->tm.tm_mon] + 1;
+          st->state |= S_MDAY;
+        }
+
+      if (!HAVE_WDAY(st->state))
+        {
+          /* calculate day of week: step tm_yday + 1 days from the
+           * weekday of the first day, wrapping around after Saturday */
+          int wday = first_wday_of(wct->tm.tm_year);
+
+          if (wct->tm.tm_yday >= 0)
+            wday += wct->tm.tm_yday + 1;
+          wct->tm.tm_wday = wday >= 0 ? wday % 7 : wday;
+          st->state |= S_WDAY;
+        }
+    }
+
+  if (!HAVE_USEC(st->state))
+    {
+      wct->wct_usec = 0;
+    }
+}
+
 gchar *
 wall_clock_time_strptime(WallClockTime *wct, const gchar *format, const gchar *input)
 {
   unsigned char c;
-  const unsigned char *bp, *ep;
-  int alt_format, i, split_year = 0, neg = 0, state = 0,
-                     day_offset = -1, week_offset = 0, offs;
+  const unsigned char *bp;
+  int alt_format;
   const char *new_fmt;
+  StrptimeState st = STRPTIME_STATE_INIT;
 
   bp = (const unsigned char *)input;
 
@@ -284,7 +798,6 @@ wall_clock_time_strptime(WallClockTime *wct, const gchar *format, const gchar *i
     {
       /* Clear `alternate' modifier prior to new conversion. */
       alt_format = 0;
-      i = 0;
 
       /* Eat up white-space. */
       if (isspace(c))
@@ -327,19 +840,19 @@ literal:
          */
         case 'c': /* Date and time, using the locale's format. */
           new_fmt = _TIME_LOCALE(loc)->d_t_fmt;
-          state |= S_WDAY | S_MON | S_MDAY | S_YEAR;
+          st.state |= S_WDAY | S_MON | S_MDAY | S_YEAR;
           goto recurse;
 
         case 'D': /* The date as "%m/%d/%y". */
           new_fmt = "%m/%d/%y";
           LEGAL_ALT(0);
-          state |= S_MON | S_MDAY | S_YEAR;
+          st.state |= S_MON | S_MDAY | S_YEAR;
           goto recurse;
 
         case 'F': /* The date as "%Y-%m-%d". */
           new_fmt = "%Y-%m-%d";
           LEGAL_ALT(0);
-          state |= S_MON | S_MDAY | S_YEAR;
+          st.state |= S_MON | S_MDAY | S_YEAR;
           goto recurse;
 
         case 'R': /* The time as "%H:%M". */
@@ -363,7 +876,7 @@ literal:
 
         case 'x': /* The date, using the locale's format. */
           new_fmt = _TIME_LOCALE(loc)->d_fmt;
-          state |= S_MON | S_MDAY | S_YEAR;
+          st.state |= S_MON | S_MDAY | S_YEAR;
 recurse:
           bp = (const unsigned char *)wall_clock_time_strptime(wct, new_fmt, (const char *)bp);
           LEGAL_ALT(ALT_E);
@@ -372,474 +885,210 @@ recurse:
         /*
          * "Elementary" conversion rules.
          */
-        case 'A': /* The day of week, using the locale's form. */
-        case 'a':
-          bp = find_string(bp, &wct->tm.tm_wday,
-                           _TIME_LOCALE(loc)->day, _TIME_LOCALE(loc)->abday, 7);
-          LEGAL_ALT(0);
-          state |= S_WDAY;
-          continue;
-
-        case 'B': /* The month, using the locale's form. */
-        case 'b':
-        case 'h':
-          bp = find_string(bp, &wct->tm.tm_mon,
-                           _TIME_LOCALE(loc)->mon, _TIME_LOCALE(loc)->abmon,
-                           12);
-          LEGAL_ALT(0);
-          state |= S_MON;
-          continue;
-
-        case 'C': /* The century number. */
-          i = 20;
-          bp = conv_num(bp, &i, 0, 99);
-
-          i = i * 100 - TM_YEAR_BASE;
-          if (split_year)
-            i += wct->tm.tm_year % 100;
-          split_year = 1;
-          wct->tm.tm_year = i;
-          LEGAL_ALT(ALT_E);
-          state |= S_YEAR;
-          continue;
-
-        case 'd': /* The day of month. */
-        case 'e':
-          bp = conv_num(bp, &wct->tm.tm_mday, 1, 31);
-          LEGAL_ALT(ALT_O);
-          state |= S_MDAY;
-          continue;
-
-        case 'f':
-        {
-          const unsigned char *end = conv_num(bp, &wct->wct_usec, 0, 999999);
-          int digits = end - bp;
-
-          /*
-           * We have read up to 6 digits, but if the message has
-           * sub-microsecond precision, eat-up the digits we cannot handle.
-           */
-          while (isdigit(*end))
-            {
-              end++;
-            }
-
-          /*
-           * If we read less than 6 digits, we need to adjust the value:
-           * "012" was parsed as 12 but is 12000 us.
-           */
-          while (digits++ < 6)
-            {
-              wct->wct_usec *= 10;
-            }
-
-          bp = end;
-          LEGAL_ALT(0);
-          state |= S_USEC;
-          continue;
-        }
-
-        case 'k': /* The hour (24-hour clock representation). */
-          LEGAL_ALT(0);
-        /* FALLTHROUGH */
-        case 'H':
-          bp = conv_num(bp, &wct->tm.tm_hour, 0, 23);
-          LEGAL_ALT(ALT_O);
-          state |= S_HOUR;
-          continue;
-
-        case 'l': /* The hour (12-hour clock representation). */
-          LEGAL_ALT(0);
-        /* FALLTHROUGH */
-        case 'I':
-          bp = conv_num(bp, &wct->tm.tm_hour, 1, 12);
-          if (wct->tm.tm_hour == 12)
-            wct->tm.tm_hour = 0;
-          LEGAL_ALT(ALT_O);
-          state |= S_HOUR;
-          continue;
-
-        case 'j': /* The day of year. */
-          i = 1;
-          bp = conv_num(bp, &i, 1, 366);
-          wct->tm.tm_yday = i - 1;
-          LEGAL_ALT(0);
-          state |= S_YDAY;
-          continue;
-
-        case 'M': /* The minute. */
-          bp = conv_num(bp, &wct->tm.tm_min, 0, 59);
-          LEGAL_ALT(ALT_O);
-          continue;
-
-        case 'm': /* The month. */
-          i = 1;
-          bp = conv_num(bp, &i, 1, 12);
-          wct->tm.tm_mon = i - 1;
-          LEGAL_ALT(ALT_O);
-          state |= S_MON;
+        default:
+          bp = _parse_conversion(c, bp, wct, &st);
+          LEGAL_ALT(_get_legal_alt_format(c));
           continue;
-
-        case 'p': /* The locale's equivalent of AM/PM. */
-          bp = find_string(bp, &i, _TIME_LOCALE(loc)->am_pm,
-                           NULL, 2);
-          if (HAVE_HOUR(state) && wct->tm.tm_hour > 11)
-            return NULL;
-          wct->tm.tm_hour += i * 12;
-          LEGAL_ALT(0);
-          continue;
-
-        case 'S': /* The seconds. */
-          bp = conv_num(bp, &wct->tm.tm_sec, 0, 61);
-          LEGAL_ALT(ALT_O);
-          continue;
-
-#ifndef TIME_MAX
-#define TIME_MAX  INT64_MAX
-#endif
-        case 's': /* seconds since the epoch */
-        {
-          time_t sse = 0;
-          uint64_t rulim = TIME_MAX;
-
-          if (*bp < '0' || *bp > '9')
-            {
-              bp = NULL;
-              continue;
-            }
-
-          do
-            {
-              sse *= 10;
-              sse += *bp++ - '0';
-              rulim /= 10;
-            }
-          while ((sse * 10 <= TIME_MAX) &&
-                 rulim && *bp >= '0' && *bp <= '9');
-
-          if (sse < 0 || (uint64_t)sse > TIME_MAX)
-            {
-              bp = NULL;
-              continue;
-            }
-
-          cached_localtime(&sse, &wct->tm);
-          state |= S_YDAY | S_WDAY |
-                   S_MON | S_MDAY | S_YEAR;
         }
-        continue;
-
-        case 'U': /* The week of year, beginning on sunday. */
-        case 'W': /* The week of year, beginning on monday. */
-          /*
-           * XXX This is bogus, as we can not assume any valid
-           * information present in the tm structure at this
-           * point to calculate a real value, so just check the
-           * range for now.
-           */
-          bp = conv_num(bp, &i, 0, 53);
-          LEGAL_ALT(ALT_O);
-          if (c == 'U')
-            day_offset = TM_SUNDAY;
-          else
-            day_offset = TM_MONDAY;
-          week_offset = i;
-          continue;
-
-        case 'w': /* The day of week, beginning on sunday. */
-          bp = conv_num(bp, &wct->tm.tm_wday, 0, 6);
-          LEGAL_ALT(ALT_O);
-          state |= S_WDAY;
-          continue;
-
-        case 'u': /* The day of week, monday = 1. */
-          bp = conv_num(bp, &i, 1, 7);
-          wct->tm.tm_wday = i % 7;
-          LEGAL_ALT(ALT_O);
-          state |= S_WDAY;
-          continue;
+    }
 
-        case 'g': /* The year corresponding to the ISO week
-         * number but without the century.
-         */
-          bp = conv_num(bp, &i, 0, 99);
-          continue;
+  _complete_wall_clock_time(wct, &st);
+  return __UNCONST(bp);
+}
 
-        case 'G': /* The year corresponding to the ISO week
-         * number with century.
-         */
-          do
-            bp++;
-          while (isdigit(*bp));
-          continue;
+/*
+ * WallClockTimeFormat: a format string compiled into a list of
+ * operations, so that parsing a timestamp does not need to interpret the
+ * format (and expand %T, %F and friends) again.  The results are the same
+ * as with wall_clock_time_strptime().
+ */
+enum
+{
+  WCTF_OP_LITERAL,
+  WCTF_OP_SPACE,
+  WCTF_OP_CONVERSION,
+  WCTF_OP_SUBFORMAT,
+};
 
-        case 'V': /* The ISO 8601:1988 week number as decimal */
-          bp = conv_num(bp, &i, 0, 53);
-          continue;
+typedef struct _WallClockTimeFormatOp
+{
+  guint8 type;
+  unsigned char c;
+  gint state;
+  WallClockTimeFormat *subformat;
+} WallClockTimeFormatOp;
 
-        case 'Y': /* The year. */
-          i = TM_YEAR_BASE; /* just for data sanity... */
-          bp = conv_num(bp, &i, 0, 9999);
-          wct->tm.tm_year = i - TM_YEAR_BASE;
-          LEGAL_ALT(ALT_E);
-          state |= S_YEAR;
-          continue;
+struct _WallClockTimeFormat
+{
+  GArray *ops;
+};
 
-        case 'y': /* The year within 100 years of the epoch. */
-          /* LEGAL_ALT(ALT_E | ALT_O); */
-          bp = conv_num(bp, &i, 0, 99);
+static void
+_format_append_op(WallClockTimeFormat *self, guint8 type, unsigned char c, gint state, WallClockTimeFormat *subformat)
+{
+  WallClockTimeFormatOp op = { .type = type, .c = c, .state = state, .subformat = subformat };
 
-          if (split_year)
-            /* preserve century */
-            i += (wct->tm.tm_year / 100) * 100;
-          else
-            {
-              split_year = 1;
-              if (i <= 68)
-                i = i + 2000 - TM_YEAR_BASE;
-              else
-                i = i + 1900 - TM_YEAR_BASE;
-            }
-          wct->tm.tm_year = i;
-          state |= S_YEAR;
-          continue;
+  g_array_append_val(self->ops, op);
+}
 
-        case 'Z':
-          if (strncmp((const char *)bp, gmt, 3) == 0 ||
-              strncmp((const char *)bp, utc, 3) == 0)
-            {
-              wct->tm.tm_isdst = 0;
-              wct->wct_gmtoff = 0;
-              wct->wct_zone = gmt;
-              bp += 3;
-            }
-          else
-            {
-              ep = find_string(bp, &i, (const char *const *)tzname, NULL, 2);
-              if (ep != NULL)
-                {
-                  wct->tm.tm_isdst = i;
-#ifdef SYSLOG_NG_HAVE_TIMEZONE
-                  wct->wct_gmtoff = -(timezone);
-#endif
-                  wct->wct_zone = tzname[i];
-                }
-              bp = ep;
-            }
-          continue;
+static gboolean
+_format_append_subformat(WallClockTimeFormat *self, const gchar *format, gint state)
+{
+  WallClockTimeFormat *subformat = wall_clock_time_format_new(format);
 
-        case 'z':
-          /*
-           * We recognize all ISO 8601 formats:
-           * Z  = Zulu time/UTC
-           * [+-]hhmm
-           * [+-]hh:mm
-           * [+-]hh
-           * We recognize all RFC-822/RFC-2822 formats:
-           * UT|GMT
-           *          North American : UTC offsets
-           * E[DS]T = Eastern : -4 | -5
-           * C[DS]T = Central : -5 | -6
-           * M[DS]T = Mountain: -6 | -7
-           * P[DS]T = Pacific : -7 | -8
-           *          Military
-           * [A-IL-M] = -1 ... -9 (J not used)
-           * [N-Y]  = +1 ... +12
-           */
-          while (isspace(*bp))
-            bp++;
+  if (!subformat)
+    return FALSE;
+  _format_append_op(self, WCTF_OP_SUBFORMAT, 0, state, subformat);
+  return TRUE;
+}
 
-          switch (*bp++)
-            {
-            case 'G':
-              if (*bp++ != 'M')
-                return NULL;
-            /*FALLTHROUGH*/
-            case 'U':
-              if (*bp++ != 'T')
-                return NULL;
-            /*FALLTHROUGH*/
-            case 'Z':
-              wct->tm.tm_isdst = 0;
-              wct->wct_gmtoff = 0;
-              wct->wct_zone = utc;
-              continue;
-            case '+':
-              neg = 0;
-              break;
-            case '-':
-              neg = 1;
-              break;
-            default:
-              --bp;
-              ep = find_string(bp, &i, nast, NULL, 4);
-              if (ep != NULL)
-                {
-                  wct->wct_gmtoff = (-5 - i) * 3600;
-                  wct->wct_zone = __UNCONST(nast[i]);
-                  bp = ep;
-                  continue;
-                }
-              ep = find_string(bp, &i, nadt, NULL, 4);
-              if (ep != NULL)
-                {
-                  wct->tm.tm_isdst = 1;
-                  wct->wct_gmtoff = (-4 - i) * 3600;
-                  wct->wct_zone = __UNCONST(nadt[i]);
-                  bp = ep;
-                  continue;
-                }
-
-              if ((*bp >= 'A' && *bp <= 'I') ||
-                  (*bp >= 'L' && *bp <= 'Y'))
-                {
-                  /* Argh! No 'J'! */
-                  if (*bp >= 'A' && *bp <= 'I')
-                    wct->wct_gmtoff =
-                      (('A' - 1) - (int)*bp) * 3600;
-                  else if (*bp >= 'L' && *bp <= 'M')
-                    wct->wct_gmtoff = ('A' - (int)*bp) * 3600;
-                  else if (*bp >= 'N' && *bp <= 'Y')
-                    wct->wct_gmtoff = ((int)*bp - 'M') * 3600;
-                  wct->wct_zone = utc; /* XXX */
-                  bp++;
-                  continue;
-                }
-              return NULL;
-            }
-          offs = 0;
-          for (i = 0; i < 4; )
-            {
-              if (isdigit(*bp))
-                {
-                  offs = offs * 10 + (*bp++ - '0');
-                  i++;
-                  continue;
-                }
-              if (i == 2 && *bp == ':')
-                {
-                  bp++;
-                  continue;
-                }
-              break;
-            }
-          switch (i)
-            {
-            case 2:
-              offs *= 100;
-              break;
-            case 4:
-              i = offs % 100;
-              if (i >= 60)
-                return NULL;
-              /* Convert minutes into decimal */
-              offs = (offs / 100) * 100 + (i * 50) / 30;
-              break;
-            default:
-              return NULL;
-            }
-          if (neg)
-            offs = -offs;
-          wct->tm.tm_isdst = 0; /* XXX */
-          wct->wct_gmtoff = (offs * 3600) / 100;
-          wct->wct_zone = utc; /* XXX */
-          continue;
+static gboolean
+_format_compile(WallClockTimeFormat *self, const gchar *format)
+{
+  const unsigned char *fp = (const unsigned char *) format;
+  unsigned char c;
 
-        /*
-         * Miscellaneous conversions.
-         */
-        case 'n': /* Any kind of white-space. */
-        case 't':
-          while (isspace(*bp))
-            bp++;
-          LEGAL_ALT(0);
+  while ((c = *fp++) != '\0')
+    {
+      if (isspace(c))
+        {
+          /* consecutive white-space is matched by the first one */
+          if (self->ops->len == 0 ||
+              g_array_index(self->ops, WallClockTimeFormatOp, self->ops->len - 1).type != WCTF_OP_SPACE)
+            _format_append_op(self, WCTF_OP_SPACE, 0, 0, NULL);
           continue;
-
-
-        default:  /* Unknown/unsupported conversion. */
-          return NULL;
         }
-    }
 
-  if (!HAVE_YDAY(state) && HAVE_YEAR(state))
-    {
-      if (HAVE_MON(state) && HAVE_MDAY(state))
+      if (c != '%')
         {
-          /* calculate day of year (ordinal date) */
-          wct->tm.tm_yday =  start_of_month[isleap_sum(wct->tm.tm_year,
-                                                       TM_YEAR_BASE)][wct->tm.tm_mon] + (wct->tm.tm_mday - 1);
-          state |= S_YDAY;
+          _format_append_op(self, WCTF_OP_LITERAL, c, 0, NULL);
+          continue;
         }
-      else if (day_offset != -1)
+
+      switch (c = *fp++)
         {
-          /*
-           * Set the date to the first Sunday (or Monday)
-           * of the specified week of the year.
-           */
-          if (!HAVE_WDAY(state))
-            {
-              wct->tm.tm_wday = day_offset;
-              state |= S_WDAY;
-            }
-          wct->tm.tm_yday = (7 -
-                             first_wday_of(wct->tm.tm_year + TM_YEAR_BASE) +
-                             day_offset) % 7 + (week_offset - 1) * 7 +
-                            wct->tm.tm_wday  - day_offset;
-          state |= S_YDAY;
+        case '%':
+          _format_append_op(self, WCTF_OP_LITERAL, c, 0, NULL);
+          break;
+        case 'c':
+          if (!_format_append_subformat(self, _TIME_LOCALE(loc)->d_t_fmt, S_WDAY | S_MON | S_MDAY | S_YEAR))
+            return FALSE;
+          break;
+        case 'D':
+          if (!_format_append_subformat(self, "%m/%d/%y", S_MON | S_MDAY | S_YEAR))
+            return FALSE;
+          break;
+        case 'F':
+          if (!_format_append_subformat(self, "%Y-%m-%d", S_MON | S_MDAY | S_YEAR))
+            return FALSE;
+          break;
+        case 'R':
+          if (!_format_append_subformat(self, "%H:%M", 0))
+            return FALSE;
+          break;
+        case 'r':
+          if (!_format_append_subformat(self, _TIME_LOCALE(loc)->t_fmt_ampm, 0))
+            return FALSE;
+          break;
+        case 'T':
+          if (!_format_append_subformat(self, "%H:%M:%S", 0))
+            return FALSE;
+          break;
+        case 'X':
+          if (!_format_append_subformat(self, _TIME_LOCALE(loc)->t_fmt, 0))
+            return FALSE;
+          break;
+        case 'x':
+          if (!_format_append_subformat(self, _TIME_LOCALE(loc)->d_fmt, S_MON | S_MDAY | S_YEAR))
+            return FALSE;
+          break;
+        case '\0':
+          return FALSE;
+        default:
+          /* the %E and %O modifiers are left to wall_clock_time_strptime() */
+          if (!strchr("AaBbhCdefkHlIjMmpSsUWwugGVYyZznt", c))
+            return FALSE;
+          _format_append_op(self, WCTF_OP_CONVERSION, c, 0, NULL);
+          break;
         }
     }
+  return TRUE;
+}
 
-  if (HAVE_YDAY(state) && HAVE_YEAR(state))
+static const unsigned char *
+_format_parse(const WallClockTimeFormat *self, WallClockTime *wct, const unsigned char *bp)
+{
+  StrptimeState st = STRPTIME_STATE_INIT;
+
+  for (guint i = 0; bp != NULL && i < self->ops->len; i++)
     {
-      int isleap;
+      const WallClockTimeFormatOp *op = &g_array_index(self->ops, WallClockTimeFormatOp, i);
 
-      if (!HAVE_MON(state))
+      switch (op->type)
         {
-          /* calculate month of day of year */
-          i = 0;
-          isleap = isleap_sum(wct->tm.tm_year, TM_YEAR_BASE);
-          while (wct->tm.tm_yday >= start_of_month[isleap][i])
-            i++;
-          if (i > 12)
-            {
-              i = 1;
-              wct->tm.tm_yday -= start_of_month[isleap][12];
-              wct->tm.tm_year++;
-            }
-          wct->tm.tm_mon = i - 1;
-          state |= S_MON;
+        case WCTF_OP_LITERAL:
+          if (op->c != *bp++)
+            return NULL;
+          break;
+        case WCTF_OP_SPACE:
+          while (isspace(*bp))
+            bp++;
+          break;
+        case WCTF_OP_CONVERSION:
+          bp = _parse_conversion(op->c, bp, wct, &st);
+          break;
+        case WCTF_OP_SUBFORMAT:
+          st.state |= op->state;
+          bp = _format_parse(op->subformat, wct, bp);
+          break;
+        default:
+          g_assert_not_reached();
         }
+    }
 
-      if (!HAVE_MDAY(state))
-        {
-          /* calculate day of month */
-          isleap = isleap_sum(wct->tm.tm_year, TM_YEAR_BASE);
-          wct->tm.tm_mday = wct->tm.tm_yday -
-                            start_of_month[isleap][wct->tm.tm_mon] + 1;
-          state |= S_MDAY;
-        }
+  _complete_wall_clock_time(wct, &st);
+  return bp;
+}
 
-      if (!HAVE_WDAY(state))
-        {
-          /* calculate day of week */
-          i = 0;
-          week_offset = first_wday_of(wct->tm.tm_year);
-          while (i++ <= wct->tm.tm_yday)
-            {
-              if (week_offset++ >= 6)
-                week_offset = 0;
-            }
-          wct->tm.tm_wday = week_offset;
-          state |= S_WDAY;
-        }
-    }
+/*
+ * wall_clock_time_format_new:
+ *
+ * Compile @format for wall_clock_time_format_parse().  Returns NULL if
+ * @format uses the %E/%O modifiers or an unknown conversion, these are
+ * only supported by wall_clock_time_strptime().
+ */
+WallClockTimeFormat *
+wall_clock_time_format_new(const gchar *format)
+{
+  WallClockTimeFormat *self = g_new0(WallClockTimeFormat, 1);
 
-  if (!HAVE_USEC(state))
+  self->ops = g_array_new(FALSE, FALSE, sizeof(WallClockTimeFormatOp));
+  if (!_format_compile(self, format))
     {
-      wct->wct_usec = 0;
+      wall_clock_time_format_free(self);
+      return NULL;
     }
+  return self;
+}
 
-  return __UNCONST(bp);
+gchar *
+wall_clock_time_format_parse(const WallClockTimeFormat *self, WallClockTime *wct, const gchar *input)
+{
+  return __UNCONST(_format_parse(self, wct, (const unsigned char *) input));
+}
+
+void
+wall_clock_time_format_free(WallClockTimeFormat *self)
+{
+  for (guint i = 0; i < self->ops->len; i++)
+    {
+      WallClockTimeFormatOp *op = &g_array_index(self->ops, WallClockTimeFormatOp, i);
+
+      if (op->subformat)
+        wall_clock_time_format_free(op->subformat);
+    }
+  g_array_free(self->ops, TRUE);
+  g_free(self);
 }
 
 /* Determine (guess) the year for the month.
@@ -939,3 +1188,37 @@ find_string(const unsigned char *bp, int *tgt, const char *const *n1,
   /* Nothing matched */
   return NULL;
 }
+
+/*
+ * Same as find_string() for day and month names, but instead of trying all
+ * names one by one, the abbreviation is looked up by its first three
+ * characters in @keys.  Full names start with their abbreviation, so a
+ * full name can only match at the same index.
+ */
+static const unsigned char *
+find_name(const unsigned char *bp, int *tgt, const char *const *full,
+          const char *const *abbrev, const guint32 *keys, int c)
+{
+  int i;
+  size_t len;
+  guint32 key;
+
+  if (!bp[0] || !bp[1] || !bp[2])
+    return NULL;
+
+  key = NAME_KEY(g_ascii_tolower(bp[0]), g_ascii_tolower(bp[1]), g_ascii_tolower(bp[2]));
+  for (i = 0; i < c; i++)
+    {
+      if (keys[i] != key)
+        continue;
+
+      *tgt = i;
+      len = strlen(full[i]);
+      if (strncasecmp(full[i], (const char *)bp, len) == 0)
+        return bp + len;
+      return bp + strlen(abbrev[i]);
+    }
+
+  /* Nothing matched */
+  return NULL;
+}
@@ -129,4 +129,10 @@ void wall_clock_time_unset(WallClockTime *wct);
 gchar *wall_clock_time_strptime(WallClockTime *wct, const gchar *format, const gchar *input);
 void wall_clock_time_guess_missing_year(WallClockTime *self);
 
+typedef struct _WallClockTimeFormat WallClockTimeFormat;
+
+WallClockTimeFormat *wall_clock_time_format_new(const gchar *format);
+gchar *wall_clock_time_format_parse(const WallClockTimeFormat *self, WallClockTime *wct, const gchar *input);
+void wall_clock_time_format_free(WallClockTimeFormat *self);
+
 #endif
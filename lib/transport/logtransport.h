@@ -38,6 +38,8 @@ struct _LogTransport
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
+  /* returns TRUE if the transport has data buffered, which can be read without polling the fd */
+  gboolean (*has_buffered_input)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 };
 
@@ -59,6 +61,14 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return self->read(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_has_buffered_input(LogTransport *self)
+{
+  if (self->has_buffered_input)
+    return self->has_buffered_input(self);
+  return FALSE;
+}
+
 void log_transport_init_instance(LogTransport *s, gint fd);
 void log_transport_free_method(LogTransport *s);
 void log_transport_free(LogTransport *s);
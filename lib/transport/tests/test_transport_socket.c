@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ */
+#include <criterion/criterion.h>
+#include "apphook.h"
+#include "fdhelpers.h"
+#include "transport/transport-socket.h"
+#include "transport/transport-aux-data.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+LogTransport *transport;
+gint peer_fd;
+
+static void
+send_datagram(const gchar *datagram)
+{
+  cr_assert_eq(send(peer_fd, datagram, strlen(datagram), 0), strlen(datagram));
+}
+
+static void
+assert_transport_reads(gsize buflen, const gchar *expected)
+{
+  gchar buf[256];
+  gssize rc;
+
+  g_assert(buflen <= sizeof(buf));
+  rc = log_transport_read(transport, buf, buflen, NULL);
+  cr_assert_eq(rc, strlen(expected), "Unexpected read() result; rc=%d, expected=%s", (gint) rc, expected);
+  cr_assert(memcmp(buf, expected, rc) == 0, "Unexpected datagram; expected=%s, got=%.*s", expected, (gint) rc, buf);
+}
+
+static void
+assert_transport_would_block(void)
+{
+  gchar buf[256];
+
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), NULL), -1);
+  cr_assert_eq(errno, EAGAIN);
+}
+
+static void
+create_socketpair_transport(gint batch_size)
+{
+  gint fds[2];
+
+  cr_assert_eq(socketpair(AF_UNIX, SOCK_DGRAM, 0, fds), 0);
+  g_fd_set_nonblock(fds[0], TRUE);
+  transport = log_transport_batched_dgram_socket_new(fds[0], batch_size);
+  peer_fd = fds[1];
+}
+
+Test(transport_socket, test_batched_dgram_returns_datagrams_of_a_batch_one_by_one)
+{
+  create_socketpair_transport(4);
+
+  send_datagram("msg1");
+  send_datagram("msg2");
+  send_datagram("msg3");
+
+  assert_transport_reads(256, "msg1");
+  cr_assert(log_transport_has_buffered_input(transport));
+  assert_transport_reads(256, "msg2");
+  assert_transport_reads(256, "msg3");
+  cr_assert_not(log_transport_has_buffered_input(transport));
+  assert_transport_would_block();
+}
+
+Test(transport_socket, test_batched_dgram_receives_more_datagrams_than_batch_size)
+{
+  create_socketpair_transport(2);
+
+  send_datagram("msg1");
+  send_datagram("msg2");
+  send_datagram("msg3");
+
+  assert_transport_reads(256, "msg1");
+  assert_transport_reads(256, "msg2");
+  cr_assert_not(log_transport_has_buffered_input(transport));
+  assert_transport_reads(256, "msg3");
+  assert_transport_would_block();
+}
+
+Test(transport_socket, test_batched_dgram_truncates_datagrams_to_the_read_buffer)
+{
+  create_socketpair_transport(4);
+
+  send_datagram("0123456789");
+  assert_transport_reads(4, "0123");
+  assert_transport_would_block();
+}
+
+Test(transport_socket, test_batched_dgram_follows_read_buffer_size_between_batches)
+{
+  create_socketpair_transport(4);
+
+  send_datagram("0123456789");
+  assert_transport_reads(4, "0123");
+
+  send_datagram("abcdefghij");
+  assert_transport_reads(16, "abcdefghij");
+
+  /* pending datagrams are truncated to the smaller buffer */
+  send_datagram("klmnopqrst");
+  send_datagram("uvwxyz0123");
+  assert_transport_reads(16, "klmnopqrst");
+  assert_transport_reads(4, "uvwx");
+  assert_transport_would_block();
+}
+
+Test(transport_socket, test_batched_dgram_skips_empty_datagrams)
+{
+  create_socketpair_transport(4);
+
+  send_datagram("");
+  send_datagram("msg1");
+
+  assert_transport_reads(256, "msg1");
+  assert_transport_would_block();
+}
+
+Test(transport_socket, test_batched_dgram_unnamed_peer_sets_no_peer_addr)
+{
+  LogTransportAuxData aux;
+  gchar buf[256];
+
+  create_socketpair_transport(4);
+  send_datagram("msg1");
+
+  log_transport_aux_data_init(&aux);
+  cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), &aux), 4);
+  cr_assert_null(aux.peer_addr);
+  log_transport_aux_data_destroy(&aux);
+}
+
+Test(transport_socket, test_batched_dgram_sets_peer_addr_of_each_datagram)
+{
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t sin_len = sizeof(sin);
+  gint fd, sender_fds[2];
+  LogTransportAuxData aux;
+  gchar buf[256];
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  cr_assert(fd >= 0);
+  cr_assert_eq(bind(fd, (struct sockaddr *) &sin, sizeof(sin)), 0);
+  cr_assert_eq(getsockname(fd, (struct sockaddr *) &sin, &sin_len), 0);
+  g_fd_set_nonblock(fd, TRUE);
+  transport = log_transport_batched_dgram_socket_new(fd, 4);
+
+  for (gint i = 0; i < 2; i++)
+    {
+      sender_fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+      cr_assert_eq(sendto(sender_fds[i], "msg", 3, 0, (struct sockaddr *) &sin, sizeof(sin)), 3);
+    }
+
+  for (gint i = 0; i < 2; i++)
+    {
+      struct sockaddr_in sender;
+      socklen_t sender_len = sizeof(sender);
+
+      cr_assert_eq(getsockname(sender_fds[i], (struct sockaddr *) &sender, &sender_len), 0);
+
+      log_transport_aux_data_init(&aux);
+      cr_assert_eq(log_transport_read(transport, buf, sizeof(buf), &aux), 3);
+      cr_assert_not_null(aux.peer_addr);
+      cr_assert_eq(g_sockaddr_get_port(aux.peer_addr), ntohs(sender.sin_port));
+      log_transport_aux_data_destroy(&aux);
+      close(sender_fds[i]);
+    }
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  transport = NULL;
+  peer_fd = -1;
+}
+
+static void
+teardown(void)
+{
+  if (transport)
+    log_transport_free(transport);
+  if (peer_fd != -1)
+    close(peer_fd);
+  app_shutdown();
+}
+
+TestSuite(transport_socket, .init = setup, .fini = teardown);
+
+#endif
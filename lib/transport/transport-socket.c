@@ -22,9 +22,12 @@
  */
 
 #include "transport-socket.h"
+#include "stats/stats-cluster-single.h"
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 static gssize
 log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
@@ -95,6 +98,186 @@ log_transport_dgram_socket_new(gint fd)
   return &self->super;
 }
 
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+static void
+_batched_dgram_allocate_buffers(LogTransportBatchedDGramSocket *self, gsize buffer_size)
+{
+  if (!self->msgs)
+    {
+      self->addrs = g_new0(struct sockaddr_storage, self->batch_size);
+      self->iov = g_new0(struct iovec, self->batch_size);
+      self->msgs = g_new0(struct mmsghdr, self->batch_size);
+      if (self->control_size)
+        self->control_buffers = g_malloc0(self->batch_size * self->control_size);
+    }
+
+  g_free(self->buffers);
+  self->buffer_size = buffer_size;
+  self->buffers = g_malloc(self->batch_size * buffer_size);
+}
+
+static gboolean
+_batched_dgram_receive_batch(LogTransportBatchedDGramSocket *self)
+{
+  struct mmsghdr *msgs = (struct mmsghdr *) self->msgs;
+  gint rc;
+
+  for (gint i = 0; i < self->batch_size; i++)
+    {
+      struct msghdr *hdr = &msgs[i].msg_hdr;
+
+      self->iov[i].iov_base = self->buffers + i * self->buffer_size;
+      self->iov[i].iov_len = self->buffer_size;
+      hdr->msg_name = &self->addrs[i];
+      hdr->msg_namelen = sizeof(self->addrs[i]);
+      hdr->msg_iov = &self->iov[i];
+      hdr->msg_iovlen = 1;
+      hdr->msg_control = self->control_size ? self->control_buffers + i * self->control_size : NULL;
+      hdr->msg_controllen = self->control_size;
+      hdr->msg_flags = 0;
+      msgs[i].msg_len = 0;
+    }
+
+  do
+    {
+      rc = recvmmsg(self->super.super.fd, msgs, self->batch_size, MSG_DONTWAIT, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  if (rc <= 0)
+    {
+      if (rc == 0)
+        errno = EAGAIN;
+      return FALSE;
+    }
+
+  self->received = rc;
+  self->next = 0;
+  stats_counter_inc(self->recv_batches);
+  stats_counter_add(self->recv_batched_messages, rc);
+  return TRUE;
+}
+
+static void
+_batched_dgram_feed_peer_addr(LogTransportBatchedDGramSocket *self, struct msghdr *msg, LogTransportAuxData *aux)
+{
+  if (msg->msg_namelen)
+    log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_name, msg->msg_namelen));
+}
+
+static gssize
+log_transport_batched_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportBatchedDGramSocket *self = (LogTransportBatchedDGramSocket *) s;
+  struct mmsghdr *msg;
+  gsize len;
+
+  do
+    {
+      if (self->next >= self->received)
+        {
+          /* the datagrams of the previous batch are consumed, so the
+           * buffers can follow the size requested by the caller */
+          if (G_UNLIKELY(self->buffer_size != buflen))
+            _batched_dgram_allocate_buffers(self, buflen);
+
+          if (!_batched_dgram_receive_batch(self))
+            return -1;
+        }
+
+      msg = &((struct mmsghdr *) self->msgs)[self->next++];
+    }
+  /* DGRAM sockets should never return EOF, skip empty datagrams */
+  while (msg->msg_len == 0);
+
+  len = MIN(msg->msg_len, buflen);
+  memcpy(buf, msg->msg_hdr.msg_iov[0].iov_base, len);
+  if (aux)
+    self->feed_aux(self, &msg->msg_hdr, aux);
+  return len;
+}
+
+static gboolean
+log_transport_batched_dgram_socket_has_buffered_input(LogTransport *s)
+{
+  LogTransportBatchedDGramSocket *self = (LogTransportBatchedDGramSocket *) s;
+
+  return self->next < self->received;
+}
+
+static void
+_batched_dgram_register_stats(LogTransportBatchedDGramSocket *self)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "dgram_recv_batches", NULL);
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->recv_batches);
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "dgram_recv_batched_messages", NULL);
+  stats_register_counter(STATS_LEVEL1, &sc_key, SC_TYPE_SINGLE_VALUE, &self->recv_batched_messages);
+  stats_unlock();
+}
+
+static void
+_batched_dgram_unregister_stats(LogTransportBatchedDGramSocket *self)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "dgram_recv_batches", NULL);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->recv_batches);
+  stats_cluster_single_key_set(&sc_key, SCS_GLOBAL, "dgram_recv_batched_messages", NULL);
+  stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &self->recv_batched_messages);
+  stats_unlock();
+}
+
+void
+log_transport_batched_dgram_socket_free_method(LogTransport *s)
+{
+  LogTransportBatchedDGramSocket *self = (LogTransportBatchedDGramSocket *) s;
+
+  _batched_dgram_unregister_stats(self);
+  g_free(self->buffers);
+  g_free(self->control_buffers);
+  g_free(self->addrs);
+  g_free(self->iov);
+  g_free(self->msgs);
+  log_transport_free_method(s);
+}
+
+void
+log_transport_batched_dgram_socket_init_instance(LogTransportBatchedDGramSocket *self, gint fd, gint batch_size)
+{
+  log_transport_dgram_socket_init_instance(&self->super, fd);
+  self->super.super.read = log_transport_batched_dgram_socket_read_method;
+  self->super.super.has_buffered_input = log_transport_batched_dgram_socket_has_buffered_input;
+  self->super.super.free_fn = log_transport_batched_dgram_socket_free_method;
+  self->feed_aux = _batched_dgram_feed_peer_addr;
+  self->batch_size = batch_size;
+  _batched_dgram_register_stats(self);
+}
+
+LogTransport *
+log_transport_batched_dgram_socket_new(gint fd, gint batch_size)
+{
+  LogTransportBatchedDGramSocket *self = g_new0(LogTransportBatchedDGramSocket, 1);
+
+  log_transport_batched_dgram_socket_init_instance(self, fd, batch_size);
+  return &self->super.super;
+}
+
+#else
+
+/* recvmmsg() is not available, fall back to reading one datagram at a time */
+LogTransport *
+log_transport_batched_dgram_socket_new(gint fd, gint batch_size)
+{
+  return log_transport_dgram_socket_new(fd);
+}
+
+#endif
+
 static gssize
 log_transport_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
@@ -123,6 +306,20 @@ log_transport_stream_socket_write_method(LogTransport *s, const gpointer buf, gs
   return rc;
 }
 
+static gssize
+log_transport_stream_socket_writev_method(LogTransport *s, struct iovec *iov, gint iov_count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gint rc;
+
+  do
+    {
+      rc = writev(self->super.fd, iov, iov_count);
+    }
+  while (rc == -1 && errno == EINTR);
+  return rc;
+}
+
 static void
 log_transport_stream_socket_free_method(LogTransport *s)
 {
@@ -137,6 +334,7 @@ log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd)
   log_transport_init_instance(&self->super, fd);
   self->super.read = log_transport_stream_socket_read_method;
   self->super.write = log_transport_stream_socket_write_method;
+  self->super.writev = log_transport_stream_socket_writev_method;
   self->super.free_fn = log_transport_stream_socket_free_method;
 }
 
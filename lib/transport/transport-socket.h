@@ -26,6 +26,9 @@
 #define TRANSPORT_TRANSPORT_SOCKET_H_INCLUDED 1
 
 #include "logtransport.h"
+#include "stats/stats-registry.h"
+
+#include <sys/socket.h>
 
 typedef struct _LogTransportSocket LogTransportSocket;
 struct _LogTransportSocket
@@ -36,6 +39,40 @@ struct _LogTransportSocket
 void log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd);
 LogTransport *log_transport_dgram_socket_new(gint fd);
 
+/* Datagram socket transport that receives up to batch_size datagrams with
+ * a single recvmmsg() call into preallocated buffers, and returns them one
+ * by one from read(). */
+typedef struct _LogTransportBatchedDGramSocket LogTransportBatchedDGramSocket;
+struct _LogTransportBatchedDGramSocket
+{
+  LogTransportSocket super;
+  gint batch_size;
+
+  /* per datagram buffers, sized to the buffer of read() and reallocated
+   * between batches when that changes */
+  gsize buffer_size;
+  gchar *buffers;
+  gsize control_size;
+  gchar *control_buffers;
+  struct sockaddr_storage *addrs;
+  struct iovec *iov;
+  gpointer msgs;
+
+  /* datagrams received by the last recvmmsg() call and the next one to return */
+  gint received;
+  gint next;
+
+  StatsCounterItem *recv_batches;
+  StatsCounterItem *recv_batched_messages;
+
+  void (*feed_aux)(LogTransportBatchedDGramSocket *self, struct msghdr *msg, LogTransportAuxData *aux);
+};
+
+void log_transport_batched_dgram_socket_init_instance(LogTransportBatchedDGramSocket *self, gint fd,
+                                                      gint batch_size);
+void log_transport_batched_dgram_socket_free_method(LogTransport *s);
+LogTransport *log_transport_batched_dgram_socket_new(gint fd, gint batch_size);
+
 void log_transport_stream_socket_init_instance(LogTransportSocket *self, gint fd);
 LogTransport *log_transport_stream_socket_new(gint fd);
 
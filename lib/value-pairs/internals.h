@@ -28,6 +28,8 @@
 #include "syslog-ng.h"
 #include "atomic.h"
 
+typedef struct _VPPlan VPPlan;
+
 struct _ValuePairs
 {
   GAtomicCounter ref_cnt;
@@ -40,6 +42,16 @@ struct _ValuePairs
 
   /* guint32 as CfgFlagHandler only supports 32 bit integers */
   guint32 scopes;
+
+  /* selection resolved for the current set of NVHandles, see VPPlan;
+   * published with an atomic pointer store, plan_lock only serializes
+   * building a new one.  Replaced plans are kept in retired_plans until
+   * plan_users, the number of threads formatting with a plan, drops to
+   * zero. */
+  GMutex *plan_lock;
+  VPPlan *plan;
+  GAtomicCounter plan_users;
+  GList *retired_plans;
 };
 
 
@@ -23,6 +23,7 @@
  */
 
 #include "value-pairs/value-pairs.h"
+#include "value-pairs/internals.h"
 
 #include <criterion/criterion.h>
 #include <criterion/parameterized.h>
@@ -33,6 +34,7 @@
 #include "plugin.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 gboolean success = TRUE;
 
@@ -283,6 +285,100 @@ Test(value_pairs, test_transformer_shift_levels)
   g_ptr_array_free(transformers, TRUE);
 }
 
+static gboolean
+vp_concat_foreach(const gchar *name, TypeHint type, const gchar *value,
+                  gsize value_len, gpointer user_data)
+{
+  GString *result = (GString *) user_data;
+
+  g_string_append_printf(result, "%s=%.*s;", name, (gint) value_len, value);
+  return FALSE;
+}
+
+Test(value_pairs, test_names_registered_after_the_first_message_are_selected)
+{
+  ValuePairs *vp = value_pairs_new();
+  LogMessage *msg = log_msg_new_empty();
+  GString *result = g_string_new("");
+  LogTemplate *template = create_template("string", "override");
+
+  value_pairs_add_glob_pattern(vp, "vp_test.*", TRUE);
+  value_pairs_add_pair(vp, "vp_test.b", template);
+  log_template_unref(template);
+
+  log_msg_set_value_by_name(msg, "vp_test.b", "nvpair", -1);
+  value_pairs_foreach(vp, vp_concat_foreach, msg, 0, LTZ_LOCAL, &template_options, result);
+  cr_assert_str_eq(result->str, "vp_test.b=override;");
+
+  log_msg_set_value_by_name(msg, "vp_test.c", "c", -1);
+  log_msg_set_value_by_name(msg, "vp_test.a", "a", -1);
+  g_string_truncate(result, 0);
+  value_pairs_foreach(vp, vp_concat_foreach, msg, 0, LTZ_LOCAL, &template_options, result);
+  cr_assert_str_eq(result->str, "vp_test.a=a;vp_test.b=override;vp_test.c=c;");
+  cr_assert_null(vp->retired_plans, "the replaced plan should be freed once it is not in use");
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
+Test(value_pairs, test_names_registered_later_share_the_rank_of_an_existing_name)
+{
+  ValuePairs *vp = value_pairs_new();
+  LogMessage *msg = log_msg_new_empty();
+  GString *result = g_string_new("");
+  LogTemplate *template = create_template("string", "pair");
+
+  value_pairs_add_glob_pattern(vp, "vp_late.*", TRUE);
+  value_pairs_add_pair(vp, "vp_late.b", template);
+  log_template_unref(template);
+
+  log_msg_set_value_by_name(msg, "vp_late.a", "a", -1);
+  value_pairs_foreach(vp, vp_concat_foreach, msg, 0, LTZ_LOCAL, &template_options, result);
+  cr_assert_str_eq(result->str, "vp_late.a=a;vp_late.b=pair;");
+
+  log_msg_set_value_by_name(msg, "vp_late.b", "nvpair", -1);
+  g_string_truncate(result, 0);
+  value_pairs_foreach(vp, vp_concat_foreach, msg, 0, LTZ_LOCAL, &template_options, result);
+  cr_assert_str_eq(result->str, "vp_late.a=a;vp_late.b=pair;");
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
+static gint
+vp_reverse_strcmp(gconstpointer a, gconstpointer b)
+{
+  return strcmp(b, a);
+}
+
+Test(value_pairs, test_different_compare_functions_can_be_mixed)
+{
+  ValuePairs *vp = value_pairs_new();
+  LogMessage *msg = log_msg_new_empty();
+  GString *result = g_string_new("");
+
+  value_pairs_add_glob_pattern(vp, "vp_cmp.*", TRUE);
+  log_msg_set_value_by_name(msg, "vp_cmp.a", "a", -1);
+  log_msg_set_value_by_name(msg, "vp_cmp.b", "b", -1);
+
+  for (gint i = 0; i < 2; i++)
+    {
+      g_string_truncate(result, 0);
+      value_pairs_foreach(vp, vp_concat_foreach, msg, 0, LTZ_LOCAL, &template_options, result);
+      cr_assert_str_eq(result->str, "vp_cmp.a=a;vp_cmp.b=b;");
+
+      g_string_truncate(result, 0);
+      value_pairs_foreach_sorted(vp, vp_concat_foreach, vp_reverse_strcmp, msg, 0, LTZ_LOCAL, &template_options, result);
+      cr_assert_str_eq(result->str, "vp_cmp.b=b;vp_cmp.a=a;");
+    }
+
+  g_string_free(result, TRUE);
+  log_msg_unref(msg);
+  value_pairs_unref(vp);
+}
+
 GlobalConfig *cfg;
 
 void
@@ -47,22 +47,64 @@ typedef struct
   LogTemplate *template;
 } VPPairConf;
 
+/*
+ * The selection plan: everything that only depends on the configuration
+ * and the set of registered NVHandles is resolved in advance, so that
+ * formatting a message does not need to match patterns, apply transforms
+ * or compare names.
+ *
+ * Each selected name gets a rank, its position in the output order as
+ * determined by the compare function.  Names that compare equal share a
+ * rank, in which case the value inserted last wins, just like when
+ * inserting them to a GTree.
+ */
+#define VP_PLAN_EXCLUDED (-1)
+
+struct _VPPlan
+{
+  GCompareFunc compare_func;
+  /* built for a compare function other than the published plan's, freed after use */
+  gboolean transient;
+
+  /* number of NVHandles covered, handles registered later need a new plan */
+  guint32 num_handles;
+
+  /* indexed by handle - 1 */
+  gint32 *handle_ranks;
+  /* indexed the same way as vp->builtins and vp->vpairs */
+  gint32 *builtin_ranks;
+  gint32 *vpair_ranks;
+
+  /* the transformed names, indexed by rank, sorted and unique */
+  GPtrArray *names;
+};
+
+typedef struct
+{
+  gchar *name;
+  gint32 *rank;
+} VPPlanCandidate;
+
 typedef struct
 {
   /* we don't own any of the fields here, it is assumed that allocations are
    * managed by the caller */
 
-  GString *name;
   GString *value;
   TypeHint type_hint;
 } VPResultValue;
 
+#define VP_RESULTS_BITS_PER_WORD (GLIB_SIZEOF_LONG * 8)
+
 typedef struct
 {
-  GTree *result_tree;
+  VPPlan *plan;
 
-  /* array of VPResultValue instances */
-  GArray *values;
+  /* indexed by rank, a value inserted later for the same name replaces
+   * the earlier one; only the ranks set in the "filled" bitmap are valid */
+  VPResultValue *values;
+  gulong *filled;
+  gint filled_words;
 } VPResults;
 
 
@@ -180,52 +222,39 @@ vp_pair_conf_free(VPPairConf *vpc)
   g_free(vpc);
 }
 
-static void
-vp_result_value_init(VPResultValue *rv, GString *name, TypeHint type_hint, GString *value)
-{
-  rv->type_hint = type_hint;
-  rv->name = name;
-  rv->value = value;
-}
+static void vp_plan_free(VPPlan *self);
 
 static void
-vp_results_init(VPResults *results, GCompareFunc compare_func)
+vp_results_init(VPResults *results, VPPlan *plan)
 {
-  results->values = g_array_sized_new(FALSE, FALSE, sizeof(VPResultValue), 16);
-  results->result_tree = g_tree_new_full((GCompareDataFunc) compare_func, NULL,
-                                         NULL, NULL);
+  results->plan = plan;
+  results->values = g_new(VPResultValue, MAX(plan->names->len, 1));
+  results->filled_words = (plan->names->len + VP_RESULTS_BITS_PER_WORD - 1) / VP_RESULTS_BITS_PER_WORD;
+  results->filled = g_new0(gulong, MAX(results->filled_words, 1));
 }
 
 static void
 vp_results_deinit(VPResults *results)
 {
-  g_tree_destroy(results->result_tree);
-  g_array_free(results->values, TRUE);
+  g_free(results->values);
+  g_free(results->filled);
 }
 
 static void
-vp_results_insert(VPResults *results, GString *name, TypeHint type_hint, GString *value)
+vp_results_insert(VPResults *results, gint32 rank, TypeHint type_hint, GString *value)
 {
-  VPResultValue *rv;
-  gint ndx = results->values->len;
+  VPResultValue *rv = &results->values[rank];
 
-  g_array_set_size(results->values, ndx + 1);
-  rv = &g_array_index(results->values, VPResultValue, ndx);
-  vp_result_value_init(rv, name, type_hint, value);
-  /* GTree takes over ownership of name */
-  g_tree_insert(results->result_tree, name->str, GINT_TO_POINTER(ndx));
+  rv->type_hint = type_hint;
+  rv->value = value;
+  results->filled[rank / VP_RESULTS_BITS_PER_WORD] |= 1UL << (rank % VP_RESULTS_BITS_PER_WORD);
 }
 
-static GString *
-vp_transform_apply (ValuePairs *vp, const gchar *key)
+static gchar *
+vp_transform_name(ValuePairs *vp, const gchar *key)
 {
   gint i;
-  GString *result = scratch_buffers_alloc();
-
-  g_string_assign(result, key);
-
-  if (vp->transforms->len == 0)
-    return result;
+  GString *result = g_string_new(key);
 
   for (i = 0; i < vp->transforms->len; i++)
     {
@@ -234,49 +263,48 @@ vp_transform_apply (ValuePairs *vp, const gchar *key)
       value_pairs_transform_set_apply(t, result);
     }
 
-  return result;
+  return g_string_free(result, FALSE);
 }
 
 /* runs over the name-value pairs requested by the user (e.g. with value_pairs_add_pair) */
 static void
-vp_pairs_foreach(gpointer data, gpointer user_data)
+vp_merge_pairs(ValuePairs *vp, VPResults *results, LogMessage *msg, gint32 seq_num, gint time_zone_mode,
+               const LogTemplateOptions *template_options)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  LogMessage *msg = ((gpointer *)user_data)[2];
-  gint32 seq_num = GPOINTER_TO_INT (((gpointer *)user_data)[3]);
-  VPResults *results = ((gpointer *)user_data)[5];
-  const LogTemplateOptions *template_options = ((gpointer *)user_data)[6];
-  GString *sb = scratch_buffers_alloc();
-  VPPairConf *vpc = (VPPairConf *)data;
-  gint time_zone_mode = GPOINTER_TO_INT (((gpointer *)user_data)[7]);
-
-  log_template_append_format((LogTemplate *)vpc->template, msg,
-                             template_options,
-                             time_zone_mode, seq_num, NULL, sb);
-
-  if (vp->omit_empty_values && sb->len == 0)
-    return;
-  vp_results_insert(results, vp_transform_apply(vp, vpc->name), vpc->template->type_hint, sb);
+  gint i;
+
+  for (i = 0; i < vp->vpairs->len; i++)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+      GString *sb = scratch_buffers_alloc();
+
+      log_template_append_format(vpc->template, msg,
+                                 template_options,
+                                 time_zone_mode, seq_num, NULL, sb);
+
+      if (vp->omit_empty_values && sb->len == 0)
+        continue;
+      vp_results_insert(results, results->plan->vpair_ranks[i], vpc->template->type_hint, sb);
+    }
 }
 
-/* runs over the LogMessage nv-pairs, and inserts them unless excluded */
 static gboolean
-vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
-                       const gchar *value, gssize value_len,
-                       gpointer user_data)
+vp_is_name_sdata(const gchar *name)
+{
+  /* same as the LM_VF_SDATA flag, which may not yet be set on a handle
+   * that was just registered */
+  return strncmp(name, logmsg_sd_prefix, logmsg_sd_prefix_len) == 0 && name[logmsg_sd_prefix_len];
+}
+
+static gboolean
+vp_is_nvpair_selected(ValuePairs *vp, const gchar *name)
 {
-  ValuePairs *vp = ((gpointer *)user_data)[0];
-  VPResults *results = ((gpointer *)user_data)[5];
   guint j;
   gboolean inc;
-  GString *sb;
-
-  if (vp->omit_empty_values && value_len == 0)
-    return FALSE;
 
   inc = (name[0] == '.' && (vp->scopes & VPS_DOT_NV_PAIRS)) ||
         (name[0] != '.' && (vp->scopes & VPS_NV_PAIRS)) ||
-        (log_msg_is_handle_sdata(handle) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
+        (vp_is_name_sdata(name) && (vp->scopes & (VPS_SDATA + VPS_RFC5424)));
 
   for (j = 0; j < vp->patterns->len; j++)
     {
@@ -284,14 +312,30 @@ vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
       if (vp_pattern_spec_eval(vps, name))
         inc = vps->include;
     }
+  return inc;
+}
+
+/* runs over the LogMessage nv-pairs, and inserts them unless excluded */
+static gboolean
+vp_msg_nvpairs_foreach(NVHandle handle, gchar *name,
+                       const gchar *value, gssize value_len,
+                       gpointer user_data)
+{
+  ValuePairs *vp = ((gpointer *)user_data)[0];
+  VPResults *results = ((gpointer *)user_data)[1];
+  VPPlan *plan = results->plan;
+  GString *sb;
+
+  if (vp->omit_empty_values && value_len == 0)
+    return FALSE;
 
-  if (!inc)
+  if (G_UNLIKELY(handle > plan->num_handles) || plan->handle_ranks[handle - 1] == VP_PLAN_EXCLUDED)
     return FALSE;
 
   sb = scratch_buffers_alloc();
 
   g_string_append_len(sb, value, value_len);
-  vp_results_insert(results, vp_transform_apply(vp, name), TYPE_HINT_STRING, sb);
+  vp_results_insert(results, plan->handle_ranks[handle - 1], TYPE_HINT_STRING, sb);
 
   return FALSE;
 }
@@ -342,9 +386,12 @@ vp_merge_set(ValuePairs *vp, ValuePairSpec *set)
 }
 
 
+static void vp_invalidate_plan(ValuePairs *vp);
+
 static void
 vp_update_builtin_list_of_values(ValuePairs *vp)
 {
+  vp_invalidate_plan(vp);
   g_ptr_array_set_size(vp->builtins, 0);
 
   if (vp->patterns->len > 0)
@@ -400,26 +447,262 @@ vp_merge_builtins(ValuePairs *vp, VPResults *results, LogMessage *msg, gint32 se
           continue;
         }
 
-      vp_results_insert(results, vp_transform_apply(vp, spec->name), TYPE_HINT_STRING, sb);
+      vp_results_insert(results, results->plan->builtin_ranks[i], TYPE_HINT_STRING, sb);
     }
 }
 
-static gboolean
-vp_foreach_helper(const gchar *name, gpointer ndx_as_pointer, gpointer data)
+/*
+ * VPPlan
+ */
+
+static void
+vp_plan_add_candidate(GArray *candidates, gchar *name, gint32 *rank)
+{
+  VPPlanCandidate candidate = { .name = name, .rank = rank };
+
+  g_array_append_val(candidates, candidate);
+}
+
+static gint
+vp_plan_candidate_cmp(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  GCompareFunc compare_func = (GCompareFunc) user_data;
+
+  return compare_func(((const VPPlanCandidate *) a)->name, ((const VPPlanCandidate *) b)->name);
+}
+
+/* names arrive in sorted order, a name equal to the last one shares its rank */
+static gint32
+vp_plan_append_name(VPPlan *self, gchar *name)
+{
+  if (self->names->len > 0 &&
+      self->compare_func(g_ptr_array_index(self->names, self->names->len - 1), name) == 0)
+    g_free(name);
+  else
+    g_ptr_array_add(self->names, name);
+  return self->names->len - 1;
+}
+
+/* merges the names of the base plan with the new candidates in a single
+ * pass, only the candidates need sorting; old_ranks maps the ranks of the
+ * base plan to the new ones */
+static void
+vp_plan_assign_ranks(VPPlan *self, const VPPlan *base, GArray *candidates, gint32 *old_ranks)
+{
+  guint base_len = base ? base->names->len : 0;
+  guint i = 0, j = 0;
+
+  g_array_sort_with_data(candidates, vp_plan_candidate_cmp, (gpointer) self->compare_func);
+
+  while (i < base_len || j < candidates->len)
+    {
+      const gchar *base_name = i < base_len ? g_ptr_array_index(base->names, i) : NULL;
+      VPPlanCandidate *candidate = j < candidates->len ? &g_array_index(candidates, VPPlanCandidate, j) : NULL;
+
+      if (base_name && (!candidate || self->compare_func(base_name, candidate->name) <= 0))
+        {
+          old_ranks[i++] = vp_plan_append_name(self, g_strdup(base_name));
+        }
+      else
+        {
+          *candidate->rank = vp_plan_append_name(self, candidate->name);
+          j++;
+        }
+    }
+}
+
+static gint32
+vp_plan_remap_rank(gint32 rank, const gint32 *old_ranks)
 {
-  VPResults *results = ((gpointer *)data)[0];
-  gint ndx = GPOINTER_TO_INT(ndx_as_pointer);
-  VPResultValue *rv = &g_array_index(results->values, VPResultValue, ndx);
-  VPForeachFunc func = ((gpointer *)data)[1];
-  gpointer user_data = ((gpointer *)data)[2];
-  gboolean *r = ((gpointer *)data)[3];
+  return rank == VP_PLAN_EXCLUDED ? VP_PLAN_EXCLUDED : old_ranks[rank];
+}
+
+/* with a base plan, only the NVHandles registered since it was built are
+ * resolved, everything else is carried over with remapped ranks */
+static VPPlan *
+vp_plan_new(ValuePairs *vp, GCompareFunc compare_func, const VPPlan *base)
+{
+  VPPlan *self = g_new0(VPPlan, 1);
+  GArray *candidates = g_array_new(FALSE, FALSE, sizeof(VPPlanCandidate));
+  NVHandle first_handle = base ? base->num_handles + 1 : 1;
+  gint32 *old_ranks = base ? g_new(gint32, base->names->len) : NULL;
+  NVHandle handle;
+  gint i;
+
+  self->compare_func = compare_func;
+  self->num_handles = logmsg_registry->names->len;
+  self->handle_ranks = g_new(gint32, self->num_handles);
+  self->builtin_ranks = g_new(gint32, vp->builtins->len);
+  self->vpair_ranks = g_new(gint32, vp->vpairs->len);
+  self->names = g_ptr_array_new_with_free_func(g_free);
+
+  for (handle = first_handle; handle <= self->num_handles; handle++)
+    {
+      const gchar *name = log_msg_get_value_name(handle, NULL);
+
+      self->handle_ranks[handle - 1] = VP_PLAN_EXCLUDED;
+      if (vp_is_nvpair_selected(vp, name))
+        vp_plan_add_candidate(candidates, vp_transform_name(vp, name), &self->handle_ranks[handle - 1]);
+    }
+
+  if (!base)
+    {
+      for (i = 0; i < vp->builtins->len; i++)
+        {
+          ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+
+          vp_plan_add_candidate(candidates, vp_transform_name(vp, spec->name), &self->builtin_ranks[i]);
+        }
+
+      for (i = 0; i < vp->vpairs->len; i++)
+        {
+          VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+
+          vp_plan_add_candidate(candidates, vp_transform_name(vp, vpc->name), &self->vpair_ranks[i]);
+        }
+    }
+
+  vp_plan_assign_ranks(self, base, candidates, old_ranks);
+
+  if (base)
+    {
+      for (handle = 1; handle < first_handle; handle++)
+        self->handle_ranks[handle - 1] = vp_plan_remap_rank(base->handle_ranks[handle - 1], old_ranks);
+      for (i = 0; i < vp->builtins->len; i++)
+        self->builtin_ranks[i] = vp_plan_remap_rank(base->builtin_ranks[i], old_ranks);
+      for (i = 0; i < vp->vpairs->len; i++)
+        self->vpair_ranks[i] = vp_plan_remap_rank(base->vpair_ranks[i], old_ranks);
+    }
+
+  g_free(old_ranks);
+  g_array_free(candidates, TRUE);
+  return self;
+}
+
+static void
+vp_plan_free(VPPlan *self)
+{
+  g_free(self->handle_ranks);
+  g_free(self->builtin_ranks);
+  g_free(self->vpair_ranks);
+  g_ptr_array_free(self->names, TRUE);
+  g_free(self);
+}
+
+/* must be called with plan_lock held.  Formatting threads may still use
+ * a replaced plan, it is freed by vp_free_retired_plans() once there are
+ * no plan users left. */
+static void
+vp_publish_plan(ValuePairs *vp, VPPlan *plan)
+{
+  VPPlan *old_plan = g_atomic_pointer_get(&vp->plan);
+
+  if (old_plan)
+    g_atomic_pointer_set(&vp->retired_plans, g_list_prepend(vp->retired_plans, old_plan));
+  g_atomic_pointer_set(&vp->plan, plan);
+}
 
-  *r &= !func(name, rv->type_hint,
-              rv->value->str,
-              rv->value->len, user_data);
-  return !*r;
+/* Users are counted before they load vp->plan.  Plans are only retired
+ * under plan_lock, so while holding it, no user means that none of the
+ * retired plans is reachable: users starting afterwards can only load the
+ * published one. */
+static void
+vp_free_retired_plans(ValuePairs *vp)
+{
+  if (!g_mutex_trylock(vp->plan_lock))
+    return;
+
+  if (g_atomic_counter_get(&vp->plan_users) == 0)
+    {
+      g_list_free_full(vp->retired_plans, (GDestroyNotify) vp_plan_free);
+      g_atomic_pointer_set(&vp->retired_plans, NULL);
+    }
+  g_mutex_unlock(vp->plan_lock);
 }
 
+static VPPlan *
+vp_update_plan(ValuePairs *vp, GCompareFunc compare_func)
+{
+  VPPlan *plan;
+
+  g_mutex_lock(vp->plan_lock);
+  plan = g_atomic_pointer_get(&vp->plan);
+  if (plan && plan->compare_func != compare_func)
+    {
+      g_mutex_unlock(vp->plan_lock);
+
+      plan = vp_plan_new(vp, compare_func, NULL);
+      plan->transient = TRUE;
+      return plan;
+    }
+
+  if (!plan || plan->num_handles < logmsg_registry->names->len)
+    {
+      plan = vp_plan_new(vp, compare_func, plan);
+      vp_publish_plan(vp, plan);
+    }
+  g_mutex_unlock(vp->plan_lock);
+  return plan;
+}
+
+/* the published plan is immutable, formatting a message only takes a lock
+ * if NVHandles were registered since it was built */
+static VPPlan *
+vp_acquire_plan(ValuePairs *vp, GCompareFunc compare_func)
+{
+  VPPlan *plan;
+
+  g_atomic_counter_inc(&vp->plan_users);
+  plan = g_atomic_pointer_get(&vp->plan);
+
+  if (G_LIKELY(plan &&
+               plan->compare_func == compare_func &&
+               plan->num_handles >= logmsg_registry->names->len))
+    return plan;
+
+  return vp_update_plan(vp, compare_func);
+}
+
+static void
+vp_release_plan(ValuePairs *vp, VPPlan *plan)
+{
+  if (plan->transient)
+    vp_plan_free(plan);
+
+  if (g_atomic_counter_dec_and_test(&vp->plan_users) && g_atomic_pointer_get(&vp->retired_plans))
+    vp_free_retired_plans(vp);
+}
+
+static void
+vp_invalidate_plan(ValuePairs *vp)
+{
+  g_mutex_lock(vp->plan_lock);
+  vp_publish_plan(vp, NULL);
+  g_mutex_unlock(vp->plan_lock);
+}
+
+static gboolean
+vp_results_foreach(VPResults *results, VPForeachFunc func, gpointer user_data)
+{
+  gint word;
+
+  /* ranks are in output order, walk the inserted ones */
+  for (word = 0; word < results->filled_words; word++)
+    {
+      gint bit = -1;
+
+      while ((bit = g_bit_nth_lsf(results->filled[word], bit)) >= 0)
+        {
+          gint32 rank = word * VP_RESULTS_BITS_PER_WORD + bit;
+          VPResultValue *rv = &results->values[rank];
+
+          if (func(g_ptr_array_index(results->plan->names, rank), rv->type_hint,
+                   rv->value->str, rv->value->len, user_data))
+            return FALSE;
+        }
+    }
+  return TRUE;
+}
 
 gboolean
 value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
@@ -428,18 +711,13 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
                             const LogTemplateOptions *template_options,
                             gpointer user_data)
 {
-  gpointer args[] = { vp, func, msg, GINT_TO_POINTER (seq_num), user_data, NULL,
-                      /* remove constness, we are not using that pointer non-const anyway */
-                      (LogTemplateOptions *) template_options, GINT_TO_POINTER(time_zone_mode)
-                    };
-  gboolean result = TRUE;
+  gboolean result;
   VPResults results;
-  gpointer helper_args[] = { &results, func, user_data, &result };
+  gpointer args[] = { vp, &results };
   ScratchBuffersMarker mark;
 
   scratch_buffers_mark(&mark);
-  vp_results_init(&results, compare_func);
-  args[5] = &results;
+  vp_results_init(&results, vp_acquire_plan(vp, compare_func));
 
   /*
    * Build up the base set
@@ -452,10 +730,12 @@ value_pairs_foreach_sorted (ValuePairs *vp, VPForeachFunc func,
   vp_merge_builtins(vp, &results, msg, seq_num, time_zone_mode, template_options);
 
   /* Merge the explicit key-value pairs too */
-  g_ptr_array_foreach(vp->vpairs, (GFunc)vp_pairs_foreach, args);
+  vp_merge_pairs(vp, &results, msg, seq_num, time_zone_mode, template_options);
 
   /* Aaand we run it through the callback! */
-  g_tree_foreach(results.result_tree, (GTraverseFunc)vp_foreach_helper, helper_args);
+  result = vp_results_foreach(&results, func, user_data);
+
+  vp_release_plan(vp, results.plan);
   vp_results_deinit(&results);
   scratch_buffers_reclaim_marked(mark);
 
@@ -853,6 +1133,30 @@ value_pairs_add_glob_patterns(ValuePairs *vp, GList *patterns, gboolean include)
   vp_update_builtin_list_of_values(vp);
 }
 
+/* the selected values only depend on the message and the template options */
+gboolean
+value_pairs_is_cacheable(ValuePairs *vp)
+{
+  gint i;
+
+  for (i = 0; i < vp->builtins->len; i++)
+    {
+      ValuePairSpec *spec = (ValuePairSpec *) g_ptr_array_index(vp->builtins, i);
+
+      if (spec->type == VPT_MACRO && !log_macro_is_cacheable(spec->id))
+        return FALSE;
+    }
+
+  for (i = 0; i < vp->vpairs->len; i++)
+    {
+      VPPairConf *vpc = (VPPairConf *) g_ptr_array_index(vp->vpairs, i);
+
+      if (!log_template_is_cacheable(vpc->template))
+        return FALSE;
+    }
+  return TRUE;
+}
+
 void
 value_pairs_add_pair(ValuePairs *vp, const gchar *key, LogTemplate *value)
 {
@@ -878,6 +1182,7 @@ value_pairs_new(void)
   vp->vpairs = g_ptr_array_new();
   vp->patterns = g_ptr_array_new();
   vp->transforms = g_ptr_array_new();
+  vp->plan_lock = g_mutex_new();
 
   return vp;
 }
@@ -917,6 +1222,10 @@ value_pairs_free (ValuePairs *vp)
     }
   g_ptr_array_free(vp->transforms, TRUE);
   g_ptr_array_free(vp->builtins, TRUE);
+  if (vp->plan)
+    vp_plan_free(vp->plan);
+  g_list_free_full(vp->retired_plans, (GDestroyNotify) vp_plan_free);
+  g_mutex_free(vp->plan_lock);
   g_free(vp);
 }
 
@@ -96,6 +96,7 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "tcp_probe_interval", KW_TCP_PROBE_INTERVAL },
   { "successful_probes_required", KW_SUCCESSFUL_PROBES_REQUIRED },
   { "dynamic_window_size", KW_DYNAMIC_WINDOW_SIZE },
+  { "recv_batch_size",    KW_RECV_BATCH_SIZE },
   { "dynamic_window_stats_freq", KW_DYNAMIC_WINDOW_STATS_FREQ },
   { "dynamic_window_realloc_ticks", KW_DYNAMIC_WINDOW_REALLOC_TICKS },
   { NULL }
@@ -52,6 +52,20 @@ Test(transport_mapper_unix, test_transport_mapper_unix_dgram_apply_transport_set
   assert_transport_mapper_stats_source(transport_mapper, SCS_UNIX_DGRAM);
 }
 
+Test(transport_mapper_unix, test_transport_mapper_unix_dgram_accepts_recv_batch_size)
+{
+  transport_mapper = transport_mapper_unix_dgram_new();
+  transport_mapper_set_recv_batch_size(transport_mapper, 16);
+  assert_transport_mapper_apply(transport_mapper, NULL);
+}
+
+Test(transport_mapper_unix, test_transport_mapper_unix_stream_rejects_recv_batch_size)
+{
+  transport_mapper = transport_mapper_unix_stream_new();
+  transport_mapper_set_recv_batch_size(transport_mapper, 16);
+  assert_transport_mapper_apply_fails(transport_mapper, NULL);
+}
+
 static void
 setup(void)
 {
@@ -40,7 +40,9 @@ struct _TransportMapperUnix
 static LogTransport *
 _create_log_transport(TransportMapper *s, gint fd)
 {
-  if (s->sock_type == SOCK_DGRAM)
+  if (s->sock_type == SOCK_DGRAM && s->recv_batch_size > 1)
+    return log_transport_unix_dgram_socket_batched_new(fd, s->recv_batch_size);
+  else if (s->sock_type == SOCK_DGRAM)
     return log_transport_unix_dgram_socket_new(fd);
   else
     return log_transport_unix_stream_socket_new(fd);
@@ -98,10 +98,28 @@ transport_mapper_apply_transport_method(TransportMapper *self, GlobalConfig *cfg
   return TRUE;
 }
 
+gboolean
+transport_mapper_apply_transport(TransportMapper *self, GlobalConfig *cfg)
+{
+  if (!self->apply_transport(self, cfg))
+    return FALSE;
+
+  /* sock_type is only known once the transport has been applied */
+  if (self->recv_batch_size && self->sock_type != SOCK_DGRAM)
+    {
+      msg_error("recv-batch-size() is only supported for datagram transports",
+                evt_tag_str("transport", self->transport));
+      return FALSE;
+    }
+  return TRUE;
+}
+
 LogTransport *
 transport_mapper_construct_log_transport_method(TransportMapper *self, gint fd)
 {
-  if (self->sock_type == SOCK_DGRAM)
+  if (self->sock_type == SOCK_DGRAM && self->recv_batch_size > 1)
+    return log_transport_batched_dgram_socket_new(fd, self->recv_batch_size);
+  else if (self->sock_type == SOCK_DGRAM)
     return log_transport_dgram_socket_new(fd);
   else
     return log_transport_stream_socket_new(fd);
@@ -120,6 +138,12 @@ transport_mapper_set_address_family(TransportMapper *self, gint address_family)
   self->address_family = address_family;
 }
 
+void
+transport_mapper_set_recv_batch_size(TransportMapper *self, gint recv_batch_size)
+{
+  self->recv_batch_size = recv_batch_size;
+}
+
 void
 transport_mapper_free_method(TransportMapper *self)
 {
@@ -132,6 +156,7 @@ transport_mapper_init_instance(TransportMapper *self, const gchar *transport)
   self->transport = g_strdup(transport);
   self->address_family = -1;
   self->sock_type = -1;
+  self->recv_batch_size = 0;
   self->free_fn = transport_mapper_free_method;
   self->apply_transport = transport_mapper_apply_transport_method;
   self->construct_log_transport = transport_mapper_construct_log_transport_method;
@@ -44,6 +44,8 @@ struct _TransportMapper
   gint sock_proto;
   /* when a proto needs a Multitransport instance */
   gboolean create_multitransport;
+  /* number of datagrams to receive with a single syscall on SOCK_DGRAM sockets, 0 if not set */
+  gint recv_batch_size;
 
   const gchar *logproto;
   gint stats_source;
@@ -57,6 +59,7 @@ struct _TransportMapper
 
 void transport_mapper_set_transport(TransportMapper *self, const gchar *transport);
 void transport_mapper_set_address_family(TransportMapper *self, gint address_family);
+void transport_mapper_set_recv_batch_size(TransportMapper *self, gint recv_batch_size);
 
 gboolean transport_mapper_open_socket(TransportMapper *self,
                                       SocketOptions *socket_options,
@@ -68,16 +71,12 @@ gboolean transport_mapper_open_socket(TransportMapper *self,
 gboolean transport_mapper_apply_transport_method(TransportMapper *self, GlobalConfig *cfg);
 LogTransport *transport_mapper_construct_log_transport_method(TransportMapper *self, gint fd);
 
+gboolean transport_mapper_apply_transport(TransportMapper *self, GlobalConfig *cfg);
+
 void transport_mapper_init_instance(TransportMapper *self, const gchar *transport);
 void transport_mapper_free(TransportMapper *self);
 void transport_mapper_free_method(TransportMapper *self);
 
-static inline gboolean
-transport_mapper_apply_transport(TransportMapper *self, GlobalConfig *cfg)
-{
-  return self->apply_transport(self, cfg);
-}
-
 static inline LogTransport *
 transport_mapper_construct_log_transport(TransportMapper *self, gint fd)
 {
@@ -273,6 +273,41 @@ log_transport_unix_dgram_socket_new(gint fd)
   return &self->super;
 }
 
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+static void
+_unix_dgram_batched_feed_aux(LogTransportBatchedDGramSocket *self, struct msghdr *msg, LogTransportAuxData *aux)
+{
+  if (msg->msg_namelen)
+    log_transport_aux_data_set_peer_addr_ref(aux, g_sockaddr_new((struct sockaddr *) msg->msg_name, msg->msg_namelen));
+
+  _feed_aux_from_cmsg(aux, msg);
+}
+
+LogTransport *
+log_transport_unix_dgram_socket_batched_new(gint fd, gint batch_size)
+{
+  LogTransportBatchedDGramSocket *self = g_new0(LogTransportBatchedDGramSocket, 1);
+
+  log_transport_batched_dgram_socket_init_instance(self, fd, batch_size);
+  self->feed_aux = _unix_dgram_batched_feed_aux;
+#if defined(SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR)
+  self->control_size = 32;
+#endif
+
+  return &self->super.super;
+}
+
+#else
+
+LogTransport *
+log_transport_unix_dgram_socket_batched_new(gint fd, gint batch_size)
+{
+  return log_transport_unix_dgram_socket_new(fd);
+}
+
+#endif
+
 static gssize
 log_transport_unix_stream_socket_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
 {
@@ -35,6 +35,8 @@ typedef struct _CSVParser
   gboolean drop_invalid;
   gchar *prefix;
   gint prefix_len;
+  NVHandle *column_handles;
+  NVHandle value_ref_handle;
 } CSVParser;
 
 #define CSV_PARSER_FLAGS_SHIFT 16
@@ -110,26 +112,29 @@ csv_parser_set_drop_invalid(LogParser *s, gboolean drop_invalid)
   self->drop_invalid = drop_invalid;
 }
 
-static const gchar *
-_format_key_for_prefix(GString *scratch, const gchar *key, const gint prefix_len)
+static NVHandle
+_resolve_column_handle(CSVParser *self, GString *name, const gchar *column)
 {
-  g_string_truncate(scratch, prefix_len);
-  g_string_append(scratch, key);
-  return scratch->str;
-}
-
-static const gchar *
-_return_key(GString *scratch, const gchar *key, const gint prefix_len)
-{
-  return key;
+  g_string_truncate(name, 0);
+  if (self->prefix)
+    g_string_append_len(name, self->prefix, self->prefix_len);
+  g_string_append(name, column);
+  return log_msg_get_value_handle(name->str);
 }
 
-typedef const gchar *(*key_formatter_t)(GString *scratch, const gchar *key, const gint prefix_len);
-
-static key_formatter_t
-dispatch_key_formatter(gchar *prefix)
+static void
+_store_current_value(CSVParser *self, LogMessage *msg, CSVScanner *scanner, NVHandle handle)
 {
-  return prefix ? _format_key_for_prefix : _return_key;
+  gint len = csv_scanner_get_current_value_len(scanner);
+  gsize ofs;
+
+  if (self->value_ref_handle != LM_V_NONE &&
+      log_msg_is_handle_settable_with_an_indirect_value(handle) &&
+      csv_scanner_is_current_value_in_input(scanner, &ofs) &&
+      len > 0 && ofs + len <= G_MAXUINT16)
+    log_msg_set_value_indirect(msg, handle, self->value_ref_handle, 0, ofs, len);
+  else
+    log_msg_set_value(msg, handle, csv_scanner_get_current_value(scanner), len);
 }
 
 static gboolean
@@ -146,18 +151,24 @@ csv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_o
   CSVScanner scanner;
   csv_scanner_init(&scanner, &self->options, input);
 
-  GString *key_scratch = scratch_buffers_alloc();
-  if (self->prefix)
-    g_string_assign(key_scratch, self->prefix);
-
-  key_formatter_t _key_formatter = dispatch_key_formatter(self->prefix);
+  GString *name = NULL;
+  gint column = 0;
   while (csv_scanner_scan_next(&scanner))
     {
-
-      log_msg_set_value_by_name(msg,
-                                _key_formatter(key_scratch, csv_scanner_get_current_name(&scanner), self->prefix_len),
-                                csv_scanner_get_current_value(&scanner),
-                                csv_scanner_get_current_value_len(&scanner));
+      NVHandle handle;
+
+      if (self->column_handles)
+        {
+          handle = self->column_handles[column++];
+        }
+      else
+        {
+          /* not initialized, e.g. in unit tests */
+          if (!name)
+            name = scratch_buffers_alloc();
+          handle = _resolve_column_handle(self, name, csv_scanner_get_current_name(&scanner));
+        }
+      _store_current_value(self, msg, &scanner, handle);
     }
 
   gboolean result = TRUE;
@@ -168,6 +179,35 @@ csv_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_o
   return result;
 }
 
+/*
+ * Column names are resolved to handles only once.  Without a template,
+ * the input is the value of MESSAGE, so unquoted columns are stored as
+ * indirect values referencing it, unless a column overwrites MESSAGE.
+ */
+static gboolean
+csv_parser_init(LogPipe *s)
+{
+  CSVParser *self = (CSVParser *) s;
+  GString *name = g_string_sized_new(64);
+  GList *l;
+  gint i;
+
+  /* one extra slot, so that it is non-NULL even without columns */
+  g_free(self->column_handles);
+  self->column_handles = g_new(NVHandle, g_list_length(self->options.columns) + 1);
+  self->value_ref_handle = self->super.template ? LM_V_NONE : LM_V_MESSAGE;
+
+  for (l = self->options.columns, i = 0; l; l = l->next, i++)
+    {
+      self->column_handles[i] = _resolve_column_handle(self, name, l->data);
+      if (self->column_handles[i] == LM_V_MESSAGE)
+        self->value_ref_handle = LM_V_NONE;
+    }
+  g_string_free(name, TRUE);
+
+  return log_parser_init_method(s);
+}
+
 static LogPipe *
 csv_parser_clone(LogPipe *s)
 {
@@ -189,6 +229,7 @@ csv_parser_free(LogPipe *s)
 
   csv_scanner_options_clean(&self->options);
   g_free(self->prefix);
+  g_free(self->column_handles);
   log_parser_free_method(s);
 }
 
@@ -201,6 +242,7 @@ csv_parser_new(GlobalConfig *cfg)
   CSVParser *self = g_new0(CSVParser, 1);
 
   log_parser_init_instance(&self->super, cfg);
+  self->super.super.init = csv_parser_init;
   self->super.super.free_fn = csv_parser_free;
   self->super.super.clone = csv_parser_clone;
   self->super.process = csv_parser_process;
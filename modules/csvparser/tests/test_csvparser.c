@@ -944,6 +944,64 @@ ParameterizedTest(CsvParserTestParam *param, parser, test_csv_parser)
   log_msg_unref(logmsg);
 }
 
+static LogParser *
+_create_initialized_parser(const gchar *column_array[])
+{
+  const gchar *string_delims[] = { "::", NULL };
+  LogParser *p = csv_parser_new(configuration);
+
+  csv_scanner_options_set_delimiters(csv_parser_get_scanner_options(p), ",");
+  csv_scanner_options_set_null_value(csv_parser_get_scanner_options(p), "-");
+  csv_scanner_options_set_string_delimiters(csv_parser_get_scanner_options(p), string_array_to_list(string_delims));
+  csv_scanner_options_set_columns(csv_parser_get_scanner_options(p), string_array_to_list(column_array));
+  cr_assert(log_pipe_init(&p->super));
+  return p;
+}
+
+static LogMessage *
+_parse_with_initialized_parser(LogParser *p, const gchar *input)
+{
+  LogMessage *msg = log_msg_new_empty();
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  log_msg_set_value(msg, LM_V_MESSAGE, input, -1);
+  cr_assert(log_parser_process_message(p, &msg, &path_options));
+  return msg;
+}
+
+Test(parser, test_csv_parser_values_survive_changing_the_message)
+{
+  const gchar *column_array[] = { "C1", "C2", "C3", "C4", NULL };
+  LogParser *p = _create_initialized_parser(column_array);
+  LogMessage *msg = _parse_with_initialized_parser(p, "foo,\"quoted, value\" ,-::bar baz  ");
+
+  log_msg_set_value(msg, LM_V_MESSAGE, "overwritten", -1);
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "C1", NULL), "foo");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "C2", NULL), "quoted, value");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "C3", NULL), "");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "C4", NULL), "bar baz");
+
+  log_msg_unref(msg);
+  log_pipe_deinit(&p->super);
+  log_pipe_unref(&p->super);
+}
+
+Test(parser, test_csv_parser_with_a_column_overwriting_the_message)
+{
+  const gchar *column_array[] = { "C1", "MESSAGE", "C2", NULL };
+  LogParser *p = _create_initialized_parser(column_array);
+  LogMessage *msg = _parse_with_initialized_parser(p, "foo,bar,baz");
+
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "C1", NULL), "foo");
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), "bar");
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "C2", NULL), "baz");
+
+  log_msg_unref(msg);
+  log_pipe_deinit(&p->super);
+  log_pipe_unref(&p->super);
+}
+
 void setup(void)
 {
   app_startup();
@@ -1128,6 +1128,29 @@ GMarkupParser db_parser =
   .error = NULL
 };
 
+/* the trees are complete once loading finishes, flatten them for faster lookups */
+static void
+_compile_program_rules(RNode *node)
+{
+  gint i;
+
+  if (node->value)
+    r_compile_tree(((PDBProgram *) node->value)->rules);
+
+  for (i = 0; i < node->num_children; i++)
+    _compile_program_rules(node->children[i]);
+
+  for (i = 0; i < node->num_pchildren; i++)
+    _compile_program_rules(node->pchildren[i]);
+}
+
+static void
+_compile_radix_trees(RNode *programs)
+{
+  _compile_program_rules(programs);
+  r_compile_tree(programs);
+}
+
 gboolean
 pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GList **examples)
 {
@@ -1183,6 +1206,7 @@ pdb_rule_set_load(PDBRuleSet *self, GlobalConfig *cfg, const gchar *config, GLis
   if (state.load_examples)
     *examples = state.examples;
 
+  _compile_radix_trees(self->programs);
   success = TRUE;
 
 error:
@@ -1029,6 +1029,161 @@ pdbtool_dictionary(int argc, char *argv[])
   return 0;
 }
 
+static gint benchmark_iterations = 1000;
+
+typedef struct _PdbToolBenchmarkSample
+{
+  gchar *program;
+  gchar *message;
+} PdbToolBenchmarkSample;
+
+static void
+pdbtool_benchmark_free_compiled_rules(RNode *root)
+{
+  gint i;
+
+  if (root->value)
+    r_free_compiled_tree(((PDBProgram *) root->value)->rules);
+
+  for (i = 0; i < root->num_children; i++)
+    pdbtool_benchmark_free_compiled_rules(root->children[i]);
+
+  for (i = 0; i < root->num_pchildren; i++)
+    pdbtool_benchmark_free_compiled_rules(root->pchildren[i]);
+}
+
+static gint
+pdbtool_benchmark_lookup(RNode *programs, PdbToolBenchmarkSample *sample, GArray *matches)
+{
+  RNode *node;
+  gint matched = 0;
+  gint i;
+
+  node = r_find_node(programs, sample->program, strlen(sample->program), NULL);
+  if (node && node->value)
+    {
+      g_array_set_size(matches, 1);
+      if (r_find_node(((PDBProgram *) node->value)->rules, sample->message, strlen(sample->message), matches))
+        matched = 1;
+
+      for (i = 0; i < matches->len; i++)
+        {
+          RParserMatch *match = &g_array_index(matches, RParserMatch, i);
+
+          g_free(match->match);
+        }
+      g_array_set_size(matches, 0);
+    }
+  return matched;
+}
+
+static void
+pdbtool_benchmark_run(const gchar *name, RNode *programs, GArray *samples)
+{
+  GArray *matches = g_array_new(FALSE, TRUE, sizeof(RParserMatch));
+  gint64 start, elapsed;
+  gint64 lookups = 0, matched = 0;
+  gint i, j;
+
+  start = g_get_monotonic_time();
+  for (i = 0; i < benchmark_iterations; i++)
+    {
+      for (j = 0; j < samples->len; j++)
+        matched += pdbtool_benchmark_lookup(programs, &g_array_index(samples, PdbToolBenchmarkSample, j), matches);
+      lookups += samples->len;
+    }
+  elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+  printf("%-10s lookups=%" G_GINT64_FORMAT " matched=%" G_GINT64_FORMAT " elapsed_usec=%" G_GINT64_FORMAT
+         " lookups_per_sec=%.0f\n",
+         name, lookups, matched, elapsed, (gdouble) lookups * G_USEC_PER_SEC / elapsed);
+  g_array_free(matches, TRUE);
+}
+
+static gint
+pdbtool_benchmark(int argc, char *argv[])
+{
+  PDBRuleSet *rule_set = pdb_rule_set_new();
+  GList *examples = NULL, *l;
+  GArray *samples;
+  PdbToolBenchmarkSample sample;
+  gint i;
+
+  if (!pdb_rule_set_load(rule_set, configuration, patterndb_file, &examples))
+    {
+      pdb_rule_set_free(rule_set);
+      return 1;
+    }
+
+  samples = g_array_new(FALSE, TRUE, sizeof(PdbToolBenchmarkSample));
+  if (match_message)
+    {
+      sample.program = g_strdup(match_program ? : "");
+      sample.message = g_strdup(match_message);
+      g_array_append_val(samples, sample);
+    }
+  else
+    {
+      for (l = examples; l; l = l->next)
+        {
+          PDBExample *example = (PDBExample *) l->data;
+
+          if (!example->message || !example->program)
+            continue;
+          sample.program = g_strdup(example->program);
+          sample.message = g_strdup(example->message);
+          g_array_append_val(samples, sample);
+        }
+    }
+  g_list_free_full(examples, (GDestroyNotify) pdb_example_free);
+
+  if (samples->len == 0)
+    {
+      fprintf(stderr, "No messages to look up, specify one using -M or add examples to the patterndb file\n");
+      g_array_free(samples, TRUE);
+      pdb_rule_set_free(rule_set);
+      return 1;
+    }
+
+  printf("Benchmarking %u messages, %d iterations\n", samples->len, benchmark_iterations);
+
+  /* pdb_rule_set_load() compiles the trees, measure that first */
+  pdbtool_benchmark_run("compiled", rule_set->programs, samples);
+  pdbtool_benchmark_free_compiled_rules(rule_set->programs);
+  r_free_compiled_tree(rule_set->programs);
+  pdbtool_benchmark_run("tree", rule_set->programs, samples);
+
+  for (i = 0; i < samples->len; i++)
+    {
+      g_free(g_array_index(samples, PdbToolBenchmarkSample, i).program);
+      g_free(g_array_index(samples, PdbToolBenchmarkSample, i).message);
+    }
+  g_array_free(samples, TRUE);
+  pdb_rule_set_free(rule_set);
+  return 0;
+}
+
+static GOptionEntry benchmark_options[] =
+{
+  {
+    "pdb",       'p', 0, G_OPTION_ARG_STRING, &patterndb_file,
+    "Name of the patterndb file", "<patterndb_file>"
+  },
+  {
+    "program", 'P', 0, G_OPTION_ARG_STRING, &match_program,
+    "Program name to look up as $PROGRAM", "<program>"
+  },
+  {
+    "message", 'M', 0, G_OPTION_ARG_STRING, &match_message,
+    "Message to look up instead of the examples in the patterndb file", "<message>"
+  },
+  {
+    "iterations", 'n', 0, G_OPTION_ARG_INT, &benchmark_iterations,
+    "Number of times to look up each message (default: 1000)", "<n>"
+  },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
+};
+
 static gboolean
 pdbtool_load_module(const gchar *option_name, const gchar *value, gpointer data, GError **error)
 {
@@ -1179,6 +1334,7 @@ static struct
   { "test", test_options, "Test pattern databases", pdbtool_test },
   { "patternize", patternize_options, "Create a pattern database from logs", pdbtool_patternize },
   { "dictionary", dictionary_options, "Dump pattern dictionary", pdbtool_dictionary },
+  { "benchmark", benchmark_options, "Measure pattern database lookup performance", pdbtool_benchmark },
   { NULL, NULL },
 };
 
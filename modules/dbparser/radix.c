@@ -931,6 +931,9 @@ r_insert_node(RNode *root, gchar *key, gpointer value, RNodeGetValueFunc value_f
   gint nodelen = root->keylen;
   gint i = 0;
 
+  /* the flattened copy would not reflect the new node */
+  r_free_compiled_tree(root);
+
   if (key[0] == '@')
     {
       gchar *end;
@@ -1169,35 +1172,35 @@ _truncate_debug_info(RFindNodeState *state, gint truncated_size)
 }
 
 static void
-_find_matching_literal_prefix(RNode *root, gchar *key, gint keylen,
-                              gint *literal_prefix_inputlen,
-                              gint *literal_prefix_radixlen)
+_match_literal_prefix(const gchar *radix_key, gint radix_keylen, gchar *key, gint keylen,
+                      gint *literal_prefix_inputlen,
+                      gint *literal_prefix_radixlen)
 {
-  gint current_node_key_length = root->keylen;
   gint input_length;
   gint radix_length;
 
-  if (current_node_key_length < 1)
+  if (radix_keylen < 1)
     radix_length = input_length = 0;
+  else if (keylen >= radix_keylen && memcmp(key, radix_key, radix_keylen) == 0)
+    {
+      /* the whole literal matches verbatim, which is the common case
+       * during successful lookups, let memcmp() do the work */
+      input_length = radix_length = radix_keylen;
+    }
   else
     {
       /* this is a prefix match algorithm, we are interested how long the
-       * common part between key and root->key is.  Currently this uses a
-       * byte-by-byte comparison, using a 64/32/16 bit units would be
-       * better.  We had a PoC code to do that, and the performance
-       * difference wasn't big enough to offset the complexity so it was
-       * removed. We might want to rerun perf tests and see if we could
-       * speed things up, but db-parser() seems fast enough as it is.
-       */
+       * common part between key and the literal is, with the twist of
+       * skipping CRs in the input where the radix has a newline. */
       input_length = radix_length = 0;
-      while (input_length < keylen && radix_length < current_node_key_length)
+      while (input_length < keylen && radix_length < radix_keylen)
         {
-          if (key[input_length] == '\r' && root->key[radix_length] == '\n')
+          if (key[input_length] == '\r' && radix_key[radix_length] == '\n')
             {
               /* skip CR from input if the radix contains a newline */
               input_length++;
             }
-          if (key[input_length] != root->key[radix_length])
+          if (key[input_length] != radix_key[radix_length])
             break;
 
           input_length++;
@@ -1208,6 +1211,14 @@ _find_matching_literal_prefix(RNode *root, gchar *key, gint keylen,
   *literal_prefix_radixlen = radix_length;
 }
 
+static void
+_find_matching_literal_prefix(RNode *root, gchar *key, gint keylen,
+                              gint *literal_prefix_inputlen,
+                              gint *literal_prefix_radixlen)
+{
+  _match_literal_prefix(root->key, root->keylen, key, keylen, literal_prefix_inputlen, literal_prefix_radixlen);
+}
+
 static RNode *
 _find_child_by_remaining_key(RFindNodeState *state, RNode *root, gchar *remaining_key, gint remaining_keylen)
 {
@@ -1439,6 +1450,306 @@ _find_node_recursively(RFindNodeState *state, RNode *root, gchar *key, gint keyl
   return NULL;
 }
 
+/**************************************************************
+ * Compiled (flattened) trees.
+ *
+ * r_compile_tree() lays out a finished tree in a handful of contiguous
+ * arrays: nodes are stored in depth-first order, literal keys are
+ * concatenated into a single buffer and literal children are found by
+ * indexing a per-node table with the first byte of the remaining key,
+ * instead of a binary search over child pointers.  The parsers of a node
+ * are stored inline along with their first/last character range, so
+ * parsers that cannot match are skipped without dereferencing them.
+ *
+ * Lookups return the original RNode, so compiled and non-compiled trees
+ * are interchangeable for the callers of r_find_node().
+ **************************************************************/
+
+typedef struct _RFlatNode
+{
+  RNode *node;
+  guint32 key_ofs;
+  gint32 keylen;
+
+  /* literal children: child_table[children_ofs + c - children_first] */
+  guint32 children_ofs;
+  guint16 children_span;
+  guchar children_first;
+
+  guint32 pchildren_ofs;
+  guint32 num_pchildren;
+} RFlatNode;
+
+typedef struct _RFlatParser
+{
+  gchar first;
+  gchar last;
+  RParserNode *parser;
+  guint32 child;
+} RFlatParser;
+
+struct _RFlatTree
+{
+  RFlatNode *nodes;
+  guint32 num_nodes;
+  gchar *keys;
+  /* 0 is used for empty slots, the root is never a child */
+  guint32 *child_table;
+  RFlatParser *parsers;
+};
+
+typedef struct _RFlatTreeBuilder
+{
+  GArray *nodes;
+  GString *keys;
+  GArray *child_table;
+  GArray *parsers;
+} RFlatTreeBuilder;
+
+static guint32
+_flatten_node(RFlatTreeBuilder *builder, RNode *node)
+{
+  guint32 ndx = builder->nodes->len;
+  RFlatNode flat_node = { 0 };
+  gint i;
+
+  flat_node.node = node;
+  flat_node.keylen = node->keylen;
+  flat_node.key_ofs = builder->keys->len;
+  if (node->keylen > 0)
+    g_string_append_len(builder->keys, node->key, node->keylen);
+
+  if (node->num_children > 0)
+    {
+      /* children are sorted by their first character as a signed char,
+       * so we need to look at all of them to find the byte range */
+      guchar first = G_MAXUINT8, last = 0;
+
+      for (i = 0; i < node->num_children; i++)
+        {
+          guchar c = (guchar) node->children[i]->key[0];
+
+          first = MIN(first, c);
+          last = MAX(last, c);
+        }
+      flat_node.children_first = first;
+      flat_node.children_span = last - first + 1;
+      flat_node.children_ofs = builder->child_table->len;
+      g_array_set_size(builder->child_table, builder->child_table->len + flat_node.children_span);
+    }
+
+  flat_node.pchildren_ofs = builder->parsers->len;
+  flat_node.num_pchildren = node->num_pchildren;
+  g_array_set_size(builder->parsers, builder->parsers->len + node->num_pchildren);
+
+  g_array_append_val(builder->nodes, flat_node);
+
+  for (i = 0; i < node->num_children; i++)
+    {
+      guint32 child = _flatten_node(builder, node->children[i]);
+      guchar c = (guchar) node->children[i]->key[0];
+
+      g_array_index(builder->child_table, guint32, flat_node.children_ofs + c - flat_node.children_first) = child;
+    }
+
+  for (i = 0; i < node->num_pchildren; i++)
+    {
+      RParserNode *parser_node = node->pchildren[i]->parser;
+      guint32 child = _flatten_node(builder, node->pchildren[i]);
+      RFlatParser *flat_parser = &g_array_index(builder->parsers, RFlatParser, flat_node.pchildren_ofs + i);
+
+      flat_parser->first = parser_node->first;
+      flat_parser->last = parser_node->last;
+      flat_parser->parser = parser_node;
+      flat_parser->child = child;
+    }
+  return ndx;
+}
+
+static void
+_free_flat_tree(RFlatTree *self)
+{
+  g_free(self->nodes);
+  g_free(self->keys);
+  g_free(self->child_table);
+  g_free(self->parsers);
+  g_free(self);
+}
+
+static RFlatTree *
+_compile_flat_tree(RNode *root)
+{
+  RFlatTreeBuilder builder;
+  RFlatTree *self = g_new0(RFlatTree, 1);
+
+  builder.nodes = g_array_new(FALSE, TRUE, sizeof(RFlatNode));
+  builder.keys = g_string_new("");
+  builder.child_table = g_array_new(FALSE, TRUE, sizeof(guint32));
+  builder.parsers = g_array_new(FALSE, TRUE, sizeof(RFlatParser));
+
+  _flatten_node(&builder, root);
+
+  self->num_nodes = builder.nodes->len;
+  self->nodes = (RFlatNode *) g_array_free(builder.nodes, FALSE);
+  self->keys = g_string_free(builder.keys, FALSE);
+  self->child_table = (guint32 *) g_array_free(builder.child_table, FALSE);
+  self->parsers = (RFlatParser *) g_array_free(builder.parsers, FALSE);
+  return self;
+}
+
+static RNode *_find_flat_node_recursively(RFindNodeState *state, RFlatTree *tree, guint32 ndx,
+                                          gchar *key, gint keylen);
+
+static inline RFlatNode *
+_flat_find_child_by_first_character(RFlatTree *tree, RFlatNode *flat_node, gchar key)
+{
+  guint c = (guchar) key - flat_node->children_first;
+
+  if (c >= flat_node->children_span)
+    return NULL;
+
+  guint32 child = tree->child_table[flat_node->children_ofs + c];
+  return child ? &tree->nodes[child] : NULL;
+}
+
+static RNode *
+_find_flat_child_by_remaining_key(RFindNodeState *state, RFlatTree *tree, RFlatNode *flat_node,
+                                  gchar *remaining_key, gint remaining_keylen)
+{
+  RFlatNode *candidate;
+
+  if (remaining_keylen >= 2 && remaining_key[0] == '\r' && remaining_key[1] == '\n')
+    {
+      remaining_key++;
+      remaining_keylen--;
+    }
+  candidate = _flat_find_child_by_first_character(tree, flat_node, remaining_key[0]);
+  if (candidate)
+    return _find_flat_node_recursively(state, tree, candidate - tree->nodes, remaining_key, remaining_keylen);
+  return NULL;
+}
+
+static RNode *
+_try_parse_with_a_given_flat_parser(RFindNodeState *state, RFlatTree *tree, RFlatParser *flat_parser,
+                                    gint matches_slot_index, gchar *remaining_key, gint remaining_keylen)
+{
+  RParserNode *parser_node = flat_parser->parser;
+  RParserMatch *match_slot;
+  gint extracted_match_len;
+  RNode *ret;
+
+  if (remaining_key[0] < flat_parser->first || remaining_key[0] > flat_parser->last)
+    return NULL;
+
+  match_slot = _clear_match_slot(state, matches_slot_index);
+  if (!parser_node->parse(remaining_key, &extracted_match_len, parser_node->param, parser_node->state, match_slot))
+    return NULL;
+
+  ret = _find_flat_node_recursively(state, tree, flat_parser->child, remaining_key + extracted_match_len,
+                                    remaining_keylen - extracted_match_len);
+
+  /* the GArray may have been reallocated by the recursion */
+  match_slot = _get_match_slot(state, matches_slot_index);
+  if (match_slot)
+    {
+      if (ret)
+        _fixup_match_offsets(state, parser_node, extracted_match_len, remaining_key, match_slot);
+      else
+        _clear_match_content(match_slot);
+    }
+  return ret;
+}
+
+static RNode *
+_find_flat_child_by_parser(RFindNodeState *state, RFlatTree *tree, RFlatNode *flat_node,
+                           gchar *remaining_key, gint remaining_keylen)
+{
+  RFlatParser *flat_parsers = &tree->parsers[flat_node->pchildren_ofs];
+  gint matches_slot_index;
+  gint parser_ndx;
+  RNode *ret = NULL;
+
+  if (flat_node->num_pchildren == 0)
+    return NULL;
+
+  matches_slot_index = _alloc_slot_in_matches(state);
+  for (parser_ndx = 0; !ret && parser_ndx < flat_node->num_pchildren; parser_ndx++)
+    ret = _try_parse_with_a_given_flat_parser(state, tree, &flat_parsers[parser_ndx], matches_slot_index,
+                                              remaining_key, remaining_keylen);
+
+  if (!ret)
+    _reset_matches_to_original_state(state, matches_slot_index);
+  return ret;
+}
+
+/* this mirrors _find_node_recursively() above, without debug info and
+ * without collecting applicable nodes, those always use the tree */
+static RNode *
+_find_flat_node_recursively(RFindNodeState *state, RFlatTree *tree, guint32 ndx, gchar *key, gint keylen)
+{
+  RFlatNode *flat_node = &tree->nodes[ndx];
+  gint literal_prefix_inputlen, literal_prefix_radixlen;
+
+  _match_literal_prefix(&tree->keys[flat_node->key_ofs], flat_node->keylen, key, keylen,
+                        &literal_prefix_inputlen,
+                        &literal_prefix_radixlen);
+
+  if (literal_prefix_inputlen == keylen && (literal_prefix_radixlen == flat_node->keylen || flat_node->keylen == -1))
+    {
+      /* key completely consumed by the literal */
+      if (flat_node->node->value)
+        return flat_node->node;
+    }
+  else if ((flat_node->keylen < 1) || (literal_prefix_inputlen < keylen && literal_prefix_radixlen >= flat_node->keylen))
+    {
+      RNode *ret;
+      gchar *remaining_key = key + literal_prefix_inputlen;
+      gint remaining_keylen = keylen - literal_prefix_inputlen;
+
+      ret = _find_flat_child_by_remaining_key(state, tree, flat_node, remaining_key, remaining_keylen);
+
+      if (!ret)
+        ret = _find_flat_child_by_parser(state, tree, flat_node, remaining_key, remaining_keylen);
+
+      if (!ret && flat_node->node->value)
+        {
+          if (!state->require_complete_match)
+            return flat_node->node;
+          state->partial_match_found = TRUE;
+        }
+
+      return ret;
+    }
+
+  return NULL;
+}
+
+void
+r_compile_tree(RNode *root)
+{
+  r_free_compiled_tree(root);
+  root->compiled = _compile_flat_tree(root);
+}
+
+void
+r_free_compiled_tree(RNode *root)
+{
+  if (root->compiled)
+    {
+      _free_flat_tree(root->compiled);
+      root->compiled = NULL;
+    }
+}
+
+static RNode *
+_find_node_from_root(RFindNodeState *state, RNode *root, gchar *key, gint keylen)
+{
+  /* debug info refers to the nodes visited, we use the tree for that */
+  if (root->compiled && !state->dbg_list && !state->applicable_nodes)
+    return _find_flat_node_recursively(state, root->compiled, 0, key, keylen);
+  return _find_node_recursively(state, root, key, keylen);
+}
+
 static RNode *
 _find_node_with_state(RFindNodeState *state, RNode *root, gchar *key, gint keylen)
 {
@@ -1446,11 +1757,11 @@ _find_node_with_state(RFindNodeState *state, RNode *root, gchar *key, gint keyle
 
   state->require_complete_match = TRUE;
   state->partial_match_found = FALSE;
-  ret = _find_node_recursively(state, root, key, keylen);
+  ret = _find_node_from_root(state, root, key, keylen);
   if (!ret && state->partial_match_found)
     {
       state->require_complete_match = FALSE;
-      ret = _find_node_recursively(state, root, key, keylen);
+      ret = _find_node_from_root(state, root, key, keylen);
     }
   return ret;
 }
@@ -1524,6 +1835,8 @@ r_new_node(const gchar *key, gpointer value)
   node->num_pchildren = 0;
   node->pchildren = NULL;
 
+  node->compiled = NULL;
+
   return node;
 }
 
@@ -1547,6 +1860,8 @@ r_free_node(RNode *node, void (*free_fn)(gpointer data))
   if (node->key)
     g_free(node->key);
 
+  r_free_compiled_tree(node);
+
   if (node->value && free_fn)
     free_fn(node->value);
 
@@ -85,6 +85,7 @@ typedef struct _RParserNode
 typedef gchar *(*RNodeGetValueFunc) (gpointer value);
 
 typedef struct _RNode RNode;
+typedef struct _RFlatTree RFlatTree;
 
 struct _RNode
 {
@@ -97,6 +98,10 @@ struct _RNode
 
   guint num_pchildren;
   RNode **pchildren;
+
+  /* flattened copy of the tree below this node, only set on roots
+   * compiled with r_compile_tree() */
+  RFlatTree *compiled;
 };
 
 typedef struct _RDebugInfo
@@ -152,6 +157,8 @@ void r_insert_node(RNode *root, gchar *key, gpointer value, RNodeGetValueFunc va
 RNode *r_find_node(RNode *root, gchar *key, gint keylen, GArray *matches);
 RNode *r_find_node_dbg(RNode *root, gchar *key, gint keylen, GArray *matches, GArray *dbg_list);
 gchar **r_find_all_applicable_nodes(RNode *root, gchar *key, gint keylen, RNodeGetValueFunc value_func);
+void r_compile_tree(RNode *root);
+void r_free_compiled_tree(RNode *root);
 
 #endif
 
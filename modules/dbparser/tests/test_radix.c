@@ -1047,6 +1047,47 @@ ParameterizedTest(RadixTestParam *param, dbparser, test_radix_search_matches, .i
     insert_node(root, param->node_to_insert[i]);
 
   test_search_matches(root, param->key, param->expected_pattern);
+
+  r_compile_tree(root);
+  test_search_matches(root, param->key, param->expected_pattern);
+  r_free_node(root, NULL);
+}
+
+Test(dbparser, test_compiled_tree_gives_the_same_results, .init = test_setup, .fini = test_teardown)
+{
+  const gchar *keys[] =
+  {
+    "alma", "almafa", "almabor", "al", "ko", "korom", "koromporkolt", "uj\nsor",
+    "a@NUMBER:szamx@aaa", "a@NUMBER@", "a@@ab", "@@a", "\xe1rv\xedzt\xfbr\xf5",
+    "xxx@ESTRING::@x", "xxx@QSTRING:q:'@", "xxx@IPv4:ip@ port @NUMBER:port@",
+    NULL
+  };
+  const gchar *lookups[] =
+  {
+    "alma", "almaf", "almafa2", "a", "kor", "koromp", "uj\r\nsor", "uj",
+    "a123aaa", "a123", "a@ab", "@a", "\xe1rv\xedzt\xfbr\xf5", "\xe1rv",
+    "xxxfoo:x", "xxx'bar'", "xxx10.0.0.1 port 22", "xxx10.0.0.1 port x", "",
+    NULL
+  };
+  RNode *root = r_new_node("", NULL);
+  RNode *expected[G_N_ELEMENTS(lookups)];
+
+  for (gint i = 0; keys[i]; i++)
+    insert_node(root, keys[i]);
+
+  for (gint i = 0; lookups[i]; i++)
+    expected[i] = r_find_node(root, (gchar *) lookups[i], strlen(lookups[i]), NULL);
+
+  r_compile_tree(root);
+  for (gint i = 0; lookups[i]; i++)
+    cr_expect_eq(r_find_node(root, (gchar *) lookups[i], strlen(lookups[i]), NULL), expected[i],
+                 "compiled lookup differs from the tree, key=%s", lookups[i]);
+
+  /* inserting drops the compiled copy, so the new node is found */
+  insert_node(root, "uj");
+  cr_expect_null(root->compiled);
+  test_search(root, "uj", TRUE);
+
   r_free_node(root, NULL);
 }
 
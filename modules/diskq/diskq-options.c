@@ -54,12 +54,46 @@ disk_queue_options_disk_buf_size_set(DiskQueueOptions *self, gint64 disk_buf_siz
   self->disk_buf_size = disk_buf_size;
 }
 
+void
+disk_queue_options_segment_size_set(DiskQueueOptions *self, gint64 segment_size)
+{
+  if (segment_size > 0 && segment_size < MIN_SEGMENT_SIZE)
+    {
+      msg_warning("WARNING: The configured segment size is smaller than the minimum allowed",
+                  evt_tag_long("configured_size", segment_size),
+                  evt_tag_long("minimum_allowed_size", MIN_SEGMENT_SIZE),
+                  evt_tag_long("new_size", MIN_SEGMENT_SIZE));
+      segment_size = MIN_SEGMENT_SIZE;
+    }
+  self->segment_size = segment_size;
+}
+
 void
 disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable)
 {
   self->reliable = reliable;
 }
 
+void
+disk_queue_options_group_commit_set(DiskQueueOptions *self, gboolean group_commit)
+{
+  self->group_commit = group_commit;
+}
+
+void
+disk_queue_options_group_commit_max_latency_set(DiskQueueOptions *self, gint max_latency)
+{
+  if (max_latency < 1)
+    {
+      msg_warning("WARNING: The configured group commit latency is smaller than the minimum allowed",
+                  evt_tag_int("configured_latency", max_latency),
+                  evt_tag_int("minimum_allowed_latency", 1),
+                  evt_tag_int("new_latency", 1));
+      max_latency = 1;
+    }
+  self->group_commit_max_latency = max_latency;
+}
+
 void
 disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction)
 {
@@ -94,6 +128,18 @@ disk_queue_options_check_plugin_settings(DiskQueueOptions *self)
         {
           msg_warning("WARNING: mem-buf-size parameter was ignored as it is not compatible with non-reliable queue. Did you mean mem-buf-length?");
         }
+      if (self->group_commit)
+        {
+          msg_warning("WARNING: group-commit parameter was ignored as it is only supported by reliable queues");
+          self->group_commit = FALSE;
+        }
+    }
+
+  if (self->segment_size > 0 && self->disk_buf_size > 0 && self->segment_size > self->disk_buf_size)
+    {
+      msg_warning("WARNING: segment-size is larger than disk-buf-size, the disk-queue will not be able to hold more than a single segment",
+                  evt_tag_long("segment_size", self->segment_size),
+                  evt_tag_long("disk_buf_size", self->disk_buf_size));
     }
 }
 
@@ -127,6 +173,9 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->reliable = FALSE;
   self->mem_buf_size = -1;
   self->qout_size = -1;
+  self->segment_size = 0;
+  self->group_commit = FALSE;
+  self->group_commit_max_latency = DEFAULT_GROUP_COMMIT_MAX_LATENCY;
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
 }
 
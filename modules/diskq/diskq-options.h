@@ -28,6 +28,8 @@
 #include "logmsg/logmsg-serialize.h"
 
 #define MIN_DISK_BUF_SIZE 1024*1024
+#define MIN_SEGMENT_SIZE 1024*1024
+#define DEFAULT_GROUP_COMMIT_MAX_LATENCY 10
 
 typedef struct _DiskQueueOptions
 {
@@ -38,12 +40,18 @@ typedef struct _DiskQueueOptions
   gboolean compaction;
   gint mem_buf_size;
   gint mem_buf_length;
+  gint64 segment_size;
+  gboolean group_commit;
+  gint group_commit_max_latency;
   gchar *dir;
 } DiskQueueOptions;
 
 void disk_queue_options_qout_size_set(DiskQueueOptions *self, gint qout_size);
 void disk_queue_options_disk_buf_size_set(DiskQueueOptions *self, gint64 disk_buf_size);
+void disk_queue_options_segment_size_set(DiskQueueOptions *self, gint64 segment_size);
 void disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable);
+void disk_queue_options_group_commit_set(DiskQueueOptions *self, gboolean group_commit);
+void disk_queue_options_group_commit_max_latency_set(DiskQueueOptions *self, gint max_latency);
 void disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction);
 void disk_queue_options_mem_buf_size_set(DiskQueueOptions *self, gint mem_buf_size);
 void disk_queue_options_mem_buf_length_set(DiskQueueOptions *self, gint mem_buf_length);
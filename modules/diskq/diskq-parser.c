@@ -33,8 +33,11 @@ static CfgLexerKeyword diskq_keywords[] =
   { "disk_buffer",       KW_DISK_BUFFER },
   { "mem_buf_length",    KW_MEM_BUF_LENGTH },
   { "disk_buf_size",     KW_DISK_BUF_SIZE },
+  { "segment_size",      KW_SEGMENT_SIZE },
   { "reliable",          KW_RELIABLE },
   { "compaction",        KW_COMPACTION },
+  { "group_commit",      KW_GROUP_COMMIT },
+  { "group_commit_max_latency", KW_GROUP_COMMIT_MAX_LATENCY },
   { "mem_buf_size",      KW_MEM_BUF_SIZE },
   { "qout_size",         KW_QOUT_SIZE },
   { "dir",               KW_DIR },
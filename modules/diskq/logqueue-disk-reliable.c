@@ -26,36 +26,204 @@
 #include "logpipe.h"
 #include "logqueue-disk-reliable.h"
 #include "messages.h"
+#include "timeutils/misc.h"
+#include "stats/stats-cluster-single.h"
 
 /*pessimistic default for reliable disk queue 10000 x 16 kbyte*/
 #define PESSIMISTIC_MEM_BUF_SIZE 10000 * 16 *1024
 
+/* sync early if this many messages are waiting for a group commit */
+#define GROUP_COMMIT_MAX_BATCH 1024
+
+static inline gboolean
+_is_group_commit_enabled(LogQueueDiskReliable *self)
+{
+  return self->group_commit_max_latency > 0;
+}
+
+static void
+_ack_messages(GQueue *messages, AckType ack_type)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  while (messages->length > 0)
+    {
+      LogMessage *msg = g_queue_pop_head(messages);
+      POINTER_TO_LOG_PATH_OPTIONS(g_queue_pop_head(messages), &path_options);
+      log_msg_ack(msg, &path_options, ack_type);
+      log_msg_unref(msg);
+    }
+  g_queue_free(messages);
+}
+
+/* puts back messages that could not be committed in front of the ones
+ * pushed in the meantime */
+static void
+_requeue_messages(LogQueueDiskReliable *self, GQueue *messages)
+{
+  g_static_mutex_lock(&self->super.super.lock);
+  while (messages->length > 0)
+    g_queue_push_head(self->qcommit, g_queue_pop_tail(messages));
+  g_static_mutex_unlock(&self->super.super.lock);
+  g_queue_free(messages);
+}
+
+/* a single fdatasync() makes every message pushed since the previous
+ * commit durable, their producers are acked only afterwards.  The pending
+ * messages are taken over under the queue lock, the sync and the acks run
+ * without it, so that producers are not blocked by the disk.
+ *
+ * Returns FALSE if the sync failed, the messages stay pending then. */
+static gboolean
+_commit(LogQueueDiskReliable *self)
+{
+  QDiskSyncFds sync_fds;
+  GQueue *committed;
+  gboolean success;
+
+  g_static_mutex_lock(&self->super.super.lock);
+  if (g_queue_is_empty(self->qcommit))
+    {
+      g_static_mutex_unlock(&self->super.super.lock);
+      return TRUE;
+    }
+  committed = self->qcommit;
+  self->qcommit = g_queue_new();
+  success = qdisk_get_sync_fds(self->super.qdisk, &sync_fds);
+  g_static_mutex_unlock(&self->super.super.lock);
+
+  guint committed_messages = committed->length / 2;
+  gint64 start = g_get_monotonic_time();
+  if (!qdisk_sync_fds(self->super.qdisk, &sync_fds) || !success)
+    {
+      msg_error("Error committing reliable disk-queue, messages are kept pending until a sync succeeds",
+                evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+                evt_tag_int("messages", committed_messages),
+                evt_tag_str("persist_name", self->super.super.persist_name));
+      _requeue_messages(self, committed);
+      return FALSE;
+    }
+  gsize sync_time = g_get_monotonic_time() - start;
+
+  stats_counter_inc(self->group_commits);
+  stats_counter_add(self->group_committed_messages, committed_messages);
+  stats_counter_add(self->group_commit_sync_time, sync_time);
+  stats_counter_set_max(self->group_commit_max_sync_time, sync_time);
+
+  _ack_messages(committed, AT_PROCESSED);
+  return TRUE;
+}
+
+/* when the queue is saved or freed there is no later sync to wait for:
+ * messages that still cannot be synced are acked as aborted, so that
+ * sources do not move their bookmarks past them */
+static void
+_commit_final(LogQueueDiskReliable *self)
+{
+  GQueue *pending;
+
+  if (_commit(self))
+    return;
+
+  g_static_mutex_lock(&self->super.super.lock);
+  pending = self->qcommit;
+  self->qcommit = g_queue_new();
+  g_static_mutex_unlock(&self->super.super.lock);
+
+  _ack_messages(pending, AT_ABORTED);
+}
+
+static void
+_arm_commit_timer(LogQueueDiskReliable *self)
+{
+  iv_validate_now();
+  self->commit_timer.expires = iv_now;
+  timespec_add_msec(&self->commit_timer.expires, self->group_commit_max_latency);
+  iv_timer_register(&self->commit_timer);
+}
+
+/* messages pushed while the commit is running request a new one, a
+ * failed commit is retried after another max-latency period */
+static void
+_commit_or_retry(LogQueueDiskReliable *self)
+{
+  if (!_commit(self) && !iv_timer_registered(&self->commit_timer))
+    _arm_commit_timer(self);
+}
+
+static void
+_commit_timer_expired(gpointer s)
+{
+  _commit_or_retry((LogQueueDiskReliable *) s);
+}
+
+/* pushes arrive from arbitrary threads that cannot arm the timer
+ * themselves, they post this event when qcommit becomes non-empty or
+ * fills up, and it is handled in the thread loading the queue (the main
+ * thread) */
+static void
+_commit_requested(gpointer s)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+  gboolean batch_full, empty;
+
+  g_static_mutex_lock(&self->super.super.lock);
+  batch_full = self->qcommit->length / 2 >= GROUP_COMMIT_MAX_BATCH;
+  empty = g_queue_is_empty(self->qcommit);
+  g_static_mutex_unlock(&self->super.super.lock);
+
+  if (batch_full)
+    {
+      if (iv_timer_registered(&self->commit_timer))
+        iv_timer_unregister(&self->commit_timer);
+      _commit_or_retry(self);
+    }
+  else if (!empty && !iv_timer_registered(&self->commit_timer))
+    {
+      _arm_commit_timer(self);
+    }
+}
+
+static void
+_start_group_commit(LogQueueDiskReliable *self)
+{
+  if (!_is_group_commit_enabled(self) || self->group_commit_started)
+    return;
+
+  iv_event_register(&self->commit_requested);
+  self->group_commit_started = TRUE;
+}
+
+static void
+_stop_group_commit(LogQueueDiskReliable *self)
+{
+  if (iv_timer_registered(&self->commit_timer))
+    iv_timer_unregister(&self->commit_timer);
+  if (self->group_commit_started)
+    iv_event_unregister(&self->commit_requested);
+  self->group_commit_started = FALSE;
+}
+
 static gboolean
 _start(LogQueueDisk *s, const gchar *filename)
 {
+  _start_group_commit((LogQueueDiskReliable *) s);
   return qdisk_start(s->qdisk, filename, NULL, NULL, NULL);
 }
 
 static gboolean
 _skip_message(LogQueueDisk *self)
 {
-  GString *serialized;
-  SerializeArchive *sa;
+  const gchar *record;
+  guint32 record_length;
 
   if (!qdisk_started(self->qdisk))
     return FALSE;
 
-  serialized = g_string_sized_new(64);
-  if (!qdisk_pop_head(self->qdisk, serialized))
-    {
-      g_string_free(serialized, TRUE);
-      return FALSE;
-    }
-
-  sa = serialize_string_archive_new(serialized);
-  serialize_archive_free(sa);
+  if (!qdisk_peek_head(self->qdisk, &record, &record_length))
+    return FALSE;
 
-  g_string_free(serialized, TRUE);
+  qdisk_consume_head(self->qdisk);
   return TRUE;
 }
 
@@ -288,6 +456,17 @@ _push_tail(LogQueueDisk *s, LogMessage *msg, LogPathOptions *local_options, cons
       local_options->ack_needed = FALSE;
     }
 
+  if (_is_group_commit_enabled(self) && local_options->ack_needed)
+    {
+      log_msg_ref(msg);
+      g_queue_push_tail(self->qcommit, msg);
+      g_queue_push_tail(self->qcommit, LOG_PATH_OPTIONS_TO_POINTER(path_options));
+      local_options->ack_needed = FALSE;
+
+      if (self->qcommit->length == 2 || self->qcommit->length / 2 == GROUP_COMMIT_MAX_BATCH)
+        iv_event_post(&self->commit_requested);
+    }
+
   return TRUE;
 }
 
@@ -295,6 +474,10 @@ static void
 _free_queue(LogQueueDisk *s)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+  _stop_group_commit(self);
+  _commit_final(self);
+  g_queue_free(self->qcommit);
+  self->qcommit = NULL;
   _empty_queue(self->qreliable);
   _empty_queue(self->qbacklog);
   g_queue_free(self->qreliable);
@@ -308,6 +491,7 @@ _load_queue(LogQueueDisk *s, const gchar *filename)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
   _empty_queue(self->qreliable);
+  _start_group_commit(self);
   return qdisk_start(s->qdisk, filename, NULL, NULL, NULL);
 }
 
@@ -315,6 +499,7 @@ static gboolean
 _save_queue (LogQueueDisk *s, gboolean *persistent)
 {
   *persistent = TRUE;
+  _commit_final((LogQueueDiskReliable *) s);
   qdisk_stop (s->qdisk);
   return TRUE;
 }
@@ -327,6 +512,52 @@ _restart(LogQueueDisk *s, DiskQueueOptions *options)
 }
 
 
+static void
+_register_counters(LogQueue *s, gint stats_level, const StatsClusterKey *sc_key)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+  StatsClusterKey group_commit_key;
+
+  if (!_is_group_commit_enabled(self))
+    return;
+
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_commits");
+  stats_register_counter(stats_level, &group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_commits);
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_committed_messages");
+  stats_register_counter(stats_level, &group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_committed_messages);
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_commit_sync_time_usec");
+  stats_register_counter(stats_level, &group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_commit_sync_time);
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_commit_max_sync_time_usec");
+  stats_register_counter(stats_level, &group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_commit_max_sync_time);
+}
+
+static void
+_unregister_counters(LogQueue *s, const StatsClusterKey *sc_key)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *) s;
+  StatsClusterKey group_commit_key;
+
+  if (!_is_group_commit_enabled(self))
+    return;
+
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_commits");
+  stats_unregister_counter(&group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_commits);
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_committed_messages");
+  stats_unregister_counter(&group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_committed_messages);
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_commit_sync_time_usec");
+  stats_unregister_counter(&group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_commit_sync_time);
+  stats_cluster_single_key_set_with_name(&group_commit_key, sc_key->component, sc_key->id, sc_key->instance,
+                                         "group_commit_max_sync_time_usec");
+  stats_unregister_counter(&group_commit_key, SC_TYPE_SINGLE_VALUE, &self->group_commit_max_sync_time);
+}
+
 static void
 _set_virtual_functions(LogQueueDisk *self)
 {
@@ -355,6 +586,18 @@ log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *persist_name
     }
   self->qreliable = g_queue_new();
   self->qbacklog = g_queue_new();
+  self->qcommit = g_queue_new();
+  if (options->group_commit && !options->read_only)
+    self->group_commit_max_latency = options->group_commit_max_latency > 0 ? options->group_commit_max_latency
+                                     : DEFAULT_GROUP_COMMIT_MAX_LATENCY;
+  IV_TIMER_INIT(&self->commit_timer);
+  self->commit_timer.cookie = self;
+  self->commit_timer.handler = _commit_timer_expired;
+  IV_EVENT_INIT(&self->commit_requested);
+  self->commit_requested.cookie = self;
+  self->commit_requested.handler = _commit_requested;
   _set_virtual_functions(&self->super);
+  self->super.super.register_stats_counters = _register_counters;
+  self->super.super.unregister_stats_counters = _unregister_counters;
   return &self->super.super;
 }
@@ -26,11 +26,25 @@
 
 #include "logqueue-disk.h"
 
+#include <iv.h>
+#include <iv_event.h>
+
 typedef struct _LogQueueDiskReliable
 {
   LogQueueDisk super;
   GQueue *qreliable;
   GQueue *qbacklog;
+
+  /* group commit: messages written to disk that are acked by the next sync */
+  gint group_commit_max_latency;
+  GQueue *qcommit;
+  struct iv_timer commit_timer;
+  struct iv_event commit_requested;
+  gboolean group_commit_started;
+  StatsCounterItem *group_commits;
+  StatsCounterItem *group_committed_messages;
+  StatsCounterItem *group_commit_sync_time;
+  StatsCounterItem *group_commit_max_sync_time;
 } LogQueueDiskReliable;
 
 LogQueue *log_queue_disk_reliable_new(DiskQueueOptions *options, const gchar *persist_name);
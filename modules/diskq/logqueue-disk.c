@@ -222,39 +222,35 @@ _free(LogQueue *s)
 static gboolean
 _pop_disk(LogQueueDisk *self, LogMessage **msg)
 {
-  GString *serialized;
   SerializeArchive *sa;
+  const gchar *record;
+  guint32 record_length;
 
   *msg = NULL;
 
   if (!qdisk_started(self->qdisk))
     return FALSE;
 
-  serialized = g_string_sized_new(64);
-  if (!qdisk_pop_head(self->qdisk, serialized))
-    {
-      g_string_free(serialized, TRUE);
-      return FALSE;
-    }
+  if (!qdisk_peek_head(self->qdisk, &record, &record_length))
+    return FALSE;
 
-  sa = serialize_string_archive_new(serialized);
+  sa = serialize_buffer_archive_new((gchar *) record, record_length);
   *msg = log_msg_new_empty();
 
   if (!log_msg_deserialize(*msg, sa))
     {
-      g_string_free(serialized, TRUE);
       serialize_archive_free(sa);
       log_msg_unref(*msg);
       *msg = NULL;
       msg_error("Can't read correct message from disk-queue file",
                 evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
                 evt_tag_long("read_position", qdisk_get_reader_head(self->qdisk)));
+      qdisk_consume_head(self->qdisk);
       return TRUE;
     }
 
   serialize_archive_free(sa);
-
-  g_string_free(serialized, TRUE);
+  qdisk_consume_head(self->qdisk);
   return TRUE;
 }
 
@@ -286,20 +282,9 @@ _read_message(LogQueueDisk *self, LogPathOptions *path_options)
 static gboolean
 _write_message(LogQueueDisk *self, LogMessage *msg)
 {
-  GString *serialized;
-  SerializeArchive *sa;
-  DiskQueueOptions *options = qdisk_get_options(self->qdisk);
-  gboolean consumed = FALSE;
   if (qdisk_started(self->qdisk) && qdisk_is_space_avail(self->qdisk, 64))
-    {
-      serialized = g_string_sized_new(64);
-      sa = serialize_string_archive_new(serialized);
-      log_msg_serialize(msg, sa, options->compaction ? LMSF_COMPACTION : 0);
-      consumed = qdisk_push_tail(self->qdisk, serialized);
-      serialize_archive_free(sa);
-      g_string_free(serialized, TRUE);
-    }
-  return consumed;
+    return qdisk_push_tail_msg(self->qdisk, msg);
+  return FALSE;
 }
 
 static void
@@ -43,6 +43,10 @@
 #define MADV_RANDOM 1
 #endif
 
+#ifndef MADV_SEQUENTIAL
+#define MADV_SEQUENTIAL 2
+#endif
+
 #define MAX_RECORD_LENGTH 100 * 1024 * 1024
 
 #define PATH_QDISK              PATH_LOCALSTATEDIR
@@ -65,10 +69,26 @@ typedef union _QDiskFileHeader
     QDiskQueuePosition qoverflow_pos;
     gint64 backlog_head;
     gint64 backlog_len;
+
+    /* segmented format only, zero for single file disk-queues */
+    gint64 segment_size;
+    gint64 first_segment;
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
 
+/* In the segmented format, positions are logical offsets that grow
+ * monotonically: records are stored in fixed-size segment files next to
+ * the header file, which are mapped into memory on demand and are
+ * removed once every head moved past them. */
+typedef struct _QDiskSegment
+{
+  gint64 index;
+  gint fd;
+  gchar *base;
+  gsize size;
+} QDiskSegment;
+
 struct _QDisk
 {
   gchar *filename;
@@ -77,6 +97,9 @@ struct _QDisk
   gint64 file_size;
   QDiskFileHeader *hdr;
   DiskQueueOptions *options;
+  GHashTable *segments;
+  GString *read_buffer;
+  gint64 next_read_head;
 };
 
 static gboolean
@@ -99,6 +122,23 @@ pwrite_strict(gint fd, const void *buf, size_t count, off_t offset)
 }
 
 
+static gboolean
+_sync_fd(QDisk *self, gint fd)
+{
+#if SYSLOG_NG_HAVE_FDATASYNC
+  if (fdatasync(fd) < 0)
+#else
+  if (fsync(fd) < 0)
+#endif
+    {
+      msg_error("Error syncing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+  return TRUE;
+}
+
 static gboolean
 _is_position_eof(QDisk *self, gint64 position)
 {
@@ -115,6 +155,334 @@ _correct_position_if_eof(QDisk *self, gint64 *position)
   return *position;
 }
 
+static inline gboolean
+_is_segmented(QDisk *self)
+{
+  return self->hdr->segment_size > 0;
+}
+
+static inline gint64
+_segment_index(QDisk *self, gint64 position)
+{
+  return (position - QDISK_RESERVED_SPACE) / self->hdr->segment_size;
+}
+
+static inline gint64
+_segment_offset(QDisk *self, gint64 position)
+{
+  return (position - QDISK_RESERVED_SPACE) % self->hdr->segment_size;
+}
+
+static inline gint64
+_segment_start(QDisk *self, gint64 index)
+{
+  return QDISK_RESERVED_SPACE + index * self->hdr->segment_size;
+}
+
+static gchar *
+_segment_filename(QDisk *self, gint64 index)
+{
+  return g_strdup_printf("%s.%08" G_GINT64_FORMAT, self->filename, index);
+}
+
+static gboolean
+_segment_allocate(QDisk *self, gint fd, const gchar *filename)
+{
+  /* storing into a shared mapping that is not backed by disk blocks ends
+   * up in SIGBUS once the filesystem fills up, so reserve the whole
+   * segment in advance where possible */
+#if SYSLOG_NG_HAVE_POSIX_FALLOCATE
+  gint rc = posix_fallocate(fd, 0, self->hdr->segment_size);
+  if (rc != 0)
+    errno = rc;
+#else
+  gint rc = ftruncate(fd, self->hdr->segment_size);
+#endif
+  if (rc != 0)
+    {
+      msg_error("Error allocating disk-queue segment file",
+                evt_tag_str("filename", filename),
+                evt_tag_long("segment_size", self->hdr->segment_size),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+  return TRUE;
+}
+
+static void
+_segment_free(QDiskSegment *segment)
+{
+  munmap(segment->base, segment->size);
+  close(segment->fd);
+  g_free(segment);
+}
+
+static QDiskSegment *
+_segment_open(QDisk *self, gint64 index, gboolean create)
+{
+  gchar *filename = _segment_filename(self, index);
+  gint openflags;
+  struct stat st;
+  gint fd;
+  gpointer p;
+
+  if (self->options->read_only)
+    openflags = O_RDONLY | O_LARGEFILE;
+  else
+    openflags = O_RDWR | O_LARGEFILE | (create ? (O_CREAT | O_TRUNC) : 0);
+
+  fd = open(filename, openflags, 0600);
+  if (fd < 0)
+    {
+      msg_error("Error opening disk-queue segment file",
+                evt_tag_str("filename", filename),
+                evt_tag_error("error"));
+      goto error;
+    }
+
+  if (create && !_segment_allocate(self, fd, filename))
+    goto error_close;
+
+  if (fstat(fd, &st) < 0 || st.st_size < self->hdr->segment_size)
+    {
+      msg_error("Disk-queue segment file is truncated",
+                evt_tag_str("filename", filename),
+                evt_tag_long("segment_size", self->hdr->segment_size));
+      goto error_close;
+    }
+
+  p = mmap(0, self->hdr->segment_size, self->options->read_only ? (PROT_READ) : (PROT_READ | PROT_WRITE),
+           MAP_SHARED, fd, 0);
+  if (p == MAP_FAILED)
+    {
+      msg_error("Error returned by mmap",
+                evt_tag_error("errno"),
+                evt_tag_str("filename", filename));
+      goto error_close;
+    }
+  madvise(p, self->hdr->segment_size, MADV_SEQUENTIAL);
+  g_free(filename);
+
+  QDiskSegment *segment = g_new0(QDiskSegment, 1);
+  segment->index = index;
+  segment->fd = fd;
+  segment->base = p;
+  segment->size = self->hdr->segment_size;
+  return segment;
+
+error_close:
+  close(fd);
+error:
+  g_free(filename);
+  return NULL;
+}
+
+static QDiskSegment *
+_get_segment(QDisk *self, gint64 index, gboolean create)
+{
+  QDiskSegment *segment = g_hash_table_lookup(self->segments, &index);
+
+  if (segment)
+    return segment;
+
+  segment = _segment_open(self, index, create);
+  if (segment)
+    g_hash_table_insert(self->segments, &segment->index, segment);
+  return segment;
+}
+
+static gboolean
+_is_segment_in_use(QDisk *self, gint64 index)
+{
+  return index == _segment_index(self, self->hdr->write_head) ||
+         index == _segment_index(self, self->hdr->read_head) ||
+         index == _segment_index(self, self->hdr->backlog_head);
+}
+
+static gboolean
+_is_segment_unused(gpointer key, gpointer value, gpointer user_data)
+{
+  QDisk *self = (QDisk *) user_data;
+  QDiskSegment *segment = (QDiskSegment *) value;
+
+  return !_is_segment_in_use(self, segment->index);
+}
+
+static void
+_put_segment(QDisk *self, QDiskSegment *segment)
+{
+  if (!_is_segment_in_use(self, segment->index))
+    g_hash_table_remove(self->segments, &segment->index);
+}
+
+/* drops the segments that every head has left behind and unmaps the ones
+ * that are not needed by any of the heads. Instead of truncating the
+ * file, a segment is released as a whole. */
+static void
+_release_segments(QDisk *self)
+{
+  gint64 oldest_used = _segment_index(self, MIN(self->hdr->backlog_head, self->hdr->read_head));
+
+  while (!self->options->read_only && self->hdr->first_segment < oldest_used)
+    {
+      gint64 index = self->hdr->first_segment;
+      gchar *filename = _segment_filename(self, index);
+
+      g_hash_table_remove(self->segments, &index);
+      if (unlink(filename) < 0 && errno != ENOENT)
+        {
+          msg_error("Error removing disk-queue segment file",
+                    evt_tag_str("filename", filename),
+                    evt_tag_error("error"));
+        }
+      g_free(filename);
+      self->hdr->first_segment++;
+    }
+
+  g_hash_table_foreach_remove(self->segments, _is_segment_unused, self);
+}
+
+static inline gboolean
+_is_segment_end(QDisk *self, gint64 position)
+{
+  return _segment_offset(self, position) + (gint64) sizeof(guint32) > self->hdr->segment_size;
+}
+
+static inline gint64
+_segmented_normalize_position(QDisk *self, gint64 position)
+{
+  if (_is_segment_end(self, position))
+    return _segment_start(self, _segment_index(self, position) + 1);
+  return position;
+}
+
+/* records never span segments, the tail of a segment that could not hold
+ * the next record is marked with a zero record length (or is shorter than
+ * a record length) */
+static QDiskSegment *
+_segmented_locate_record(QDisk *self, gint64 *position, guint32 *record_length)
+{
+  QDiskSegment *segment;
+  gint64 offset;
+  guint32 n;
+
+  *position = _segmented_normalize_position(self, *position);
+  segment = _get_segment(self, _segment_index(self, *position), FALSE);
+  if (!segment)
+    return NULL;
+
+  offset = _segment_offset(self, *position);
+  memcpy(&n, segment->base + offset, sizeof(n));
+  if (n == 0 && _segment_index(self, *position) != _segment_index(self, self->hdr->write_head))
+    {
+      _put_segment(self, segment);
+      *position = _segment_start(self, _segment_index(self, *position) + 1);
+      segment = _get_segment(self, _segment_index(self, *position), FALSE);
+      if (!segment)
+        return NULL;
+
+      offset = 0;
+      memcpy(&n, segment->base, sizeof(n));
+    }
+
+  n = GUINT32_FROM_BE(n);
+  if (n == 0 || n > MAX_RECORD_LENGTH || offset + (gint64) sizeof(n) + n > self->hdr->segment_size)
+    {
+      msg_error("Disk-queue segment contains invalid record-length",
+                evt_tag_int("rec_length", n),
+                evt_tag_str("filename", self->filename),
+                evt_tag_long("segment", segment->index),
+                evt_tag_long("offset", offset));
+      _put_segment(self, segment);
+      return NULL;
+    }
+
+  *record_length = n;
+  return segment;
+}
+
+/* closes the segment of the write head with an end marker and moves on to
+ * the next one */
+static void
+_segmented_finish_segment(QDisk *self)
+{
+  gint64 index = _segment_index(self, self->hdr->write_head);
+
+  QDiskSegment *segment = _get_segment(self, index, FALSE);
+  if (segment)
+    {
+      if (!_is_segment_end(self, self->hdr->write_head))
+        memset(segment->base + _segment_offset(self, self->hdr->write_head), 0, sizeof(guint32));
+
+      /* group commits only sync the segment of the write head */
+      if (self->options->group_commit)
+        _sync_fd(self, segment->fd);
+    }
+  self->hdr->write_head = _segment_start(self, index + 1);
+  _release_segments(self);
+}
+
+static gboolean
+_segmented_push_tail_msg(QDisk *self, LogMessage *msg)
+{
+  while (TRUE)
+    {
+      if (_is_segment_end(self, self->hdr->write_head))
+        _segmented_finish_segment(self);
+
+      gint64 offset = _segment_offset(self, self->hdr->write_head);
+      QDiskSegment *segment = _get_segment(self, _segment_index(self, self->hdr->write_head), offset == 0);
+      if (!segment)
+        return FALSE;
+
+      gchar *record = segment->base + offset + sizeof(guint32);
+      gsize space = MIN(self->hdr->segment_size - offset - (gint64) sizeof(guint32), MAX_RECORD_LENGTH);
+      SerializeArchive *sa = serialize_buffer_archive_new(record, space);
+      sa->silent = TRUE;
+      gboolean success = log_msg_serialize(msg, sa, self->options->compaction ? LMSF_COMPACTION : 0);
+      guint32 record_length = serialize_buffer_archive_get_pos(sa);
+      serialize_archive_free(sa);
+
+      if (success && record_length > 0)
+        {
+          record_length = GUINT32_TO_BE(record_length);
+          memcpy(segment->base + offset, &record_length, sizeof(record_length));
+          self->hdr->write_head += GUINT32_FROM_BE(record_length) + sizeof(record_length);
+          self->hdr->length++;
+          return TRUE;
+        }
+
+      if (offset == 0)
+        {
+          msg_error("Error writing message into disk-queue segment, message does not fit into a segment",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_long("segment_size", self->hdr->segment_size));
+          return FALSE;
+        }
+
+      /* does not fit into the rest of this segment, retry in the next one */
+      _segmented_finish_segment(self);
+    }
+}
+
+static gboolean
+_segmented_peek_head(QDisk *self, const gchar **record, guint32 *record_length)
+{
+  gint64 position = _segmented_normalize_position(self, self->hdr->read_head);
+
+  if (position == self->hdr->write_head)
+    return FALSE;
+
+  QDiskSegment *segment = _segmented_locate_record(self, &position, record_length);
+  if (!segment)
+    return FALSE;
+
+  *record = segment->base + _segment_offset(self, position) + sizeof(guint32);
+  self->hdr->read_head = position;
+  self->next_read_head = position + sizeof(guint32) + *record_length;
+  return TRUE;
+}
+
 static gchar *
 _next_filename(QDisk *self)
 {
@@ -193,6 +561,11 @@ qdisk_is_space_avail(QDisk *self, gint at_least)
 {
   /* sizeof(guint32): record_length is a 4 bytes long value which is stored before each serialized LogMessage */
   gint64 msg_len = at_least + sizeof(guint32);
+
+  if (_is_segmented(self))
+    return msg_len <= self->hdr->segment_size &&
+           self->hdr->write_head - self->hdr->backlog_head + msg_len <= self->options->disk_buf_size;
+
   return (
            (_is_backlog_head_prevent_write_head(self)) &&
            (_is_write_head_less_than_max_size(self) || _is_able_to_reset_write_head_to_beginning_of_qdisk(self))
@@ -275,6 +648,9 @@ qdisk_get_empty_space(QDisk *self)
   gint64 wpos = qdisk_get_writer_head(self);
   gint64 bpos = qdisk_get_backlog_head(self);
 
+  if (_is_segmented(self))
+    return MAX(qdisk_get_maximum_size(self) - (wpos - bpos), 0);
+
   if (wpos > bpos)
     {
       return (qdisk_get_maximum_size(self) - wpos) +
@@ -284,6 +660,34 @@ qdisk_get_empty_space(QDisk *self)
   return bpos - wpos;
 }
 
+static gboolean
+_segmented_push_tail(QDisk *self, GString *record)
+{
+  guint32 record_length = GUINT32_TO_BE(record->len);
+
+  if ((gint64) (record->len + sizeof(record_length)) > self->hdr->segment_size)
+    {
+      msg_error("Error writing message into disk-queue segment, message does not fit into a segment",
+                evt_tag_str("filename", self->filename),
+                evt_tag_long("segment_size", self->hdr->segment_size));
+      return FALSE;
+    }
+
+  if (_segment_offset(self, self->hdr->write_head) + (gint64) (record->len + sizeof(record_length)) > self->hdr->segment_size)
+    _segmented_finish_segment(self);
+
+  gint64 offset = _segment_offset(self, self->hdr->write_head);
+  QDiskSegment *segment = _get_segment(self, _segment_index(self, self->hdr->write_head), offset == 0);
+  if (!segment)
+    return FALSE;
+
+  memcpy(segment->base + offset, &record_length, sizeof(record_length));
+  memcpy(segment->base + offset + sizeof(record_length), record->str, record->len);
+  self->hdr->write_head += record->len + sizeof(record_length);
+  self->hdr->length++;
+  return TRUE;
+}
+
 gboolean
 qdisk_push_tail(QDisk *self, GString *record)
 {
@@ -306,6 +710,9 @@ qdisk_push_tail(QDisk *self, GString *record)
       return FALSE;
     }
 
+  if (_is_segmented(self))
+    return _segmented_push_tail(self, record);
+
   if (!pwrite_strict(self->fd, (gchar *) &record_length, sizeof(record_length), self->hdr->write_head) ||
       !pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head + sizeof(record_length)))
     {
@@ -371,22 +778,22 @@ _is_record_length_reached_hard_limit(guint32 record_length)
   return record_length > MAX_RECORD_LENGTH;
 }
 
-gboolean
-qdisk_pop_head(QDisk *self, GString *record)
+static gboolean
+_peek_head(QDisk *self, const gchar **record, guint32 *record_length)
 {
   if (self->hdr->read_head != self->hdr->write_head)
     {
-      guint32 record_length;
+      guint32 n;
       gssize res;
-      res = pread(self->fd, (gchar *) &record_length, sizeof(record_length), self->hdr->read_head);
+      res = pread(self->fd, (gchar *) &n, sizeof(n), self->hdr->read_head);
 
       if (res == 0)
         {
           /* hmm, we are either at EOF or at hdr->qout_ofs, we need to wrap */
           self->hdr->read_head = QDISK_RESERVED_SPACE;
-          res = pread(self->fd, (gchar *) &record_length, sizeof(record_length), self->hdr->read_head);
+          res = pread(self->fd, (gchar *) &n, sizeof(n), self->hdr->read_head);
         }
-      if (res != sizeof(record_length))
+      if (res != sizeof(n))
         {
           msg_error("Error reading disk-queue file, cannot read record-length",
                     evt_tag_str("error", res < 0 ? g_strerror(errno) : "short read"),
@@ -395,64 +802,131 @@ qdisk_pop_head(QDisk *self, GString *record)
           return FALSE;
         }
 
-      record_length = GUINT32_FROM_BE(record_length);
-      if (_is_record_length_reached_hard_limit(record_length))
+      n = GUINT32_FROM_BE(n);
+      if (_is_record_length_reached_hard_limit(n))
         {
           msg_warning("Disk-queue file contains possibly invalid record-length",
-                      evt_tag_int("rec_length", record_length),
+                      evt_tag_int("rec_length", n),
                       evt_tag_str("filename", self->filename),
                       evt_tag_long("offset", self->hdr->read_head));
           return FALSE;
         }
-      else if (record_length == 0)
+      else if (n == 0)
         {
           msg_error("Disk-queue file contains empty record",
-                    evt_tag_int("rec_length", record_length),
+                    evt_tag_int("rec_length", n),
                     evt_tag_str("filename", self->filename),
                     evt_tag_long("offset", self->hdr->read_head));
           return FALSE;
         }
 
-      g_string_set_size(record, record_length);
-      res = pread(self->fd, record->str, record_length, self->hdr->read_head + sizeof(record_length));
-      if (res != record_length)
+      if (!self->read_buffer)
+        self->read_buffer = g_string_sized_new(n);
+      g_string_set_size(self->read_buffer, n);
+      res = pread(self->fd, self->read_buffer->str, n, self->hdr->read_head + sizeof(n));
+      if (res != n)
         {
           msg_error("Error reading disk-queue file",
                     evt_tag_str("filename", self->filename),
                     evt_tag_str("error", res < 0 ? g_strerror(errno) : "short read"),
-                    evt_tag_int("expected read length", record_length),
+                    evt_tag_int("expected read length", n),
                     evt_tag_int("actually read", res));
           return FALSE;
         }
 
-      self->hdr->read_head = self->hdr->read_head + record->len + sizeof(record_length);
+      *record = self->read_buffer->str;
+      *record_length = n;
+      self->next_read_head = self->hdr->read_head + n + sizeof(n);
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/* Returns the record at the read head without moving the head. The
+ * returned buffer is owned by the QDisk and is valid until the next
+ * qdisk call, it points right into the segment in the segmented format. */
+gboolean
+qdisk_peek_head(QDisk *self, const gchar **record, guint32 *record_length)
+{
+  self->next_read_head = -1;
+
+  if (_is_segmented(self))
+    return _segmented_peek_head(self, record, record_length);
+  return _peek_head(self, record, record_length);
+}
+
+/* moves the read head past the record returned by qdisk_peek_head() */
+void
+qdisk_consume_head(QDisk *self)
+{
+  g_assert(self->next_read_head >= 0);
+
+  gint64 prev_backlog_head = self->hdr->backlog_head;
 
-      if (self->hdr->read_head > self->hdr->write_head)
+  self->hdr->read_head = self->next_read_head;
+  self->next_read_head = -1;
+
+  if (!_is_segmented(self) && self->hdr->read_head > self->hdr->write_head)
+    {
+      self->hdr->read_head = _correct_position_if_eof(self, &self->hdr->read_head);
+    }
+
+  self->hdr->length--;
+  if (!self->options->reliable)
+    {
+      self->hdr->backlog_head = self->hdr->read_head;
+
+      g_assert(self->hdr->backlog_len == 0);
+      if (_is_segmented(self))
         {
-          self->hdr->read_head = _correct_position_if_eof(self, &self->hdr->read_head);
+          if (_segment_index(self, prev_backlog_head) != _segment_index(self, self->hdr->backlog_head))
+            _release_segments(self);
         }
-
-      self->hdr->length--;
-      if (!self->options->reliable)
+      else if (!self->options->read_only && qdisk_is_file_empty(self))
         {
+          msg_debug("Queue file became empty, truncating file",
+                    evt_tag_str("filename", self->filename));
+          self->hdr->read_head = QDISK_RESERVED_SPACE;
+          self->hdr->write_head = QDISK_RESERVED_SPACE;
           self->hdr->backlog_head = self->hdr->read_head;
-
-          g_assert(self->hdr->backlog_len == 0);
-          if (!self->options->read_only && qdisk_is_file_empty(self))
-            {
-              msg_debug("Queue file became empty, truncating file",
-                        evt_tag_str("filename", self->filename));
-              self->hdr->read_head = QDISK_RESERVED_SPACE;
-              self->hdr->write_head = QDISK_RESERVED_SPACE;
-              self->hdr->backlog_head = self->hdr->read_head;
-              self->hdr->length = 0;
-              _truncate_file(self, self->hdr->write_head);
-            }
+          self->hdr->length = 0;
+          _truncate_file(self, self->hdr->write_head);
         }
-      return TRUE;
-
     }
-  return FALSE;
+}
+
+gboolean
+qdisk_pop_head(QDisk *self, GString *record)
+{
+  const gchar *data;
+  guint32 data_length;
+
+  if (!qdisk_peek_head(self, &data, &data_length))
+    return FALSE;
+
+  g_string_truncate(record, 0);
+  g_string_append_len(record, data, data_length);
+  qdisk_consume_head(self);
+  return TRUE;
+}
+
+gboolean
+qdisk_push_tail_msg(QDisk *self, LogMessage *msg)
+{
+  GString *serialized;
+  SerializeArchive *sa;
+  gboolean consumed;
+
+  if (_is_segmented(self))
+    return _segmented_push_tail_msg(self, msg);
+
+  serialized = g_string_sized_new(64);
+  sa = serialize_string_archive_new(serialized);
+  log_msg_serialize(msg, sa, self->options->compaction ? LMSF_COMPACTION : 0);
+  consumed = qdisk_push_tail(self, serialized);
+  serialize_archive_free(sa);
+  g_string_free(serialized, TRUE);
+  return consumed;
 }
 
 static gboolean
@@ -514,7 +988,11 @@ _try_to_load_queue(QDisk *self, GQueue *queue, QDiskQueuePosition *pos, gchar *t
   len = pos->len;
   ofs = pos->ofs;
 
-  if (!(ofs > 0 && ofs < self->hdr->write_head))
+  /* in the segmented format the in-memory queues are the only contents of
+   * the file beyond the header, write_head points into the segments */
+  gint64 lowest_valid_ofs = _is_segmented(self) ? QDISK_RESERVED_SPACE : self->hdr->write_head;
+
+  if (!(ofs > 0 && ofs < lowest_valid_ofs))
     {
       if (!_load_queue(self, queue, ofs, len, count))
         return !self->options->read_only;
@@ -594,7 +1072,10 @@ _load_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow)
       gint64 end_ofs = QDISK_RESERVED_SPACE;
       if (!self->options->read_only)
         {
-          qdisk_try_to_truncate_file_to_minimal(self, &end_ofs);
+          if (_is_segmented(self))
+            _truncate_file(self, QDISK_RESERVED_SPACE);
+          else
+            qdisk_try_to_truncate_file_to_minimal(self, &end_ofs);
         }
       self->file_size = MAX(end_ofs, QDISK_RESERVED_SPACE);
 
@@ -619,6 +1100,8 @@ _load_state(QDisk *self, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow)
 
       msg_debug("Reliable disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
+                evt_tag_long("segment_size", self->hdr->segment_size),
+                evt_tag_long("first_segment", self->hdr->first_segment),
                 evt_tag_long("backlog_head", self->hdr->backlog_head),
                 evt_tag_long("read_head", self->hdr->read_head),
                 evt_tag_long("write_head", self->hdr->write_head),
@@ -776,6 +1259,9 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
   if (self->options->disk_buf_size <= 0)
     return TRUE;
 
+  if (!self->segments)
+    self->segments = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, (GDestroyNotify) _segment_free);
+
   if (self->options->read_only && !filename)
     return FALSE;
 
@@ -857,6 +1343,10 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
       self->hdr->write_head = QDISK_RESERVED_SPACE;
       self->hdr->backlog_head = self->hdr->read_head;
       self->hdr->length = 0;
+      self->hdr->segment_size = MAX(self->options->segment_size, 0);
+      self->hdr->first_segment = 0;
+      if (_is_segmented(self))
+        self->hdr->version = 2;
       self->file_size = self->hdr->write_head;
 
       if (!qdisk_save_state(self, qout, qbacklog, qoverflow))
@@ -904,8 +1394,17 @@ qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog,
           self->hdr->qoverflow_pos.count = GUINT32_SWAP_LE_BE(self->hdr->qoverflow_pos.count);
           self->hdr->backlog_head = GUINT64_SWAP_LE_BE(self->hdr->backlog_head);
           self->hdr->backlog_len = GUINT64_SWAP_LE_BE(self->hdr->backlog_len);
+          self->hdr->segment_size = GUINT64_SWAP_LE_BE(self->hdr->segment_size);
+          self->hdr->first_segment = GUINT64_SWAP_LE_BE(self->hdr->first_segment);
           self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
         }
+      if (!self->options->read_only && self->hdr->segment_size != MAX(self->options->segment_size, 0))
+        {
+          msg_warning("WARNING: The segment-size of an existing disk-queue file cannot be changed, keeping the original format",
+                      evt_tag_str("filename", self->filename),
+                      evt_tag_long("file_segment_size", self->hdr->segment_size),
+                      evt_tag_long("configured_segment_size", self->options->segment_size));
+        }
       if (!_load_state(self, qout, qbacklog, qoverflow))
         {
           munmap((void *)self->hdr, sizeof(QDiskFileHeader));
@@ -924,6 +1423,7 @@ qdisk_init_instance(QDisk *self, DiskQueueOptions *options, const gchar *file_id
 {
   self->fd = -1;
   self->file_size = 0;
+  self->next_read_head = -1;
   self->options = options;
 
   self->file_id = file_id;
@@ -932,6 +1432,12 @@ qdisk_init_instance(QDisk *self, DiskQueueOptions *options, const gchar *file_id
 void
 qdisk_stop(QDisk *self)
 {
+  if (self->segments)
+    {
+      g_hash_table_destroy(self->segments);
+      self->segments = NULL;
+    }
+
   if (self->filename)
     {
       g_free(self->filename);
@@ -956,10 +1462,29 @@ qdisk_stop(QDisk *self)
   self->options = NULL;
 }
 
+static gssize
+_segmented_read(QDisk *self, gpointer buffer, gsize bytes_to_read, gint64 position)
+{
+  QDiskSegment *segment = _get_segment(self, _segment_index(self, position), FALSE);
+
+  if (!segment)
+    return -1;
+
+  gint64 offset = _segment_offset(self, position);
+  gsize res = MIN(bytes_to_read, (gsize) (self->hdr->segment_size - offset));
+  memcpy(buffer, segment->base + offset, res);
+  _put_segment(self, segment);
+  return res;
+}
+
 gssize
 qdisk_read(QDisk *self, gpointer buffer, gsize bytes_to_read, gint64 position)
 {
   gssize res;
+
+  if (_is_segmented(self))
+    return _segmented_read(self, buffer, bytes_to_read, position);
+
   res = pread(self->fd, buffer, bytes_to_read, position);
   if (res <= 0)
     {
@@ -975,6 +1500,18 @@ qdisk_skip_record(QDisk *self, guint64 position)
 {
   guint64 new_position = position;
   guint32 record_length;
+
+  if (_is_segmented(self))
+    {
+      gint64 record_position = position;
+      QDiskSegment *segment = _segmented_locate_record(self, &record_position, &record_length);
+      if (!segment)
+        return position;
+
+      _put_segment(self, segment);
+      return record_position + record_length + sizeof(record_length);
+    }
+
   qdisk_read (self, (gchar *) &record_length, sizeof(record_length), position);
   record_length = GUINT32_FROM_BE(record_length);
   new_position += record_length + sizeof(record_length);
@@ -988,6 +1525,11 @@ qdisk_skip_record(QDisk *self, guint64 position)
 void
 qdisk_reset_file_if_possible(QDisk *self)
 {
+  /* segments are released as the heads move on, an emptied segmented
+   * queue keeps appending to its last segment */
+  if (_is_segmented(self))
+    return;
+
   if (qdisk_is_file_empty(self))
     {
       self->hdr->read_head = QDISK_RESERVED_SPACE;
@@ -997,6 +1539,61 @@ qdisk_reset_file_if_possible(QDisk *self)
     }
 }
 
+static gboolean
+_dup_sync_fd(QDisk *self, gint fd, QDiskSyncFds *sync_fds)
+{
+  gint new_fd = dup(fd);
+
+  if (new_fd < 0)
+    {
+      msg_error("Error duplicating disk-queue file descriptor for syncing",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+  sync_fds->fds[sync_fds->num_fds++] = new_fd;
+  return TRUE;
+}
+
+/* collects the files holding the records written so far and the header,
+ * duplicated so that qdisk_sync_fds() can run without the queue lock */
+gboolean
+qdisk_get_sync_fds(QDisk *self, QDiskSyncFds *sync_fds)
+{
+  gboolean success = TRUE;
+
+  sync_fds->num_fds = 0;
+  if (!qdisk_started(self) || self->options->read_only)
+    return TRUE;
+
+  if (_is_segmented(self))
+    {
+      gint64 index = _segment_index(self, self->hdr->write_head);
+      QDiskSegment *segment = g_hash_table_lookup(self->segments, &index);
+
+      if (segment)
+        success = _dup_sync_fd(self, segment->fd, sync_fds);
+    }
+
+  return _dup_sync_fd(self, self->fd, sync_fds) && success;
+}
+
+/* makes the files collected by qdisk_get_sync_fds() durable and closes them */
+gboolean
+qdisk_sync_fds(QDisk *self, QDiskSyncFds *sync_fds)
+{
+  gboolean success = TRUE;
+
+  for (gint i = 0; i < sync_fds->num_fds; i++)
+    {
+      if (!_sync_fd(self, sync_fds->fds[i]))
+        success = FALSE;
+      close(sync_fds->fds[i]);
+    }
+  sync_fds->num_fds = 0;
+  return success;
+}
+
 DiskQueueOptions *
 qdisk_get_options(QDisk *self)
 {
@@ -1043,6 +1640,8 @@ void
 qdisk_set_reader_head(QDisk *self, gint64 new_value)
 {
   self->hdr->read_head = new_value;
+  if (_is_segmented(self))
+    _release_segments(self);
 }
 
 gint64
@@ -1054,7 +1653,11 @@ qdisk_get_backlog_head(QDisk *self)
 void
 qdisk_set_backlog_head(QDisk *self, gint64 new_value)
 {
+  gint64 prev_backlog_head = self->hdr->backlog_head;
+
   self->hdr->backlog_head = new_value;
+  if (_is_segmented(self) && _segment_index(self, prev_backlog_head) != _segment_index(self, new_value))
+    _release_segments(self);
 }
 
 void
@@ -1096,6 +1699,8 @@ qdisk_is_read_only(QDisk *self)
 void
 qdisk_free(QDisk *self)
 {
+  if (self->read_buffer)
+    g_string_free(self->read_buffer, TRUE);
   g_free(self);
 }
 
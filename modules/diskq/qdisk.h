@@ -47,16 +47,31 @@ QDiskQueuePosition;
 
 typedef struct _QDisk QDisk;
 
+/* the header file and the segment of the write head */
+#define QDISK_MAX_SYNC_FDS 2
+
+typedef struct
+{
+  gint fds[QDISK_MAX_SYNC_FDS];
+  gint num_fds;
+}
+QDiskSyncFds;
+
 QDisk *qdisk_new(void);
 
 gboolean qdisk_is_space_avail(QDisk *self, gint at_least);
 gint64 qdisk_get_empty_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
+gboolean qdisk_push_tail_msg(QDisk *self, LogMessage *msg);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
+gboolean qdisk_peek_head(QDisk *self, const gchar **record, guint32 *record_length);
+void qdisk_consume_head(QDisk *self);
 gboolean qdisk_start(QDisk *self, const gchar *filename, GQueue *qout, GQueue *qbacklog, GQueue *qoverflow);
 void qdisk_init_instance(QDisk *self, DiskQueueOptions *options, const gchar *file_id);
 void qdisk_stop(QDisk *self);
 void qdisk_reset_file_if_possible(QDisk *self);
+gboolean qdisk_get_sync_fds(QDisk *self, QDiskSyncFds *sync_fds);
+gboolean qdisk_sync_fds(QDisk *self, QDiskSyncFds *sync_fds);
 gboolean qdisk_started(QDisk *self);
 void qdisk_free(QDisk *self);
 
@@ -169,6 +169,65 @@ Test(diskq, testcase_ack_and_rewind_messages)
   disk_queue_options_destroy(&options);
 }
 
+Test(diskq, testcase_group_commit_acks_after_sync)
+{
+  LogQueue *q;
+  DiskQueueOptions options = {0};
+  const gchar *filename = "test-group_commit.rqf";
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  options.group_commit = TRUE;
+  options.group_commit_max_latency = 1000;
+
+  q = log_queue_disk_reliable_new(&options, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+
+  StatsClusterKey sc_key;
+  stats_cluster_logpipe_key_set(&sc_key, SCS_DESTINATION, "group commit", NULL);
+  stats_lock();
+  log_queue_register_stats_counters(q, 0, &sc_key);
+  stats_unlock();
+
+  LogQueueDiskReliable *reliable_queue = (LogQueueDiskReliable *) q;
+
+  unlink(filename);
+  log_queue_disk_load_queue(q, filename);
+  fed_messages = 0;
+  acked_messages = 0;
+
+  cr_assert_not(iv_timer_registered(&reliable_queue->commit_timer), "commit timer should be idle without messages");
+
+  /* commit requests are posted to the main thread, they are handled right away here */
+  feed_some_messages(q, 10);
+  reliable_queue->commit_requested.handler(reliable_queue->commit_requested.cookie);
+  cr_assert_eq(acked_messages, 0, "messages should not be acked before they are committed");
+  cr_assert_eq(stats_counter_get(reliable_queue->group_commits), 0);
+  cr_assert(iv_timer_registered(&reliable_queue->commit_timer), "commit timer should be armed by pending messages");
+
+  /* reaching the batch limit commits without waiting for the timer */
+  feed_some_messages(q, 1024 - 10);
+  reliable_queue->commit_requested.handler(reliable_queue->commit_requested.cookie);
+  cr_assert_eq(acked_messages, 1024, "a full batch should be committed and acked: acked_messages=%d", acked_messages);
+  cr_assert_not(iv_timer_registered(&reliable_queue->commit_timer), "commit timer should be idle after the commit");
+  cr_assert_eq(stats_counter_get(reliable_queue->group_commits), 1);
+  cr_assert_eq(stats_counter_get(reliable_queue->group_committed_messages), 1024);
+
+  feed_some_messages(q, 5);
+  cr_assert_eq(acked_messages, 1024);
+
+  gboolean persistent;
+  log_queue_disk_save_queue(q, &persistent);
+  cr_assert_eq(acked_messages, fed_messages, "pending messages should be committed when the queue is saved");
+  cr_assert_eq(stats_counter_get(reliable_queue->group_commits), 2);
+
+  stats_lock();
+  log_queue_unregister_stats_counters(q, &sc_key);
+  stats_unlock();
+  log_queue_unref(q);
+  unlink(filename);
+  disk_queue_options_destroy(&options);
+}
+
 #define FEEDERS 1
 #define MESSAGES_PER_FEEDER 10000
 #define MESSAGES_SUM (FEEDERS * MESSAGES_PER_FEEDER)
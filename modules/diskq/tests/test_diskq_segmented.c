@@ -0,0 +1,264 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue.h"
+#include "logqueue-disk.h"
+#include "logqueue-disk-reliable.h"
+#include "logqueue-disk-non-reliable.h"
+#include "qdisk.h"
+#include "apphook.h"
+#include "plugin.h"
+
+#include "queue_utils_lib.h"
+#include "test_diskq_tools.h"
+#include <criterion/criterion.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define TEST_RECORD_SIZE 1000
+#define TEST_RECORDS (3 * MIN_SEGMENT_SIZE / TEST_RECORD_SIZE)
+
+static gboolean
+_segment_exists(const gchar *filename, gint64 index)
+{
+  struct stat st;
+  gchar *segment_filename = g_strdup_printf("%s.%08" G_GINT64_FORMAT, filename, index);
+  gboolean result = stat(segment_filename, &st) == 0;
+
+  g_free(segment_filename);
+  return result;
+}
+
+static void
+_remove_queue_files(const gchar *filename)
+{
+  for (gint64 i = 0; i < 16; i++)
+    {
+      gchar *segment_filename = g_strdup_printf("%s.%08" G_GINT64_FORMAT, filename, i);
+      unlink(segment_filename);
+      g_free(segment_filename);
+    }
+  unlink(filename);
+}
+
+static void
+_construct_segmented_options(DiskQueueOptions *options, gboolean reliable)
+{
+  _construct_options(options, 10 * MIN_SEGMENT_SIZE, 100000, reliable);
+  options->segment_size = MIN_SEGMENT_SIZE;
+}
+
+static QDisk *
+_start_qdisk(DiskQueueOptions *options, const gchar *filename, GQueue *queues[3])
+{
+  QDisk *qdisk = qdisk_new();
+
+  qdisk_init_instance(qdisk, options, "SLQF");
+  cr_assert(qdisk_start(qdisk, filename, queues[0], queues[1], queues[2]));
+  return qdisk;
+}
+
+static void
+_stop_qdisk(QDisk *qdisk, GQueue *queues[3])
+{
+  cr_assert(qdisk_save_state(qdisk, queues[0], queues[1], queues[2]));
+  qdisk_stop(qdisk);
+  qdisk_free(qdisk);
+}
+
+static void
+_push_records(QDisk *qdisk, gint first, gint n)
+{
+  GString *record = g_string_sized_new(TEST_RECORD_SIZE);
+
+  for (gint i = first; i < first + n; i++)
+    {
+      g_string_printf(record, "%08d", i);
+      g_string_set_size(record, TEST_RECORD_SIZE);
+      memset(record->str + 8, 'a' + i % 26, TEST_RECORD_SIZE - 8);
+      cr_assert(qdisk_push_tail(qdisk, record), "pushing record %d failed", i);
+    }
+  g_string_free(record, TRUE);
+}
+
+static void
+_pop_records(QDisk *qdisk, gint first, gint n)
+{
+  for (gint i = first; i < first + n; i++)
+    {
+      const gchar *record;
+      guint32 record_length;
+      gchar expected_id[16];
+
+      cr_assert(qdisk_peek_head(qdisk, &record, &record_length), "peeking record %d failed", i);
+      cr_assert_eq(record_length, TEST_RECORD_SIZE);
+
+      g_snprintf(expected_id, sizeof(expected_id), "%08d", i);
+      cr_assert_arr_eq(record, expected_id, 8);
+      cr_assert_eq(record[TEST_RECORD_SIZE - 1], 'a' + i % 26);
+      qdisk_consume_head(qdisk);
+    }
+}
+
+Test(diskq_segmented, records_span_multiple_segments_and_segments_are_released)
+{
+  const gchar *filename = "test_segmented_records.qf";
+  DiskQueueOptions options;
+  GQueue *queues[3] = { g_queue_new(), g_queue_new(), g_queue_new() };
+
+  _remove_queue_files(filename);
+  _construct_segmented_options(&options, FALSE);
+  QDisk *qdisk = _start_qdisk(&options, filename, queues);
+
+  _push_records(qdisk, 0, TEST_RECORDS);
+  cr_assert_eq(qdisk_get_length(qdisk), TEST_RECORDS);
+  cr_assert(_segment_exists(filename, 0));
+  cr_assert(_segment_exists(filename, 2));
+
+  _pop_records(qdisk, 0, TEST_RECORDS / 2);
+  cr_assert_not(_segment_exists(filename, 0), "fully consumed segment should have been removed");
+
+  _pop_records(qdisk, TEST_RECORDS / 2, TEST_RECORDS - TEST_RECORDS / 2);
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  const gchar *record;
+  guint32 record_length;
+  cr_assert_not(qdisk_peek_head(qdisk, &record, &record_length));
+
+  _stop_qdisk(qdisk, queues);
+  _remove_queue_files(filename);
+  for (gint i = 0; i < 3; i++)
+    g_queue_free(queues[i]);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq_segmented, contents_are_kept_across_restarts)
+{
+  const gchar *filename = "test_segmented_restart.qf";
+  DiskQueueOptions options;
+  GQueue *queues[3] = { g_queue_new(), g_queue_new(), g_queue_new() };
+
+  _remove_queue_files(filename);
+  _construct_segmented_options(&options, FALSE);
+  QDisk *qdisk = _start_qdisk(&options, filename, queues);
+
+  _push_records(qdisk, 0, TEST_RECORDS);
+  _pop_records(qdisk, 0, 10);
+  _stop_qdisk(qdisk, queues);
+
+  /* the format of an existing file is taken from its header */
+  options.segment_size = 0;
+  qdisk = _start_qdisk(&options, filename, queues);
+  cr_assert_eq(qdisk_get_length(qdisk), TEST_RECORDS - 10);
+
+  _push_records(qdisk, TEST_RECORDS, 10);
+  _pop_records(qdisk, 10, TEST_RECORDS);
+  cr_assert_eq(qdisk_get_length(qdisk), 0);
+
+  _stop_qdisk(qdisk, queues);
+  _remove_queue_files(filename);
+  for (gint i = 0; i < 3; i++)
+    g_queue_free(queues[i]);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq_segmented, disk_buf_size_limits_the_queue)
+{
+  const gchar *filename = "test_segmented_full.qf";
+  DiskQueueOptions options;
+  GQueue *queues[3] = { g_queue_new(), g_queue_new(), g_queue_new() };
+
+  _remove_queue_files(filename);
+  _construct_segmented_options(&options, FALSE);
+  options.disk_buf_size = 2 * MIN_SEGMENT_SIZE;
+  QDisk *qdisk = _start_qdisk(&options, filename, queues);
+
+  gint pushed = 0;
+  while (qdisk_is_space_avail(qdisk, TEST_RECORD_SIZE))
+    _push_records(qdisk, pushed++, 1);
+
+  cr_assert_gt(pushed, 0);
+  cr_assert_leq(qdisk_get_writer_head(qdisk) - qdisk_get_backlog_head(qdisk), options.disk_buf_size);
+  cr_assert_lt(qdisk_get_empty_space(qdisk), TEST_RECORD_SIZE + 4);
+
+  _pop_records(qdisk, 0, pushed);
+  cr_assert(qdisk_is_space_avail(qdisk, TEST_RECORD_SIZE));
+
+  _stop_qdisk(qdisk, queues);
+  _remove_queue_files(filename);
+  for (gint i = 0; i < 3; i++)
+    g_queue_free(queues[i]);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq_segmented, reliable_queue_acks_and_rewinds)
+{
+  const gchar *filename = "test_segmented_reliable.rqf";
+  DiskQueueOptions options;
+  gint messages = 4 * MIN_SEGMENT_SIZE / get_one_message_serialized_size();
+
+  _remove_queue_files(filename);
+  _construct_segmented_options(&options, TRUE);
+
+  LogQueue *q = log_queue_disk_reliable_new(&options, NULL);
+  log_queue_set_use_backlog(q, TRUE);
+  log_queue_disk_load_queue(q, filename);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, messages);
+  cr_assert(_segment_exists(filename, 3));
+
+  send_some_messages(q, messages / 2);
+  log_queue_rewind_backlog(q, messages / 4);
+  send_some_messages(q, messages / 4);
+  log_queue_ack_backlog(q, messages / 2);
+  cr_assert_not(_segment_exists(filename, 0), "acknowledged segment should have been removed");
+
+  send_some_messages(q, messages - messages / 2);
+  log_queue_ack_backlog(q, messages - messages / 2);
+  cr_assert_eq(fed_messages, acked_messages, "fed_messages=%d, acked_messages=%d", fed_messages, acked_messages);
+
+  log_queue_unref(q);
+  _remove_queue_files(filename);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cfg_load_module(configuration, "disk-buffer");
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(diskq_segmented, .init = setup, .fini = teardown);
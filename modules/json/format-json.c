@@ -29,7 +29,7 @@
 #include "cfg.h"
 #include "value-pairs/cmdline.h"
 #include "syslog-ng.h"
-#include "utf8utils.h"
+#include "json-writer.h"
 #include "scanner/list-scanner/list-scanner.h"
 #include "scratch-buffers.h"
 
@@ -96,7 +96,16 @@ typedef struct
 static inline void
 tf_json_append_escaped(GString *dest, const gchar *str, gssize str_len)
 {
-  append_unsafe_utf8_as_escaped_text(dest, str, str_len, "\"");
+  json_writer_append_escaped(dest, str, str_len);
+}
+
+/* the name-value pairs of the message are a good estimate of the output
+ * size, make room for them upfront instead of growing the buffer
+ * repeatedly */
+static inline void
+tf_json_reserve(GString *result, LogMessage *msg)
+{
+  json_writer_reserve(result, msg->payload->used);
 }
 
 static gboolean
@@ -329,6 +338,7 @@ tf_json_append(GString *result, ValuePairs *vp, LogMessage *msg,
   state.buffer = result;
   state.template_options = template_options;
 
+  tf_json_reserve(result, msg);
   return value_pairs_walk(vp,
                           tf_json_obj_start, tf_json_value, tf_json_obj_end,
                           msg, seq_num, time_zone_mode,
@@ -423,6 +433,7 @@ tf_flat_json_append(GString *result, ValuePairs *vp, LogMessage *msg,
   state.buffer = result;
   state.template_options = template_options;
 
+  tf_json_reserve(result, msg);
   g_string_append_c(state.buffer, '{');
 
   gboolean success = value_pairs_walk(vp,
@@ -464,8 +475,16 @@ tf_json_free_state(gpointer s)
   tf_simple_func_free_state(&state->super);
 }
 
-TEMPLATE_FUNCTION(TFJsonState, tf_json, tf_json_prepare, NULL, tf_json_call,
-                  tf_json_free_state, NULL);
+static gboolean
+tf_json_is_cacheable(LogTemplateFunction *self, gpointer s)
+{
+  TFJsonState *state = (TFJsonState *)s;
+
+  return value_pairs_is_cacheable(state->vp);
+}
+
+TEMPLATE_FUNCTION_CACHEABLE(TFJsonState, tf_json, tf_json_prepare, NULL, tf_json_call,
+                            tf_json_free_state, NULL, tf_json_is_cacheable);
 
-TEMPLATE_FUNCTION(TFJsonState, tf_flat_json, tf_json_prepare, NULL, tf_flat_json_call,
-                  tf_json_free_state, NULL);
+TEMPLATE_FUNCTION_CACHEABLE(TFJsonState, tf_flat_json, tf_json_prepare, NULL, tf_flat_json_call,
+                            tf_json_free_state, NULL, tf_json_is_cacheable);
@@ -23,6 +23,7 @@
 #define JSON_C_VER_013 (13 << 8)
 
 #include "json-parser.h"
+#include "json-scanner.h"
 #include "dot-notation.h"
 #include "scratch-buffers.h"
 
@@ -42,6 +43,7 @@ typedef struct _JSONParser
   gchar *marker;
   gint marker_len;
   gchar *extract_prefix;
+  JSONParserBackend backend;
 } JSONParser;
 
 void
@@ -72,6 +74,20 @@ json_parser_set_extract_prefix(LogParser *s, const gchar *extract_prefix)
   self->extract_prefix = g_strdup(extract_prefix);
 }
 
+gboolean
+json_parser_set_backend(LogParser *s, const gchar *backend)
+{
+  JSONParser *self = (JSONParser *) s;
+
+  if (strcmp(backend, "json-c") == 0)
+    self->backend = JSON_PARSER_BACKEND_JSON_C;
+  else if (strcmp(backend, "native") == 0)
+    self->backend = JSON_PARSER_BACKEND_NATIVE;
+  else
+    return FALSE;
+  return TRUE;
+}
+
 static void
 json_parser_process_object(struct json_object *jso,
                            const gchar *prefix,
@@ -208,33 +224,12 @@ json_tokener_error_desc(enum json_tokener_error err)
 #endif
 
 static gboolean
-json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
-                    gsize input_len)
+json_parser_process_with_json_c(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                                const gchar *input, gsize input_len)
 {
-  JSONParser *self = (JSONParser *) s;
   struct json_object *jso;
   struct json_tokener *tok;
 
-  msg_trace("json-parser message processing started",
-            evt_tag_str ("input", input),
-            evt_tag_str ("prefix", self->prefix),
-            evt_tag_str ("marker", self->marker),
-            evt_tag_printf("msg", "%p", *pmsg));
-  if (self->marker)
-    {
-      if (strncmp(input, self->marker, self->marker_len) != 0)
-        {
-          msg_debug("json-parser(): no marker at the beginning of the message, skipping JSON parsing ",
-                    evt_tag_str ("input", input),
-                    evt_tag_str ("marker", self->marker));
-          return FALSE;
-        }
-      input += self->marker_len;
-
-      while (isspace(*input))
-        input++;
-    }
-
   tok = json_tokener_new();
   jso = json_tokener_parse_ex(tok, input, input_len);
   if (tok->err != json_tokener_success || !jso)
@@ -261,6 +256,118 @@ json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_
   return TRUE;
 }
 
+/*
+ * Without a template the input is the value of MESSAGE, which a "MESSAGE"
+ * key would overwrite while other leaves still reference or copy it.
+ * Such a leaf is stored last, and only the last one of them, as it
+ * would win anyway.
+ */
+static void
+json_parser_store_leaves(JSONScanner *scanner, LogMessage *msg, NVHandle ref_handle, gsize ref_ofs)
+{
+  gsize count = json_scanner_get_leaf_count(scanner);
+  const JSONScannerLeaf *message_leaf = NULL;
+
+  for (gsize i = 0; i < count; i++)
+    {
+      const JSONScannerLeaf *leaf = json_scanner_get_leaf(scanner, i);
+      NVHandle handle = log_msg_get_value_handle(json_scanner_get_leaf_key(scanner, leaf));
+      gsize ofs = ref_ofs + leaf->value_ofs;
+
+      if (handle == LM_V_MESSAGE)
+        message_leaf = leaf;
+      else if (leaf->value_in_input && ref_handle != LM_V_NONE &&
+               log_msg_is_handle_settable_with_an_indirect_value(handle) &&
+               leaf->value_len > 0 && ofs + leaf->value_len <= G_MAXUINT16)
+        log_msg_set_value_indirect(msg, handle, ref_handle, 0, ofs, leaf->value_len);
+      else
+        log_msg_set_value(msg, handle, json_scanner_get_leaf_value(scanner, leaf), leaf->value_len);
+    }
+
+  if (message_leaf)
+    log_msg_set_value(msg, LM_V_MESSAGE, json_scanner_get_leaf_value(scanner, message_leaf), message_leaf->value_len);
+}
+
+/*
+ * Unescaped values are stored as indirect values referencing the input,
+ * if the input is the MESSAGE itself.  Nothing is stored unless the
+ * whole payload is valid, just like with json-c.
+ */
+static gboolean
+json_parser_process_natively(JSONParser *self, LogMessage **pmsg, const LogPathOptions *path_options,
+                             const gchar *input, gsize input_len, NVHandle ref_handle, gsize ref_ofs)
+{
+  JSONScanner scanner;
+  ScratchBuffersMarker marker;
+  gboolean success = FALSE;
+
+  scratch_buffers_mark(&marker);
+  json_scanner_init(&scanner, self->prefix, self->extract_prefix);
+
+  switch (json_scanner_scan(&scanner, input, input_len))
+    {
+    case JSON_SCANNER_SUCCESS:
+      log_msg_make_writable(pmsg, path_options);
+      json_parser_store_leaves(&scanner, *pmsg, ref_handle, ref_ofs);
+      success = TRUE;
+      break;
+    case JSON_SCANNER_SYNTAX_ERROR:
+      msg_error("json-parser(): failed to parse JSON payload",
+                evt_tag_str("input", input),
+                evt_tag_str("json_error", json_scanner_get_error(&scanner)));
+      break;
+    case JSON_SCANNER_NOT_AN_OBJECT:
+      msg_error("json-parser(): failed to extract JSON members into name-value pairs. The parsed/extracted JSON payload was not an object",
+                evt_tag_str("input", input),
+                evt_tag_str("extract_prefix", self->extract_prefix));
+      break;
+    default:
+      g_assert_not_reached();
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
+
+static gboolean
+json_parser_process(LogParser *s, LogMessage **pmsg, const LogPathOptions *path_options, const gchar *input,
+                    gsize input_len)
+{
+  JSONParser *self = (JSONParser *) s;
+  const gchar *value_start = input;
+
+  msg_trace("json-parser message processing started",
+            evt_tag_str ("input", input),
+            evt_tag_str ("prefix", self->prefix),
+            evt_tag_str ("marker", self->marker),
+            evt_tag_printf("msg", "%p", *pmsg));
+  if (self->marker)
+    {
+      if (strncmp(input, self->marker, self->marker_len) != 0)
+        {
+          msg_debug("json-parser(): no marker at the beginning of the message, skipping JSON parsing ",
+                    evt_tag_str ("input", input),
+                    evt_tag_str ("marker", self->marker));
+          return FALSE;
+        }
+      input += self->marker_len;
+
+      while (isspace(*input))
+        input++;
+      input_len -= input - value_start;
+    }
+
+  if (self->backend == JSON_PARSER_BACKEND_NATIVE)
+    {
+      /* without a template, the input is the value of MESSAGE */
+      NVHandle ref_handle = self->super.template ? LM_V_NONE : LM_V_MESSAGE;
+
+      return json_parser_process_natively(self, pmsg, path_options, input, input_len,
+                                          ref_handle, input - value_start);
+    }
+  return json_parser_process_with_json_c(self, pmsg, path_options, input, input_len);
+}
+
 static LogPipe *
 json_parser_clone(LogPipe *s)
 {
@@ -271,6 +378,7 @@ json_parser_clone(LogPipe *s)
   json_parser_set_prefix(cloned, self->prefix);
   json_parser_set_marker(cloned, self->marker);
   json_parser_set_extract_prefix(cloned, self->extract_prefix);
+  ((JSONParser *) cloned)->backend = self->backend;
   log_parser_set_template(cloned, log_template_ref(self->super.template));
 
   return &cloned->super;
@@ -25,9 +25,16 @@
 
 #include "parser/parser-expr.h"
 
+typedef enum
+{
+  JSON_PARSER_BACKEND_JSON_C,
+  JSON_PARSER_BACKEND_NATIVE,
+} JSONParserBackend;
+
 void json_parser_set_extract_prefix(LogParser *s, const gchar *extract_prefix);
 void json_parser_set_prefix(LogParser *p, const gchar *prefix);
 void json_parser_set_marker(LogParser *p, const gchar *marker);
+gboolean json_parser_set_backend(LogParser *s, const gchar *backend);
 LogParser *json_parser_new(GlobalConfig *cfg);
 
 #endif
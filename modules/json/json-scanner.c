@@ -0,0 +1,680 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "json-scanner.h"
+#include "scratch-buffers.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define JSON_SCANNER_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* same as the default depth of json_tokener_new() */
+#define JSON_SCANNER_MAX_DEPTH 32
+
+/*
+ * The scanner accepts what json-c accepts in its default (non-strict)
+ * mode as far as it matters in log messages: strings may be enclosed in
+ * single quotes and literals are case insensitive.  Just like json-c, it
+ * stops after the first complete value and ignores the rest of the input.
+ *
+ * Most of the input is usually made up of strings, whose end is located
+ * 16 (or 8) bytes at a time.
+ */
+
+static gsize
+_find_quote_or_backslash_generic(const guchar *s, gsize n, guchar quote_char)
+{
+  const guint64 ones = 0x0101010101010101ULL;
+  const guint64 highs = 0x8080808080808080ULL;
+  gsize i = 0;
+
+  while (i + sizeof(guint64) <= n)
+    {
+      guint64 word, quote, backslash;
+
+      memcpy(&word, s + i, sizeof(word));
+      quote = word ^ (ones * quote_char);
+      backslash = word ^ (ones * '\\');
+
+      if ((((quote - ones) & ~quote) | ((backslash - ones) & ~backslash)) & highs)
+        break;
+      i += sizeof(guint64);
+    }
+
+  while (i < n && s[i] != quote_char && s[i] != '\\')
+    i++;
+  return i;
+}
+
+#if JSON_SCANNER_HAVE_SSE2
+
+static gsize
+_find_quote_or_backslash(const guchar *s, gsize n, guchar quote_char)
+{
+  const __m128i quote = _mm_set1_epi8((gchar) quote_char);
+  const __m128i backslash = _mm_set1_epi8('\\');
+  gsize i = 0;
+
+  while (i + 16 <= n)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) (s + i));
+      guint32 mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                                                    _mm_cmpeq_epi8(block, backslash)));
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+      i += 16;
+    }
+  return i + _find_quote_or_backslash_generic(s + i, n - i, quote_char);
+}
+
+#else
+
+#define _find_quote_or_backslash _find_quote_or_backslash_generic
+
+#endif
+
+static gboolean
+_syntax_error(JSONScanner *self, const gchar *error)
+{
+  self->error = error;
+  return FALSE;
+}
+
+static inline gchar
+_peek(JSONScanner *self)
+{
+  if (self->pos >= self->input_len)
+    return 0;
+  return self->input[self->pos];
+}
+
+static inline void
+_skip_whitespace(JSONScanner *self)
+{
+  while (self->pos < self->input_len)
+    {
+      switch (self->input[self->pos])
+        {
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+          self->pos++;
+          break;
+        default:
+          return;
+        }
+    }
+}
+
+static inline gboolean
+_is_recording(JSONScanner *self)
+{
+  return self->name_start >= 0;
+}
+
+static void
+_add_leaf(JSONScanner *self, gsize value_ofs, gsize value_len, gboolean value_in_input)
+{
+  JSONScannerLeaf leaf =
+  {
+    .key_ofs = self->keys->len,
+    .value_ofs = value_ofs,
+    .value_len = value_len,
+    .value_in_input = value_in_input,
+  };
+
+  if (self->prefix)
+    g_string_append(self->keys, self->prefix);
+  g_string_append_len(self->keys, self->path->str + self->name_start, self->path->len - self->name_start);
+  g_string_append_c(self->keys, 0);
+  g_string_append_len(self->leaves, (const gchar *) &leaf, sizeof(leaf));
+}
+
+static gboolean
+_parse_hex4(JSONScanner *self, gsize pos, gunichar *value)
+{
+  *value = 0;
+  if (self->input_len - pos < 4)
+    return FALSE;
+
+  for (gint i = 0; i < 4; i++)
+    {
+      gint digit = g_ascii_xdigit_value(self->input[pos + i]);
+
+      if (digit < 0)
+        return FALSE;
+      *value = (*value << 4) | digit;
+    }
+  return TRUE;
+}
+
+static gboolean
+_unescape_unicode(JSONScanner *self, GString *dest)
+{
+  gchar buf[6];
+  gunichar c, low;
+
+  /* self->pos points to the 'u' of \uXXXX */
+  if (!_parse_hex4(self, self->pos + 1, &c))
+    return _syntax_error(self, "invalid \\u escape sequence");
+  self->pos += 5;
+
+  if (c >= 0xd800 && c < 0xdc00)
+    {
+      if (self->input_len - self->pos >= 6 &&
+          self->input[self->pos] == '\\' && self->input[self->pos + 1] == 'u' &&
+          _parse_hex4(self, self->pos + 2, &low) &&
+          low >= 0xdc00 && low < 0xe000)
+        {
+          c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+          self->pos += 6;
+        }
+      else
+        c = 0xfffd;
+    }
+  else if (c >= 0xdc00 && c < 0xe000)
+    c = 0xfffd;
+
+  g_string_append_len(dest, buf, g_unichar_to_utf8(c, buf));
+  return TRUE;
+}
+
+static gboolean
+_unescape(JSONScanner *self, GString *dest)
+{
+  gchar c;
+
+  /* self->pos points to the backslash */
+  self->pos++;
+  if (self->pos >= self->input_len)
+    return _syntax_error(self, "unterminated string");
+
+  c = self->input[self->pos];
+  switch (c)
+    {
+    case '"':
+    case '\'':
+    case '\\':
+    case '/':
+      g_string_append_c(dest, c);
+      break;
+    case 'b':
+      g_string_append_c(dest, '\b');
+      break;
+    case 'f':
+      g_string_append_c(dest, '\f');
+      break;
+    case 'n':
+      g_string_append_c(dest, '\n');
+      break;
+    case 'r':
+      g_string_append_c(dest, '\r');
+      break;
+    case 't':
+      g_string_append_c(dest, '\t');
+      break;
+    case 'u':
+      return _unescape_unicode(self, dest);
+    default:
+      return _syntax_error(self, "invalid escape sequence");
+    }
+  self->pos++;
+  return TRUE;
+}
+
+/*
+ * Scans a string starting at its opening quote.  If the string contains
+ * no escapes, its value is a slice of the input and *unescaped is FALSE,
+ * otherwise the value is appended to dest and ofs/len refer to dest.
+ */
+static gboolean
+_scan_string(JSONScanner *self, GString *dest, gboolean *unescaped, gsize *ofs, gsize *len)
+{
+  const guchar quote_char = self->input[self->pos];
+  gsize start = ++self->pos;
+  gsize run_start = start;
+  gsize dest_start = dest->len;
+
+  *unescaped = FALSE;
+  while (TRUE)
+    {
+      self->pos += _find_quote_or_backslash((const guchar *) self->input + self->pos,
+                                            self->input_len - self->pos, quote_char);
+      if (self->pos >= self->input_len)
+        return _syntax_error(self, "unterminated string");
+
+      if (self->input[self->pos] == quote_char)
+        break;
+
+      *unescaped = TRUE;
+      g_string_append_len(dest, self->input + run_start, self->pos - run_start);
+      if (!_unescape(self, dest))
+        return FALSE;
+      run_start = self->pos;
+    }
+
+  if (*unescaped)
+    {
+      g_string_append_len(dest, self->input + run_start, self->pos - run_start);
+      *ofs = dest_start;
+      *len = dest->len - dest_start;
+    }
+  else
+    {
+      *ofs = start;
+      *len = self->pos - start;
+    }
+
+  /* closing quote */
+  self->pos++;
+  return TRUE;
+}
+
+static gboolean
+_scan_key(JSONScanner *self)
+{
+  gboolean unescaped;
+  gsize ofs, len;
+
+  if (!_scan_string(self, self->path, &unescaped, &ofs, &len))
+    return FALSE;
+
+  if (!unescaped)
+    g_string_append_len(self->path, self->input + ofs, len);
+  return TRUE;
+}
+
+static gboolean
+_scan_string_value(JSONScanner *self)
+{
+  gboolean unescaped;
+  gsize ofs, len;
+
+  if (!_scan_string(self, self->values, &unescaped, &ofs, &len))
+    return FALSE;
+
+  if (_is_recording(self))
+    _add_leaf(self, ofs, len, !unescaped);
+  else if (unescaped)
+    g_string_truncate(self->values, ofs);
+  return TRUE;
+}
+
+static gboolean
+_scan_literal(JSONScanner *self, const gchar *literal, gsize literal_len)
+{
+  if (self->input_len - self->pos < literal_len ||
+      g_ascii_strncasecmp(self->input + self->pos, literal, literal_len) != 0)
+    return _syntax_error(self, "invalid literal");
+
+  self->pos += literal_len;
+  return TRUE;
+}
+
+static gboolean
+_scan_boolean(JSONScanner *self, const gchar *literal, gsize literal_len)
+{
+  gsize start = self->pos;
+
+  if (!_scan_literal(self, literal, literal_len))
+    return FALSE;
+
+  if (!_is_recording(self))
+    return TRUE;
+
+  if (memcmp(self->input + start, literal, literal_len) == 0)
+    {
+      _add_leaf(self, start, literal_len, TRUE);
+    }
+  else
+    {
+      gsize ofs = self->values->len;
+
+      g_string_append_len(self->values, literal, literal_len);
+      _add_leaf(self, ofs, literal_len, FALSE);
+    }
+  return TRUE;
+}
+
+static void
+_add_double(JSONScanner *self, gsize start, gsize len)
+{
+  gsize ofs = self->values->len;
+  gdouble value;
+
+  /* the input is not necessarily NUL terminated after the number */
+  g_string_append_len(self->values, self->input + start, len);
+  value = g_ascii_strtod(self->values->str + ofs, NULL);
+  g_string_truncate(self->values, ofs);
+
+  g_string_append_printf(self->values, "%f", value);
+  _add_leaf(self, ofs, self->values->len - ofs, FALSE);
+}
+
+/* json-parser() formats integers as json_object_get_int() returns them,
+ * which saturates at the limits of a 32 bit int */
+static void
+_add_int(JSONScanner *self, gsize start, gsize len)
+{
+  const gchar *s = self->input + start;
+  gboolean negative = (s[0] == '-');
+  gsize first_digit = negative ? 1 : 0;
+  gint64 value = 0;
+  gboolean canonical;
+
+  for (gsize i = first_digit; i < len; i++)
+    {
+      value = value * 10 + (s[i] - '0');
+      if (value > (gint64) G_MAXINT32 + 1)
+        break;
+    }
+  if (negative)
+    value = -value;
+
+  /* if the literal is what printf() would produce, reference the input */
+  canonical = value >= G_MININT32 && value <= G_MAXINT32 &&
+              !(s[first_digit] == '0' && len > first_digit + 1) &&
+              !(negative && value == 0);
+
+  if (canonical)
+    {
+      _add_leaf(self, start, len, TRUE);
+    }
+  else
+    {
+      gsize ofs = self->values->len;
+
+      g_string_append_printf(self->values, "%i", (gint) CLAMP(value, G_MININT32, G_MAXINT32));
+      _add_leaf(self, ofs, self->values->len - ofs, FALSE);
+    }
+}
+
+static inline gsize
+_skip_digits(JSONScanner *self, gsize pos)
+{
+  while (pos < self->input_len && g_ascii_isdigit(self->input[pos]))
+    pos++;
+  return pos;
+}
+
+static gboolean
+_scan_number(JSONScanner *self)
+{
+  gsize start = self->pos;
+  gsize pos = start;
+  gboolean is_double = FALSE;
+
+  if (self->input[pos] == '-')
+    pos++;
+  if (pos >= self->input_len || !g_ascii_isdigit(self->input[pos]))
+    return _syntax_error(self, "invalid number");
+  pos = _skip_digits(self, pos);
+
+  if (pos < self->input_len && self->input[pos] == '.')
+    {
+      is_double = TRUE;
+      pos++;
+      if (pos >= self->input_len || !g_ascii_isdigit(self->input[pos]))
+        return _syntax_error(self, "invalid number");
+      pos = _skip_digits(self, pos);
+    }
+
+  if (pos < self->input_len && (self->input[pos] == 'e' || self->input[pos] == 'E'))
+    {
+      is_double = TRUE;
+      pos++;
+      if (pos < self->input_len && (self->input[pos] == '+' || self->input[pos] == '-'))
+        pos++;
+      if (pos >= self->input_len || !g_ascii_isdigit(self->input[pos]))
+        return _syntax_error(self, "invalid number");
+      pos = _skip_digits(self, pos);
+    }
+  self->pos = pos;
+
+  if (!_is_recording(self))
+    return TRUE;
+
+  if (is_double)
+    _add_double(self, start, pos - start);
+  else
+    _add_int(self, start, pos - start);
+  return TRUE;
+}
+
+static gboolean _scan_value(JSONScanner *self);
+
+static gboolean
+_enter_container(JSONScanner *self)
+{
+  /* skip the opening bracket */
+  self->pos++;
+  if (++self->depth > JSON_SCANNER_MAX_DEPTH)
+    return _syntax_error(self, "nesting too deep");
+  _skip_whitespace(self);
+  return TRUE;
+}
+
+static gboolean
+_scan_object(JSONScanner *self)
+{
+  gsize path_len = self->path->len;
+
+  if (!_enter_container(self))
+    return FALSE;
+
+  if (_peek(self) == '}')
+    {
+      self->pos++;
+      self->depth--;
+      return TRUE;
+    }
+
+  while (TRUE)
+    {
+      _skip_whitespace(self);
+      if (_peek(self) != '"' && _peek(self) != '\'')
+        return _syntax_error(self, "expected a string as object key");
+
+      if (path_len > 0)
+        g_string_append_c(self->path, '.');
+      if (!_scan_key(self))
+        return FALSE;
+
+      _skip_whitespace(self);
+      if (_peek(self) != ':')
+        return _syntax_error(self, "expected ':' after object key");
+      self->pos++;
+
+      if (!_scan_value(self))
+        return FALSE;
+      g_string_truncate(self->path, path_len);
+
+      _skip_whitespace(self);
+      switch (_peek(self))
+        {
+        case ',':
+          self->pos++;
+          break;
+        case '}':
+          self->pos++;
+          self->depth--;
+          return TRUE;
+        default:
+          return _syntax_error(self, "expected ',' or '}' after object member");
+        }
+    }
+}
+
+static gboolean
+_scan_array(JSONScanner *self)
+{
+  gsize path_len = self->path->len;
+  gint index_ = 0;
+
+  if (!_enter_container(self))
+    return FALSE;
+
+  if (_peek(self) == ']')
+    {
+      self->pos++;
+      self->depth--;
+      return TRUE;
+    }
+
+  while (TRUE)
+    {
+      g_string_append_printf(self->path, "[%d]", index_++);
+      if (!_scan_value(self))
+        return FALSE;
+      g_string_truncate(self->path, path_len);
+
+      _skip_whitespace(self);
+      switch (_peek(self))
+        {
+        case ',':
+          self->pos++;
+          break;
+        case ']':
+          self->pos++;
+          self->depth--;
+          return TRUE;
+        default:
+          return _syntax_error(self, "expected ',' or ']' after array element");
+        }
+    }
+}
+
+static gboolean
+_scan_value_by_type(JSONScanner *self)
+{
+  gchar c = _peek(self);
+
+  switch (c)
+    {
+    case '{':
+      return _scan_object(self);
+    case '[':
+      return _scan_array(self);
+    case '"':
+    case '\'':
+      return _scan_string_value(self);
+    case 't':
+    case 'T':
+      return _scan_boolean(self, "true", 4);
+    case 'f':
+    case 'F':
+      return _scan_boolean(self, "false", 5);
+    case 'n':
+    case 'N':
+      return _scan_literal(self, "null", 4);
+    case 0:
+      if (self->pos >= self->input_len)
+        return _syntax_error(self, "unexpected end of input");
+      break;
+    default:
+      if (c == '-' || g_ascii_isdigit(c))
+        return _scan_number(self);
+      break;
+    }
+  return _syntax_error(self, "unexpected character");
+}
+
+static inline gboolean
+_is_target(JSONScanner *self)
+{
+  if (self->target_found)
+    return FALSE;
+
+  if (!self->extract_prefix)
+    return self->depth == 0;
+  return strcmp(self->path->str, self->extract_prefix) == 0;
+}
+
+static gboolean
+_scan_target(JSONScanner *self)
+{
+  gboolean result;
+
+  self->target_found = TRUE;
+  if (_peek(self) != '{')
+    return _scan_value_by_type(self);
+
+  self->target_is_object = TRUE;
+  self->name_start = self->path->len > 0 ? self->path->len + 1 : 0;
+  result = _scan_object(self);
+  self->name_start = -1;
+  return result;
+}
+
+static gboolean
+_scan_value(JSONScanner *self)
+{
+  _skip_whitespace(self);
+
+  if (_is_target(self))
+    return _scan_target(self);
+  return _scan_value_by_type(self);
+}
+
+JSONScannerResult
+json_scanner_scan(JSONScanner *self, const gchar *input, gsize input_len)
+{
+  self->input = input;
+  self->input_len = input_len;
+  self->pos = 0;
+  self->depth = 0;
+  self->error = NULL;
+  self->target_found = FALSE;
+  self->target_is_object = FALSE;
+  self->name_start = -1;
+
+  g_string_truncate(self->path, 0);
+  g_string_truncate(self->keys, 0);
+  g_string_truncate(self->values, 0);
+  g_string_truncate(self->leaves, 0);
+
+  if (!_scan_value(self))
+    return JSON_SCANNER_SYNTAX_ERROR;
+
+  if (!self->target_is_object)
+    return JSON_SCANNER_NOT_AN_OBJECT;
+  return JSON_SCANNER_SUCCESS;
+}
+
+/* the buffers are allocated from the scratch buffers of the current thread */
+void
+json_scanner_init(JSONScanner *self, const gchar *prefix, const gchar *extract_prefix)
+{
+  memset(self, 0, sizeof(*self));
+  self->prefix = prefix;
+  self->extract_prefix = extract_prefix;
+  self->name_start = -1;
+
+  self->path = scratch_buffers_alloc();
+  self->keys = scratch_buffers_alloc();
+  self->values = scratch_buffers_alloc();
+  self->leaves = scratch_buffers_alloc();
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef JSON_SCANNER_H_INCLUDED
+#define JSON_SCANNER_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+/*
+ * A validating JSON scanner that flattens a document into name-value
+ * pairs, using the same naming rules as the json-c based json-parser()
+ * ("object.member", "array[0]").  It builds no intermediate tree: leaves
+ * are collected in a flat list, values that need no transformation point
+ * back into the input, the rest are stored in a shared buffer.
+ */
+
+typedef enum
+{
+  JSON_SCANNER_SUCCESS,
+  JSON_SCANNER_SYNTAX_ERROR,
+  JSON_SCANNER_NOT_AN_OBJECT,
+} JSONScannerResult;
+
+typedef struct _JSONScannerLeaf
+{
+  gsize key_ofs;
+  gsize value_ofs;
+  gsize value_len;
+  /* value_ofs is an offset in the input, otherwise in the values buffer */
+  gboolean value_in_input;
+} JSONScannerLeaf;
+
+typedef struct _JSONScanner
+{
+  const gchar *prefix;
+  const gchar *extract_prefix;
+
+  const gchar *input;
+  gsize input_len;
+  gsize pos;
+  gint depth;
+  const gchar *error;
+
+  /* dot-notation path of the value being scanned */
+  GString *path;
+  /* the target is the extracted value (or the document itself without
+   * extract-prefix), its members are recorded as leaves */
+  gboolean target_found;
+  gboolean target_is_object;
+  /* start of the name within path, -1 outside of the target */
+  gssize name_start;
+
+  GString *keys;
+  GString *values;
+  GString *leaves;
+} JSONScanner;
+
+void json_scanner_init(JSONScanner *self, const gchar *prefix, const gchar *extract_prefix);
+JSONScannerResult json_scanner_scan(JSONScanner *self, const gchar *input, gsize input_len);
+
+static inline gsize
+json_scanner_get_leaf_count(JSONScanner *self)
+{
+  return self->leaves->len / sizeof(JSONScannerLeaf);
+}
+
+static inline const JSONScannerLeaf *
+json_scanner_get_leaf(JSONScanner *self, gsize index_)
+{
+  return &((const JSONScannerLeaf *) self->leaves->str)[index_];
+}
+
+static inline const gchar *
+json_scanner_get_leaf_key(JSONScanner *self, const JSONScannerLeaf *leaf)
+{
+  return self->keys->str + leaf->key_ofs;
+}
+
+static inline const gchar *
+json_scanner_get_leaf_value(JSONScanner *self, const JSONScannerLeaf *leaf)
+{
+  return (leaf->value_in_input ? self->input : self->values->str) + leaf->value_ofs;
+}
+
+static inline const gchar *
+json_scanner_get_error(JSONScanner *self)
+{
+  return self->error;
+}
+
+#endif
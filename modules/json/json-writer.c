@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "json-writer.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define JSON_WRITER_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/*
+ * Escaping for $(format-json).  The output matches what
+ * append_unsafe_utf8_as_escaped_text(dest, str, len, "\"") produces:
+ *   - '"' and '\' are escaped with a backslash,
+ *   - control characters as \b, \f, \n, \r, \t or \u00XX,
+ *   - invalid utf8 sequences byte-by-byte as \\xXX,
+ *   - valid utf8 characters are reproduced as is.
+ *
+ * Instead of decoding every character, we look for the first byte that
+ * needs attention (control characters, '"', '\' and anything non-ASCII)
+ * and copy the clean run before it in one go.  Most values are plain
+ * ASCII, so this usually copies the entire value with a single memcpy().
+ */
+
+static inline gboolean
+_is_byte_special(guchar c)
+{
+  return c < 0x20 || c >= 0x80 || c == '"' || c == '\\';
+}
+
+static gsize
+_find_special_byte_generic(const guchar *s, gsize n)
+{
+  const guint64 ones = 0x0101010101010101ULL;
+  const guint64 highs = 0x8080808080808080ULL;
+  gsize i = 0;
+
+  /* the classic "has a byte less than" / "has a zero byte" bit tricks,
+   * they may flag bytes above the first match, but never miss one */
+  while (i + sizeof(guint64) <= n)
+    {
+      guint64 word, quote, backslash;
+
+      memcpy(&word, s + i, sizeof(word));
+      quote = word ^ (ones * '"');
+      backslash = word ^ (ones * '\\');
+
+      if (((word - ones * 0x20) | word |
+           ((quote - ones) & ~quote) |
+           ((backslash - ones) & ~backslash)) & highs)
+        break;
+      i += sizeof(guint64);
+    }
+
+  while (i < n && !_is_byte_special(s[i]))
+    i++;
+  return i;
+}
+
+#if JSON_WRITER_HAVE_SSE2
+
+static gsize
+_find_special_byte(const guchar *s, gsize n)
+{
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i space = _mm_set1_epi8(0x20);
+  gsize i = 0;
+
+  while (i + 16 <= n)
+    {
+      __m128i block = _mm_loadu_si128((const __m128i *) (s + i));
+
+      /* signed comparison: both control characters and bytes >= 0x80
+       * (negative as signed) are less than a space */
+      __m128i match = _mm_or_si128(_mm_cmplt_epi8(block, space),
+                                   _mm_or_si128(_mm_cmpeq_epi8(block, quote),
+                                                _mm_cmpeq_epi8(block, backslash)));
+      guint32 mask = _mm_movemask_epi8(match);
+
+      if (mask)
+        return i + __builtin_ctz(mask);
+      i += 16;
+    }
+  return i + _find_special_byte_generic(s + i, n - i);
+}
+
+#else
+
+#define _find_special_byte _find_special_byte_generic
+
+#endif
+
+static const gchar hex_digits[] = "0123456789abcdef";
+
+static inline void
+_append_hex_escape(GString *dest, const gchar *prefix, gsize prefix_len, guchar c)
+{
+  g_string_append_len(dest, prefix, prefix_len);
+  g_string_append_c(dest, hex_digits[c >> 4]);
+  g_string_append_c(dest, hex_digits[c & 0xf]);
+}
+
+static inline void
+_append_escaped_ascii(GString *dest, guchar c)
+{
+  switch (c)
+    {
+    case '\b':
+      g_string_append_len(dest, "\\b", 2);
+      break;
+    case '\f':
+      g_string_append_len(dest, "\\f", 2);
+      break;
+    case '\n':
+      g_string_append_len(dest, "\\n", 2);
+      break;
+    case '\r':
+      g_string_append_len(dest, "\\r", 2);
+      break;
+    case '\t':
+      g_string_append_len(dest, "\\t", 2);
+      break;
+    case '\\':
+      g_string_append_len(dest, "\\\\", 2);
+      break;
+    case '"':
+      g_string_append_len(dest, "\\\"", 2);
+      break;
+    default:
+      _append_hex_escape(dest, "\\u00", 4, c);
+      break;
+    }
+}
+
+/* returns the number of input bytes consumed */
+static inline gsize
+_append_escaped_non_ascii(GString *dest, const gchar *str, gsize str_len)
+{
+  gunichar uchar = g_utf8_get_char_validated(str, str_len);
+
+  if (G_UNLIKELY(uchar == (gunichar) -1 || uchar == (gunichar) -2))
+    {
+      _append_hex_escape(dest, "\\\\x", 3, *(const guchar *) str);
+      return 1;
+    }
+
+  gsize char_len = g_utf8_next_char(str) - str;
+  g_string_append_len(dest, str, char_len);
+  return char_len;
+}
+
+void
+json_writer_append_escaped(GString *dest, const gchar *str, gssize str_len)
+{
+  const gchar *end;
+
+  if (str_len < 0)
+    str_len = strlen(str);
+  end = str + str_len;
+
+  json_writer_reserve(dest, str_len);
+  while (str < end)
+    {
+      gsize clean_len = _find_special_byte((const guchar *) str, end - str);
+
+      if (clean_len)
+        {
+          g_string_append_len(dest, str, clean_len);
+          str += clean_len;
+          if (str == end)
+            break;
+        }
+
+      if ((guchar) *str < 0x80)
+        {
+          _append_escaped_ascii(dest, *str);
+          str++;
+        }
+      else
+        {
+          str += _append_escaped_non_ascii(dest, str, end - str);
+        }
+    }
+}
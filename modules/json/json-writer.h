@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2020 One Identity
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef JSON_WRITER_H_INCLUDED
+#define JSON_WRITER_H_INCLUDED 1
+
+#include "syslog-ng.h"
+
+void json_writer_append_escaped(GString *dest, const gchar *str, gssize str_len);
+
+static inline void
+json_writer_reserve(GString *dest, gsize extra)
+{
+  gsize len = dest->len;
+
+  /* GString has no API to grow the allocation without changing the
+   * length, but it keeps the allocation when truncating */
+  if (dest->allocated_len <= len + extra)
+    {
+      g_string_set_size(dest, len + extra);
+      g_string_truncate(dest, len);
+    }
+}
+
+#endif
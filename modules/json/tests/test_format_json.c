@@ -24,11 +24,14 @@
 #include <criterion/criterion.h>
 
 #include "libtest/cr_template.h"
+#include "stopwatch.h"
 #include "apphook.h"
 #include "plugin.h"
 #include "cfg.h"
 #include "logmsg/logmsg.h"
 
+#define BENCHMARK_COUNT 100000
+
 void
 setup(void)
 {
@@ -241,6 +244,125 @@ Test(format_json, test_format_flat_json_with_type_hints)
                          "{\"b\":{\"subkey\":\"bar\"}}");
 }
 
+Test(format_json, test_format_json_escaping_in_long_values)
+{
+  LogMessage *msg = create_empty_message();
+
+  /* special characters at various offsets around the 8/16 byte blocks of the scanner */
+  log_msg_set_value_by_name(msg, "long1", "0123456789abcde\"0123456789abcdef\\", -1);
+  log_msg_set_value_by_name(msg, "long2", "01234567\n0123456789abcdef0123456\x01", -1);
+  log_msg_set_value_by_name(msg, "long3", "0123456789abcdef\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 0123456789\xad", -1);
+  log_msg_set_value_by_name(msg, "long4", "0123456789abcdef0123456789abcdef\xc3", -1);
+
+  assert_template_format_msg("$(format-json MSG=${long1})",
+                             "{\"MSG\":\"0123456789abcde\\\"0123456789abcdef\\\\\"}", msg);
+  assert_template_format_msg("$(format-json MSG=${long2})",
+                             "{\"MSG\":\"01234567\\n0123456789abcdef0123456\\u0001\"}", msg);
+  assert_template_format_msg("$(format-json MSG=${long3})",
+                             "{\"MSG\":\"0123456789abcdef\xc3\xa1rv\xc3\xadzt\xc5\xb1r\xc5\x91 0123456789\\\\xad\"}", msg);
+  assert_template_format_msg("$(format-json MSG=${long4})",
+                             "{\"MSG\":\"0123456789abcdef0123456789abcdef\\\\xc3\"}", msg);
+
+  log_msg_unref(msg);
+}
+
+Test(format_json, test_format_json_results_are_cached_for_multiple_destinations)
+{
+  LogTemplate *templ = compile_template("$(format-json --scope rfc5424 --key MSG)", FALSE);
+  LogTemplate *same_templ = compile_template("$(format-json --scope rfc5424 --key MSG)", FALSE);
+  LogMessage *msg = create_sample_message();
+  GString *res = g_string_new("");
+  GString *cached_res = g_string_new("");
+
+  log_msg_enable_result_cache(msg);
+  log_template_format(templ, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+  LogMessageCachedResult *cached_results = msg->cached_results;
+  cr_assert_not_null(cached_results);
+
+  /* served from the cache: no new entry */
+  log_template_format(same_templ, msg, NULL, LTZ_LOCAL, 0, NULL, cached_res);
+  cr_assert_str_eq(cached_res->str, res->str);
+  cr_assert_eq(msg->cached_results, cached_results);
+
+  /* a different time zone is a different key */
+  log_template_format(templ, msg, NULL, LTZ_SEND, 0, NULL, cached_res);
+  cr_assert_neq(msg->cached_results, cached_results);
+
+  log_msg_set_value_by_name(msg, "MSG", "changed", -1);
+  cr_assert_null(msg->cached_results);
+  log_template_format(same_templ, msg, NULL, LTZ_LOCAL, 0, NULL, cached_res);
+  cr_assert(strstr(cached_res->str, "\"MSG\":\"changed\""));
+
+  log_template_unref(templ);
+  log_template_unref(same_templ);
+  g_string_free(res, TRUE);
+  g_string_free(cached_res, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(format_json, test_format_json_results_depending_on_seqnum)
+{
+  LogTemplate *seqnum_in_pairs = compile_template("$(format-json seq=$SEQNUM)", FALSE);
+  LogTemplate *seqnum_outside = compile_template("$SEQNUM $(format-json MSG=$MSG)", FALSE);
+  LogMessage *msg = create_empty_message();
+  GString *res = g_string_new("");
+
+  log_msg_enable_result_cache(msg);
+  log_template_format(seqnum_in_pairs, msg, NULL, LTZ_LOCAL, 1, NULL, res);
+  cr_assert_str_eq(res->str, "{\"seq\":\"1\"}");
+  cr_assert_null(msg->cached_results);
+
+  log_template_format(seqnum_outside, msg, NULL, LTZ_LOCAL, 1, NULL, res);
+  cr_assert_str_eq(res->str, "1 {\"MSG\":\"árvíztűrőtükörfúrógép\"}");
+  log_template_format(seqnum_outside, msg, NULL, LTZ_LOCAL, 2, NULL, res);
+  cr_assert_str_eq(res->str, "2 {\"MSG\":\"árvíztűrőtükörfúrógép\"}");
+
+  log_template_unref(seqnum_in_pairs);
+  log_template_unref(seqnum_outside);
+  g_string_free(res, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(format_json, test_format_json_throughput)
+{
+  LogTemplate *templ = log_template_new(configuration, NULL);
+  LogMessage *msg = create_sample_message();
+  GString *res = g_string_sized_new(4096);
+  gsize total_bytes = 0;
+  guint64 elapsed_usec;
+  gint i;
+
+  /* make a typical 1-2KB event */
+  for (i = 0; i < 16; i++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "event.field%02d", i);
+      log_msg_set_value_by_name(msg, name,
+                                i % 4 == 0
+                                ? "GET /index.html?q=\"quoted\" HTTP/1.1\tMozilla/5.0 (X11; Linux x86_64)"
+                                : "plain ASCII value of a typical name-value pair from a parser", -1);
+    }
+
+  cr_assert(log_template_compile(templ, "$(format-json --scope rfc5424 --key event.*)", NULL));
+
+  start_stopwatch();
+  for (i = 0; i < BENCHMARK_COUNT; i++)
+    {
+      g_string_truncate(res, 0);
+      log_template_format(templ, msg, NULL, LTZ_LOCAL, 0, NULL, res);
+      total_bytes += res->len;
+    }
+  elapsed_usec = MAX(stop_stopwatch_and_get_result(), 1);
+
+  printf("      %-90s; %.2f MB/sec, event size=%" G_GSIZE_FORMAT " bytes\n",
+         "$(format-json) throughput", total_bytes / (gdouble) elapsed_usec, res->len);
+
+  log_template_unref(templ);
+  g_string_free(res, TRUE);
+  log_msg_unref(msg);
+}
+
 Test(format_json, test_format_json_performance)
 {
   perftest_template("$(format-json APP.*)\n");
@@ -22,8 +22,11 @@
 #include "json-parser.h"
 #include "apphook.h"
 #include "msg_parse_lib.h"
+#include "stopwatch.h"
 #include <criterion/criterion.h>
 
+#include <string.h>
+
 static LogMessage *
 parse_json_into_log_message_no_check(const gchar *json, LogParser *json_parser)
 {
@@ -182,3 +185,187 @@ Test(json_parser, test_json_parser_works_with_templates)
   log_msg_unref(msg);
   log_pipe_unref(&json_parser->super);
 }
+
+static LogParser *
+_construct_native_json_parser(void)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+
+  cr_assert(json_parser_set_backend(json_parser, "native"));
+  return json_parser;
+}
+
+Test(json_parser, test_json_parser_rejects_unknown_backends)
+{
+  LogParser *json_parser = json_parser_new(NULL);
+
+  cr_assert(json_parser_set_backend(json_parser, "json-c"));
+  cr_assert_not(json_parser_set_backend(json_parser, "foobar"));
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_native_backend_gives_the_same_results_as_json_c)
+{
+  const gchar *json = "{'int': 123, 'booltrue': true, 'boolfalse': false, 'double': 1.23, "
+                      "'object': {'member1': 'foo', 'member2': 'bar', 'nested': {'a': [1, {'b': 'c'}]}}, "
+                      "'array': [1, 2, [3, 4]], 'null': null, \"str\": \"a\\\"b\\\\c\\n\\u00e1\\ud83d\\ude00\", "
+                      "'big': 12345678901, 'neg': -42, 'zero': -0, 'exp': 1e3, 'empty': '', 'eobj': {}, 'earr': []}";
+  const gchar *keys[] =
+  {
+    ".prefix.int", ".prefix.booltrue", ".prefix.boolfalse", ".prefix.double",
+    ".prefix.object.member1", ".prefix.object.member2", ".prefix.object.nested.a[0]", ".prefix.object.nested.a[1].b",
+    ".prefix.array[0]", ".prefix.array[1]", ".prefix.array[2][0]", ".prefix.array[2][1]", ".prefix.null",
+    ".prefix.str", ".prefix.big", ".prefix.neg", ".prefix.zero", ".prefix.exp", ".prefix.empty",
+    NULL
+  };
+  LogParser *json_c_parser = json_parser_new(NULL);
+  LogParser *native_parser = _construct_native_json_parser();
+  LogMessage *json_c_msg, *native_msg;
+
+  json_parser_set_prefix(json_c_parser, ".prefix.");
+  json_parser_set_prefix(native_parser, ".prefix.");
+  json_c_msg = parse_json_into_log_message(json, json_c_parser);
+  native_msg = parse_json_into_log_message(json, native_parser);
+
+  for (gint i = 0; keys[i]; i++)
+    {
+      NVHandle handle = log_msg_get_value_handle(keys[i]);
+      gssize json_c_len, native_len;
+      const gchar *json_c_value = log_msg_get_value(json_c_msg, handle, &json_c_len);
+      const gchar *native_value = log_msg_get_value(native_msg, handle, &native_len);
+
+      cr_assert_eq(native_len, json_c_len, "value length mismatch for %s", keys[i]);
+      cr_assert_arr_eq(native_value, json_c_value, json_c_len, "value mismatch for %s: %.*s vs %.*s",
+                       keys[i], (gint) native_len, native_value, (gint) json_c_len, json_c_value);
+    }
+  assert_log_message_value(native_msg, log_msg_get_value_handle(".prefix.big"), "2147483647");
+  assert_log_message_value(native_msg, log_msg_get_value_handle(".prefix.str"), "a\"b\\c\n\xc3\xa1\xf0\x9f\x98\x80");
+
+  log_msg_unref(json_c_msg);
+  log_msg_unref(native_msg);
+  log_pipe_unref(&json_c_parser->super);
+  log_pipe_unref(&native_parser->super);
+}
+
+Test(json_parser, test_native_backend_references_unescaped_values_in_message)
+{
+  LogMessage *msg;
+  LogParser *json_parser = _construct_native_json_parser();
+  json_parser_set_marker(json_parser, "@cee:");
+  msg = parse_json_into_log_message("@cee: {\"foo\": \"bar\", \"baz\": \"esc\\taped\"}", json_parser);
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  assert_log_message_value(msg, log_msg_get_value_handle("baz"), "esc\taped");
+
+  const gchar *message = log_msg_get_value(msg, LM_V_MESSAGE, NULL);
+  const gchar *foo = log_msg_get_value(msg, log_msg_get_value_handle("foo"), NULL);
+  cr_assert(foo > message && foo < message + strlen(message), "foo should be an indirect value referencing MESSAGE");
+
+  log_msg_unref(msg);
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_native_backend_stores_a_message_key_after_the_other_values)
+{
+  LogMessage *msg;
+  LogParser *json_parser = _construct_native_json_parser();
+
+  msg = parse_json_into_log_message("{\"MESSAGE\": \"x\", \"foo\": \"bar\", \"baz\": \"esc\\taped\"}", json_parser);
+  assert_log_message_value(msg, LM_V_MESSAGE, "x");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  assert_log_message_value(msg, log_msg_get_value_handle("baz"), "esc\taped");
+  log_msg_unref(msg);
+
+  msg = parse_json_into_log_message("{\"MESSAGE\": \"a long first value\", \"MESSAGE\": \"y\", \"foo\": \"bar\"}",
+                                    json_parser);
+  assert_log_message_value(msg, LM_V_MESSAGE, "y");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  log_msg_unref(msg);
+
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_native_backend_extracts_subobjects_if_extract_prefix_is_specified)
+{
+  LogMessage *msg;
+  LogParser *json_parser = _construct_native_json_parser();
+
+  json_parser_set_extract_prefix(json_parser, "[1].inner");
+  msg = parse_json_into_log_message("[{'foo':'bar'}, {'inner': {'bar':'foo', 'list': [1]}, 'other': 'x'}]", json_parser);
+  assert_log_message_value(msg, log_msg_get_value_handle("bar"), "foo");
+  assert_log_message_value(msg, log_msg_get_value_handle("list[0]"), "1");
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "");
+  assert_log_message_value(msg, log_msg_get_value_handle("other"), "");
+  log_msg_unref(msg);
+
+  assert_json_parser_fails("[{'foo':'bar'}, {'inner': 'not-an-object'}]", json_parser);
+  assert_json_parser_fails("[{'foo':'bar'}]", json_parser);
+  log_pipe_unref(&json_parser->super);
+}
+
+Test(json_parser, test_native_backend_fails_for_invalid_json)
+{
+  const gchar *invalid_inputs[] =
+  {
+    "not-valid-json", "", "   ", "[1, 2, 3]", "'string'",
+    "{", "{'foo'}", "{'foo': }", "{'foo': 'bar',}", "{'foo': 'bar' 'baz': 1}",
+    "{'foo': \"unterminated}", "{'foo': \"\\x\"}", "{'foo': \"\\u12\"}",
+    "{'foo': 01.}", "{'foo': -}", "{'foo': 1e}", "{'foo': tru}", "{'foo': [1, 2}",
+    "{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':"
+    "{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a':{'a': 1}}}}}}}}}}}}}}}}"
+    "}}}}}}}}}}}}}}}}}",
+    NULL
+  };
+  LogParser *json_parser = _construct_native_json_parser();
+  LogMessage *msg;
+
+  for (gint i = 0; invalid_inputs[i]; i++)
+    assert_json_parser_fails(invalid_inputs[i], json_parser);
+
+  /* trailing data is ignored, just like with json-c */
+  msg = parse_json_into_log_message("{'foo': 'bar'} trailing", json_parser);
+  assert_log_message_value(msg, log_msg_get_value_handle("foo"), "bar");
+  log_msg_unref(msg);
+  log_pipe_unref(&json_parser->super);
+}
+
+static void
+_benchmark_backend(LogParser *json_parser, const gchar *backend, const gchar *json)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_msg_new_empty();
+  const gint iterations = 20000;
+
+  log_msg_set_value(msg, LM_V_MESSAGE, json, -1);
+  start_stopwatch();
+  for (gint i = 0; i < iterations; i++)
+    {
+      LogMessage *clone = log_msg_clone_cow(msg, &path_options);
+
+      cr_assert(log_parser_process_message(json_parser, &clone, &path_options));
+      log_msg_unref(clone);
+    }
+  stop_stopwatch_and_display_result(iterations, "json-parser(backend(%s)), %d bytes of nested JSON",
+                                    backend, (gint) strlen(json));
+  log_msg_unref(msg);
+}
+
+Test(json_parser, test_json_parser_performance)
+{
+  const gchar *json =
+    "{\"@timestamp\": \"2020-06-15T10:22:31.123Z\", \"host\": {\"name\": \"web-frontend-01\", \"ip\": [\"10.0.1.15\", "
+    "\"fe80::1\"], \"os\": {\"family\": \"debian\", \"version\": \"10\"}}, \"http\": {\"request\": {\"method\": \"GET\", "
+    "\"referrer\": \"https://www.example.com/index.html\", \"bytes\": 1024}, \"response\": {\"status_code\": 200, "
+    "\"bytes\": 48213}}, \"url\": {\"original\": \"/api/v1/users?id=1234&fields=name,email\", \"path\": "
+    "\"/api/v1/users\"}, \"user_agent\": {\"original\": \"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 "
+    "(KHTML, like Gecko) Chrome/83.0.4103.97 Safari/537.36\"}, \"event\": {\"duration\": 0.0342, \"outcome\": "
+    "\"success\", \"tags\": [\"frontend\", \"production\", \"eu-west-1\"]}, \"message\": \"GET /api/v1/users "
+    "returned \\\"200 OK\\\" in 34ms\"}";
+  LogParser *json_c_parser = json_parser_new(NULL);
+  LogParser *native_parser = _construct_native_json_parser();
+
+  _benchmark_backend(json_c_parser, "json-c", json);
+  _benchmark_backend(native_parser, "native", json);
+
+  log_pipe_unref(&json_c_parser->super);
+  log_pipe_unref(&native_parser->super);
+}
@@ -32,6 +32,7 @@
 #include "str-format.h"
 #include "utf8utils.h"
 #include "str-utils.h"
+#include "tls-support.h"
 
 #include <regex.h>
 #include <ctype.h>
@@ -507,6 +508,63 @@ sd_step(const guchar **data, gint *left)
   (*left)--;
 }
 
+/*
+ * SD value names (".SDATA.<SD-ID>.<PARAM-NAME>") are mapped to their
+ * NVHandle through a small per-thread cache, so that the registry (and its
+ * lock) is only consulted the first time a name is seen by a thread.  A
+ * cached handle is validated against the registry by its name, so stale
+ * entries are never returned.
+ */
+#define SD_HANDLE_CACHE_SIZE 64
+
+typedef struct _SDHandleCacheEntry
+{
+  guint hash;
+  NVHandle handle;
+} SDHandleCacheEntry;
+
+TLS_BLOCK_START
+{
+  SDHandleCacheEntry sd_handle_cache[SD_HANDLE_CACHE_SIZE];
+}
+TLS_BLOCK_END;
+
+#define sd_handle_cache __tls_deref(sd_handle_cache)
+
+static NVHandle
+sd_lookup_value_handle(const gchar *name, gsize name_len)
+{
+  guint hash = 5381;
+
+  for (gsize i = 0; i < name_len; i++)
+    hash = (hash << 5) + hash + name[i];
+
+  SDHandleCacheEntry *entry = &sd_handle_cache[hash % SD_HANDLE_CACHE_SIZE];
+  if (entry->handle && entry->hash == hash)
+    {
+      gssize cached_name_len = 0;
+      const gchar *cached_name = log_msg_get_value_name(entry->handle, &cached_name_len);
+
+      if (cached_name && cached_name_len == name_len && memcmp(cached_name, name, name_len) == 0)
+        return entry->handle;
+    }
+
+  entry->hash = hash;
+  entry->handle = log_msg_get_value_handle(name);
+  return entry->handle;
+}
+
+/* values without escapes are referenced from the raw message if it is
+ * stored, instead of being copied */
+static void
+sd_set_value(LogMessage *self, NVHandle handle, const guchar *value, gsize value_len, const guchar *raw_data)
+{
+  if (raw_data && value_len > 0 && value - raw_data + value_len <= G_MAXUINT16)
+    log_msg_set_value_indirect(self, handle, handles.raw_message, 0, value - raw_data, value_len);
+  else
+    log_msg_set_value(self, handle, (const gchar *) value, value_len);
+}
+
 /**
  * log_msg_parse:
  * @self: LogMessage instance to store parsed information into
@@ -519,7 +577,8 @@ sd_step(const guchar **data, gint *left)
  * in @self.values and dup the SD string. Parsing is affected by the bits set @flags argument.
  **/
 static gboolean
-log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgFormatOptions *options)
+log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgFormatOptions *options,
+                 const guchar *raw_data)
 {
   /*
    * STRUCTURED-DATA = NILVALUE / 1*SD-ELEMENT
@@ -547,7 +606,9 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
   /* UTF-8 string */
   gchar sd_param_value[options->sdata_param_value_max + 1];
   gsize sd_param_value_len;
-  gchar sd_value_name[66];
+  /* prefix, SD-ID, '.', PARAM-NAME */
+  gchar sd_value_name[80];
+  gsize sd_value_name_len;
 
   guint open_sd = 0;
   gint left = *length, pos;
@@ -600,7 +661,7 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
           strncpy(sd_value_name + logmsg_sd_prefix_len, sd_id_name, sizeof(sd_value_name) - logmsg_sd_prefix_len);
           if (*src == ']')
             {
-              log_msg_set_value_by_name(self, sd_value_name, "", 0);
+              log_msg_set_value(self, sd_lookup_value_handle(sd_value_name, logmsg_sd_prefix_len + pos), "", 0);
             }
           else
             {
@@ -641,6 +702,7 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
               sd_param_name[pos] = 0;
               strncpy(&sd_value_name[logmsg_sd_prefix_len + 1 + sd_id_len], sd_param_name,
                       sizeof(sd_value_name) - logmsg_sd_prefix_len - 1 - sd_id_len);
+              sd_value_name_len = logmsg_sd_prefix_len + 1 + sd_id_len + pos;
 
               if (left && *src == '=')
                 sd_step(&src, &left);
@@ -652,42 +714,69 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
               if (left && *src == '"')
                 {
                   gboolean quote = FALSE;
+                  gboolean escaped = FALSE;
+                  const guchar *value_start;
+
                   /* opening quote */
                   sd_step(&src, &left);
+                  value_start = src;
                   pos = 0;
 
+                  /* the value is only copied to sd_param_value once an
+                   * escape is found, until then it is used in place */
                   while (left && (*src != '"' || quote))
                     {
                       if (!quote && *src == '\\')
                         {
+                          if (!escaped)
+                            {
+                              pos = MIN(src - value_start, sizeof(sd_param_value) - 1);
+                              memcpy(sd_param_value, value_start, pos);
+                              escaped = TRUE;
+                            }
                           quote = TRUE;
                         }
                       else
                         {
-                          if (quote && *src != '"' && *src != ']' && *src != '\\' && pos < sizeof(sd_param_value) - 1)
-                            {
-                              sd_param_value[pos] = '\\';
-                              pos++;
-                            }
-                          else if (!quote &&  *src == ']')
+                          if (!quote && *src == ']')
                             {
                               sd_step(&src, &left);
                               goto error;
                             }
-                          if (pos < sizeof(sd_param_value) - 1)
+                          if (escaped)
                             {
-                              sd_param_value[pos] = *src;
-                              pos++;
+                              if (quote && *src != '"' && *src != ']' && *src != '\\' && pos < sizeof(sd_param_value) - 1)
+                                {
+                                  sd_param_value[pos] = '\\';
+                                  pos++;
+                                }
+                              if (pos < sizeof(sd_param_value) - 1)
+                                {
+                                  sd_param_value[pos] = *src;
+                                  pos++;
+                                }
                             }
                           quote = FALSE;
                         }
                       sd_step(&src, &left);
                     }
-                  sd_param_value[pos] = 0;
-                  sd_param_value_len = pos;
 
                   if (left && *src == '"')/* closing quote */
-                    sd_step(&src, &left);
+                    {
+                      NVHandle handle = sd_lookup_value_handle(sd_value_name, sd_value_name_len);
+
+                      if (escaped)
+                        {
+                          sd_param_value_len = pos;
+                          log_msg_set_value(self, handle, sd_param_value, sd_param_value_len);
+                        }
+                      else
+                        {
+                          sd_param_value_len = MIN(src - value_start, sizeof(sd_param_value) - 1);
+                          sd_set_value(self, handle, value_start, sd_param_value_len, raw_data);
+                        }
+                      sd_step(&src, &left);
+                    }
                   else
                     goto error;
                 }
@@ -695,8 +784,6 @@ log_msg_parse_sd(LogMessage *self, const guchar **data, gint *length, const MsgF
                 {
                   goto error;
                 }
-
-              log_msg_set_value_by_name(self, sd_value_name, sd_param_value, sd_param_value_len);
             }
 
           if (left && *src == ']')
@@ -945,7 +1032,8 @@ log_msg_parse_syslog_proto(const MsgFormatOptions *parse_options, const guchar *
     goto error;
 
   /* structured data part */
-  if (!log_msg_parse_sd(self, &src, &left, parse_options))
+  if (!log_msg_parse_sd(self, &src, &left, parse_options,
+                        (parse_options->flags & LP_STORE_RAW_MESSAGE) ? data : NULL))
     goto error;
 
   /* checking if there are remaining data in log message */
@@ -37,6 +37,7 @@ typedef struct _DateParser
 {
   LogParser super;
   GList *date_formats;
+  GPtrArray *compiled_date_formats;
   gchar *date_tz;
   LogMessageTimeStamp time_stamp;
   TimeZoneInfo *date_tz_info;
@@ -69,11 +70,32 @@ date_parser_set_time_stamp(LogParser *s, LogMessageTimeStamp time_stamp)
   self->time_stamp = time_stamp;
 }
 
+static void
+_free_compiled_date_format(gpointer format)
+{
+  if (format)
+    wall_clock_time_format_free((WallClockTimeFormat *) format);
+}
+
+/* formats that cannot be compiled remain NULL and are interpreted by
+ * wall_clock_time_strptime() instead */
+static void
+_compile_date_formats(DateParser *self)
+{
+  if (self->compiled_date_formats)
+    g_ptr_array_free(self->compiled_date_formats, TRUE);
+
+  self->compiled_date_formats = g_ptr_array_new_with_free_func(_free_compiled_date_format);
+  for (GList *item = self->date_formats; item; item = item->next)
+    g_ptr_array_add(self->compiled_date_formats, wall_clock_time_format_new(item->data));
+}
+
 static gboolean
 date_parser_init(LogPipe *s)
 {
   DateParser *self = (DateParser *) s;
 
+  _compile_date_formats(self);
   if (self->date_tz_info)
     time_zone_info_free(self->date_tz_info);
   self->date_tz_info = self->date_tz ? time_zone_info_new(self->date_tz) : NULL;
@@ -83,7 +105,7 @@ date_parser_init(LogPipe *s)
 /* NOTE: tm is initialized with the current time and date */
 static gboolean
 _parse_timestamp_and_deduce_missing_parts(DateParser *self, WallClockTime *wct, const gchar *input,
-                                          const gchar *date_format)
+                                          const gchar *date_format, const WallClockTimeFormat *compiled_date_format)
 {
   const gchar *remainder;
 
@@ -91,7 +113,10 @@ _parse_timestamp_and_deduce_missing_parts(DateParser *self, WallClockTime *wct,
             evt_tag_str("input", input),
             evt_tag_str("date_format", date_format));
 
-  remainder = wall_clock_time_strptime(wct, date_format, input);
+  if (compiled_date_format)
+    remainder = wall_clock_time_format_parse(compiled_date_format, wct, input);
+  else
+    remainder = wall_clock_time_strptime(wct, date_format, input);
 
   if (!remainder || remainder[0])
     return FALSE;
@@ -107,9 +132,12 @@ _parse_timestamp_and_deduce_missing_parts(DateParser *self, WallClockTime *wct,
 static gboolean
 _parse_timestamp_against_date_format_list(DateParser *self, WallClockTime *wct, const gchar *input)
 {
-  for (GList *item = self->date_formats; item; item = item->next)
+  guint i = 0;
+
+  for (GList *item = self->date_formats; item; item = item->next, i++)
     {
-      if (_parse_timestamp_and_deduce_missing_parts(self, wct, input, item->data))
+      if (_parse_timestamp_and_deduce_missing_parts(self, wct, input, item->data,
+                                                    g_ptr_array_index(self->compiled_date_formats, i)))
         return TRUE;
     }
 
@@ -180,6 +208,8 @@ date_parser_free(LogPipe *s)
   DateParser *self = (DateParser *)s;
 
   string_list_free(self->date_formats);
+  if (self->compiled_date_formats)
+    g_ptr_array_free(self->compiled_date_formats, TRUE);
   g_free(self->date_tz);
   if (self->date_tz_info)
     time_zone_info_free(self->date_tz_info);
@@ -239,3 +239,35 @@ Test(dnscache, test_lru_lists)
   _fill_dns_cache(cache, cache_size);
   dns_cache_free(cache);
 }
+
+static gpointer
+_lookup_in_thread(gpointer user_data)
+{
+  guint32 ni = htonl(GPOINTER_TO_UINT(user_data));
+  gchar hostname[16];
+  gsize hostname_len;
+  gboolean positive;
+
+  if (!dns_caching_lookup(AF_INET, (void *) &ni, hostname, sizeof(hostname), &hostname_len, &positive))
+    return NULL;
+  return g_strndup(hostname, hostname_len);
+}
+
+Test(dnscache, test_global_cache_is_shared_between_threads)
+{
+  guint32 ni = htonl(1234);
+  gchar *hostname;
+
+  cr_assert_not(dns_caching_is_cached(AF_INET, (void *) &ni));
+  dns_caching_store(AF_INET, (void *) &ni, "a-rather-long-hostname", TRUE);
+  cr_assert(dns_caching_is_cached(AF_INET, (void *) &ni));
+
+  /* the hostname is truncated to the size of the buffer */
+  GThread *thread = g_thread_create(_lookup_in_thread, GUINT_TO_POINTER(1234), TRUE, NULL);
+  hostname = g_thread_join(thread);
+  cr_assert_str_eq(hostname, "a-rather-long-h");
+  g_free(hostname);
+
+  thread = g_thread_create(_lookup_in_thread, GUINT_TO_POINTER(4321), TRUE, NULL);
+  cr_assert_null(g_thread_join(thread));
+}
@@ -26,6 +26,7 @@
 #include "find-crlf.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 struct findcrlf_params
 {
@@ -138,3 +139,142 @@ ParameterizedTest(struct findcrlf_params *params, findcrlf, test)
                 "EOM is at wrong location. msg=%s, eom_ofs=%d, eom=%s\n",
                 params->msg, (gint) params->eom_ofs, eom);
 }
+
+static FindCrlfImpl all_impls[] =
+{
+  FIND_CRLF_IMPL_GENERIC,
+  FIND_CRLF_IMPL_SSE2,
+  FIND_CRLF_IMPL_AVX2,
+};
+
+static const gchar *
+_impl_name(FindCrlfImpl impl)
+{
+  switch (impl)
+    {
+    case FIND_CRLF_IMPL_GENERIC:
+      return "generic";
+    case FIND_CRLF_IMPL_SSE2:
+      return "sse2";
+    case FIND_CRLF_IMPL_AVX2:
+      return "avx2";
+    default:
+      return "auto";
+    }
+}
+
+static void
+_teardown(void)
+{
+  find_crlf_set_impl(FIND_CRLF_IMPL_AUTO);
+}
+
+Test(findcrlf, all_implementations_find_the_same_terminator_at_every_offset, .fini = _teardown)
+{
+  const gchar terminators[] = { '\r', '\n', '\0' };
+  gchar buffer[160];
+
+  for (gint impl = 0; impl < G_N_ELEMENTS(all_impls); impl++)
+    {
+      if (!find_crlf_set_impl(all_impls[impl]))
+        continue;
+
+      for (gint t = 0; t < G_N_ELEMENTS(terminators); t++)
+        {
+          for (gint start = 0; start < 32; start++)
+            {
+              for (gint pos = start; pos < sizeof(buffer); pos++)
+                {
+                  memset(buffer, 'a', sizeof(buffer));
+                  buffer[pos] = terminators[t];
+
+                  gchar *eol = find_cr_or_lf(buffer + start, sizeof(buffer) - start);
+                  const guchar *eom = find_lf_or_nul((guchar *) buffer + start, sizeof(buffer) - start);
+
+                  if (terminators[t] == '\0')
+                    cr_assert_null(eol, "NUL should terminate the search, impl=%s, pos=%d", _impl_name(all_impls[impl]), pos);
+                  else
+                    cr_assert_eq(eol, buffer + pos, "impl=%s, start=%d, pos=%d", _impl_name(all_impls[impl]), start, pos);
+
+                  if (terminators[t] == '\r')
+                    cr_assert_null(eom, "CR is not an EOM character, impl=%s, pos=%d", _impl_name(all_impls[impl]), pos);
+                  else
+                    cr_assert_eq(eom, (guchar *) buffer + pos, "impl=%s, start=%d, pos=%d", _impl_name(all_impls[impl]), start,
+                                 pos);
+
+                  /* the terminator is just beyond the length limit */
+                  cr_assert_null(find_cr_or_lf(buffer + start, pos - start));
+                  cr_assert_null(find_lf_or_nul((guchar *) buffer + start, pos - start));
+                }
+            }
+        }
+    }
+}
+
+#define BENCHMARK_BUFFER_SIZE (64 * 1024 * 1024)
+#define BENCHMARK_ROUNDS 4
+
+static gchar *
+_generate_log_file_contents(gsize size)
+{
+  gchar *buffer = g_malloc(size);
+  gsize pos = 0;
+  guint seed = 0;
+
+  while (pos < size)
+    {
+      /* typical syslog line lengths, between 80 and 400 bytes */
+      seed = seed * 1103515245 + 12345;
+      gsize line_len = MIN(80 + (seed >> 16) % 320, size - pos);
+
+      for (gsize i = 0; i + 1 < line_len; i++)
+        buffer[pos + i] = 'a' + (i % 26);
+      buffer[pos + line_len - 1] = '\n';
+      pos += line_len;
+    }
+  return buffer;
+}
+
+Test(findcrlf, benchmark_line_splitting_throughput, .fini = _teardown)
+{
+  gchar *buffer = _generate_log_file_contents(BENCHMARK_BUFFER_SIZE);
+  gsize expected_lines = 0;
+
+  for (gint impl = 0; impl < G_N_ELEMENTS(all_impls); impl++)
+    {
+      if (!find_crlf_set_impl(all_impls[impl]))
+        {
+          printf("find_cr_or_lf() benchmark: %s is not supported by this CPU\n", _impl_name(all_impls[impl]));
+          continue;
+        }
+
+      gsize lines = 0;
+      gint64 start = g_get_monotonic_time();
+
+      for (gint round = 0; round < BENCHMARK_ROUNDS; round++)
+        {
+          gchar *p = buffer;
+          gchar *end = buffer + BENCHMARK_BUFFER_SIZE;
+          gchar *eol;
+
+          while ((eol = find_cr_or_lf(p, end - p)))
+            {
+              lines++;
+              p = eol + 1;
+            }
+        }
+
+      gint64 elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+      if (expected_lines == 0)
+        expected_lines = lines;
+      cr_assert_eq(lines, expected_lines, "Implementations disagree on the number of lines, impl=%s",
+                   _impl_name(all_impls[impl]));
+
+      printf("find_cr_or_lf() benchmark: impl=%s, lines=%" G_GSIZE_FORMAT ", throughput=%.2f GB/s\n",
+             _impl_name(all_impls[impl]), lines,
+             ((gdouble) BENCHMARK_BUFFER_SIZE * BENCHMARK_ROUNDS) / elapsed / 1000.0);
+    }
+
+  g_free(buffer);
+}
@@ -125,6 +125,23 @@ testcase_replace(const gchar *log, const gchar *re, gchar *replacement, const gc
   log_msg_unref(msg);
 }
 
+void
+testcase_required_literal(const gchar *pattern, const gchar *expected_literal, LogMatcher *m)
+{
+  gchar *literal;
+
+  cr_assert(log_matcher_compile(m, pattern, NULL), "pattern=%s", pattern);
+  literal = log_matcher_get_required_literal(m);
+
+  if (expected_literal)
+    cr_assert_str_eq(literal, expected_literal, "pattern=%s, literal=%s, expected=%s\n",
+                     pattern, literal, expected_literal);
+  else
+    cr_assert_null(literal, "pattern=%s, literal=%s, expected=NULL\n", pattern, literal);
+
+  g_free(literal);
+  log_matcher_unref(m);
+}
 
 void
 setup(void)
@@ -194,6 +211,30 @@ Test(matcher, disable_jit)
                    "favíz", "favíztűrőtükörfúrógép", _construct_matcher(LMF_DISABLE_JIT, log_matcher_pcre_re_new));
 }
 
+static void
+_assert_named_substrings_are_stored(gint matcher_flags)
+{
+  LogMatcher *m = _construct_matcher(LMF_STORE_MATCHES | matcher_flags, log_matcher_pcre_re_new);
+  LogMessage *msg = _create_log_message("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: user=bar id=42");
+
+  cr_assert(log_matcher_compile(m, "user=(?<user>[a-z]+) (?<key>[a-z]+)=(?<value>[0-9]+)", NULL));
+  cr_assert(log_matcher_match(m, msg, LM_V_MESSAGE, log_msg_get_value(msg, LM_V_MESSAGE, NULL), -1));
+
+  assert_log_message_value_by_name(msg, "user", "bar");
+  assert_log_message_value_by_name(msg, "key", "id");
+  assert_log_message_value_by_name(msg, "value", "42");
+  assert_log_message_value_by_name(msg, "3", "42");
+
+  log_matcher_unref(m);
+  log_msg_unref(msg);
+}
+
+Test(matcher, named_substrings)
+{
+  _assert_named_substrings_are_stored(0);
+  _assert_named_substrings_are_stored(LMF_DISABLE_JIT);
+}
+
 Test(matcher, string_match)
 {
   testcase_replace("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: árvíztűrőtükörfúrógép", "árvíz",
@@ -270,3 +311,22 @@ Test(matcher, pcre812_incompatibility, .description = "tests a pcre 8.12 incompa
   testcase_replace("<155>2006-02-11T10:34:56+01:00 bzorp syslog-ng[23323]: wikiwiki",
                    "([[:digit:]]{1,3}\\.){3}[[:digit:]]{1,3}", "foo", "wikiwiki", _construct_matcher(LMF_GLOBAL, log_matcher_pcre_re_new));
 }
+
+Test(matcher, required_literal)
+{
+  testcase_required_literal("session opened", "session opened", _construct_matcher(0, log_matcher_string_new));
+  testcase_required_literal("sshd*session", "session", _construct_matcher(0, log_matcher_glob_new));
+
+  testcase_required_literal("^Accepted (password|publickey) for", "Accepted ",
+                            _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("failed\\.+login attempts?", "login attempt",
+                            _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("port \\d{2,5} via ssh2", " via ssh2", _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("\\x41\\x42C[abc]+ def", " def", _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("(?i)error", "error", _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("error|warning", NULL, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("(?x) e r r o r", NULL, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("\\Qa.b\\E", NULL, _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("árvíz?", "árví", _construct_matcher(0, log_matcher_pcre_re_new));
+  testcase_required_literal("árvíz", "rv", _construct_matcher(LMF_ICASE, log_matcher_pcre_re_new));
+}
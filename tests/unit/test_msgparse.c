@@ -1053,6 +1053,49 @@ Test(msgparse, test_expected_sd_pairs_without_sd_param)
   run_parameterized_test(params);
 }
 
+Test(msgparse, test_expected_sd_pairs_referencing_the_raw_message)
+{
+  struct sdata_pair expected_sd_pairs[] =
+  {
+    { ".SDATA.exampleSDID@0.iut", "3"},
+    { ".SDATA.exampleSDID@0.eventSource", "Application"},
+    { ".SDATA.exampleSDID@0.escaped", "quote\"bracket]backslash\\"},
+    { ".SDATA.examplePriority@0.class", "high"},
+    { ".SDATA.examplePriority@0.empty", ""},
+    {  NULL, NULL }
+  };
+
+  struct msgparse_params params[] =
+  {
+    {
+      "<7>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\" eventSource=\"Application\" escaped=\"quote\\\"bracket\\]backslash\\\\\"][examplePriority@0 class=\"high\" empty=\"\"] An application event log entry...",
+      LP_SYSLOG_PROTOCOL | LP_STORE_RAW_MESSAGE, NULL,
+      7,             // pri
+      1162083599, 156000, 3600,    // timestamp (sec/usec/zone)
+      "mymachine",       // host
+      "evntslog", //app
+      "An application event log entry...", // msg
+      "[exampleSDID@0 iut=\"3\" eventSource=\"Application\" escaped=\"quote\\\"bracket\\]backslash\\\\\"][examplePriority@0 class=\"high\" empty=\"\"]", //sd_str
+      NULL,//processid
+      NULL,//msgid
+      expected_sd_pairs
+    },
+    {NULL}
+  };
+
+  run_parameterized_test(params);
+}
+
+Test(msgparse, test_sd_values_survive_changing_the_raw_message)
+{
+  LogMessage *msg = _parse_log_message("<7>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\"] msg",
+                                       LP_SYSLOG_PROTOCOL | LP_STORE_RAW_MESSAGE, NULL);
+
+  log_msg_set_value_by_name(msg, "RAWMSG", "overwritten", -1);
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, ".SDATA.exampleSDID@0.iut", NULL), "3");
+  log_msg_unref(msg);
+}
+
 Test(msgparse, test_ip_in_host)
 {
   struct msgparse_params params[] =